@@ -63,6 +63,7 @@
 #include <cstdlib>
 #include <util.h>
 
+#include "benchmark_hist.hpp"
 #include "benchmark_time.hpp"
 #include "os.h"
 
@@ -72,6 +73,9 @@
 #define RRAND(max, min) (rand() % ((max) - (min)) + (min))
 #define RRAND_R(seed, max, min) (os_rand_r(seed) % ((max) - (min)) + (min))
 
+/* maximum number of latency percentiles reported */
+#define BENCHMARK_MAX_PCTLS 16
+
 struct benchmark;
 
 /*
@@ -97,6 +101,13 @@ struct benchmark_args {
 	unsigned seed;		 /* PRNG seed */
 	unsigned repeats;	/* number of repeats of one scenario */
 	unsigned min_exe_time;   /* minimal execution time */
+	char *percentiles;       /* latency percentiles to report */
+	char *output_format;     /* format of results */
+	char *timer;		 /* source of latency timestamps */
+	bool use_rdtsc;		 /* latency measured with rdtsc */
+	size_t rate;		 /* target operations per second per thread */
+	char *arrival;		 /* distribution of operations arrivals */
+	bool poisson;		 /* Poisson arrivals in open-loop mode */
 	bool help;		 /* print help for benchmark */
 	void *opts;		 /* benchmark specific arguments */
 };
@@ -129,9 +140,9 @@ struct latency {
 	uint64_t min;
 	uint64_t avg;
 	double std_dev;
-	uint64_t pctl50_0p;
-	uint64_t pctl99_0p;
-	uint64_t pctl99_9p;
+	size_t npctls;			     /* number of percentiles */
+	double pctl[BENCHMARK_MAX_PCTLS];    /* requested percentiles */
+	uint64_t pctl_val[BENCHMARK_MAX_PCTLS]; /* values at percentiles */
 };
 
 /*
@@ -140,7 +151,6 @@ struct latency {
 struct thread_results {
 	benchmark_time_t beg;
 	benchmark_time_t end;
-	benchmark_time_t end_op[];
 };
 
 /*
@@ -161,6 +171,9 @@ struct total_results {
 	struct results total;
 	struct latency latency;
 	struct bench_results *res;
+	struct benchmark_hist *hist;	 /* latencies of all repeats */
+	double nsecs_per_tick;		 /* histogram unit in nanoseconds */
+	unsigned long long get_time_avg; /* timestamp cost in nanoseconds */
 };
 
 /*
@@ -254,6 +267,7 @@ struct worker_info {
 	void *priv;		       /* worker's private data */
 	benchmark_time_t beg;	  /* start time */
 	benchmark_time_t end;	  /* end time */
+	struct benchmark_hist *hist;   /* latencies of operations */
 };
 
 /*
@@ -263,7 +277,6 @@ struct operation_info {
 	struct worker_info *worker;  /* worker's info */
 	struct benchmark_args *args; /* benchmark arguments */
 	size_t index;		     /* operation's index */
-	benchmark_time_t end;	/* operation's end time */
 };
 
 /*
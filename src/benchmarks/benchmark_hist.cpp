@@ -0,0 +1,275 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*
+ * benchmark_hist.cpp -- latency histogram module definitions
+ *
+ * The histogram uses log-linear buckets, as described by the HdrHistogram
+ * project: values below HIST_SUB_COUNT are recorded exactly and every
+ * following power of two range is split into HIST_HALF_COUNT equal
+ * buckets. This keeps the relative error of any reported value below
+ * 1 / HIST_HALF_COUNT while the memory footprint does not depend on the
+ * number of recorded values.
+ */
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "benchmark_hist.hpp"
+#include "util.h"
+
+#define HIST_SUB_BITS 10
+#define HIST_SUB_COUNT (1ULL << HIST_SUB_BITS)
+#define HIST_HALF_COUNT (HIST_SUB_COUNT >> 1)
+#define HIST_NBUCKETS ((64 - HIST_SUB_BITS + 2) * HIST_HALF_COUNT)
+
+/*
+ * struct benchmark_hist -- latency histogram
+ */
+struct benchmark_hist {
+	uint64_t count; /* number of recorded values */
+	uint64_t min;   /* smallest recorded value */
+	uint64_t max;   /* largest recorded value */
+	double sum;     /* sum of recorded values */
+	double sum_sq;  /* sum of squares of recorded values */
+	uint64_t buckets[HIST_NBUCKETS];
+};
+
+/*
+ * hist_bucket -- (internal) return index of the bucket for given value
+ */
+static inline size_t
+hist_bucket(uint64_t value)
+{
+	if (value < HIST_SUB_COUNT)
+		return (size_t)value;
+
+	unsigned shift = util_mssb_index64(value) - HIST_SUB_BITS + 1;
+
+	return (size_t)(shift * HIST_HALF_COUNT + (value >> shift));
+}
+
+/*
+ * hist_bucket_value -- (internal) return the highest value which falls into
+ * the bucket of given index
+ */
+static uint64_t
+hist_bucket_value(size_t idx)
+{
+	if (idx < HIST_SUB_COUNT)
+		return idx;
+
+	unsigned shift = (unsigned)(idx / HIST_HALF_COUNT - 1);
+	uint64_t low = (idx - shift * HIST_HALF_COUNT) << shift;
+
+	return low + ((1ULL << shift) - 1);
+}
+
+/*
+ * benchmark_hist_alloc -- allocate an empty histogram
+ */
+struct benchmark_hist *
+benchmark_hist_alloc(void)
+{
+	struct benchmark_hist *hist =
+		(struct benchmark_hist *)malloc(sizeof(*hist));
+	if (hist == nullptr)
+		return nullptr;
+
+	benchmark_hist_reset(hist);
+
+	return hist;
+}
+
+/*
+ * benchmark_hist_free -- release histogram
+ */
+void
+benchmark_hist_free(struct benchmark_hist *hist)
+{
+	free(hist);
+}
+
+/*
+ * benchmark_hist_reset -- remove all recorded values
+ */
+void
+benchmark_hist_reset(struct benchmark_hist *hist)
+{
+	memset(hist, 0, sizeof(*hist));
+	hist->min = UINT64_MAX;
+}
+
+/*
+ * benchmark_hist_record -- record a single value
+ */
+void
+benchmark_hist_record(struct benchmark_hist *hist, uint64_t value)
+{
+	hist->buckets[hist_bucket(value)]++;
+	hist->count++;
+
+	if (value < hist->min)
+		hist->min = value;
+	if (value > hist->max)
+		hist->max = value;
+
+	double v = (double)value;
+	hist->sum += v;
+	hist->sum_sq += v * v;
+}
+
+/*
+ * benchmark_hist_merge -- add all values recorded in src to dst
+ */
+void
+benchmark_hist_merge(struct benchmark_hist *dst,
+		     const struct benchmark_hist *src)
+{
+	if (src->count == 0)
+		return;
+
+	for (size_t i = 0; i < HIST_NBUCKETS; i++)
+		dst->buckets[i] += src->buckets[i];
+
+	dst->count += src->count;
+	dst->sum += src->sum;
+	dst->sum_sq += src->sum_sq;
+
+	if (src->min < dst->min)
+		dst->min = src->min;
+	if (src->max > dst->max)
+		dst->max = src->max;
+}
+
+/*
+ * benchmark_hist_count -- return number of recorded values
+ */
+uint64_t
+benchmark_hist_count(const struct benchmark_hist *hist)
+{
+	return hist->count;
+}
+
+/*
+ * benchmark_hist_min -- return the smallest recorded value
+ */
+uint64_t
+benchmark_hist_min(const struct benchmark_hist *hist)
+{
+	return hist->count ? hist->min : 0;
+}
+
+/*
+ * benchmark_hist_max -- return the largest recorded value
+ */
+uint64_t
+benchmark_hist_max(const struct benchmark_hist *hist)
+{
+	return hist->max;
+}
+
+/*
+ * benchmark_hist_mean -- return the arithmetic mean of recorded values
+ */
+double
+benchmark_hist_mean(const struct benchmark_hist *hist)
+{
+	if (hist->count == 0)
+		return 0.0;
+
+	return hist->sum / (double)hist->count;
+}
+
+/*
+ * benchmark_hist_std_dev -- return the standard deviation of recorded values
+ */
+double
+benchmark_hist_std_dev(const struct benchmark_hist *hist)
+{
+	if (hist->count == 0)
+		return 0.0;
+
+	double mean = benchmark_hist_mean(hist);
+	double var = hist->sum_sq / (double)hist->count - mean * mean;
+
+	/* rounding errors may yield a tiny negative variance */
+	return var > 0.0 ? sqrt(var) : 0.0;
+}
+
+/*
+ * benchmark_hist_percentile -- return the value below or equal to which
+ * the given percent of recorded values falls
+ */
+uint64_t
+benchmark_hist_percentile(const struct benchmark_hist *hist, double pctl)
+{
+	assert(pctl >= 0.0 && pctl <= 100.0);
+
+	if (hist->count == 0)
+		return 0;
+
+	uint64_t target = (uint64_t)ceil(pctl / 100.0 * (double)hist->count);
+	if (target == 0)
+		target = 1;
+	if (target > hist->count)
+		target = hist->count;
+
+	uint64_t sum = 0;
+	for (size_t i = 0; i < HIST_NBUCKETS; i++) {
+		sum += hist->buckets[i];
+		if (sum >= target) {
+			uint64_t value = hist_bucket_value(i);
+			return value < hist->max ? value : hist->max;
+		}
+	}
+
+	return hist->max;
+}
+
+/*
+ * benchmark_hist_foreach -- call cb for every non-empty bucket in the
+ * ascending order of values
+ */
+void
+benchmark_hist_foreach(const struct benchmark_hist *hist,
+		       benchmark_hist_cb cb, void *arg)
+{
+	for (size_t i = 0; i < HIST_NBUCKETS; i++) {
+		if (hist->buckets[i] == 0)
+			continue;
+
+		uint64_t value = hist_bucket_value(i);
+		cb(value < hist->max ? value : hist->max, hist->buckets[i],
+		   arg);
+	}
+}
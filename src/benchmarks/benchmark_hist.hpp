@@ -0,0 +1,66 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*
+ * benchmark_hist.hpp -- declarations of latency histogram module
+ */
+#ifndef _BENCHMARK_HIST_H
+#define _BENCHMARK_HIST_H
+
+#include <cstddef>
+#include <cstdint>
+
+struct benchmark_hist;
+
+/*
+ * benchmark_hist_cb -- callback for benchmark_hist_foreach, called with the
+ * highest value represented by a non-empty bucket and its count
+ */
+typedef void (*benchmark_hist_cb)(uint64_t value, uint64_t count, void *arg);
+
+struct benchmark_hist *benchmark_hist_alloc(void);
+void benchmark_hist_free(struct benchmark_hist *hist);
+void benchmark_hist_reset(struct benchmark_hist *hist);
+void benchmark_hist_record(struct benchmark_hist *hist, uint64_t value);
+void benchmark_hist_merge(struct benchmark_hist *dst,
+			  const struct benchmark_hist *src);
+
+uint64_t benchmark_hist_count(const struct benchmark_hist *hist);
+uint64_t benchmark_hist_min(const struct benchmark_hist *hist);
+uint64_t benchmark_hist_max(const struct benchmark_hist *hist);
+double benchmark_hist_mean(const struct benchmark_hist *hist);
+double benchmark_hist_std_dev(const struct benchmark_hist *hist);
+uint64_t benchmark_hist_percentile(const struct benchmark_hist *hist,
+				   double pctl);
+void benchmark_hist_foreach(const struct benchmark_hist *hist,
+			    benchmark_hist_cb cb, void *arg);
+
+#endif /* _BENCHMARK_HIST_H */
@@ -39,6 +39,13 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#ifdef BENCHMARK_HAS_RDTSC
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
 #define NSECPSEC 1000000000
 
 /*
@@ -138,3 +145,78 @@ benchmark_get_avg_get_time(void)
 
 	return avg;
 }
+
+/*
+ * benchmark_ticks_clock -- get current time from the clock source in
+ * nanoseconds
+ */
+uint64_t
+benchmark_ticks_clock(void)
+{
+	benchmark_time_t time;
+	benchmark_time_get(&time);
+
+	return benchmark_time_get_nsecs(&time);
+}
+
+/*
+ * benchmark_ticks_rdtsc -- get current value of the time stamp counter
+ *
+ * The instruction is not serializing, so it is meant only for measuring
+ * operations which take considerably longer than the counter read itself.
+ */
+uint64_t
+benchmark_ticks_rdtsc(void)
+{
+#ifdef BENCHMARK_HAS_RDTSC
+	return __rdtsc();
+#else
+	assert(0);
+	return 0;
+#endif
+}
+
+/* duration of the time stamp counter calibration in nanoseconds */
+#define RDTSC_CALIBRATION_NSECS 100000000ULL
+
+/*
+ * benchmark_rdtsc_nsecs_per_tick -- return the number of nanoseconds per
+ * single time stamp counter tick, measured against the clock source on the
+ * first call
+ */
+double
+benchmark_rdtsc_nsecs_per_tick(void)
+{
+	static double nsecs_per_tick;
+
+	if (nsecs_per_tick != 0.0)
+		return nsecs_per_tick;
+
+	uint64_t nsecs_beg = benchmark_ticks_clock();
+	uint64_t ticks_beg = benchmark_ticks_rdtsc();
+	uint64_t nsecs_end;
+	do {
+		nsecs_end = benchmark_ticks_clock();
+	} while (nsecs_end - nsecs_beg < RDTSC_CALIBRATION_NSECS);
+	uint64_t ticks_end = benchmark_ticks_rdtsc();
+
+	nsecs_per_tick = (double)(nsecs_end - nsecs_beg) /
+		(double)(ticks_end - ticks_beg);
+
+	return nsecs_per_tick;
+}
+
+/*
+ * benchmark_get_avg_get_ticks -- calculates average number of ticks of the
+ * given source required to read the source itself
+ */
+unsigned long long
+benchmark_get_avg_get_ticks(uint64_t (*get)(void))
+{
+	uint64_t beg = get();
+	for (size_t i = 0; i < N_PROBES_GET_TIME; i++)
+		get();
+	uint64_t end = get();
+
+	return (end - beg) / N_PROBES_GET_TIME;
+}
@@ -32,8 +32,13 @@
 /*
  * benchmark_time.hpp -- declarations of benchmark_time module
  */
+#include <cstdint>
 #include <ctime>
 
+#if defined(__x86_64__) || defined(_M_X64)
+#define BENCHMARK_HAS_RDTSC 1
+#endif
+
 typedef struct timespec benchmark_time_t;
 
 void benchmark_time_get(benchmark_time_t *time);
@@ -45,3 +50,8 @@ int benchmark_time_compare(const benchmark_time_t *t1,
 			   const benchmark_time_t *t2);
 void benchmark_time_set(benchmark_time_t *time, unsigned long long nsecs);
 unsigned long long benchmark_get_avg_get_time(void);
+
+uint64_t benchmark_ticks_clock(void);
+uint64_t benchmark_ticks_rdtsc(void);
+double benchmark_rdtsc_nsecs_per_tick(void);
+unsigned long long benchmark_get_avg_get_ticks(uint64_t (*get)(void));
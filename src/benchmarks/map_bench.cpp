@@ -30,10 +30,12 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 /*
- * map_bench.cpp -- benchmarks for: ctree, btree, rtree, rbtree, hashmap_atomic
- * and hashmap_tx from examples.
+ * map_bench.cpp -- benchmarks for: ctree, btree, rtree, rbtree, bptree, art,
+ * skiplist, hashmap_atomic, hashmap_tx, hashmap_rp and hashmap_mt from
+ * examples.
  */
 #include <cassert>
+#include <cmath>
 
 #include "benchmark.hpp"
 #include "file.h"
@@ -41,14 +43,19 @@
 #include "os_thread.h"
 #include "poolset_util.hpp"
 
+#include "bptree_map.h"
 #include "map.h"
+#include "map_bptree.h"
+#include "map_art.h"
 #include "map_btree.h"
 #include "map_ctree.h"
 #include "map_hashmap_atomic.h"
+#include "map_hashmap_mt.h"
 #include "map_hashmap_rp.h"
 #include "map_hashmap_tx.h"
 #include "map_rbtree.h"
 #include "map_rtree.h"
+#include "map_skiplist.h"
 
 /* Values less than 3 is not suitable for current rtree implementation */
 #define FACTOR 3
@@ -75,30 +82,124 @@ struct root {
 static const struct {
 	const char *str;
 	const struct map_ops *ops;
+	/* the map synchronizes concurrent access on its own */
+	bool concurrent;
 } map_types[] = {
-	{"ctree", MAP_CTREE},		{"btree", MAP_BTREE},
-	{"rtree", MAP_RTREE},		{"rbtree", MAP_RBTREE},
-	{"hashmap_tx", MAP_HASHMAP_TX}, {"hashmap_atomic", MAP_HASHMAP_ATOMIC},
-	{"hashmap_rp", MAP_HASHMAP_RP}};
+	{"ctree", MAP_CTREE, false},
+	{"btree", MAP_BTREE, false},
+	{"rtree", MAP_RTREE, false},
+	{"rbtree", MAP_RBTREE, false},
+	{"bptree", MAP_BPTREE, false},
+	{"art", MAP_ART, false},
+	{"skiplist", MAP_SKIPLIST, false},
+	{"hashmap_tx", MAP_HASHMAP_TX, false},
+	{"hashmap_atomic", MAP_HASHMAP_ATOMIC, false},
+	{"hashmap_rp", MAP_HASHMAP_RP, false},
+	{"hashmap_mt", MAP_HASHMAP_MT, true}};
 
 #define MAP_TYPES_NUM (sizeof(map_types) / sizeof(map_types[0]))
 
+/* skew of the zipfian distributions of map_mix, the YCSB default */
+#define MIX_ZIPF_THETA 0.99
+
+/*
+ * mix_op -- operations of the map_mix benchmark
+ */
+enum mix_op {
+	MIX_GET,    /* look up the key and read its value */
+	MIX_UPDATE, /* overwrite the beginning of the value */
+	MIX_INSERT, /* insert a new key with a newly allocated value */
+	MIX_REMOVE, /* remove the key and free its value */
+	MIX_SCAN,   /* visit keys in order starting at the key */
+	MIX_RMW,    /* read and update the value in one transaction */
+
+	MAX_MIX_OP
+};
+
+/*
+ * mix_dist -- distributions of keys and value sizes of map_mix
+ */
+enum mix_dist {
+	MIX_DIST_CONSTANT, /* value sizes only */
+	MIX_DIST_UNIFORM,
+	MIX_DIST_ZIPFIAN,
+	MIX_DIST_LATEST, /* keys only, skewed towards the newest ones */
+
+	MAX_MIX_DIST
+};
+
+static const char *mix_dist_names[MAX_MIX_DIST] = {
+	"constant", "uniform", "zipfian", "latest",
+};
+
+/*
+ * mix_workloads -- YCSB core workloads expressed as map_mix parameters
+ */
+static const struct {
+	const char *name;
+	unsigned ratio[MAX_MIX_OP];
+	enum mix_dist key_dist;
+} mix_workloads[] = {
+	/* get, update, insert, remove, scan, rmw */
+	{"a", {50, 50, 0, 0, 0, 0}, MIX_DIST_ZIPFIAN},
+	{"b", {95, 5, 0, 0, 0, 0}, MIX_DIST_ZIPFIAN},
+	{"c", {100, 0, 0, 0, 0, 0}, MIX_DIST_ZIPFIAN},
+	{"d", {95, 0, 5, 0, 0, 0}, MIX_DIST_LATEST},
+	{"e", {0, 0, 5, 0, 95, 0}, MIX_DIST_ZIPFIAN},
+	{"f", {50, 0, 0, 0, 0, 50}, MIX_DIST_ZIPFIAN},
+};
+
 struct map_bench_args {
 	unsigned seed;
 	uint64_t max_key;
 	char *type;
 	bool ext_tx;
 	bool alloc;
+	size_t node_size;
+	size_t scan_length;
+
+	/* map_mix only */
+	char *workload;
+	size_t records;
+	unsigned ratio[MAX_MIX_OP];
+	char *key_dist;
+	char *size_dist;
+	size_t min_vsize;
+};
+
+/*
+ * mix_req -- single pregenerated request of map_mix, the key is resolved
+ * when the request is executed
+ */
+struct mix_req {
+	enum mix_op op;
+	size_t len; /* value size or the number of keys to scan */
 };
 
 struct map_bench_worker {
 	uint64_t *keys;
 	size_t nkeys;
+
+	/* map_mix only */
+	struct mix_req *reqs;
+	char *buff;
+};
+
+/*
+ * mix_zipf -- zipfian distribution generator, as described in "Quickly
+ * Generating Billion-Record Synthetic Databases" by J. Gray et al.
+ */
+struct mix_zipf {
+	uint64_t n;
+	double zetan;
+	double alpha;
+	double eta;
 };
 
 struct map_bench {
 	struct map_ctx *mapc;
 	os_mutex_t lock;
+	bool concurrent;
 	PMEMobjpool *pop;
 	size_t pool_size;
 
@@ -115,6 +216,14 @@ struct map_bench {
 	int (*insert)(struct map_bench *, uint64_t);
 	int (*remove)(struct map_bench *, uint64_t);
 	int (*get)(struct map_bench *, uint64_t);
+
+	/* map_mix only */
+	unsigned mix_ratio[MAX_MIX_OP]; /* cumulative ratios of operations */
+	enum mix_dist key_dist;
+	enum mix_dist size_dist;
+	struct mix_zipf key_zipf;
+	struct mix_zipf size_zipf;
+	uint64_t mix_nkeys; /* number of keys ever inserted */
 };
 
 /*
@@ -173,6 +282,42 @@ parse_map_type(const char *str)
 	return nullptr;
 }
 
+/*
+ * map_type_concurrent -- check whether the map can be used by many threads
+ * without external locking
+ */
+static bool
+map_type_concurrent(const struct map_ops *ops)
+{
+	for (unsigned i = 0; i < MAP_TYPES_NUM; i++) {
+		if (map_types[i].ops == ops)
+			return map_types[i].concurrent;
+	}
+
+	return false;
+}
+
+/*
+ * map_bench_lock -- serializes access to the map, unless the map handles
+ * concurrent access on its own
+ */
+static void
+map_bench_lock(struct map_bench *map_bench)
+{
+	if (!map_bench->concurrent)
+		mutex_lock_nofail(&map_bench->lock);
+}
+
+/*
+ * map_bench_unlock -- unlocks the lock taken by map_bench_lock
+ */
+static void
+map_bench_unlock(struct map_bench *map_bench)
+{
+	if (!map_bench->concurrent)
+		mutex_unlock_nofail(&map_bench->lock);
+}
+
 /*
  * map_remove_free_op -- remove and free object from map
  */
@@ -219,11 +364,11 @@ map_remove_op(struct benchmark *bench, struct operation_info *info)
 
 	uint64_t key = tworker->keys[info->index];
 
-	mutex_lock_nofail(&map_bench->lock);
+	map_bench_lock(map_bench);
 
 	int ret = map_bench->remove(map_bench, key);
 
-	mutex_unlock_nofail(&map_bench->lock);
+	map_bench_unlock(map_bench);
 
 	return ret;
 }
@@ -271,11 +416,11 @@ map_insert_op(struct benchmark *bench, struct operation_info *info)
 	auto *tworker = (struct map_bench_worker *)info->worker->priv;
 	uint64_t key = tworker->keys[info->index];
 
-	mutex_lock_nofail(&map_bench->lock);
+	map_bench_lock(map_bench);
 
 	int ret = map_bench->insert(map_bench, key);
 
-	mutex_unlock_nofail(&map_bench->lock);
+	map_bench_unlock(map_bench);
 
 	return ret;
 }
@@ -313,15 +458,49 @@ map_get_op(struct benchmark *bench, struct operation_info *info)
 
 	uint64_t key = tworker->keys[info->index];
 
-	mutex_lock_nofail(&map_bench->lock);
+	map_bench_lock(map_bench);
 
 	int ret = map_bench->get(map_bench, key);
 
-	mutex_unlock_nofail(&map_bench->lock);
+	map_bench_unlock(map_bench);
 
 	return ret;
 }
 
+/*
+ * map_scan_cb -- counts down the number of keys left to visit in the scan
+ */
+static int
+map_scan_cb(uint64_t key, PMEMoid value, void *arg)
+{
+	auto *left = (size_t *)arg;
+
+	return --(*left) == 0;
+}
+
+/*
+ * map_scan_op -- main operation for map_scan benchmark
+ */
+static int
+map_scan_op(struct benchmark *bench, struct operation_info *info)
+{
+	auto *map_bench = (struct map_bench *)pmembench_get_priv(bench);
+	auto *tworker = (struct map_bench_worker *)info->worker->priv;
+
+	uint64_t key = tworker->keys[info->index];
+	size_t left = map_bench->margs->scan_length;
+
+	map_bench_lock(map_bench);
+
+	map_range(map_bench->mapc, map_bench->map, key, UINT64_MAX,
+		  map_scan_cb, &left);
+
+	map_bench_unlock(map_bench);
+
+	/* the scan starts at an existing key, it must have been visited */
+	return left == map_bench->margs->scan_length;
+}
+
 /*
  * map_common_init_worker -- common init worker function for map_* benchmarks
  */
@@ -384,6 +563,8 @@ map_common_free_worker(struct benchmark *bench, struct benchmark_args *args,
 		(void)pmemobj_tx_end();
 	}
 	free(tworker->keys);
+	free(tworker->reqs);
+	free(tworker->buff);
 	free(tworker);
 }
 
@@ -520,6 +701,8 @@ map_common_init(struct benchmark *bench, struct benchmark_args *args)
 		goto err_free_bench;
 	}
 
+	map_bench->concurrent = map_type_concurrent(ops);
+
 	if (map_bench->margs->ext_tx && args->n_threads > 1) {
 		fprintf(stderr, "external transaction "
 				"requires single thread\n");
@@ -542,7 +725,8 @@ map_common_init(struct benchmark *bench, struct benchmark_args *args)
 		? SIZE_PER_KEY + map_bench->args->dsize + ALLOC_OVERHEAD
 		: SIZE_PER_KEY;
 
-	map_bench->pool_size = map_bench->nkeys * size_per_key * FACTOR;
+	map_bench->pool_size = (map_bench->nkeys + map_bench->margs->records) *
+		size_per_key * FACTOR;
 
 	if (args->is_poolset || type == TYPE_DEVDAX) {
 		if (args->fsize < map_bench->pool_size) {
@@ -594,7 +778,11 @@ map_common_init(struct benchmark *bench, struct benchmark_args *args)
 
 	map_bench->root_oid = map_bench->root.oid;
 
-	if (map_create(map_bench->mapc, &D_RW(map_bench->root)->map, nullptr)) {
+	struct bptree_map_args bptree_args;
+	bptree_args.node_size = map_bench->margs->node_size;
+
+	if (map_create(map_bench->mapc, &D_RW(map_bench->root)->map,
+		       ops == MAP_BPTREE ? &bptree_args : nullptr)) {
 		perror("map_new");
 		goto err_free_map;
 	}
@@ -653,17 +841,20 @@ map_keys_init(struct benchmark *bench, struct benchmark_args *args)
 
 	mutex_lock_nofail(&map_bench->lock);
 
-	TX_BEGIN(map_bench->pop)
-	{
-		for (size_t i = 0; i < map_bench->nkeys; i++) {
-			uint64_t key;
-			PMEMoid oid;
-			do {
-				key = get_key(&targs->seed, targs->max_key);
-				oid = map_get(map_bench->mapc, map_bench->map,
-					      key);
-			} while (!OID_IS_NULL(oid));
-
+	/*
+	 * Each key is inserted in its own transaction, because maps which
+	 * grow incrementally (hashmap_mt) do not resize within transactions.
+	 */
+	for (size_t i = 0; i < map_bench->nkeys && !ret; i++) {
+		uint64_t key;
+		PMEMoid oid;
+		do {
+			key = get_key(&targs->seed, targs->max_key);
+			oid = map_get(map_bench->mapc, map_bench->map, key);
+		} while (!OID_IS_NULL(oid));
+
+		TX_BEGIN(map_bench->pop)
+		{
 			if (targs->alloc)
 				oid = pmemobj_tx_alloc(args->dsize,
 						       OBJ_TYPE_NUM);
@@ -672,17 +863,15 @@ map_keys_init(struct benchmark *bench, struct benchmark_args *args)
 
 			ret = map_insert(map_bench->mapc, map_bench->map, key,
 					 oid);
-			if (ret)
-				break;
-
-			map_bench->keys[i] = key;
 		}
+		TX_ONABORT
+		{
+			ret = -1;
+		}
+		TX_END
+
+		map_bench->keys[i] = key;
 	}
-	TX_ONABORT
-	{
-		ret = -1;
-	}
-	TX_END
 
 	mutex_unlock_nofail(&map_bench->lock);
 
@@ -762,11 +951,510 @@ map_get_exit(struct benchmark *bench, struct benchmark_args *args)
 	return map_common_exit(bench, args);
 }
 
-static struct benchmark_clo map_bench_clos[5];
+/*
+ * map_scan_init -- init function for map_scan benchmark
+ */
+static int
+map_scan_init(struct benchmark *bench, struct benchmark_args *args)
+{
+	int ret = map_common_init(bench, args);
+	if (ret)
+		return ret;
+
+	auto *map_bench = (struct map_bench *)pmembench_get_priv(bench);
+	if (map_bench->mapc->ops->range == nullptr) {
+		fprintf(stderr,
+			"map type '%s' does not support range queries\n",
+			map_bench->margs->type);
+		errno = ENOTSUP;
+		goto err_exit_common;
+	}
+
+	ret = map_keys_init(bench, args);
+	if (ret)
+		goto err_exit_common;
+
+	return 0;
+err_exit_common:
+	/* pmembench reports the errno of a failed initialization */
+	int oerrno = errno;
+	map_common_exit(bench, args);
+	errno = oerrno;
+	return -1;
+}
+
+/*
+ * mix_rand -- return 62-bit random value
+ */
+static uint64_t
+mix_rand(unsigned *seed)
+{
+	uint64_t hi = os_rand_r(seed) & 0x7fffffff;
+	uint64_t lo = os_rand_r(seed) & 0x7fffffff;
+
+	return hi << 31 | lo;
+}
+
+/*
+ * mix_rand_double -- return random value from the [0, 1) range
+ */
+static double
+mix_rand_double(unsigned *seed)
+{
+	return (double)mix_rand(seed) / (double)(1ULL << 62);
+}
+
+/*
+ * mix_hash -- FNV-1a hash of a 64-bit value, used to scatter the keys over
+ * the whole key space
+ */
+static uint64_t
+mix_hash(uint64_t val)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (int i = 0; i < 8; i++) {
+		hash ^= val & 0xff;
+		hash *= 0x100000001b3ULL;
+		val >>= 8;
+	}
+
+	return hash;
+}
+
+/*
+ * mix_zipf_init -- prepare zipfian generator of values from [0, n) range
+ */
+static void
+mix_zipf_init(struct mix_zipf *zipf, uint64_t n)
+{
+	assert(n != 0);
+
+	double zeta2 = 1.0 + pow(0.5, MIX_ZIPF_THETA);
+	double zetan = 0.0;
+	for (uint64_t i = 1; i <= n; i++)
+		zetan += 1.0 / pow((double)i, MIX_ZIPF_THETA);
+
+	zipf->n = n;
+	zipf->zetan = zetan;
+	zipf->alpha = 1.0 / (1.0 - MIX_ZIPF_THETA);
+	zipf->eta = n > 2 ? (1.0 - pow(2.0 / (double)n, 1.0 - MIX_ZIPF_THETA)) /
+			(1.0 - zeta2 / zetan)
+			  : 0.0;
+}
+
+/*
+ * mix_zipf_next -- return next value, 0 is the most frequent one
+ */
+static uint64_t
+mix_zipf_next(const struct mix_zipf *zipf, unsigned *seed)
+{
+	double u = mix_rand_double(seed);
+	double uz = u * zipf->zetan;
+
+	if (uz < 1.0)
+		return 0;
+	if (uz < 1.0 + pow(0.5, MIX_ZIPF_THETA))
+		return 1;
+
+	double base = zipf->eta * u - zipf->eta + 1.0;
+	auto val = (uint64_t)((double)zipf->n * pow(base, zipf->alpha));
+
+	return val < zipf->n ? val : zipf->n - 1;
+}
+
+/*
+ * mix_parse_dist -- parse name of a distribution
+ */
+static int
+mix_parse_dist(const char *str, enum mix_dist *dist)
+{
+	for (unsigned i = 0; i < MAX_MIX_DIST; i++) {
+		if (strcmp(str, mix_dist_names[i]) == 0) {
+			*dist = (enum mix_dist)i;
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+/*
+ * mix_value_size -- return size of a value drawn from the value size
+ * distribution
+ */
+static size_t
+mix_value_size(struct map_bench *map_bench, unsigned *seed)
+{
+	size_t min = map_bench->margs->min_vsize;
+	size_t max = map_bench->args->dsize;
+
+	switch (map_bench->size_dist) {
+		case MIX_DIST_UNIFORM:
+			return min + mix_rand(seed) % (max - min + 1);
+		case MIX_DIST_ZIPFIAN:
+			return min + mix_zipf_next(&map_bench->size_zipf, seed);
+		default:
+			return max;
+	}
+}
+
+/*
+ * mix_key -- return the key of a request, drawn from the key distribution
+ * at the time the request is executed
+ */
+static uint64_t
+mix_key(struct map_bench *map_bench, uint64_t rank)
+{
+	uint64_t nkeys = map_bench->mix_nkeys;
+	uint64_t idx;
+
+	switch (map_bench->key_dist) {
+		case MIX_DIST_ZIPFIAN:
+			/* scatter the most frequent keys over the key space */
+			idx = mix_hash(rank) % map_bench->margs->records;
+			break;
+		case MIX_DIST_LATEST:
+			idx = rank < nkeys ? nkeys - 1 - rank : 0;
+			break;
+		default:
+			idx = rank % nkeys;
+			break;
+	}
+
+	return mix_hash(idx);
+}
+
+/*
+ * mix_insert -- allocate a value of given size and insert it into the map
+ */
+static int
+mix_insert(struct map_bench *map_bench, uint64_t key, size_t len)
+{
+	int ret = 0;
+
+	TX_BEGIN(map_bench->pop)
+	{
+		PMEMoid val = pmemobj_tx_alloc(len, OBJ_TYPE_NUM);
+		memset(pmemobj_direct(val), (int)key, len);
+
+		ret = map_insert(map_bench->mapc, map_bench->map, key, val);
+		if (ret != 0)
+			pmemobj_tx_abort(EINVAL);
+	}
+	TX_ONABORT
+	{
+		ret = -1;
+	}
+	TX_END
+
+	return ret;
+}
+
+/*
+ * mix_read -- copy the value of the key to the worker's buffer
+ */
+static size_t
+mix_read(struct map_bench *map_bench, struct map_bench_worker *tworker,
+	 PMEMoid val)
+{
+	size_t size = pmemobj_alloc_usable_size(val);
+	if (size > map_bench->args->dsize)
+		size = map_bench->args->dsize;
+
+	memcpy(tworker->buff, pmemobj_direct(val), size);
+
+	return size;
+}
+
+/*
+ * mix_update -- overwrite the beginning of the value of the key in
+ * a transaction, optionally reading the value first
+ */
+static int
+mix_update(struct map_bench *map_bench, struct map_bench_worker *tworker,
+	   uint64_t key, size_t len, bool read)
+{
+	int ret = 0;
+
+	TX_BEGIN(map_bench->pop)
+	{
+		PMEMoid val = map_get(map_bench->mapc, map_bench->map, key);
+		if (!OID_IS_NULL(val)) {
+			size_t size = read ? mix_read(map_bench, tworker, val)
+					   : pmemobj_alloc_usable_size(val);
+			if (len > size)
+				len = size;
+
+			pmemobj_tx_add_range(val, 0, len);
+			memset(pmemobj_direct(val), (int)~key, len);
+		}
+	}
+	TX_ONABORT
+	{
+		ret = -1;
+	}
+	TX_END
+
+	return ret;
+}
+
+/*
+ * map_mix_op -- main operation for map_mix benchmark
+ */
+static int
+map_mix_op(struct benchmark *bench, struct operation_info *info)
+{
+	auto *map_bench = (struct map_bench *)pmembench_get_priv(bench);
+	auto *tworker = (struct map_bench_worker *)info->worker->priv;
+	struct mix_req *req = &tworker->reqs[info->index];
+	uint64_t rank = tworker->keys[info->index];
+	int ret = 0;
+
+	if (req->op == MIX_INSERT) {
+		auto idx = (uint64_t)util_fetch_and_add64(
+			&map_bench->mix_nkeys, 1);
+		uint64_t key = mix_hash(idx);
+
+		map_bench_lock(map_bench);
+		ret = mix_insert(map_bench, key, req->len);
+		map_bench_unlock(map_bench);
+
+		return ret;
+	}
+
+	uint64_t key = mix_key(map_bench, rank);
+	PMEMoid val;
+	size_t left;
+
+	map_bench_lock(map_bench);
+
+	switch (req->op) {
+		case MIX_GET:
+			val = map_get(map_bench->mapc, map_bench->map, key);
+			if (!OID_IS_NULL(val))
+				mix_read(map_bench, tworker, val);
+			break;
+		case MIX_UPDATE:
+		case MIX_RMW:
+			ret = mix_update(map_bench, tworker, key, req->len,
+					 req->op == MIX_RMW);
+			break;
+		case MIX_REMOVE:
+			/* the key might have been removed already */
+			(void)map_remove_free_op(map_bench, key);
+			break;
+		case MIX_SCAN:
+			left = req->len;
+			map_range(map_bench->mapc, map_bench->map, key,
+				  UINT64_MAX, map_scan_cb, &left);
+			break;
+		default:
+			assert(0);
+	}
+
+	map_bench_unlock(map_bench);
+
+	return ret;
+}
+
+/*
+ * map_mix_init_worker -- init worker function for map_mix benchmark,
+ * pregenerates operations, ranks of keys and value sizes
+ */
+static int
+map_mix_init_worker(struct benchmark *bench, struct benchmark_args *args,
+		    struct worker_info *worker)
+{
+	int ret = map_common_init_worker(bench, args, worker);
+	if (ret)
+		return ret;
+
+	auto *map_bench = (struct map_bench *)pmembench_get_priv(bench);
+	auto *targs = (struct map_bench_args *)args->opts;
+	auto *tworker = (struct map_bench_worker *)worker->priv;
+
+	tworker->reqs = (struct mix_req *)malloc(tworker->nkeys *
+						 sizeof(*tworker->reqs));
+	tworker->buff = (char *)malloc(args->dsize);
+	if (!tworker->reqs || !tworker->buff) {
+		perror("malloc");
+		/* the worker, including reqs and buff, is freed by free_worker */
+		return -1;
+	}
+
+	unsigned seed = os_rand_r(&targs->seed);
+	unsigned total = map_bench->mix_ratio[MAX_MIX_OP - 1];
+
+	for (size_t i = 0; i < tworker->nkeys; i++) {
+		struct mix_req *req = &tworker->reqs[i];
+
+		unsigned r = os_rand_r(&seed) % total;
+		unsigned op = 0;
+		while (r >= map_bench->mix_ratio[op])
+			op++;
+		req->op = (enum mix_op)op;
+
+		if (map_bench->key_dist == MIX_DIST_UNIFORM)
+			tworker->keys[i] = mix_rand(&seed);
+		else
+			tworker->keys[i] =
+				mix_zipf_next(&map_bench->key_zipf, &seed);
+
+		if (req->op == MIX_SCAN)
+			req->len = 1 + mix_rand(&seed) % targs->scan_length;
+		else
+			req->len = mix_value_size(map_bench, &seed);
+	}
+
+	return 0;
+}
+
+/*
+ * map_mix_parse -- validate and apply parameters of the map_mix benchmark
+ */
+static int
+map_mix_parse(struct map_bench *map_bench)
+{
+	struct map_bench_args *margs = map_bench->margs;
+	const unsigned *ratio = margs->ratio;
+
+	if (mix_parse_dist(margs->key_dist, &map_bench->key_dist) ||
+	    map_bench->key_dist == MIX_DIST_CONSTANT) {
+		fprintf(stderr, "invalid key distribution -- '%s'\n",
+			margs->key_dist);
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (strcmp(margs->workload, "custom") != 0) {
+		size_t i;
+		for (i = 0; i < ARRAY_SIZE(mix_workloads); i++) {
+			if (strcmp(margs->workload, mix_workloads[i].name) == 0)
+				break;
+		}
+
+		if (i == ARRAY_SIZE(mix_workloads)) {
+			fprintf(stderr, "invalid workload -- '%s'\n",
+				margs->workload);
+			errno = EINVAL;
+			return -1;
+		}
+
+		ratio = mix_workloads[i].ratio;
+		map_bench->key_dist = mix_workloads[i].key_dist;
+	}
+
+	if (mix_parse_dist(margs->size_dist, &map_bench->size_dist) ||
+	    map_bench->size_dist == MIX_DIST_LATEST) {
+		fprintf(stderr, "invalid value size distribution -- '%s'\n",
+			margs->size_dist);
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (margs->min_vsize > map_bench->args->dsize) {
+		fprintf(stderr, "minimum value size exceeds data size\n");
+		errno = EINVAL;
+		return -1;
+	}
+
+	unsigned total = 0;
+	for (unsigned i = 0; i < MAX_MIX_OP; i++) {
+		total += ratio[i];
+		map_bench->mix_ratio[i] = total;
+	}
+
+	if (total == 0) {
+		fprintf(stderr, "all operation ratios are zero\n");
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (ratio[MIX_SCAN] && map_bench->mapc->ops->range == nullptr) {
+		fprintf(stderr,
+			"map type '%s' does not support range queries\n",
+			margs->type);
+		errno = ENOTSUP;
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * map_mix_init -- init function for map_mix benchmark, inserts the initial
+ * records
+ */
+static int
+map_mix_init(struct benchmark *bench, struct benchmark_args *args)
+{
+	auto *margs = (struct map_bench_args *)args->opts;
+
+	/* values are always allocated, updates modify them */
+	margs->alloc = true;
+
+	int ret = map_common_init(bench, args);
+	if (ret)
+		return ret;
+
+	auto *map_bench = (struct map_bench *)pmembench_get_priv(bench);
+	if (map_mix_parse(map_bench))
+		goto err_exit_common;
+
+	if (map_bench->key_dist != MIX_DIST_UNIFORM)
+		mix_zipf_init(&map_bench->key_zipf, margs->records);
+	if (map_bench->size_dist == MIX_DIST_ZIPFIAN)
+		mix_zipf_init(&map_bench->size_zipf,
+			      args->dsize - margs->min_vsize + 1);
+
+	/*
+	 * Each key is inserted in its own transaction, because maps which
+	 * grow incrementally (hashmap_mt) do not resize within transactions.
+	 */
+	for (size_t i = 0; i < margs->records; i++) {
+		size_t len = mix_value_size(map_bench, &margs->seed);
+		if (mix_insert(map_bench, mix_hash(i), len)) {
+			fprintf(stderr, "inserting initial records failed\n");
+			goto err_exit_common;
+		}
+	}
+	map_bench->mix_nkeys = margs->records;
+
+	return 0;
+err_exit_common:
+	/* pmembench reports the errno of a failed initialization */
+	int oerrno = errno;
+	map_common_exit(bench, args);
+	errno = oerrno;
+	return -1;
+}
+
+static struct benchmark_clo map_bench_clos[7];
+static struct benchmark_clo map_mix_clos[16];
 
 static struct benchmark_info map_insert_info;
 static struct benchmark_info map_remove_info;
 static struct benchmark_info map_get_info;
+static struct benchmark_info map_scan_info;
+static struct benchmark_info map_mix_info;
+
+/*
+ * map_mix_ratio_clo -- initialize CLO of the ratio of given operation
+ */
+static void
+map_mix_ratio_clo(struct benchmark_clo *clo, const char *opt_long,
+		  const char *descr, enum mix_op op, const char *def)
+{
+	clo->opt_long = opt_long;
+	clo->descr = descr;
+	clo->off = clo_field_offset(struct map_bench_args, ratio[op]);
+	clo->type = CLO_TYPE_UINT;
+	clo->def = def;
+	clo->type_uint.size = clo_field_size(struct map_bench_args, ratio[op]);
+	clo->type_uint.base = CLO_INT_BASE_DEC;
+	clo->type_uint.min = 0;
+	clo->type_uint.max = 100;
+}
 
 CONSTRUCTOR(map_bench_constructor)
 void
@@ -776,7 +1464,8 @@ map_bench_constructor(void)
 	map_bench_clos[0].opt_long = "type";
 	map_bench_clos[0].descr =
 		"Type of container "
-		"[ctree|btree|rtree|rbtree|hashmap_tx|hashmap_atomic]";
+		"[ctree|btree|rtree|rbtree|bptree|art|skiplist|hashmap_tx|"
+		"hashmap_atomic|hashmap_rp|hashmap_mt]";
 
 	map_bench_clos[0].off = clo_field_offset(struct map_bench_args, type);
 	map_bench_clos[0].type = CLO_TYPE_STR;
@@ -822,6 +1511,33 @@ map_bench_constructor(void)
 	map_bench_clos[4].off = clo_field_offset(struct map_bench_args, alloc);
 	map_bench_clos[4].type = CLO_TYPE_FLAG;
 
+	map_bench_clos[5].opt_short = 'N';
+	map_bench_clos[5].opt_long = "node-size";
+	map_bench_clos[5].descr = "Size of a node in bytes (bptree only)";
+	map_bench_clos[5].off =
+		clo_field_offset(struct map_bench_args, node_size);
+	map_bench_clos[5].type = CLO_TYPE_UINT;
+	map_bench_clos[5].def = "256";
+	map_bench_clos[5].type_uint.size =
+		clo_field_size(struct map_bench_args, node_size);
+	map_bench_clos[5].type_uint.base = CLO_INT_BASE_DEC;
+	map_bench_clos[5].type_uint.min = BPTREE_MAP_MIN_NODE_SIZE;
+	map_bench_clos[5].type_uint.max = BPTREE_MAP_MAX_NODE_SIZE;
+
+	map_bench_clos[6].opt_short = 'L';
+	map_bench_clos[6].opt_long = "scan-length";
+	map_bench_clos[6].descr = "Number of keys visited by a single scan "
+				  "(map_scan) or the maximum one (map_mix)";
+	map_bench_clos[6].off =
+		clo_field_offset(struct map_bench_args, scan_length);
+	map_bench_clos[6].type = CLO_TYPE_UINT;
+	map_bench_clos[6].def = "100";
+	map_bench_clos[6].type_uint.size =
+		clo_field_size(struct map_bench_args, scan_length);
+	map_bench_clos[6].type_uint.base = CLO_INT_BASE_DEC;
+	map_bench_clos[6].type_uint.min = 1;
+	map_bench_clos[6].type_uint.max = SIZE_MAX;
+
 	map_insert_info.name = "map_insert";
 	map_insert_info.brief = "Inserting to tree map";
 	map_insert_info.init = map_common_init;
@@ -872,4 +1588,110 @@ map_bench_constructor(void)
 	map_get_info.rm_file = true;
 	map_get_info.allow_poolset = true;
 	REGISTER_BENCHMARK(map_get_info);
+
+	map_scan_info.name = "map_scan";
+	map_scan_info.brief = "Tree range scan";
+	map_scan_info.init = map_scan_init;
+	map_scan_info.exit = map_get_exit;
+	map_scan_info.multithread = true;
+	map_scan_info.multiops = true;
+	map_scan_info.init_worker = map_bench_get_init_worker;
+	map_scan_info.free_worker = map_common_free_worker;
+	map_scan_info.operation = map_scan_op;
+	map_scan_info.measure_time = true;
+	map_scan_info.clos = map_bench_clos;
+	map_scan_info.nclos = ARRAY_SIZE(map_bench_clos);
+	map_scan_info.opts_size = sizeof(struct map_bench_args);
+	map_scan_info.rm_file = true;
+	map_scan_info.allow_poolset = true;
+	REGISTER_BENCHMARK(map_scan_info);
+
+	/* map_mix does not use max-key and always allocates values */
+	map_mix_clos[0] = map_bench_clos[0];
+	map_mix_clos[1] = map_bench_clos[1];
+	map_mix_clos[2] = map_bench_clos[3];
+	map_mix_clos[3] = map_bench_clos[5];
+	map_mix_clos[4] = map_bench_clos[6];
+
+	map_mix_clos[5].opt_long = "workload";
+	map_mix_clos[5].descr = "YCSB core workload [a|b|c|d|e|f], "
+				"custom uses the ratios and key-dist options";
+	map_mix_clos[5].off =
+		clo_field_offset(struct map_bench_args, workload);
+	map_mix_clos[5].type = CLO_TYPE_STR;
+	map_mix_clos[5].def = "custom";
+
+	map_mix_clos[6].opt_long = "records";
+	map_mix_clos[6].descr = "Number of keys inserted before the "
+				"benchmark starts";
+	map_mix_clos[6].off = clo_field_offset(struct map_bench_args, records);
+	map_mix_clos[6].type = CLO_TYPE_UINT;
+	map_mix_clos[6].def = "10000";
+	map_mix_clos[6].type_uint.size =
+		clo_field_size(struct map_bench_args, records);
+	map_mix_clos[6].type_uint.base = CLO_INT_BASE_DEC;
+	map_mix_clos[6].type_uint.min = 1;
+	map_mix_clos[6].type_uint.max = SIZE_MAX;
+
+	map_mix_ratio_clo(&map_mix_clos[7], "get-ratio",
+			  "Relative frequency of lookups", MIX_GET, "50");
+	map_mix_ratio_clo(&map_mix_clos[8], "update-ratio",
+			  "Relative frequency of value updates", MIX_UPDATE,
+			  "50");
+	map_mix_ratio_clo(&map_mix_clos[9], "insert-ratio",
+			  "Relative frequency of inserts of new keys",
+			  MIX_INSERT, "0");
+	map_mix_ratio_clo(&map_mix_clos[10], "remove-ratio",
+			  "Relative frequency of removals", MIX_REMOVE, "0");
+	map_mix_ratio_clo(&map_mix_clos[11], "scan-ratio",
+			  "Relative frequency of range scans", MIX_SCAN, "0");
+	map_mix_ratio_clo(&map_mix_clos[12], "rmw-ratio",
+			  "Relative frequency of read-modify-writes", MIX_RMW,
+			  "0");
+
+	map_mix_clos[13].opt_long = "key-dist";
+	map_mix_clos[13].descr = "Distribution of accessed keys "
+				 "[uniform|zipfian|latest]";
+	map_mix_clos[13].off =
+		clo_field_offset(struct map_bench_args, key_dist);
+	map_mix_clos[13].type = CLO_TYPE_STR;
+	map_mix_clos[13].def = "zipfian";
+
+	map_mix_clos[14].opt_long = "value-size-dist";
+	map_mix_clos[14].descr = "Distribution of value sizes between "
+				 "min-value-size and data-size "
+				 "[constant|uniform|zipfian]";
+	map_mix_clos[14].off =
+		clo_field_offset(struct map_bench_args, size_dist);
+	map_mix_clos[14].type = CLO_TYPE_STR;
+	map_mix_clos[14].def = "constant";
+
+	map_mix_clos[15].opt_long = "min-value-size";
+	map_mix_clos[15].descr = "Minimum size of a value";
+	map_mix_clos[15].off =
+		clo_field_offset(struct map_bench_args, min_vsize);
+	map_mix_clos[15].type = CLO_TYPE_UINT;
+	map_mix_clos[15].def = "1";
+	map_mix_clos[15].type_uint.size =
+		clo_field_size(struct map_bench_args, min_vsize);
+	map_mix_clos[15].type_uint.base = CLO_INT_BASE_DEC;
+	map_mix_clos[15].type_uint.min = 1;
+	map_mix_clos[15].type_uint.max = SIZE_MAX;
+
+	map_mix_info.name = "map_mix";
+	map_mix_info.brief = "Mixed map workload";
+	map_mix_info.init = map_mix_init;
+	map_mix_info.exit = map_common_exit;
+	map_mix_info.multithread = true;
+	map_mix_info.multiops = true;
+	map_mix_info.init_worker = map_mix_init_worker;
+	map_mix_info.free_worker = map_common_free_worker;
+	map_mix_info.operation = map_mix_op;
+	map_mix_info.measure_time = true;
+	map_mix_info.clos = map_mix_clos;
+	map_mix_info.nclos = ARRAY_SIZE(map_mix_clos);
+	map_mix_info.opts_size = sizeof(struct map_bench_args);
+	map_mix_info.rm_file = true;
+	map_mix_info.allow_poolset = true;
+	REGISTER_BENCHMARK(map_mix_info);
 }
@@ -0,0 +1,225 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *      * Neither the name of the copyright holder nor the names of its
+ *        contributors may be used to endorse or promote products derived
+ *        from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_open.cpp -- pool open benchmark definition
+ */
+
+#include <cassert>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+
+#include "benchmark.hpp"
+#include "file.h"
+#include "libpmemobj.h"
+
+#define LAYOUT_NAME "obj_open"
+
+/*
+ * prog_args - command line parsed arguments
+ */
+struct prog_args {
+	size_t pool_size;	   /* size of the pool to be opened */
+	bool no_prefault;	   /* if set, do not prefault at open */
+	unsigned prefault_threads; /* number of prefault threads */
+};
+
+/*
+ * obj_open_bench - variables used in benchmark, passed within functions
+ */
+struct obj_open_bench {
+	struct prog_args *pa; /* prog_args structure */
+	const char *path;     /* path to the pool */
+};
+
+/*
+ * obj_open_prefault_set -- (internal) configures prefaulting at open
+ */
+static int
+obj_open_prefault_set(int at_open, int threads)
+{
+	if (pmemobj_ctl_set(NULL, "prefault.at_open", &at_open) != 0 ||
+	    pmemobj_ctl_set(NULL, "prefault.threads", &threads) != 0) {
+		fprintf(stderr, "%s\n", pmemobj_errormsg());
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * obj_open_init -- benchmark initialization
+ */
+static int
+obj_open_init(struct benchmark *bench, struct benchmark_args *args)
+{
+	assert(bench != nullptr);
+	assert(args != nullptr);
+	assert(args->opts != nullptr);
+
+	enum file_type type = util_file_get_type(args->fname);
+	if (type == OTHER_ERROR) {
+		fprintf(stderr, "could not check type of file %s\n",
+			args->fname);
+		return -1;
+	}
+
+	auto *ob = (struct obj_open_bench *)malloc(sizeof(struct obj_open_bench));
+	if (ob == nullptr) {
+		perror("malloc");
+		return -1;
+	}
+
+	ob->pa = (struct prog_args *)args->opts;
+	ob->path = args->fname;
+
+	size_t psize = ob->pa->pool_size;
+	if (args->is_poolset || type == TYPE_DEVDAX) {
+		if (args->fsize < psize) {
+			fprintf(stderr, "file size too large\n");
+			goto err;
+		}
+		psize = 0;
+	}
+
+	PMEMobjpool *pop;
+	pop = pmemobj_create(args->fname, LAYOUT_NAME, psize, args->fmode);
+	if (pop == nullptr) {
+		fprintf(stderr, "%s\n", pmemobj_errormsg());
+		goto err;
+	}
+	pmemobj_close(pop);
+
+	if (obj_open_prefault_set(!ob->pa->no_prefault,
+				  (int)ob->pa->prefault_threads) != 0)
+		goto err;
+
+	pmembench_set_priv(bench, ob);
+
+	return 0;
+
+err:
+	free(ob);
+	return -1;
+}
+
+/*
+ * obj_open_exit -- benchmark clean up
+ */
+static int
+obj_open_exit(struct benchmark *bench, struct benchmark_args *args)
+{
+	auto *ob = (struct obj_open_bench *)pmembench_get_priv(bench);
+
+	/* restore the defaults for the benchmarks that follow */
+	int ret = obj_open_prefault_set(0, 1);
+
+	free(ob);
+
+	return ret;
+}
+
+/*
+ * obj_open_op -- opens and closes the pool
+ */
+static int
+obj_open_op(struct benchmark *bench, struct operation_info *info)
+{
+	auto *ob = (struct obj_open_bench *)pmembench_get_priv(bench);
+
+	PMEMobjpool *pop = pmemobj_open(ob->path, LAYOUT_NAME);
+	if (pop == nullptr) {
+		fprintf(stderr, "%s\n", pmemobj_errormsg());
+		return -1;
+	}
+
+	pmemobj_close(pop);
+
+	return 0;
+}
+
+static struct benchmark_clo obj_open_clo[3];
+static struct benchmark_info obj_open_info;
+
+CONSTRUCTOR(obj_open_constructor)
+void
+obj_open_constructor(void)
+{
+	obj_open_clo[0].opt_short = 's';
+	obj_open_clo[0].opt_long = "pool-size";
+	obj_open_clo[0].descr = "Size of the pool to be opened";
+	obj_open_clo[0].def = "1073741824";
+	obj_open_clo[0].off = clo_field_offset(struct prog_args, pool_size);
+	obj_open_clo[0].type = CLO_TYPE_UINT;
+	obj_open_clo[0].type_uint.size =
+		clo_field_size(struct prog_args, pool_size);
+	obj_open_clo[0].type_uint.base = CLO_INT_BASE_DEC;
+	obj_open_clo[0].type_uint.min = PMEMOBJ_MIN_POOL;
+	obj_open_clo[0].type_uint.max = SIZE_MAX;
+
+	obj_open_clo[1].opt_short = 'n';
+	obj_open_clo[1].opt_long = "no-prefault";
+	obj_open_clo[1].descr = "Do not prefault the pool at open";
+	obj_open_clo[1].def = "false";
+	obj_open_clo[1].off = clo_field_offset(struct prog_args, no_prefault);
+	obj_open_clo[1].type = CLO_TYPE_FLAG;
+
+	obj_open_clo[2].opt_short = 'T';
+	obj_open_clo[2].opt_long = "prefault-threads";
+	obj_open_clo[2].descr = "Number of threads used to prefault the pool";
+	obj_open_clo[2].def = "1";
+	obj_open_clo[2].off =
+		clo_field_offset(struct prog_args, prefault_threads);
+	obj_open_clo[2].type = CLO_TYPE_UINT;
+	obj_open_clo[2].type_uint.size =
+		clo_field_size(struct prog_args, prefault_threads);
+	obj_open_clo[2].type_uint.base = CLO_INT_BASE_DEC;
+	obj_open_clo[2].type_uint.min = 1;
+	obj_open_clo[2].type_uint.max = INT_MAX;
+
+	obj_open_info.name = "obj_open";
+	obj_open_info.brief = "Benchmark for pmemobj_open() with prefaulting";
+	obj_open_info.init = obj_open_init;
+	obj_open_info.exit = obj_open_exit;
+	obj_open_info.multithread = false;
+	obj_open_info.multiops = true;
+	obj_open_info.operation = obj_open_op;
+	obj_open_info.measure_time = true;
+	obj_open_info.clos = obj_open_clo;
+	obj_open_info.nclos = ARRAY_SIZE(obj_open_clo);
+	obj_open_info.opts_size = sizeof(struct prog_args);
+	obj_open_info.rm_file = true;
+	obj_open_info.allow_poolset = true;
+	REGISTER_BENCHMARK(obj_open_info);
+}
@@ -31,7 +31,7 @@
  */
 
 /*
- * obj_pmalloc.cpp -- pmalloc benchmarks definition
+ * obj_pmalloc.cpp -- pmalloc and publish benchmarks definition
  */
 
 #include <cassert>
@@ -71,6 +71,8 @@ struct prog_args {
 	size_t minsize;       /* minimum size for random allocation size */
 	bool use_random_size; /* if set, use random size allocations */
 	unsigned seed;	/* PRNG seed */
+	size_t batch;	/* number of objects published at once */
+	bool bulk;	/* if set, reserve the whole batch in a single call */
 };
 
 POBJ_LAYOUT_BEGIN(pmalloc_layout);
@@ -94,14 +96,17 @@ struct obj_bench {
 	size_t *sizes;		   /* sizes for allocations */
 	TOID(struct my_root) root; /* root object's OID */
 	uint64_t *offs;		   /* pointer to the vector of offsets */
+	size_t nobjs;		   /* number of objects in the benchmark */
 };
 
 /*
- * obj_init -- common part of the benchmark initialization for pmalloc and
- * pfree. It allocates the PMEM memory pool and the necessary offset vector.
+ * obj_init -- common part of the benchmark initialization for pmalloc, pfree
+ * and publish. It allocates the PMEM memory pool and the necessary offset
+ * vector for the given number of objects per operation.
  */
 static int
-obj_init(struct benchmark *bench, struct benchmark_args *args)
+obj_init(struct benchmark *bench, struct benchmark_args *args,
+	 size_t objs_per_op)
 {
 	struct my_root *root = nullptr;
 	assert(bench != nullptr);
@@ -135,6 +140,8 @@ obj_init(struct benchmark *bench, struct benchmark_args *args)
 
 	size_t n_ops_total = args->n_ops_per_thread * args->n_threads;
 	assert(n_ops_total != 0);
+	size_t n_objs_total = n_ops_total * objs_per_op;
+	ob->nobjs = n_objs_total;
 
 	/* Create pmemobj pool. */
 	size_t alloc_size = args->dsize;
@@ -143,9 +150,9 @@ obj_init(struct benchmark *bench, struct benchmark_args *args)
 
 	/* For data objects */
 	size_t poolsize = PMEMOBJ_MIN_POOL +
-		(n_ops_total * (alloc_size + OOB_HEADER_SIZE))
+		(n_objs_total * (alloc_size + OOB_HEADER_SIZE))
 		/* for offsets */
-		+ n_ops_total * sizeof(uint64_t);
+		+ n_objs_total * sizeof(uint64_t);
 
 	/* multiply by FACTOR for metadata, fragmentation, etc. */
 	poolsize = (size_t)(poolsize * FACTOR);
@@ -187,7 +194,7 @@ obj_init(struct benchmark *bench, struct benchmark_args *args)
 	root = D_RW(ob->root);
 	assert(root != nullptr);
 	POBJ_ZALLOC(ob->pop, &root->offs, uint64_t,
-		    n_ops_total * sizeof(PMEMoid));
+		    n_objs_total * sizeof(PMEMoid));
 	if (TOID_IS_NULL(root->offs)) {
 		fprintf(stderr, "POBJ_ZALLOC off_vect: %s\n",
 			pmemobj_errormsg());
@@ -196,7 +203,7 @@ obj_init(struct benchmark *bench, struct benchmark_args *args)
 
 	ob->offs = D_RW(root->offs);
 
-	ob->sizes = (size_t *)malloc(n_ops_total * sizeof(size_t));
+	ob->sizes = (size_t *)malloc(n_objs_total * sizeof(size_t));
 	if (ob->sizes == nullptr) {
 		fprintf(stderr, "malloc rand size vect err\n");
 		goto free_pop;
@@ -204,14 +211,14 @@ obj_init(struct benchmark *bench, struct benchmark_args *args)
 
 	if (ob->pa->use_random_size) {
 		size_t width = args->dsize - ob->pa->minsize;
-		for (size_t i = 0; i < n_ops_total; i++) {
+		for (size_t i = 0; i < n_objs_total; i++) {
 			auto hr = (uint32_t)os_rand_r(&ob->pa->seed);
 			auto lr = (uint32_t)os_rand_r(&ob->pa->seed);
 			uint64_t r64 = (uint64_t)hr << 32 | lr;
 			ob->sizes[i] = r64 % width + ob->pa->minsize;
 		}
 	} else {
-		for (size_t i = 0; i < n_ops_total; i++)
+		for (size_t i = 0; i < n_objs_total; i++)
 			ob->sizes[i] = args->dsize;
 	}
 
@@ -249,7 +256,7 @@ obj_exit(struct benchmark *bench, struct benchmark_args *args)
 static int
 pmalloc_init(struct benchmark *bench, struct benchmark_args *args)
 {
-	return obj_init(bench, args);
+	return obj_init(bench, args, 1);
 }
 
 /*
@@ -375,7 +382,7 @@ pmalloc_exit(struct benchmark *bench, struct benchmark_args *args)
 {
 	auto *ob = (struct obj_bench *)pmembench_get_priv(bench);
 
-	for (size_t i = 0; i < args->n_ops_per_thread * args->n_threads; i++) {
+	for (size_t i = 0; i < ob->nobjs; i++) {
 		if (ob->offs[i])
 			pfree(ob->pop, &ob->offs[i]);
 	}
@@ -390,7 +397,7 @@ pmalloc_exit(struct benchmark *bench, struct benchmark_args *args)
 static int
 pfree_init(struct benchmark *bench, struct benchmark_args *args)
 {
-	int ret = obj_init(bench, args);
+	int ret = obj_init(bench, args, 1);
 	if (ret)
 		return ret;
 
@@ -430,8 +437,127 @@ pfree_op(struct benchmark *bench, struct operation_info *info)
 	return 0;
 }
 
+/*
+ * publish_init -- initialization for the publish benchmark. Performs the
+ * common initialization for all of the objects published in the benchmark.
+ */
+static int
+publish_init(struct benchmark *bench, struct benchmark_args *args)
+{
+	return obj_init(bench, args, ((struct prog_args *)args->opts)->batch);
+}
+
+/*
+ * publish_worker_init -- allocates the actions used by the worker, each
+ * object needs one for its reservation and one for storing its offset
+ */
+static int
+publish_worker_init(struct benchmark *bench, struct benchmark_args *args,
+		    struct worker_info *worker)
+{
+	auto *ob = (struct obj_bench *)pmembench_get_priv(bench);
+
+	auto *actv = (struct pobj_action *)malloc(sizeof(struct pobj_action) *
+						  ob->pa->batch * 2);
+	if (actv == nullptr) {
+		perror("malloc");
+		return -1;
+	}
+
+	worker->priv = actv;
+
+	return 0;
+}
+
+/*
+ * publish_worker_fini -- frees the actions of the worker
+ */
+static void
+publish_worker_fini(struct benchmark *bench, struct benchmark_args *args,
+		    struct worker_info *worker)
+{
+	free(worker->priv);
+}
+
+/*
+ * publish_reserve -- reserves the batch of objects one by one
+ */
+static int
+publish_reserve(struct obj_bench *ob, struct pobj_action *actv,
+		uint64_t first, size_t batch)
+{
+	size_t nact = 0;
+	for (size_t i = first; i < first + batch; ++i) {
+		PMEMoid oid = pmemobj_reserve(ob->pop, &actv[nact++],
+					      ob->sizes[i], 0);
+		if (OID_IS_NULL(oid)) {
+			fprintf(stderr, "pmemobj_reserve: %s\n",
+				pmemobj_errormsg());
+			pmemobj_cancel(ob->pop, actv, nact - 1);
+			return -1;
+		}
+
+		pmemobj_set_value(ob->pop, &actv[nact++], &ob->offs[i],
+				  oid.off);
+	}
+
+	return 0;
+}
+
+/*
+ * publish_reserve_bulk -- reserves the whole batch of objects with a single
+ * pmemobj_xreserve_n() call, all of them have the size of the first one
+ */
+static int
+publish_reserve_bulk(struct obj_bench *ob, struct pobj_action *actv,
+		     uint64_t first, size_t batch)
+{
+	if (pmemobj_xreserve_n(ob->pop, actv, nullptr, batch,
+			       ob->sizes[first], 0, 0) != 0) {
+		fprintf(stderr, "pmemobj_xreserve_n: %s\n",
+			pmemobj_errormsg());
+		return -1;
+	}
+
+	for (size_t i = 0; i < batch; ++i)
+		pmemobj_set_value(ob->pop, &actv[batch + i],
+				  &ob->offs[first + i], actv[i].heap.offset);
+
+	return 0;
+}
+
+/*
+ * publish_op -- actual benchmark operation. Reserves a batch of objects and
+ * publishes them, along with their offsets, in a single pmemobj_publish().
+ */
+static int
+publish_op(struct benchmark *bench, struct operation_info *info)
+{
+	auto *ob = (struct obj_bench *)pmembench_get_priv(bench);
+	auto *actv = (struct pobj_action *)info->worker->priv;
+	size_t batch = ob->pa->batch;
+
+	uint64_t first = (info->index +
+			  info->worker->index * info->args->n_ops_per_thread) *
+		batch;
+
+	int ret = ob->pa->bulk ? publish_reserve_bulk(ob, actv, first, batch)
+			       : publish_reserve(ob, actv, first, batch);
+	if (ret != 0)
+		return -1;
+
+	/* each object has a reservation and a set value action */
+	if (pmemobj_publish(ob->pop, actv, batch * 2) != 0) {
+		fprintf(stderr, "pmemobj_publish: %s\n", pmemobj_errormsg());
+		return -1;
+	}
+
+	return 0;
+}
+
 /* command line options definition */
 static struct benchmark_clo pmalloc_clo[3];
+static struct benchmark_clo publish_clo[5];
 /*
  * Stores information about pmalloc benchmark.
  */
@@ -444,6 +570,10 @@ static struct benchmark_info pfree_info;
  * Stores information about pmix benchmark.
  */
 static struct benchmark_info pmix_info;
+/*
+ * Stores information about publish benchmark.
+ */
+static struct benchmark_info publish_info;
 
 CONSTRUCTOR(obj_pmalloc_constructor)
 void
@@ -531,4 +661,44 @@ obj_pmalloc_constructor(void)
 	pmix_info.rm_file = true;
 	pmix_info.allow_poolset = true;
 	REGISTER_BENCHMARK(pmix_info);
+
+	for (size_t i = 0; i < ARRAY_SIZE(pmalloc_clo); ++i)
+		publish_clo[i] = pmalloc_clo[i];
+
+	publish_clo[3].opt_short = 'b';
+	publish_clo[3].opt_long = "batch";
+	publish_clo[3].descr = "Number of objects published at once";
+	publish_clo[3].off = clo_field_offset(struct prog_args, batch);
+	publish_clo[3].def = "1024";
+	publish_clo[3].type = CLO_TYPE_UINT;
+	publish_clo[3].type_uint.size = clo_field_size(struct prog_args, batch);
+	publish_clo[3].type_uint.base = CLO_INT_BASE_DEC;
+	publish_clo[3].type_uint.min = 1;
+	publish_clo[3].type_uint.max = UINT_MAX;
+
+	publish_clo[4].opt_short = 'N';
+	publish_clo[4].opt_long = "bulk";
+	publish_clo[4].descr = "Reserve the whole batch with a single "
+			       "pmemobj_xreserve_n() call";
+	publish_clo[4].off = clo_field_offset(struct prog_args, bulk);
+	publish_clo[4].type = CLO_TYPE_FLAG;
+
+	publish_info.name = "publish";
+	publish_info.brief = "Benchmark for bulk pmemobj_publish() of "
+			     "reservations";
+	publish_info.init = publish_init;
+
+	publish_info.exit = pmalloc_exit; /* same as for pmalloc */
+	publish_info.multithread = true;
+	publish_info.multiops = true;
+	publish_info.operation = publish_op;
+	publish_info.init_worker = publish_worker_init;
+	publish_info.free_worker = publish_worker_fini;
+	publish_info.measure_time = true;
+	publish_info.clos = publish_clo;
+	publish_info.nclos = ARRAY_SIZE(publish_clo);
+	publish_info.opts_size = sizeof(struct prog_args);
+	publish_info.rm_file = true;
+	publish_info.allow_poolset = true;
+	REGISTER_BENCHMARK(publish_info);
 };
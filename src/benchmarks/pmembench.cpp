@@ -72,6 +72,9 @@
 /* average time required to get a current time from the system */
 unsigned long long Get_time_avg;
 
+/* average number of ticks required to read the time stamp counter */
+static unsigned long long Get_rdtsc_avg;
+
 #define MIN_EXE_TIME_E 0.5
 
 /*
@@ -123,7 +126,7 @@ static struct version_s {
 static struct bench_list benchmarks;
 
 /* common arguments for benchmarks */
-static struct benchmark_clo pmembench_clos[13];
+static struct benchmark_clo pmembench_clos[18];
 
 /* list of arguments for pmembench */
 static struct benchmark_clo pmembench_opts[2];
@@ -294,6 +297,52 @@ pmembench_constructor(void)
 	pmembench_clos[12].off =
 		clo_field_offset(struct benchmark_args, is_dynamic_poolset);
 	pmembench_clos[12].ignore_in_res = true;
+
+	pmembench_clos[13].opt_long = "percentiles";
+	pmembench_clos[13].type = CLO_TYPE_STR;
+	pmembench_clos[13].descr =
+		"Latency percentiles to report separated by semicolon";
+	pmembench_clos[13].off =
+		clo_field_offset(struct benchmark_args, percentiles);
+	pmembench_clos[13].def = "50;99;99.9";
+	pmembench_clos[13].ignore_in_res = true;
+
+	pmembench_clos[14].opt_long = "output-format";
+	pmembench_clos[14].type = CLO_TYPE_STR;
+	pmembench_clos[14].descr = "Format of results: csv or json";
+	pmembench_clos[14].off =
+		clo_field_offset(struct benchmark_args, output_format);
+	pmembench_clos[14].def = "csv";
+	pmembench_clos[14].ignore_in_res = true;
+
+	pmembench_clos[15].opt_long = "timer";
+	pmembench_clos[15].type = CLO_TYPE_STR;
+	pmembench_clos[15].descr =
+		"Source of latency timestamps: clock or rdtsc";
+	pmembench_clos[15].off = clo_field_offset(struct benchmark_args, timer);
+	pmembench_clos[15].def = "clock";
+	pmembench_clos[15].ignore_in_res = true;
+
+	pmembench_clos[16].opt_long = "rate";
+	pmembench_clos[16].type = CLO_TYPE_UINT;
+	pmembench_clos[16].descr = "Target number of operations per second per "
+				   "thread, 0 runs operations back to back";
+	pmembench_clos[16].off = clo_field_offset(struct benchmark_args, rate);
+	pmembench_clos[16].def = "0";
+	pmembench_clos[16].type_uint.size =
+		clo_field_size(struct benchmark_args, rate);
+	pmembench_clos[16].type_uint.base = CLO_INT_BASE_DEC;
+	pmembench_clos[16].type_uint.min = 0;
+	pmembench_clos[16].type_uint.max = ULONG_MAX;
+
+	pmembench_clos[17].opt_long = "arrival";
+	pmembench_clos[17].type = CLO_TYPE_STR;
+	pmembench_clos[17].descr =
+		"Distribution of intervals between operations with --rate: "
+		"constant or poisson";
+	pmembench_clos[17].off =
+		clo_field_offset(struct benchmark_args, arrival);
+	pmembench_clos[17].def = "constant";
 }
 
 /*
@@ -390,20 +439,218 @@ pmembench_merge_clos(struct benchmark *bench)
 }
 
 /*
- * pmembench_run_worker -- run worker with benchmark operation
+ * pmembench_run_ops_closed -- run operations one after another as fast as
+ * possible
  */
 static int
-pmembench_run_worker(struct benchmark *bench, struct worker_info *winfo)
+pmembench_run_ops_closed(struct benchmark *bench, struct worker_info *winfo,
+			 uint64_t (*get_ticks)(void))
 {
-	benchmark_time_get(&winfo->beg);
+	uint64_t beg = get_ticks();
+	for (size_t i = 0; i < winfo->nops; i++) {
+		if (bench->info->operation(bench, &winfo->opinfo[i]))
+			return -1;
+		uint64_t end = get_ticks();
+		benchmark_hist_record(winfo->hist, end - beg);
+		beg = end;
+	}
+
+	return 0;
+}
+
+/*
+ * pmembench_exp_interval -- return exponentially distributed interval with
+ * the given mean, which makes the arrivals a Poisson process
+ */
+static double
+pmembench_exp_interval(unsigned *seed, double mean)
+{
+	/* uniformly distributed value from the (0, 1] range */
+	double u = ((os_rand_r(seed) & 0x7fffffff) + 1.0) / 2147483648.0;
+
+	return -log(u) * mean;
+}
+
+/*
+ * pmembench_run_ops_open -- run operations at a fixed arrival rate
+ *
+ * An operation is started at its intended start time or, if the previous
+ * operation took longer than the interval between them, right after the
+ * previous one. The latency is measured from the intended start time, so
+ * the time an operation spends waiting for slower predecessors is included
+ * in the results.
+ */
+static int
+pmembench_run_ops_open(struct benchmark *bench, struct worker_info *winfo,
+		       uint64_t (*get_ticks)(void))
+{
+	struct benchmark_args *args = winfo->opinfo[0].args;
+	double nsecs_per_tick =
+		args->use_rdtsc ? benchmark_rdtsc_nsecs_per_tick() : 1.0;
+	double interval = 1e9 / nsecs_per_tick / (double)args->rate;
+	unsigned seed = args->seed + (unsigned)winfo->index;
+
+	uint64_t start = get_ticks();
+	double offset = 0.0;
 	for (size_t i = 0; i < winfo->nops; i++) {
+		uint64_t intended = start + (uint64_t)offset;
+		while (get_ticks() < intended)
+			sched_yield();
+
 		if (bench->info->operation(bench, &winfo->opinfo[i]))
 			return -1;
-		benchmark_time_get(&winfo->opinfo[i].end);
+		uint64_t end = get_ticks();
+		benchmark_hist_record(winfo->hist, end - intended);
+
+		offset += args->poisson
+			? pmembench_exp_interval(&seed, interval)
+			: interval;
 	}
+
+	return 0;
+}
+
+/*
+ * pmembench_run_worker -- run worker with benchmark operation
+ */
+static int
+pmembench_run_worker(struct benchmark *bench, struct worker_info *winfo)
+{
+	assert(winfo->nops != 0);
+	struct benchmark_args *args = winfo->opinfo[0].args;
+	uint64_t (*get_ticks)(void) =
+		args->use_rdtsc ? benchmark_ticks_rdtsc : benchmark_ticks_clock;
+
+	benchmark_time_get(&winfo->beg);
+	int ret;
+	if (args->rate)
+		ret = pmembench_run_ops_open(bench, winfo, get_ticks);
+	else
+		ret = pmembench_run_ops_closed(bench, winfo, get_ticks);
 	benchmark_time_get(&winfo->end);
 
+	return ret;
+}
+
+/*
+ * pmembench_parse_pctls -- parse list of latency percentiles separated by
+ * semicolon
+ */
+static int
+pmembench_parse_pctls(const char *list, struct latency *lat)
+{
+	char *str = strdup(list);
+	if (str == nullptr) {
+		perror("strdup");
+		return -1;
+	}
+
+	int ret = 0;
+	lat->npctls = 0;
+	for (char *tok = strtok(str, ";"); tok != nullptr;
+	     tok = strtok(nullptr, ";")) {
+		if (lat->npctls == BENCHMARK_MAX_PCTLS) {
+			fprintf(stderr, "too many percentiles (max %d)\n",
+				BENCHMARK_MAX_PCTLS);
+			ret = -1;
+			break;
+		}
+
+		char *end;
+		double pctl = strtod(tok, &end);
+		if (end == tok || *end != '\0' || !(pctl > 0.0) ||
+		    pctl > 100.0) {
+			fprintf(stderr, "invalid percentile: %s\n", tok);
+			ret = -1;
+			break;
+		}
+
+		lat->pctl[lat->npctls++] = pctl;
+	}
+
+	free(str);
+	return ret;
+}
+
+/*
+ * pmembench_parse_format -- parse format of results
+ */
+static int
+pmembench_parse_format(const char *format, bool *json)
+{
+	if (strcmp(format, "csv") == 0) {
+		*json = false;
+		return 0;
+	}
+
+	if (strcmp(format, "json") == 0) {
+		*json = true;
+		return 0;
+	}
+
+	fprintf(stderr, "invalid output format: %s\n", format);
+	return -1;
+}
+
+/*
+ * pmembench_init_timer -- select source of latency timestamps
+ */
+static int
+pmembench_init_timer(struct benchmark_args *args)
+{
+	if (strcmp(args->timer, "clock") == 0) {
+		args->use_rdtsc = false;
+		return 0;
+	}
+
+	if (strcmp(args->timer, "rdtsc") != 0) {
+		fprintf(stderr, "invalid timer: %s\n", args->timer);
+		return -1;
+	}
+
+#ifdef BENCHMARK_HAS_RDTSC
+	if (Get_rdtsc_avg == 0)
+		Get_rdtsc_avg =
+			benchmark_get_avg_get_ticks(benchmark_ticks_rdtsc);
+	args->use_rdtsc = true;
+
 	return 0;
+#else
+	fprintf(stderr, "rdtsc timer not supported on this platform\n");
+	return -1;
+#endif
+}
+
+/*
+ * pmembench_parse_arrival -- parse distribution of intervals between
+ * operations in the open-loop mode
+ */
+static int
+pmembench_parse_arrival(struct benchmark_args *args)
+{
+	if (strcmp(args->arrival, "constant") == 0) {
+		args->poisson = false;
+		return 0;
+	}
+
+	if (strcmp(args->arrival, "poisson") == 0) {
+		args->poisson = true;
+		return 0;
+	}
+
+	fprintf(stderr, "invalid arrival distribution: %s\n", args->arrival);
+	return -1;
+}
+
+/*
+ * pmembench_print_pctl -- print percentile with at least one decimal digit
+ */
+static void
+pmembench_print_pctl(double pctl)
+{
+	char buff[32];
+	snprintf(buff, sizeof(buff), "%g", pctl);
+	printf("%s%s", buff, strchr(buff, '.') ? "" : ".0");
 }
 
 /*
@@ -411,7 +658,7 @@ pmembench_run_worker(struct benchmark *bench, struct worker_info *winfo)
  */
 static void
 pmembench_print_header(struct pmembench *pb, struct benchmark *bench,
-		       struct clo_vec *clovec)
+		       struct clo_vec *clovec, const struct latency *lat)
 {
 	if (pb->scenario) {
 		printf("%s: %s [%" PRIu64 "]%s%s%s\n", pb->scenario->name,
@@ -431,10 +678,12 @@ pmembench_print_header(struct pmembench *pb, struct benchmark *bench,
 	       "latency-avg[nsec];"
 	       "latency-min[nsec];"
 	       "latency-max[nsec];"
-	       "latency-std-dev[nsec];"
-	       "latency-pctl-50.0%%[nsec];"
-	       "latency-pctl-99.0%%[nsec];"
-	       "latency-pctl-99.9%%[nsec]");
+	       "latency-std-dev[nsec]");
+	for (size_t k = 0; k < lat->npctls; k++) {
+		printf(";latency-pctl-");
+		pmembench_print_pctl(lat->pctl[k]);
+		printf("%%[nsec]");
+	}
 	size_t i;
 	for (i = 0; i < bench->nclos; i++) {
 		if (!bench->clos[i].ignore_in_res) {
@@ -457,13 +706,12 @@ static void
 pmembench_print_results(struct benchmark *bench, struct benchmark_args *args,
 			struct total_results *res)
 {
-	printf("%f;%f;%f;%f;%f;%f;%" PRIu64 ";%" PRIu64 ";%" PRIu64
-	       ";%f;%" PRIu64 ";%" PRIu64 ";%" PRIu64,
+	printf("%f;%f;%f;%f;%f;%f;%" PRIu64 ";%" PRIu64 ";%" PRIu64 ";%f",
 	       res->total.avg, res->nopsps, res->total.max, res->total.min,
 	       res->total.med, res->total.std_dev, res->latency.avg,
-	       res->latency.min, res->latency.max, res->latency.std_dev,
-	       res->latency.pctl50_0p, res->latency.pctl99_0p,
-	       res->latency.pctl99_9p);
+	       res->latency.min, res->latency.max, res->latency.std_dev);
+	for (size_t k = 0; k < res->latency.npctls; k++)
+		printf(";%" PRIu64, res->latency.pctl_val[k]);
 
 	size_t i;
 	for (i = 0; i < bench->nclos; i++) {
@@ -480,6 +728,110 @@ pmembench_print_results(struct benchmark *bench, struct benchmark_args *args,
 	printf("\n");
 }
 
+/*
+ * pmembench_print_json_str -- print string as JSON string literal
+ */
+static void
+pmembench_print_json_str(const char *str)
+{
+	putchar('"');
+	for (; *str != '\0'; str++) {
+		if (*str == '"' || *str == '\\')
+			printf("\\%c", *str);
+		else if ((unsigned char)*str < 0x20)
+			printf("\\u%04x", (unsigned)*str);
+		else
+			putchar(*str);
+	}
+	putchar('"');
+}
+
+/*
+ * struct json_hist_ctx -- context of printing histogram buckets as JSON
+ */
+struct json_hist_ctx {
+	double nsecs_per_tick;
+	bool first;
+};
+
+/*
+ * pmembench_print_json_bucket -- print single histogram bucket as JSON
+ */
+static void
+pmembench_print_json_bucket(uint64_t value, uint64_t count, void *arg)
+{
+	auto *ctx = (struct json_hist_ctx *)arg;
+
+	printf("%s[%" PRIu64 ",%" PRIu64 "]", ctx->first ? "" : ",",
+	       (uint64_t)((double)value * ctx->nsecs_per_tick), count);
+	ctx->first = false;
+}
+
+/*
+ * pmembench_print_results_json -- print benchmark's results as a single
+ * line JSON object, the keys of which match the CSV columns
+ *
+ * The benchmark specific extra values are printed by callbacks in the CSV
+ * format, so they are not a part of the JSON object.
+ */
+static void
+pmembench_print_results_json(struct pmembench *pb, struct benchmark *bench,
+			     struct benchmark_args *args,
+			     struct total_results *res)
+{
+	printf("{\"benchmark\":");
+	pmembench_print_json_str(bench->info->name);
+	if (pb->scenario) {
+		printf(",\"scenario\":");
+		pmembench_print_json_str(pb->scenario->name);
+		if (pb->scenario->group) {
+			printf(",\"group\":");
+			pmembench_print_json_str(pb->scenario->group);
+		}
+	}
+
+	printf(",\"total-avg[sec]\":%f"
+	       ",\"ops-per-second[1/sec]\":%f"
+	       ",\"total-max[sec]\":%f"
+	       ",\"total-min[sec]\":%f"
+	       ",\"total-median[sec]\":%f"
+	       ",\"total-std-dev[sec]\":%f"
+	       ",\"latency-avg[nsec]\":%" PRIu64
+	       ",\"latency-min[nsec]\":%" PRIu64
+	       ",\"latency-max[nsec]\":%" PRIu64
+	       ",\"latency-std-dev[nsec]\":%f",
+	       res->total.avg, res->nopsps, res->total.max, res->total.min,
+	       res->total.med, res->total.std_dev, res->latency.avg,
+	       res->latency.min, res->latency.max, res->latency.std_dev);
+	for (size_t k = 0; k < res->latency.npctls; k++) {
+		printf(",\"latency-pctl-");
+		pmembench_print_pctl(res->latency.pctl[k]);
+		printf("%%[nsec]\":%" PRIu64, res->latency.pctl_val[k]);
+	}
+
+	for (size_t i = 0; i < bench->nclos; i++) {
+		if (bench->clos[i].ignore_in_res)
+			continue;
+		putchar(',');
+		pmembench_print_json_str(bench->clos[i].opt_long);
+		putchar(':');
+		pmembench_print_json_str(benchmark_clo_str(
+			&bench->clos[i], args, bench->args_size));
+	}
+
+	if (bench->info->print_bandwidth)
+		printf(",\"bandwidth[MiB/s]\":%f",
+		       res->nopsps * args->dsize / 1024 / 1024);
+
+	printf(",\"timer\":");
+	pmembench_print_json_str(args->timer);
+
+	struct json_hist_ctx ctx = {res->nsecs_per_tick, true};
+	printf(",\"latency-histogram[nsec]\":[");
+	benchmark_hist_foreach(res->hist, pmembench_print_json_bucket, &ctx);
+	printf("]}\n");
+}
+
 /*
  * pmembench_parse_clos -- parse command line arguments for benchmark
  */
@@ -619,6 +971,8 @@ pmembench_init_workers(struct benchmark_worker **workers,
 			workers[i]->info.opinfo[j].args = args;
 			workers[i]->info.opinfo[j].index = j;
 		}
+		workers[i]->info.hist = benchmark_hist_alloc();
+		assert(workers[i]->info.hist != nullptr);
 		workers[i]->bench = bench;
 		workers[i]->args = args;
 		workers[i]->func = pmembench_run_worker;
@@ -633,19 +987,17 @@ end:
 }
 
 /*
- * results_store -- store results of a single repeat
+ * results_store -- store results of a single repeat and merge latencies
+ * measured by workers into the histogram of all repeats
  */
 static void
-results_store(struct bench_results *res, struct benchmark_worker **workers,
-	      unsigned nthreads, size_t nops)
+results_store(struct bench_results *res, struct benchmark_hist *hist,
+	      struct benchmark_worker **workers, unsigned nthreads)
 {
 	for (unsigned i = 0; i < nthreads; i++) {
 		res->thres[i]->beg = workers[i]->info.beg;
 		res->thres[i]->end = workers[i]->info.end;
-		for (size_t j = 0; j < nops; j++) {
-			res->thres[i]->end_op[j] =
-				workers[i]->info.opinfo[j].end;
-		}
+		benchmark_hist_merge(hist, workers[i]->info.hist);
 	}
 }
 
@@ -672,17 +1024,6 @@ compare_doubles(const void *a1, const void *b1)
 	return (*a > *b) - (*a < *b);
 }
 
-/*
-* compare_uint64t -- comparing function used for sorting
-*/
-static int
-compare_uint64t(const void *a1, const void *b1)
-{
-	const auto *a = (const uint64_t *)a1;
-	const auto *b = (const uint64_t *)b1;
-	return (*a > *b) - (*a < *b);
-}
-
 /*
  * results_alloc -- prepare structure to store all benchmark results
  */
@@ -695,6 +1036,26 @@ results_alloc(struct benchmark_args *args)
 	total->nrepeats = args->repeats;
 	total->nthreads = args->n_threads;
 	total->nops = args->n_ops_per_thread;
+	total->hist = benchmark_hist_alloc();
+	assert(total->hist != nullptr);
+
+	int ret = pmembench_parse_pctls(args->percentiles, &total->latency);
+	assert(ret == 0);
+	(void)ret;
+
+	if (args->use_rdtsc) {
+		total->nsecs_per_tick = benchmark_rdtsc_nsecs_per_tick();
+		total->get_time_avg = (unsigned long long)(
+			(double)Get_rdtsc_avg * total->nsecs_per_tick);
+	} else {
+		total->nsecs_per_tick = 1.0;
+		total->get_time_avg = Get_time_avg;
+	}
+
+	/* in the open-loop mode the total time is set by the schedule */
+	if (args->rate)
+		total->get_time_avg = 0;
+
 	total->res = (struct bench_results *)malloc(args->repeats *
 						    sizeof(*total->res));
 	assert(total->res != nullptr);
@@ -707,9 +1068,7 @@ results_alloc(struct benchmark_args *args)
 		assert(res->thres != nullptr);
 		for (size_t j = 0; j < args->n_threads; j++) {
 			res->thres[j] = (struct thread_results *)malloc(
-				sizeof(*res->thres[j]) +
-				args->n_ops_per_thread *
-					sizeof(benchmark_time_t));
+				sizeof(*res->thres[j]));
 			assert(res->thres[j] != nullptr);
 		}
 	}
@@ -729,6 +1088,7 @@ results_free(struct total_results *total)
 		free(total->res[i].thres);
 	}
 	free(total->res);
+	benchmark_hist_free(total->hist);
 	free(total);
 }
 
@@ -744,12 +1104,9 @@ get_total_results(struct total_results *tres)
 
 	/* reset results */
 	memset(&tres->total, 0, sizeof(tres->total));
-	memset(&tres->latency, 0, sizeof(tres->latency));
 
 	tres->total.min = DBL_MAX;
 	tres->total.max = DBL_MIN;
-	tres->latency.min = UINT64_MAX;
-	tres->latency.max = 0;
 
 	/* allocate helper arrays */
 	benchmark_time_t *tbeg =
@@ -763,7 +1120,7 @@ get_total_results(struct total_results *tres)
 
 	/* estimate total penalty of getting time from the system */
 	benchmark_time_t Tget;
-	unsigned long long nsecs = tres->nops * Get_time_avg;
+	unsigned long long nsecs = tres->nops * tres->get_time_avg;
 	benchmark_time_set(&Tget, nsecs);
 
 	for (size_t i = 0; i < tres->nrepeats; i++) {
@@ -832,76 +1189,23 @@ get_total_results(struct total_results *tres)
 	tres->total.std_dev = sqrt(tres->total.std_dev / tres->nrepeats);
 
 	/* latency */
-	for (size_t i = 0; i < tres->nrepeats; i++) {
-		struct bench_results *res = &tres->res[i];
-		for (size_t j = 0; j < tres->nthreads; j++) {
-			struct thread_results *thres = res->thres[j];
-			benchmark_time_t *beg = &thres->beg;
-			for (size_t o = 0; o < tres->nops; o++) {
-				benchmark_time_t lat;
-				benchmark_time_diff(&lat, beg,
-						    &thres->end_op[o]);
-				uint64_t nsecs = benchmark_time_get_nsecs(&lat);
-
-				/* min, max latency */
-				if (nsecs > tres->latency.max)
-					tres->latency.max = nsecs;
-				if (nsecs < tres->latency.min)
-					tres->latency.min = nsecs;
-
-				tres->latency.avg += nsecs;
-
-				beg = &thres->end_op[o];
-			}
-		}
+	struct benchmark_hist *hist = tres->hist;
+	double scale = tres->nsecs_per_tick;
+	assert(benchmark_hist_count(hist) > 0);
+
+	tres->latency.min =
+		(uint64_t)((double)benchmark_hist_min(hist) * scale);
+	tres->latency.max =
+		(uint64_t)((double)benchmark_hist_max(hist) * scale);
+	tres->latency.avg = (uint64_t)(benchmark_hist_mean(hist) * scale);
+	tres->latency.std_dev = benchmark_hist_std_dev(hist) * scale;
+
+	for (size_t k = 0; k < tres->latency.npctls; k++) {
+		uint64_t val = benchmark_hist_percentile(hist,
+							 tres->latency.pctl[k]);
+		tres->latency.pctl_val[k] = (uint64_t)((double)val * scale);
 	}
 
-	/* average latency */
-	size_t count = tres->nrepeats * tres->nthreads * tres->nops;
-	assert(count > 0);
-	tres->latency.avg /= count;
-
-	auto *ntotals = (uint64_t *)calloc(count, sizeof(uint64_t));
-	assert(ntotals != nullptr);
-	count = 0;
-
-	/* std deviation of latency and percentiles */
-	for (size_t i = 0; i < tres->nrepeats; i++) {
-		struct bench_results *res = &tres->res[i];
-		for (size_t j = 0; j < tres->nthreads; j++) {
-			struct thread_results *thres = res->thres[j];
-			benchmark_time_t *beg = &thres->beg;
-			for (size_t o = 0; o < tres->nops; o++) {
-				benchmark_time_t lat;
-				benchmark_time_diff(&lat, beg,
-						    &thres->end_op[o]);
-				uint64_t nsecs = benchmark_time_get_nsecs(&lat);
-
-				uint64_t dev = (nsecs - tres->latency.avg);
-				dev *= dev;
-
-				tres->latency.std_dev += dev;
-
-				beg = &thres->end_op[o];
-
-				ntotals[count] = nsecs;
-				++count;
-			}
-		}
-	}
-
-	tres->latency.std_dev = sqrt(tres->latency.std_dev / count);
-
-	/* find 50%, 99.0% and 99.9% percentiles */
-	qsort(ntotals, count, sizeof(uint64_t), compare_uint64t);
-	uint64_t p50_0 = count * 50 / 100;
-	uint64_t p99_0 = count * 99 / 100;
-	uint64_t p99_9 = count * 999 / 1000;
-	tres->latency.pctl50_0p = ntotals[p50_0];
-	tres->latency.pctl99_0p = ntotals[p99_0];
-	tres->latency.pctl99_9p = ntotals[p99_9];
-	free(ntotals);
-
 	free(totals);
 	free(tend);
 	free(tbeg);
@@ -1135,7 +1439,7 @@ pmembench_remove_file(const char *path)
  */
 static int
 pmembench_single_repeat(struct benchmark *bench, struct benchmark_args *args,
-			struct bench_results *res)
+			struct bench_results *res, struct benchmark_hist *hist)
 {
 	int ret = 0;
 
@@ -1194,12 +1498,13 @@ pmembench_single_repeat(struct benchmark *bench, struct benchmark_args *args,
 		}
 	}
 
-	results_store(res, workers, args->n_threads, args->n_ops_per_thread);
+	results_store(res, hist, workers, args->n_threads);
 
 	for (j = 0; j < args->n_threads; j++) {
 		benchmark_worker_exit(workers[j]);
 
 		free(workers[j]->info.opinfo);
+		benchmark_hist_free(workers[j]->info.hist);
 		benchmark_worker_free(workers[j]);
 	}
 
@@ -1228,7 +1533,8 @@ scale_up_min_exe_time(struct benchmark *bench, struct benchmark_args *args,
 		 * run single benchmark repeat to probe execution time
 		 */
 		int ret = pmembench_single_repeat(bench, args,
-						  &total_res->res[0]);
+						  &total_res->res[0],
+						  total_res->hist);
 		if (ret != 0)
 			return 1;
 		get_total_results(total_res);
@@ -1281,6 +1587,8 @@ pmembench_run(struct pmembench *pb, struct benchmark *bench)
 	struct total_results *total_res = nullptr;
 	struct latency *stats = nullptr;
 	double *workers_times = nullptr;
+	struct latency pctls;
+	bool json = false;
 
 	struct clo_vec *clovec = nullptr;
 
@@ -1361,7 +1669,15 @@ pmembench_run(struct pmembench *pb, struct benchmark *bench)
 		return -1;
 	}
 
-	pmembench_print_header(pb, bench, clovec);
+	if (pmembench_parse_pctls(args->percentiles, &pctls) ||
+	    pmembench_parse_format(args->output_format, &json) ||
+	    pmembench_init_timer(args) || pmembench_parse_arrival(args)) {
+		ret = -1;
+		goto out;
+	}
+
+	if (!json)
+		pmembench_print_header(pb, bench, clovec, &pctls);
 
 	size_t args_i;
 	for (args_i = 0; args_i < clovec->nargs; args_i++) {
@@ -1378,6 +1694,13 @@ pmembench_run(struct pmembench *pb, struct benchmark *bench)
 		args->opts = (void *)((uintptr_t)args +
 				      sizeof(struct benchmark_args));
 
+		if (pmembench_parse_pctls(args->percentiles, &pctls) ||
+		    pmembench_init_timer(args) ||
+		    pmembench_parse_arrival(args)) {
+			ret = -1;
+			goto out;
+		}
+
 		if (args->is_dynamic_poolset) {
 			if (!bench->info->allow_poolset) {
 				fprintf(stderr,
@@ -1442,13 +1765,18 @@ pmembench_run(struct pmembench *pb, struct benchmark *bench)
 
 		for (; i < args->repeats; i++) {
 			ret = pmembench_single_repeat(bench, args,
-						      &total_res->res[i]);
+						      &total_res->res[i],
+						      total_res->hist);
 			if (ret != 0)
 				goto out;
 		}
 
 		get_total_results(total_res);
-		pmembench_print_results(bench, args, total_res);
+		if (json)
+			pmembench_print_results_json(pb, bench, args,
+						     total_res);
+		else
+			pmembench_print_results(bench, args, total_res);
 
 		args->n_ops_per_thread = n_ops_per_thread_copy;
 		args->n_threads = n_threads_copy;
@@ -32,10 +32,12 @@
 
 /*
  * pmemobj_tx.cpp -- pmemobj_tx_alloc(), pmemobj_tx_free(),
- * pmemobj_tx_realloc(), pmemobj_tx_add_range() benchmarks.
+ * pmemobj_tx_realloc(), pmemobj_tx_add_range() benchmarks and a benchmark of
+ * transactions which snapshot large ranges.
  */
 #include <cassert>
 #include <cerrno>
+#include <cinttypes>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -184,6 +186,7 @@ struct obj_tx_args {
 	unsigned min_rsize; /* minimum reallocation size */
 	unsigned rsize;     /* reallocation size */
 	bool change_type;   /* change type number in reallocation */
+	bool latency_stats; /* collect latency histograms of tx phases */
 	size_t obj_size;    /* size of each allocated object */
 	size_t n_ops;       /* number of operations */
 	int parse_mode;     /* type of parsing function */
@@ -1047,7 +1050,18 @@ obj_tx_init(struct benchmark *bench, struct benchmark_args *args)
 		goto free_all;
 	}
 
+	if (obj_bench.obj_args->latency_stats) {
+		int enabled = 1;
+		if (pmemobj_ctl_set(obj_bench.pop, "stats.tx.latency.enabled",
+				    &enabled) != 0) {
+			perror("pmemobj_ctl_set");
+			goto free_pop;
+		}
+	}
+
 	return 0;
+free_pop:
+	pmemobj_close(obj_bench.pop);
 free_all:
 	free(obj_bench.sizes);
 free_random_types:
@@ -1056,6 +1070,40 @@ free_random_types:
 	return -1;
 }
 
+/*
+ * obj_tx_print_latency -- prints the latency histograms of transaction phases
+ * collected by the library.
+ */
+static void
+obj_tx_print_latency(PMEMobjpool *pop)
+{
+	const char *phases[] = {"add_range", "pre_commit", "process", "lock"};
+	const char *fields[] = {"count", "total", "max",
+				"p50",   "p99",   "p999"};
+
+	printf("tx-phase;"
+	       "count;"
+	       "total[nsec];"
+	       "max[nsec];"
+	       "pctl-50.0%%[nsec];"
+	       "pctl-99.0%%[nsec];"
+	       "pctl-99.9%%[nsec]\n");
+
+	char query[64];
+	for (const char *phase : phases) {
+		printf("%s", phase);
+		for (const char *field : fields) {
+			uint64_t value = 0;
+			snprintf(query, sizeof(query), "stats.tx.latency.%s.%s",
+				 phase, field);
+			if (pmemobj_ctl_get(pop, query, &value) != 0)
+				perror("pmemobj_ctl_get");
+			printf(";%" PRIu64, value);
+		}
+		printf("\n");
+	}
+}
+
 /*
  * obj_tx_exit -- common part for the exit function of the transactional
  * benchmarks in their exit functions.
@@ -1064,8 +1112,11 @@ int
 obj_tx_exit(struct benchmark *bench, struct benchmark_args *args)
 {
 	auto *obj_bench = (struct obj_tx_bench *)pmembench_get_priv(bench);
-	if (obj_bench->lib_mode != LIB_MODE_DRAM)
+	if (obj_bench->lib_mode != LIB_MODE_DRAM) {
+		if (obj_bench->obj_args->latency_stats)
+			obj_tx_print_latency(obj_bench->pop);
 		pmemobj_close(obj_bench->pop);
+	}
 
 	free(obj_bench->sizes);
 	if (obj_bench->type_mode == NUM_MODE_RAND)
@@ -1085,13 +1136,200 @@ obj_tx_realloc_exit(struct benchmark *bench, struct benchmark_args *args)
 	return obj_tx_exit(bench, args);
 }
 
+/*
+ * obj_tx_snapshot_args -- command line arguments of the obj_tx_snapshot
+ * benchmark.
+ */
+struct obj_tx_snapshot_args {
+	unsigned ranges;    /* number of ranges the snapshot is split into */
+	size_t ulog_retain; /* value of the tx.cache.retain parameter */
+	size_t ulog_decay;  /* value of the tx.cache.decay parameter */
+};
+
+/*
+ * obj_tx_snapshot_bench -- stores variables used in obj_tx_snapshot
+ * benchmark.
+ */
+struct obj_tx_snapshot_bench {
+	PMEMobjpool *pop; /* handle to persistent pool */
+	PMEMoid *oids;    /* object snapshotted by each worker */
+	size_t dsize;     /* size of the snapshot */
+	unsigned ranges;  /* number of ranges the snapshot is split into */
+};
+
+/*
+ * obj_tx_snapshot_op -- main operation of the obj_tx_snapshot benchmark,
+ * snapshots the whole worker's object in one transaction.
+ */
+static int
+obj_tx_snapshot_op(struct benchmark *bench, struct operation_info *info)
+{
+	auto *sb = (struct obj_tx_snapshot_bench *)pmembench_get_priv(bench);
+	PMEMoid oid = sb->oids[info->worker->index];
+	size_t range = sb->dsize / sb->ranges;
+	int ret = 0;
+
+	TX_BEGIN(sb->pop)
+	{
+		for (unsigned i = 0; i < sb->ranges; i++) {
+			size_t size = i == sb->ranges - 1
+				? sb->dsize - range * i
+				: range;
+			pmemobj_tx_add_range(oid, range * i, size);
+		}
+	}
+	TX_ONABORT
+	{
+		fprintf(stderr, "transaction failed\n");
+		ret = -1;
+	}
+	TX_END
+
+	return ret;
+}
+
+/*
+ * obj_tx_snapshot_init -- initialization function of the obj_tx_snapshot
+ * benchmark, creates the pool, sets the undo log retention and allocates
+ * one object per worker.
+ */
+static int
+obj_tx_snapshot_init(struct benchmark *bench, struct benchmark_args *args)
+{
+	assert(bench != nullptr);
+	assert(args != nullptr);
+	assert(args->opts != nullptr);
+
+	auto *sargs = (struct obj_tx_snapshot_args *)args->opts;
+
+	char path[PATH_MAX];
+	if (util_safe_strcpy(path, args->fname, sizeof(path)) != 0)
+		return -1;
+
+	enum file_type type = util_file_get_type(args->fname);
+	if (type == OTHER_ERROR) {
+		fprintf(stderr, "could not check type of file %s\n",
+			args->fname);
+		return -1;
+	}
+
+	if (sargs->ranges == 0 || sargs->ranges > args->dsize) {
+		fprintf(stderr, "invalid number of ranges\n");
+		return -1;
+	}
+
+	auto *sb = (struct obj_tx_snapshot_bench *)calloc(
+		1, sizeof(struct obj_tx_snapshot_bench));
+	if (sb == nullptr) {
+		perror("calloc");
+		return -1;
+	}
+
+	sb->dsize = args->dsize;
+	sb->ranges = sargs->ranges;
+
+	/*
+	 * Each worker needs room for its object, the undo logs of its
+	 * transaction and the logs retained in its lane.
+	 */
+	size_t psize = args->n_threads *
+		(2 * (args->dsize + ALLOC_OVERHEAD) + sargs->ulog_retain);
+	psize += PMEMOBJ_MIN_POOL;
+	psize = (size_t)(psize * FACTOR);
+
+	if (args->is_poolset || type == TYPE_DEVDAX) {
+		if (args->fsize < psize) {
+			fprintf(stderr, "file size too large\n");
+			goto free_sb;
+		}
+
+		psize = 0;
+	} else if (args->is_dynamic_poolset) {
+		int ret = dynamic_poolset_create(args->fname, psize);
+		if (ret == -1)
+			goto free_sb;
+
+		if (util_safe_strcpy(path, POOLSET_PATH, sizeof(path)) != 0)
+			goto free_sb;
+
+		psize = 0;
+	}
+
+	sb->pop = pmemobj_create(path, LAYOUT_NAME, psize, args->fmode);
+	if (sb->pop == nullptr) {
+		perror("pmemobj_create");
+		goto free_sb;
+	}
+
+	if (sargs->ulog_retain != 0) {
+		long long retain = (long long)sargs->ulog_retain;
+		if (pmemobj_ctl_set(sb->pop, "tx.cache.retain", &retain) !=
+		    0) {
+			perror("pmemobj_ctl_set");
+			goto free_pop;
+		}
+	}
+
+	if (sargs->ulog_decay != 0) {
+		long long decay = (long long)sargs->ulog_decay;
+		if (pmemobj_ctl_set(sb->pop, "tx.cache.decay", &decay) != 0) {
+			perror("pmemobj_ctl_set");
+			goto free_pop;
+		}
+	}
+
+	sb->oids = (PMEMoid *)calloc(args->n_threads, sizeof(PMEMoid));
+	if (sb->oids == nullptr) {
+		perror("calloc");
+		goto free_pop;
+	}
+
+	for (unsigned i = 0; i < args->n_threads; i++) {
+		if (pmemobj_zalloc(sb->pop, &sb->oids[i], args->dsize, 0) !=
+		    0) {
+			perror("pmemobj_zalloc");
+			goto free_oids;
+		}
+	}
+
+	pmembench_set_priv(bench, sb);
+
+	return 0;
+free_oids:
+	free(sb->oids);
+free_pop:
+	pmemobj_close(sb->pop);
+free_sb:
+	free(sb);
+	return -1;
+}
+
+/*
+ * obj_tx_snapshot_exit -- exit function of the obj_tx_snapshot benchmark.
+ */
+static int
+obj_tx_snapshot_exit(struct benchmark *bench, struct benchmark_args *args)
+{
+	auto *sb = (struct obj_tx_snapshot_bench *)pmembench_get_priv(bench);
+
+	pmemobj_close(sb->pop);
+	free(sb->oids);
+	free(sb);
+
+	return 0;
+}
+
 /* Array defining common command line arguments. */
-static struct benchmark_clo obj_tx_clo[8];
+static struct benchmark_clo obj_tx_clo[9];
+
+/* Array defining command line arguments of the obj_tx_snapshot benchmark. */
+static struct benchmark_clo obj_tx_snapshot_clo[3];
 
 static struct benchmark_info obj_tx_alloc;
 static struct benchmark_info obj_tx_free;
 static struct benchmark_info obj_tx_realloc;
 static struct benchmark_info obj_tx_add_range;
+static struct benchmark_info obj_tx_snapshot;
 
 CONSTRUCTOR(pmemobj_tx_constructor)
 void
@@ -1122,60 +1360,67 @@ pmemobj_tx_constructor(void)
 	obj_tx_clo[2].type_uint.base = CLO_INT_BASE_DEC | CLO_INT_BASE_HEX;
 	obj_tx_clo[2].type_uint.min = 0;
 	obj_tx_clo[2].type_uint.max = UINT_MAX;
+	obj_tx_clo[3].opt_short = 0;
+	obj_tx_clo[3].opt_long = "latency-stats";
+	obj_tx_clo[3].descr = "Print latency histograms of transaction "
+			      "phases collected by the library";
+	obj_tx_clo[3].type = CLO_TYPE_FLAG;
+	obj_tx_clo[3].off = clo_field_offset(struct obj_tx_args, latency_stats);
+
 	/*
 	 * nclos field in benchmark_info structures is decremented to make this
 	 * options available only for obj_tx_alloc, obj_tx_free and
 	 * obj_tx_realloc benchmarks.
 	 */
-	obj_tx_clo[3].opt_short = 'L';
-	obj_tx_clo[3].opt_long = "lib";
-	obj_tx_clo[3].descr = "Type of library";
-	obj_tx_clo[3].def = "tx";
-	obj_tx_clo[3].off = clo_field_offset(struct obj_tx_args, lib);
-	obj_tx_clo[3].type = CLO_TYPE_STR;
-
-	obj_tx_clo[4].opt_short = 'N';
-	obj_tx_clo[4].opt_long = "nestings";
-	obj_tx_clo[4].type = CLO_TYPE_UINT;
-	obj_tx_clo[4].descr = "Number of nested transactions";
-	obj_tx_clo[4].off = clo_field_offset(struct obj_tx_args, nested);
-	obj_tx_clo[4].def = "0";
-	obj_tx_clo[4].type_uint.size =
-		clo_field_size(struct obj_tx_args, nested);
-	obj_tx_clo[4].type_uint.base = CLO_INT_BASE_DEC | CLO_INT_BASE_HEX;
-	obj_tx_clo[4].type_uint.min = 0;
-	obj_tx_clo[4].type_uint.max = MAX_OPS;
-
-	obj_tx_clo[5].opt_short = 'r';
-	obj_tx_clo[5].opt_long = "min-rsize";
+	obj_tx_clo[4].opt_short = 'L';
+	obj_tx_clo[4].opt_long = "lib";
+	obj_tx_clo[4].descr = "Type of library";
+	obj_tx_clo[4].def = "tx";
+	obj_tx_clo[4].off = clo_field_offset(struct obj_tx_args, lib);
+	obj_tx_clo[4].type = CLO_TYPE_STR;
+
+	obj_tx_clo[5].opt_short = 'N';
+	obj_tx_clo[5].opt_long = "nestings";
 	obj_tx_clo[5].type = CLO_TYPE_UINT;
-	obj_tx_clo[5].descr = "Minimum reallocation size";
-	obj_tx_clo[5].off = clo_field_offset(struct obj_tx_args, min_rsize);
+	obj_tx_clo[5].descr = "Number of nested transactions";
+	obj_tx_clo[5].off = clo_field_offset(struct obj_tx_args, nested);
 	obj_tx_clo[5].def = "0";
 	obj_tx_clo[5].type_uint.size =
-		clo_field_size(struct obj_tx_args, min_rsize);
+		clo_field_size(struct obj_tx_args, nested);
 	obj_tx_clo[5].type_uint.base = CLO_INT_BASE_DEC | CLO_INT_BASE_HEX;
 	obj_tx_clo[5].type_uint.min = 0;
-	obj_tx_clo[5].type_uint.max = UINT_MAX;
+	obj_tx_clo[5].type_uint.max = MAX_OPS;
 
-	obj_tx_clo[6].opt_short = 'R';
-	obj_tx_clo[6].opt_long = "realloc-size";
+	obj_tx_clo[6].opt_short = 'r';
+	obj_tx_clo[6].opt_long = "min-rsize";
 	obj_tx_clo[6].type = CLO_TYPE_UINT;
-	obj_tx_clo[6].descr = "Reallocation size";
-	obj_tx_clo[6].off = clo_field_offset(struct obj_tx_args, rsize);
-	obj_tx_clo[6].def = "1";
+	obj_tx_clo[6].descr = "Minimum reallocation size";
+	obj_tx_clo[6].off = clo_field_offset(struct obj_tx_args, min_rsize);
+	obj_tx_clo[6].def = "0";
 	obj_tx_clo[6].type_uint.size =
-		clo_field_size(struct obj_tx_args, rsize);
+		clo_field_size(struct obj_tx_args, min_rsize);
 	obj_tx_clo[6].type_uint.base = CLO_INT_BASE_DEC | CLO_INT_BASE_HEX;
-	obj_tx_clo[6].type_uint.min = 1;
-	obj_tx_clo[6].type_uint.max = ULONG_MAX;
+	obj_tx_clo[6].type_uint.min = 0;
+	obj_tx_clo[6].type_uint.max = UINT_MAX;
+
+	obj_tx_clo[7].opt_short = 'R';
+	obj_tx_clo[7].opt_long = "realloc-size";
+	obj_tx_clo[7].type = CLO_TYPE_UINT;
+	obj_tx_clo[7].descr = "Reallocation size";
+	obj_tx_clo[7].off = clo_field_offset(struct obj_tx_args, rsize);
+	obj_tx_clo[7].def = "1";
+	obj_tx_clo[7].type_uint.size =
+		clo_field_size(struct obj_tx_args, rsize);
+	obj_tx_clo[7].type_uint.base = CLO_INT_BASE_DEC | CLO_INT_BASE_HEX;
+	obj_tx_clo[7].type_uint.min = 1;
+	obj_tx_clo[7].type_uint.max = ULONG_MAX;
 
-	obj_tx_clo[7].opt_short = 'c';
-	obj_tx_clo[7].opt_long = "changed-type";
-	obj_tx_clo[7].descr = "Use another type number in "
+	obj_tx_clo[8].opt_short = 'c';
+	obj_tx_clo[8].opt_long = "changed-type";
+	obj_tx_clo[8].descr = "Use another type number in "
 			      "reallocation than in allocation";
-	obj_tx_clo[7].type = CLO_TYPE_FLAG;
-	obj_tx_clo[7].off = clo_field_offset(struct obj_tx_args, change_type);
+	obj_tx_clo[8].type = CLO_TYPE_FLAG;
+	obj_tx_clo[8].off = clo_field_offset(struct obj_tx_args, change_type);
 
 	obj_tx_alloc.name = "obj_tx_alloc";
 	obj_tx_alloc.brief = "pmemobj_tx_alloc() benchmark";
@@ -1244,4 +1489,64 @@ pmemobj_tx_constructor(void)
 	obj_tx_add_range.rm_file = true;
 	obj_tx_add_range.allow_poolset = true;
 	REGISTER_BENCHMARK(obj_tx_add_range);
+
+	obj_tx_snapshot_clo[0].opt_short = 0;
+	obj_tx_snapshot_clo[0].opt_long = "ranges";
+	obj_tx_snapshot_clo[0].descr = "Number of ranges the snapshot is "
+				       "split into";
+	obj_tx_snapshot_clo[0].type = CLO_TYPE_UINT;
+	obj_tx_snapshot_clo[0].off =
+		clo_field_offset(struct obj_tx_snapshot_args, ranges);
+	obj_tx_snapshot_clo[0].def = "1";
+	obj_tx_snapshot_clo[0].type_uint.size =
+		clo_field_size(struct obj_tx_snapshot_args, ranges);
+	obj_tx_snapshot_clo[0].type_uint.base = CLO_INT_BASE_DEC;
+	obj_tx_snapshot_clo[0].type_uint.min = 1;
+	obj_tx_snapshot_clo[0].type_uint.max = UINT_MAX;
+
+	obj_tx_snapshot_clo[1].opt_short = 0;
+	obj_tx_snapshot_clo[1].opt_long = "ulog-retain";
+	obj_tx_snapshot_clo[1].descr = "Extended undo log capacity retained "
+				       "in each lane (tx.cache.retain)";
+	obj_tx_snapshot_clo[1].type = CLO_TYPE_UINT;
+	obj_tx_snapshot_clo[1].off =
+		clo_field_offset(struct obj_tx_snapshot_args, ulog_retain);
+	obj_tx_snapshot_clo[1].def = "0";
+	obj_tx_snapshot_clo[1].type_uint.size =
+		clo_field_size(struct obj_tx_snapshot_args, ulog_retain);
+	obj_tx_snapshot_clo[1].type_uint.base =
+		CLO_INT_BASE_DEC | CLO_INT_BASE_HEX;
+	obj_tx_snapshot_clo[1].type_uint.min = 0;
+	obj_tx_snapshot_clo[1].type_uint.max = PMEMOBJ_MAX_ALLOC_SIZE;
+
+	obj_tx_snapshot_clo[2].opt_short = 0;
+	obj_tx_snapshot_clo[2].opt_long = "ulog-decay";
+	obj_tx_snapshot_clo[2].descr = "Number of transactions after which "
+				       "unused retained undo logs are "
+				       "released (tx.cache.decay)";
+	obj_tx_snapshot_clo[2].type = CLO_TYPE_UINT;
+	obj_tx_snapshot_clo[2].off =
+		clo_field_offset(struct obj_tx_snapshot_args, ulog_decay);
+	obj_tx_snapshot_clo[2].def = "0";
+	obj_tx_snapshot_clo[2].type_uint.size =
+		clo_field_size(struct obj_tx_snapshot_args, ulog_decay);
+	obj_tx_snapshot_clo[2].type_uint.base = CLO_INT_BASE_DEC;
+	obj_tx_snapshot_clo[2].type_uint.min = 0;
+	obj_tx_snapshot_clo[2].type_uint.max = UINT_MAX;
+
+	obj_tx_snapshot.name = "obj_tx_snapshot";
+	obj_tx_snapshot.brief = "benchmark of transactions which snapshot "
+				"large ranges";
+	obj_tx_snapshot.init = obj_tx_snapshot_init;
+	obj_tx_snapshot.exit = obj_tx_snapshot_exit;
+	obj_tx_snapshot.multithread = true;
+	obj_tx_snapshot.multiops = true;
+	obj_tx_snapshot.operation = obj_tx_snapshot_op;
+	obj_tx_snapshot.measure_time = true;
+	obj_tx_snapshot.clos = obj_tx_snapshot_clo;
+	obj_tx_snapshot.nclos = ARRAY_SIZE(obj_tx_snapshot_clo);
+	obj_tx_snapshot.opts_size = sizeof(struct obj_tx_snapshot_args);
+	obj_tx_snapshot.rm_file = true;
+	obj_tx_snapshot.allow_poolset = true;
+	REGISTER_BENCHMARK(obj_tx_snapshot);
 }
@@ -34,6 +34,8 @@
  * ctl_prefault.c -- implementation of the prefault CTL namespace
  */
 
+#include <errno.h>
+
 #include "ctl.h"
 #include "set.h"
 #include "out.h"
@@ -81,12 +83,41 @@ CTL_WRITE_HANDLER(at_open)(void *ctx, enum ctl_query_source source,
 	return 0;
 }
 
+static int
+CTL_READ_HANDLER(threads)(void *ctx, enum ctl_query_source source,
+	void *arg, struct ctl_indexes *indexes)
+{
+	int *arg_out = arg;
+	*arg_out = Prefault_threads;
+
+	return 0;
+}
+
+static int
+CTL_WRITE_HANDLER(threads)(void *ctx, enum ctl_query_source source,
+	void *arg, struct ctl_indexes *indexes)
+{
+	int arg_in = *(int *)arg;
+
+	if (arg_in < 1) {
+		ERR("number of prefault threads must be positive");
+		errno = EINVAL;
+		return -1;
+	}
+
+	Prefault_threads = arg_in;
+
+	return 0;
+}
+
 static struct ctl_argument CTL_ARG(at_create) = CTL_ARG_BOOLEAN;
 static struct ctl_argument CTL_ARG(at_open) = CTL_ARG_BOOLEAN;
+static struct ctl_argument CTL_ARG(threads) = CTL_ARG_INT;
 
 static const struct ctl_node CTL_NODE(prefault)[] = {
 	CTL_LEAF_RW(at_create),
 	CTL_LEAF_RW(at_open),
+	CTL_LEAF_RW(threads),
 
 	CTL_NODE_END
 };
@@ -146,7 +146,9 @@ char *util_map_hint(size_t len, size_t req_align);
  * layout change.
  *
  * Use 1GB page alignment only if the mapping length is at least
- * twice as big as the page size.
+ * twice as big as the page size. This also applies when a smaller alignment
+ * was requested, as long as it evenly divides 1GB, so that large mappings
+ * can still be backed by 1GB pages.
  */
 static inline size_t
 util_map_hint_align(size_t len, size_t req_align)
@@ -154,7 +156,9 @@ util_map_hint_align(size_t len, size_t req_align)
 	size_t align = 2 * MEGABYTE;
 	if (req_align)
 		align = req_align;
-	else if (len >= 2 * GIGABYTE)
+
+	if (len >= 2 * GIGABYTE && align < GIGABYTE &&
+			GIGABYTE % align == 0)
 		align = GIGABYTE;
 
 	return align;
@@ -0,0 +1,78 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * os_numa_freebsd.c -- FreeBSD abstraction layer for NUMA topology queries
+ *
+ * NUMA placement is not supported on FreeBSD, all of the memory is treated
+ * as if it belonged to a single node.
+ */
+
+#include "os_numa.h"
+
+/*
+ * os_numa_nnodes -- returns the highest possible node number plus one
+ */
+unsigned
+os_numa_nnodes(void)
+{
+	return 1;
+}
+
+/*
+ * os_numa_cpu_node -- returns the node the given cpu belongs to
+ */
+int
+os_numa_cpu_node(unsigned cpu)
+{
+	return -1;
+}
+
+/*
+ * os_numa_current_node -- returns the node of the cpu the calling thread is
+ *	currently running on
+ */
+int
+os_numa_current_node(void)
+{
+	return -1;
+}
+
+/*
+ * os_numa_addr_node -- returns the node that backs the page at the given
+ *	address
+ */
+int
+os_numa_addr_node(const void *addr)
+{
+	return -1;
+}
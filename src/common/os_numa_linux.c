@@ -0,0 +1,153 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * os_numa_linux.c -- Linux abstraction layer for NUMA topology queries
+ *
+ * The topology is read from sysfs and the memory placement is queried
+ * directly through the system calls, so that there's no dependency on libnuma.
+ */
+
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/mempolicy.h>
+
+#include "os_numa.h"
+#include "out.h"
+
+#define NODE_POSSIBLE_PATH "/sys/devices/system/node/possible"
+#define CPU_DIR_FMT "/sys/devices/system/cpu/cpu%u"
+
+/*
+ * os_numa_nnodes -- returns the highest possible node number plus one
+ */
+unsigned
+os_numa_nnodes(void)
+{
+	FILE *f = fopen(NODE_POSSIBLE_PATH, "r");
+	if (f == NULL) {
+		LOG(4, "!%s", NODE_POSSIBLE_PATH);
+		return 1;
+	}
+
+	/* the list of nodes is in the "0,2-3" format, the last one is max */
+	char buf[256];
+	char *line = fgets(buf, sizeof(buf), f);
+	fclose(f);
+
+	if (line == NULL)
+		return 1;
+
+	char *last = strrchr(line, '-');
+	char *comma = strrchr(line, ',');
+	if (last == NULL || (comma != NULL && comma > last))
+		last = comma;
+
+	char *end;
+	unsigned long max = strtoul(last == NULL ? line : last + 1, &end, 10);
+	if (end == line || max >= INT_MAX)
+		return 1;
+
+	return (unsigned)max + 1;
+}
+
+/*
+ * os_numa_cpu_node -- returns the node the given cpu belongs to
+ */
+int
+os_numa_cpu_node(unsigned cpu)
+{
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), CPU_DIR_FMT, cpu);
+
+	DIR *dir = opendir(path);
+	if (dir == NULL) {
+		LOG(4, "!%s", path);
+		return -1;
+	}
+
+	int node = -1;
+	struct dirent *d;
+	while ((d = readdir(dir)) != NULL) {
+		unsigned n;
+		if (sscanf(d->d_name, "node%u", &n) == 1 && n < INT_MAX) {
+			node = (int)n;
+			break;
+		}
+	}
+
+	closedir(dir);
+
+	return node;
+}
+
+/*
+ * os_numa_current_node -- returns the node of the cpu the calling thread is
+ *	currently running on
+ */
+int
+os_numa_current_node(void)
+{
+	unsigned cpu;
+	unsigned node;
+	if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0) {
+		LOG(4, "!getcpu");
+		return -1;
+	}
+
+	return (int)node;
+}
+
+/*
+ * os_numa_addr_node -- returns the node that backs the page at the given
+ *	address, the page is faulted in if it isn't already
+ */
+int
+os_numa_addr_node(const void *addr)
+{
+	int node;
+	if (syscall(SYS_get_mempolicy, &node, NULL, 0, addr,
+			MPOL_F_NODE | MPOL_F_ADDR) != 0) {
+		LOG(4, "!get_mempolicy %p", addr);
+		return -1;
+	}
+
+	return node;
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * os_numa_windows.c -- Windows abstraction layer for NUMA topology queries
+ */
+
+#include <windows.h>
+#include <psapi.h>
+
+#include "os_numa.h"
+#include "out.h"
+
+/*
+ * os_numa_nnodes -- returns the highest possible node number plus one
+ */
+unsigned
+os_numa_nnodes(void)
+{
+	ULONG highest;
+	if (!GetNumaHighestNodeNumber(&highest)) {
+		LOG(4, "!GetNumaHighestNodeNumber");
+		return 1;
+	}
+
+	return (unsigned)highest + 1;
+}
+
+/*
+ * os_numa_cpu_node -- returns the node the given cpu belongs to
+ */
+int
+os_numa_cpu_node(unsigned cpu)
+{
+	PROCESSOR_NUMBER pn;
+	pn.Group = (WORD)(cpu / 64);
+	pn.Number = (BYTE)(cpu % 64);
+	pn.Reserved = 0;
+
+	USHORT node;
+	if (!GetNumaProcessorNodeEx(&pn, &node) || node == MAXUSHORT) {
+		LOG(4, "!GetNumaProcessorNodeEx");
+		return -1;
+	}
+
+	return (int)node;
+}
+
+/*
+ * os_numa_current_node -- returns the node of the cpu the calling thread is
+ *	currently running on
+ */
+int
+os_numa_current_node(void)
+{
+	PROCESSOR_NUMBER pn;
+	GetCurrentProcessorNumberEx(&pn);
+
+	USHORT node;
+	if (!GetNumaProcessorNodeEx(&pn, &node) || node == MAXUSHORT) {
+		LOG(4, "!GetNumaProcessorNodeEx");
+		return -1;
+	}
+
+	return (int)node;
+}
+
+/*
+ * os_numa_addr_node -- returns the node that backs the page at the given
+ *	address, the page is faulted in if it isn't already
+ */
+int
+os_numa_addr_node(const void *addr)
+{
+	/* the node is only reported for pages in the working set */
+	(void) *(volatile const char *)addr;
+
+	PSAPI_WORKING_SET_EX_INFORMATION info;
+	info.VirtualAddress = (PVOID)addr;
+	if (!QueryWorkingSetEx(GetCurrentProcess(), &info, sizeof(info))) {
+		LOG(4, "!QueryWorkingSetEx");
+		return -1;
+	}
+
+	if (!info.VirtualAttributes.Valid)
+		return -1;
+
+	return (int)info.VirtualAttributes.Node;
+}
@@ -102,6 +102,7 @@ static void *Rpmem_handle_remote;
 
 int Prefault_at_open = 0;
 int Prefault_at_create = 0;
+int Prefault_threads = 1;
 int SDS_at_create = POOL_FEAT_INCOMPAT_DEFAULT & POOL_E_FEAT_SDS ? 1 : 0;
 
 
@@ -341,20 +342,126 @@ static const char *parser_errstr[PARSER_MAX_CODE] = {
 };
 
 /*
- * util_replica_force_page_allocation - (internal) forces page allocation for
- * replica
+ * Granularity of the work units the prefault is split into, big enough to
+ * make the coordination cost negligible and a multiple of both the 2MB and
+ * 1GB page sizes, so that no huge page is faulted in by two threads.
+ */
+#define PREFAULT_SLICE_SIZE GIGABYTE
+
+/*
+ * prefault_ctx -- state shared by the threads prefaulting a replica
+ */
+struct prefault_ctx {
+	struct pool_replica *rep;
+	size_t nslices; /* total number of slices in all parts */
+	uint64_t next; /* index of the next slice to be prefaulted */
+};
+
+/*
+ * util_prefault_range -- (internal) touches every page of the given range
  */
 static void
-util_replica_force_page_allocation(struct pool_replica *rep)
+util_prefault_range(char *addr, size_t len)
 {
-	volatile char *cur_addr = rep->part[0].addr;
-	char *addr_end = (char *)cur_addr + rep->resvsize;
+	volatile char *cur_addr = addr;
+	char *addr_end = addr + len;
 	for (; cur_addr < addr_end; cur_addr += Pagesize) {
 		*cur_addr = *cur_addr;
 		VALGRIND_SET_CLEAN(cur_addr, 1);
 	}
 }
 
+/*
+ * util_prefault_slice -- (internal) prefaults the slice with the given index,
+ *	slices are counted through all of the parts of the replica
+ */
+static void
+util_prefault_slice(struct pool_replica *rep, size_t slice)
+{
+	for (unsigned p = 0; p < rep->nparts; ++p) {
+		size_t nslices = (rep->part[p].size + PREFAULT_SLICE_SIZE - 1) /
+			PREFAULT_SLICE_SIZE;
+		if (slice >= nslices) {
+			slice -= nslices;
+			continue;
+		}
+
+		size_t off = slice * PREFAULT_SLICE_SIZE;
+		size_t len = rep->part[p].size - off;
+		if (len > PREFAULT_SLICE_SIZE)
+			len = PREFAULT_SLICE_SIZE;
+
+		util_prefault_range((char *)rep->part[p].addr + off, len);
+		return;
+	}
+}
+
+/*
+ * util_prefault_worker -- (internal) prefaults slices until there are none left
+ */
+static void *
+util_prefault_worker(void *arg)
+{
+	struct prefault_ctx *ctx = arg;
+
+	uint64_t slice;
+	while ((slice = util_fetch_and_add64(&ctx->next, 1)) < ctx->nslices)
+		util_prefault_slice(ctx->rep, slice);
+
+	return NULL;
+}
+
+/*
+ * util_replica_force_page_allocation - (internal) forces page allocation for
+ * replica
+ *
+ * The parts of the replica are split into slices which are prefaulted by up
+ * to Prefault_threads threads in parallel, the calling thread included. If a
+ * thread cannot be created, its share of the work is picked up by the others.
+ */
+static void
+util_replica_force_page_allocation(struct pool_replica *rep)
+{
+	struct prefault_ctx ctx;
+	ctx.rep = rep;
+	ctx.next = 0;
+	ctx.nslices = 0;
+	for (unsigned p = 0; p < rep->nparts; ++p)
+		ctx.nslices += (rep->part[p].size + PREFAULT_SLICE_SIZE - 1) /
+			PREFAULT_SLICE_SIZE;
+
+	/* the calling thread is one of the prefaulting threads */
+	size_t nthreads = Prefault_threads > 1 ?
+		(size_t)Prefault_threads - 1 : 0;
+	if (nthreads >= ctx.nslices)
+		nthreads = ctx.nslices > 0 ? ctx.nslices - 1 : 0;
+
+	os_thread_t *threads = NULL;
+	if (nthreads != 0) {
+		threads = Malloc(sizeof(*threads) * nthreads);
+		if (threads == NULL) {
+			LOG(2, "!Malloc, prefaulting in a single thread");
+			nthreads = 0;
+		}
+	}
+
+	size_t started = 0;
+	for (; started < nthreads; ++started) {
+		if (os_thread_create(&threads[started], NULL,
+				util_prefault_worker, &ctx) != 0) {
+			LOG(2, "cannot create prefault thread");
+			break;
+		}
+	}
+
+	util_prefault_worker(&ctx);
+
+	for (size_t i = 0; i < started; ++i)
+		os_thread_join(&threads[i], NULL);
+
+	Free(threads);
+}
+
 /*
  * util_map_hdr -- map a header of a pool set
  */
@@ -45,4 +45,7 @@
 /* number of values in a bucket which force hashtable rebuild */
 #define MAX_HASHSET_THRESHOLD 10
 
+/* number of old buckets migrated per operation while the hashtable resizes */
+#define MIGRATE_BUCKETS_NUM 4
+
 #endif
@@ -0,0 +1,693 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * integer hash map implementation which allows concurrent access
+ *
+ * Every bucket is protected by one of HM_MT_NLOCKS striped reader-writer
+ * locks and the table grows using linear hashing - a single bucket is split
+ * at a time, in a small transaction, so neither insertions nor removals ever
+ * have to wait for the whole table to be rehashed.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <inttypes.h>
+
+#include <libpmemobj.h>
+#include <ex_common.h>
+#include "hashmap_mt.h"
+
+/* number of striped locks, must be a power of two */
+#define HM_MT_NLOCKS_LOG2 8
+#define HM_MT_NLOCKS (1ULL << HM_MT_NLOCKS_LOG2)
+
+/*
+ * initial number of buckets, equal to the number of locks so that the key's
+ * lock never changes when the table grows
+ */
+#define HM_MT_INIT_BUCKETS_LOG2 HM_MT_NLOCKS_LOG2
+#define HM_MT_INIT_BUCKETS (1ULL << HM_MT_INIT_BUCKETS_LOG2)
+
+/* maximum number of bucket segments */
+#define HM_MT_MAX_SEGMENTS (64 - HM_MT_INIT_BUCKETS_LOG2 + 1)
+
+/* average number of entries per bucket which triggers a bucket split */
+#define HM_MT_LOAD_FACTOR 2
+
+#define HM_MT_CACHELINE_SIZE 64
+
+/* layout definition */
+TOID_DECLARE(struct bucket, HASHMAP_MT_TYPE_OFFSET + 1);
+TOID_DECLARE(struct entry, HASHMAP_MT_TYPE_OFFSET + 2);
+TOID_DECLARE(struct stripe, HASHMAP_MT_TYPE_OFFSET + 3);
+
+struct entry {
+	uint64_t key;
+	PMEMoid value;
+
+	/* next entry list pointer */
+	TOID(struct entry) next;
+};
+
+struct bucket {
+	TOID(struct entry) head;
+};
+
+struct stripe {
+	/* protects all buckets with index == stripe index (mod NLOCKS) */
+	PMEMrwlock lock;
+
+	/* number of values stored in the stripe's buckets */
+	uint64_t count;
+
+	char padding[2 * HM_MT_CACHELINE_SIZE - sizeof(PMEMrwlock) -
+		sizeof(uint64_t)];
+};
+
+struct hashmap_mt {
+	/* random number generator seed */
+	uint32_t seed;
+
+	/* hash function salt */
+	uint64_t salt;
+
+	/* number of buckets, modified only with the resize lock held */
+	uint64_t nbuckets;
+
+	/* serializes bucket splits */
+	PMEMmutex resize_lock;
+
+	/* array of HM_MT_NLOCKS lock stripes */
+	TOID(struct stripe) stripes;
+
+	/*
+	 * bucket segments, the first one has HM_MT_INIT_BUCKETS buckets and
+	 * each next one doubles the total capacity of the table
+	 */
+	TOID(struct bucket) segments[HM_MT_MAX_SEGMENTS];
+};
+
+/*
+ * hash -- salted splitmix64 finalizer, spreads the key bits over the whole
+ * hash so that the low bits can be used as the bucket index
+ */
+static uint64_t
+hash(TOID(struct hashmap_mt) hashmap, uint64_t key)
+{
+	uint64_t h = key ^ D_RO(hashmap)->salt;
+
+	h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+
+	return h ^ (h >> 31);
+}
+
+/*
+ * hm_mt_nbuckets -- (internal) returns the current number of buckets
+ */
+static uint64_t
+hm_mt_nbuckets(TOID(struct hashmap_mt) hashmap)
+{
+	return *(const volatile uint64_t *)&D_RO(hashmap)->nbuckets;
+}
+
+/*
+ * hm_mt_bucket_idx -- (internal) returns index of the bucket for the hash
+ * in a table with nbuckets buckets
+ */
+static uint64_t
+hm_mt_bucket_idx(uint64_t h, uint64_t nbuckets)
+{
+	uint64_t low = 1ULL << find_last_set_64(nbuckets);
+	uint64_t idx = h & ((low << 1) - 1);
+
+	/* the bucket was not split yet in this round */
+	if (idx >= nbuckets)
+		idx = h & (low - 1);
+
+	return idx;
+}
+
+/*
+ * hm_mt_segment_idx -- (internal) returns index of the segment which holds
+ * the bucket and the bucket offset within it
+ */
+static unsigned
+hm_mt_segment_idx(uint64_t idx, uint64_t *off)
+{
+	if (idx < HM_MT_INIT_BUCKETS) {
+		*off = idx;
+		return 0;
+	}
+
+	int bit = find_last_set_64(idx);
+	*off = idx - (1ULL << bit);
+
+	return (unsigned)(bit - HM_MT_INIT_BUCKETS_LOG2 + 1);
+}
+
+/*
+ * hm_mt_segment_size -- (internal) returns number of buckets in the segment
+ */
+static uint64_t
+hm_mt_segment_size(unsigned seg)
+{
+	if (seg == 0)
+		return HM_MT_INIT_BUCKETS;
+
+	return HM_MT_INIT_BUCKETS << (seg - 1);
+}
+
+/*
+ * hm_mt_bucket -- (internal) returns pointer to the bucket with given index
+ */
+static struct bucket *
+hm_mt_bucket(TOID(struct hashmap_mt) hashmap, uint64_t idx)
+{
+	uint64_t off;
+	unsigned seg = hm_mt_segment_idx(idx, &off);
+
+	return &D_RW(D_RW(hashmap)->segments[seg])[off];
+}
+
+/*
+ * hm_mt_stripe -- (internal) returns the lock stripe for the hash
+ */
+static struct stripe *
+hm_mt_stripe(TOID(struct hashmap_mt) hashmap, uint64_t h)
+{
+	return &D_RW(D_RW(hashmap)->stripes)[h & (HM_MT_NLOCKS - 1)];
+}
+
+/*
+ * hm_mt_rdlock -- (internal) locks the stripe for reading, within
+ * a transaction the lock is taken for writing until the transaction ends
+ */
+static int
+hm_mt_rdlock(PMEMobjpool *pop, struct stripe *s)
+{
+	if (pmemobj_tx_stage() == TX_STAGE_WORK)
+		return pmemobj_tx_lock(TX_PARAM_RWLOCK, &s->lock);
+
+	return pmemobj_rwlock_rdlock(pop, &s->lock);
+}
+
+/*
+ * hm_mt_rdunlock -- (internal) releases lock taken by hm_mt_rdlock
+ */
+static void
+hm_mt_rdunlock(PMEMobjpool *pop, struct stripe *s)
+{
+	if (pmemobj_tx_stage() != TX_STAGE_WORK)
+		pmemobj_rwlock_unlock(pop, &s->lock);
+}
+
+/*
+ * hm_mt_overloaded -- (internal) checks whether the stripe holds more
+ * values than the load factor allows
+ */
+static int
+hm_mt_overloaded(TOID(struct hashmap_mt) hashmap, struct stripe *s)
+{
+	uint64_t nbuckets = hm_mt_nbuckets(hashmap);
+	uint64_t i = (uint64_t)(s - D_RO(D_RO(hashmap)->stripes));
+	uint64_t nstripe = nbuckets / HM_MT_NLOCKS +
+		(i < nbuckets % HM_MT_NLOCKS ? 1 : 0);
+
+	return s->count > HM_MT_LOAD_FACTOR * nstripe;
+}
+
+/*
+ * hm_mt_split -- (internal) splits the next bucket in order,
+ * must be called with the resize lock held and outside of a transaction
+ *
+ * Both the split bucket and its new image share the lock stripe, so only
+ * the writers of a single stripe are blocked for the duration of the split.
+ */
+static int
+hm_mt_split(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap)
+{
+	uint64_t nbuckets = D_RO(hashmap)->nbuckets;
+	uint64_t low = 1ULL << find_last_set_64(nbuckets);
+	uint64_t mask = (low << 1) - 1;
+	uint64_t src = nbuckets - low;
+	uint64_t dst = nbuckets;
+
+	uint64_t off;
+	unsigned seg = hm_mt_segment_idx(dst, &off);
+	if (seg >= HM_MT_MAX_SEGMENTS)
+		return -1;
+
+	struct stripe *s = hm_mt_stripe(hashmap, src);
+	int ret = 0;
+
+	TX_BEGIN_PARAM(pop, TX_PARAM_RWLOCK, &s->lock, TX_PARAM_NONE) {
+		if (TOID_IS_NULL(D_RO(hashmap)->segments[seg])) {
+			TX_ADD_FIELD(hashmap, segments[seg]);
+			D_RW(hashmap)->segments[seg] = TX_ZALLOC(struct bucket,
+				hm_mt_segment_size(seg) *
+				sizeof(struct bucket));
+		}
+
+		struct bucket *bsrc = hm_mt_bucket(hashmap, src);
+		struct bucket *bdst = hm_mt_bucket(hashmap, dst);
+		TX_ADD_DIRECT(bsrc);
+		TX_ADD_DIRECT(bdst);
+
+		TOID(struct entry) *prev = &bsrc->head;
+		while (!TOID_IS_NULL(*prev)) {
+			TOID(struct entry) en = *prev;
+			if ((hash(hashmap, D_RO(en)->key) & mask) != dst) {
+				prev = &D_RW(en)->next;
+				continue;
+			}
+
+			TX_ADD_DIRECT(prev);
+			*prev = D_RO(en)->next;
+
+			TX_ADD_FIELD(en, next);
+			D_RW(en)->next = bdst->head;
+			bdst->head = en;
+		}
+
+		TX_ADD_FIELD(hashmap, nbuckets);
+		D_RW(hashmap)->nbuckets = nbuckets + 1;
+	} TX_ONABORT {
+		fprintf(stderr, "%s: transaction aborted: %s\n", __func__,
+			pmemobj_errormsg());
+		/*
+		 * We don't need to do anything here, because everything is
+		 * consistent. The only thing affected is performance.
+		 */
+		ret = -1;
+	} TX_END
+
+	return ret;
+}
+
+/*
+ * hm_mt_grow -- (internal) splits one bucket, if wait is not set and another
+ * thread is already splitting a bucket, it's left to that thread
+ *
+ * The split is skipped within a transaction, because the stripe lock would
+ * be held until the outermost transaction ends and could be taken in
+ * a different order than by other threads.
+ */
+static int
+hm_mt_grow(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap, int wait)
+{
+	if (pmemobj_tx_stage() != TX_STAGE_NONE)
+		return 1;
+
+	PMEMmutex *lock = &D_RW(hashmap)->resize_lock;
+	if (wait)
+		pmemobj_mutex_lock(pop, lock);
+	else if (pmemobj_mutex_trylock(pop, lock) != 0)
+		return 1;
+
+	int ret = hm_mt_split(pop, hashmap);
+
+	pmemobj_mutex_unlock(pop, lock);
+
+	return ret;
+}
+
+/*
+ * hm_mt_insert -- inserts specified value into the hashmap,
+ * returns:
+ * - 0 if successful,
+ * - 1 if value already existed,
+ * - -1 if something bad happened
+ */
+int
+hm_mt_insert(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap,
+	uint64_t key, PMEMoid value)
+{
+	uint64_t h = hash(hashmap, key);
+	struct stripe *s = hm_mt_stripe(hashmap, h);
+	int ret = 0;
+
+	/*
+	 * A key never moves to a bucket guarded by a different stripe, so
+	 * the bucket can be safely computed once the stripe is locked.
+	 */
+	TX_BEGIN_PARAM(pop, TX_PARAM_RWLOCK, &s->lock, TX_PARAM_NONE) {
+		struct bucket *b = hm_mt_bucket(hashmap,
+			hm_mt_bucket_idx(h, hm_mt_nbuckets(hashmap)));
+
+		TOID(struct entry) var;
+		for (var = b->head; !TOID_IS_NULL(var);
+				var = D_RO(var)->next) {
+			if (D_RO(var)->key == key) {
+				ret = 1;
+				break;
+			}
+		}
+
+		if (ret == 0) {
+			TX_ADD_DIRECT(b);
+			TX_ADD_DIRECT(&s->count);
+
+			TOID(struct entry) e = TX_NEW(struct entry);
+			D_RW(e)->key = key;
+			D_RW(e)->value = value;
+			D_RW(e)->next = b->head;
+			b->head = e;
+
+			s->count++;
+		}
+	} TX_ONABORT {
+		fprintf(stderr, "transaction aborted: %s\n",
+			pmemobj_errormsg());
+		ret = -1;
+	} TX_END
+
+	if (ret == 0 && hm_mt_overloaded(hashmap, s))
+		hm_mt_grow(pop, hashmap, 0);
+
+	return ret;
+}
+
+/*
+ * hm_mt_remove -- removes specified value from the hashmap,
+ * returns:
+ * - key's value if successful,
+ * - OID_NULL if value didn't exist or if something bad happened
+ */
+PMEMoid
+hm_mt_remove(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap, uint64_t key)
+{
+	uint64_t h = hash(hashmap, key);
+	struct stripe *s = hm_mt_stripe(hashmap, h);
+	PMEMoid retoid = OID_NULL;
+
+	TX_BEGIN_PARAM(pop, TX_PARAM_RWLOCK, &s->lock, TX_PARAM_NONE) {
+		struct bucket *b = hm_mt_bucket(hashmap,
+			hm_mt_bucket_idx(h, hm_mt_nbuckets(hashmap)));
+
+		TOID(struct entry) *prev = &b->head;
+		while (!TOID_IS_NULL(*prev) && D_RO(*prev)->key != key)
+			prev = &D_RW(*prev)->next;
+
+		if (!TOID_IS_NULL(*prev)) {
+			TOID(struct entry) var = *prev;
+
+			TX_ADD_DIRECT(prev);
+			TX_ADD_DIRECT(&s->count);
+
+			retoid = D_RO(var)->value;
+			*prev = D_RO(var)->next;
+			s->count--;
+			TX_FREE(var);
+		}
+	} TX_ONABORT {
+		fprintf(stderr, "transaction aborted: %s\n",
+			pmemobj_errormsg());
+		retoid = OID_NULL;
+	} TX_END
+
+	return retoid;
+}
+
+/*
+ * hm_mt_find -- (internal) returns entry with the specified key
+ */
+static TOID(struct entry)
+hm_mt_find(TOID(struct hashmap_mt) hashmap, uint64_t h, uint64_t key)
+{
+	struct bucket *b = hm_mt_bucket(hashmap,
+		hm_mt_bucket_idx(h, hm_mt_nbuckets(hashmap)));
+
+	TOID(struct entry) var;
+	for (var = b->head; !TOID_IS_NULL(var); var = D_RO(var)->next)
+		if (D_RO(var)->key == key)
+			break;
+
+	return var;
+}
+
+/*
+ * hm_mt_get -- checks whether specified value is in the hashmap
+ */
+PMEMoid
+hm_mt_get(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap, uint64_t key)
+{
+	uint64_t h = hash(hashmap, key);
+	struct stripe *s = hm_mt_stripe(hashmap, h);
+
+	if (hm_mt_rdlock(pop, s) != 0)
+		return OID_NULL;
+
+	TOID(struct entry) var = hm_mt_find(hashmap, h, key);
+	PMEMoid retoid = TOID_IS_NULL(var) ? OID_NULL : D_RO(var)->value;
+
+	hm_mt_rdunlock(pop, s);
+
+	return retoid;
+}
+
+/*
+ * hm_mt_lookup -- checks whether specified value exists
+ */
+int
+hm_mt_lookup(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap, uint64_t key)
+{
+	uint64_t h = hash(hashmap, key);
+	struct stripe *s = hm_mt_stripe(hashmap, h);
+
+	if (hm_mt_rdlock(pop, s) != 0)
+		return 0;
+
+	int ret = !TOID_IS_NULL(hm_mt_find(hashmap, h, key));
+
+	hm_mt_rdunlock(pop, s);
+
+	return ret;
+}
+
+/*
+ * hm_mt_foreach -- calls cb for all values from the hashmap,
+ * bucket splits are blocked for the duration of the walk
+ */
+int
+hm_mt_foreach(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap,
+	int (*cb)(uint64_t key, PMEMoid value, void *arg), void *arg)
+{
+	PMEMmutex *lock = &D_RW(hashmap)->resize_lock;
+	pmemobj_mutex_lock(pop, lock);
+
+	uint64_t nbuckets = D_RO(hashmap)->nbuckets;
+	TOID(struct entry) var;
+
+	int ret = 0;
+	for (uint64_t i = 0; i < nbuckets && ret == 0; ++i) {
+		struct stripe *s = hm_mt_stripe(hashmap, i);
+		if (hm_mt_rdlock(pop, s) != 0) {
+			ret = -1;
+			break;
+		}
+
+		for (var = hm_mt_bucket(hashmap, i)->head; !TOID_IS_NULL(var);
+				var = D_RO(var)->next) {
+			ret = cb(D_RO(var)->key, D_RO(var)->value, arg);
+			if (ret)
+				break;
+		}
+
+		hm_mt_rdunlock(pop, s);
+	}
+
+	pmemobj_mutex_unlock(pop, lock);
+
+	return ret;
+}
+
+/*
+ * hm_mt_debug -- prints complete hashmap state
+ */
+static void
+hm_mt_debug(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap, FILE *out)
+{
+	uint64_t nbuckets = hm_mt_nbuckets(hashmap);
+	TOID(struct entry) var;
+
+	fprintf(out, "salt: %" PRIx64 "\n", D_RO(hashmap)->salt);
+	fprintf(out, "count: %zu, buckets: %" PRIu64 "\n",
+		hm_mt_count(pop, hashmap), nbuckets);
+
+	for (uint64_t i = 0; i < nbuckets; ++i) {
+		struct bucket *b = hm_mt_bucket(hashmap, i);
+		if (TOID_IS_NULL(b->head))
+			continue;
+
+		int num = 0;
+		fprintf(out, "%" PRIu64 ": ", i);
+		for (var = b->head; !TOID_IS_NULL(var);
+				var = D_RO(var)->next) {
+			fprintf(out, "%" PRIu64 " ", D_RO(var)->key);
+			num++;
+		}
+		fprintf(out, "(%d)\n", num);
+	}
+}
+
+/*
+ * hm_mt_rebuild -- splits buckets until the load factor is satisfied
+ */
+static int
+hm_mt_rebuild(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap)
+{
+	while (hm_mt_count(pop, hashmap) >
+			HM_MT_LOAD_FACTOR * hm_mt_nbuckets(hashmap)) {
+		int ret = hm_mt_grow(pop, hashmap, 1);
+		if (ret)
+			return ret < 0 ? -1 : 0;
+	}
+
+	return 0;
+}
+
+/*
+ * hm_mt_count -- returns number of elements
+ */
+size_t
+hm_mt_count(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap)
+{
+	const struct stripe *stripes = D_RO(D_RO(hashmap)->stripes);
+	size_t count = 0;
+
+	for (uint64_t i = 0; i < HM_MT_NLOCKS; ++i)
+		count += stripes[i].count;
+
+	return count;
+}
+
+/*
+ * hm_mt_init -- recovers hashmap state, called after pmemobj_open
+ */
+int
+hm_mt_init(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap)
+{
+	srand(D_RO(hashmap)->seed);
+	return 0;
+}
+
+/*
+ * hm_mt_create -- allocates new hashmap
+ */
+int
+hm_mt_create(PMEMobjpool *pop, TOID(struct hashmap_mt) *map, void *arg)
+{
+	struct hashmap_args *args = (struct hashmap_args *)arg;
+	int ret = 0;
+	TX_BEGIN(pop) {
+		TX_ADD_DIRECT(map);
+		*map = TX_ZNEW(struct hashmap_mt);
+
+		D_RW(*map)->seed = args ? args->seed : 0;
+		D_RW(*map)->salt = ((uint64_t)rand()) << 32 | (uint64_t)rand();
+		D_RW(*map)->nbuckets = HM_MT_INIT_BUCKETS;
+		D_RW(*map)->stripes = TX_ZALLOC(struct stripe,
+			HM_MT_NLOCKS * sizeof(struct stripe));
+		D_RW(*map)->segments[0] = TX_ZALLOC(struct bucket,
+			HM_MT_INIT_BUCKETS * sizeof(struct bucket));
+	} TX_ONABORT {
+		ret = -1;
+	} TX_END
+
+	return ret;
+}
+
+/*
+ * hm_mt_destroy -- frees the hashmap and all its entries
+ */
+int
+hm_mt_destroy(PMEMobjpool *pop, TOID(struct hashmap_mt) *map)
+{
+	int ret = 0;
+	TX_BEGIN(pop) {
+		uint64_t nbuckets = D_RO(*map)->nbuckets;
+		for (uint64_t i = 0; i < nbuckets; ++i) {
+			TOID(struct entry) var = hm_mt_bucket(*map, i)->head;
+			while (!TOID_IS_NULL(var)) {
+				TOID(struct entry) next = D_RO(var)->next;
+				TX_FREE(var);
+				var = next;
+			}
+		}
+
+		for (unsigned i = 0; i < HM_MT_MAX_SEGMENTS; ++i)
+			TX_FREE(D_RO(*map)->segments[i]);
+
+		TX_FREE(D_RO(*map)->stripes);
+		TX_FREE(*map);
+
+		TX_ADD_DIRECT(map);
+		*map = TOID_NULL(struct hashmap_mt);
+	} TX_ONABORT {
+		ret = -1;
+	} TX_END
+
+	return ret;
+}
+
+/*
+ * hm_mt_check -- checks if specified persistent object is an
+ * instance of hashmap
+ */
+int
+hm_mt_check(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap)
+{
+	return TOID_IS_NULL(hashmap) || !TOID_VALID(hashmap);
+}
+
+/*
+ * hm_mt_cmd -- execute cmd for hashmap
+ */
+int
+hm_mt_cmd(PMEMobjpool *pop, TOID(struct hashmap_mt) hashmap,
+		unsigned cmd, uint64_t arg)
+{
+	switch (cmd) {
+		case HASHMAP_CMD_REBUILD:
+			return hm_mt_rebuild(pop, hashmap);
+		case HASHMAP_CMD_DEBUG:
+			if (!arg)
+				return -EINVAL;
+			hm_mt_debug(pop, hashmap, (FILE *)arg);
+			return 0;
+		default:
+			return -EINVAL;
+	}
+}
@@ -73,6 +73,9 @@ struct add_entry {
 	/* Action array index counter */
 	size_t actv_cnt;
 
+	/* migration progress marker published with the entry */
+	uint64_t migrated;
+
 #ifdef DEBUG
 	/* Swaps counter for current insertion. Enabled in debug mode */
 	int swaps;
@@ -91,6 +94,15 @@ struct hashmap_rp {
 
 	/* entries */
 	TOID(struct entry) entries;
+
+	/* entries which are being migrated, NULL if no resize is in progress */
+	TOID(struct entry) entries_old;
+
+	/* capacity of the entries being migrated */
+	uint64_t capacity_old;
+
+	/* index of the next old entry to be migrated */
+	uint64_t migrated;
 };
 
 int *swaps_array = NULL;
@@ -192,6 +204,9 @@ hashmap_create(PMEMobjpool *pop, TOID(struct hashmap_rp) *hashmap_p,
 	D_RW(hashmap)->capacity = INIT_ENTRIES_NUM_RP;
 	D_RW(hashmap)->resize_threshold = (uint64_t)(INIT_ENTRIES_NUM_RP *
 		HASHMAP_RP_LOAD_FACTOR);
+	TOID_ASSIGN(D_RW(hashmap)->entries_old, OID_NULL);
+	D_RW(hashmap)->capacity_old = 0;
+	D_RW(hashmap)->migrated = 0;
 
 	size_t sz = sizeof(struct entry) * D_RO(hashmap)->capacity;
 	/* init entries with zero in order to track unused hashes */
@@ -201,7 +216,7 @@ hashmap_create(PMEMobjpool *pop, TOID(struct hashmap_rp) *hashmap_p,
 		goto reserve_err;
 	actv_cnt++;
 
-	pmemobj_persist(pop, D_RW(hashmap), sizeof(hashmap));
+	pmemobj_persist(pop, D_RW(hashmap), sizeof(struct hashmap_rp));
 
 	pmemobj_set_value(pop, &actv[actv_cnt++], &hashmap_p->oid.pool_uuid_lo,
 		hashmap.oid.pool_uuid_lo);
@@ -270,7 +285,7 @@ entry_add(PMEMobjpool *pop, struct hashmap_rp *hashmap, struct add_entry *args,
 
 	if (rebuild == HASHMAP_RP_REBUILD)
 		hashmap->count++;
-	else {
+	else if (rebuild == HASHMAP_RP_NO_REBUILD) {
 		pmemobj_set_value(pop, args->actv + args->actv_cnt++,
 			&hashmap->count, hashmap->count + 1);
 	}
@@ -278,9 +293,31 @@ entry_add(PMEMobjpool *pop, struct hashmap_rp *hashmap, struct add_entry *args,
 	entry_update(pop, hashmap, args, rebuild);
 }
 
+/*
+ * entry_publish -- publishes actions of the insertion, an entry moved from
+ * the old table is published together with the migration progress marker
+ */
+static void
+entry_publish(PMEMobjpool *pop, struct hashmap_rp *hashmap,
+	struct add_entry *args, int rebuild)
+{
+	if (rebuild == HASHMAP_RP_REBUILD)
+		return;
+
+	if (rebuild == HASHMAP_RP_MIGRATE) {
+		HM_ASSERT(HASHMAP_RP_MAX_ACTIONS > args->actv_cnt);
+		pmemobj_set_value(pop, args->actv + args->actv_cnt++,
+			&hashmap->migrated, args->migrated);
+	}
+
+	pmemobj_publish(pop, args->actv, args->actv_cnt);
+}
+
 /*
  * insert_helper -- inserts specified value into the hashmap
  * If function was called during rebuild process, no redo logs will be used.
+ * If an entry is being migrated from the old table, the migrated marker is
+ * published along with it and the counter of elements is left unchanged.
  * returns:
  * - 0 if successful,
  * - 1 if value already existed
@@ -288,9 +325,11 @@ entry_add(PMEMobjpool *pop, struct hashmap_rp *hashmap, struct add_entry *args,
  */
 static int
 insert_helper(PMEMobjpool *pop, struct hashmap_rp *hashmap, uint64_t key,
-	PMEMoid value, int rebuild)
+	PMEMoid value, int rebuild, uint64_t migrated)
 {
-	HM_ASSERT(hashmap->count + 1 < hashmap->resize_threshold);
+	/* migrated entries are already counted */
+	HM_ASSERT(rebuild == HASHMAP_RP_MIGRATE ||
+		hashmap->count + 1 < hashmap->resize_threshold);
 
 	struct pobj_action actv[HASHMAP_RP_MAX_ACTIONS];
 
@@ -299,6 +338,7 @@ insert_helper(PMEMobjpool *pop, struct hashmap_rp *hashmap, uint64_t key,
 	args.data.value = value;
 	args.data.hash = hash(hashmap, key);
 	args.pos = args.data.hash;
+	args.migrated = migrated;
 	if (rebuild != HASHMAP_RP_REBUILD) {
 		args.actv = actv;
 		args.actv_cnt = 0;
@@ -321,8 +361,7 @@ insert_helper(PMEMobjpool *pop, struct hashmap_rp *hashmap, uint64_t key,
 		if (!entry_is_empty(entry_p->hash) &&
 				entry_p->key == args.data.key) {
 			entry_update(pop, hashmap, &args, rebuild);
-			if (rebuild != HASHMAP_RP_REBUILD)
-				pmemobj_publish(pop, args.actv, args.actv_cnt);
+			entry_publish(pop, hashmap, &args, rebuild);
 
 			return 1;
 		}
@@ -330,8 +369,7 @@ insert_helper(PMEMobjpool *pop, struct hashmap_rp *hashmap, uint64_t key,
 		/* Case 2: slot is empty from the beginning */
 		if (entry_p->hash == 0) {
 			entry_add(pop, hashmap, &args, rebuild);
-			if (rebuild != HASHMAP_RP_REBUILD)
-				pmemobj_publish(pop, args.actv, args.actv_cnt);
+			entry_publish(pop, hashmap, &args, rebuild);
 
 			return 0;
 		}
@@ -346,9 +384,7 @@ insert_helper(PMEMobjpool *pop, struct hashmap_rp *hashmap, uint64_t key,
 		if (existing_dist < dist) {
 			if (entry_is_deleted(entry_p->hash)) {
 				entry_add(pop, hashmap, &args, rebuild);
-				if (rebuild != HASHMAP_RP_REBUILD)
-					pmemobj_publish(pop, args.actv,
-						args.actv_cnt);
+				entry_publish(pop, hashmap, &args, rebuild);
 
 				return 0;
 			}
@@ -404,6 +440,45 @@ index_lookup(const struct hashmap_rp *hashmap, uint64_t key)
 	return 0;
 }
 
+/*
+ * old_index_lookup -- checks if given key exists in the part of the old
+ * entries which was not migrated yet.
+ * Returns index number if key was found, 0 otherwise.
+ */
+static uint64_t
+old_index_lookup(const struct hashmap_rp *hashmap, uint64_t key)
+{
+	if (TOID_IS_NULL(hashmap->entries_old))
+		return 0;
+
+	/* view of the old entries, so that the probing helpers can be used */
+	struct hashmap_rp old = *hashmap;
+	old.capacity = hashmap->capacity_old;
+	old.entries = hashmap->entries_old;
+
+	uint64_t pos = index_lookup(&old, key);
+
+	return pos >= hashmap->migrated ? pos : 0;
+}
+
+/*
+ * entry_find -- returns entry with given key from the current or the old
+ * entries, NULL if the key does not exist
+ */
+static struct entry *
+entry_find(struct hashmap_rp *hashmap, uint64_t key)
+{
+	uint64_t pos = index_lookup(hashmap, key);
+	if (pos != 0)
+		return D_RW(hashmap->entries) + pos;
+
+	pos = old_index_lookup(hashmap, key);
+	if (pos != 0)
+		return D_RW(hashmap->entries_old) + pos;
+
+	return NULL;
+}
+
 /*
  * entries_cache -- cache entries from second argument in entries from first
  * argument
@@ -420,7 +495,7 @@ entries_cache(PMEMobjpool *pop, struct hashmap_rp *dest,
 			continue;
 
 		if (insert_helper(pop, dest, e->key,
-				e->value, HASHMAP_RP_REBUILD) == -1)
+				e->value, HASHMAP_RP_REBUILD, 0) == -1)
 			return -1;
 	}
 	HM_ASSERT(src->count == dest->count);
@@ -428,6 +503,137 @@ entries_cache(PMEMobjpool *pop, struct hashmap_rp *dest,
 	return 0;
 }
 
+/*
+ * hm_rp_migrate -- moves up to nslots old entries to the current ones. Every
+ * moved entry is published together with the migration progress marker, so
+ * an interrupted migration simply resumes from the marker. Old entries are
+ * freed once all of them are moved.
+ * Returns 0 on success, -1 otherwise.
+ */
+static int
+hm_rp_migrate(PMEMobjpool *pop, TOID(struct hashmap_rp) hashmap,
+		uint64_t nslots)
+{
+	struct hashmap_rp *map = D_RW(hashmap);
+	if (TOID_IS_NULL(map->entries_old))
+		return 0;
+
+	const struct entry *e = D_RO(map->entries_old);
+	uint64_t pos = map->migrated;
+	uint64_t end = map->capacity_old - pos > nslots ?
+		pos + nslots : map->capacity_old;
+
+	for (; pos < end; ++pos) {
+		if (entry_is_empty(e[pos].hash))
+			continue;
+
+		if (insert_helper(pop, map, e[pos].key, e[pos].value,
+				HASHMAP_RP_MIGRATE, pos + 1) == -1)
+			return -1;
+	}
+
+	/*
+	 * We will need at most 5 actions:
+	 * - 1 action to free old entries
+	 * - 2 actions to clear oid of old entries
+	 * - 1 action to clear old capacity
+	 * - 1 action to set migration progress marker
+	 */
+	struct pobj_action actv[5];
+	size_t actv_cnt = 0;
+
+	if (end == map->capacity_old) {
+		pmemobj_defer_free(pop, map->entries_old.oid,
+			&actv[actv_cnt++]);
+		pmemobj_set_value(pop, &actv[actv_cnt++],
+			&map->entries_old.oid.pool_uuid_lo, 0);
+		pmemobj_set_value(pop, &actv[actv_cnt++],
+			&map->entries_old.oid.off, 0);
+		pmemobj_set_value(pop, &actv[actv_cnt++],
+			&map->capacity_old, 0);
+		pmemobj_set_value(pop, &actv[actv_cnt++], &map->migrated, 0);
+	} else if (map->migrated != end) {
+		/* trailing empty slots */
+		pmemobj_set_value(pop, &actv[actv_cnt++], &map->migrated, end);
+	}
+
+	if (actv_cnt != 0)
+		pmemobj_publish(pop, actv, actv_cnt);
+
+	return 0;
+}
+
+/*
+ * hm_rp_resize -- replaces entries with empty ones of a new capacity, the
+ * previous entries are then migrated a few at a time by following operations.
+ * Returns 0 on success, -1 otherwise.
+ */
+static int
+hm_rp_resize(PMEMobjpool *pop, TOID(struct hashmap_rp) hashmap,
+		size_t capacity_new)
+{
+	/* only one migration can be in progress */
+	if (hm_rp_migrate(pop, hashmap, UINT64_MAX) != 0)
+		return -1;
+
+	/*
+	 * We will need 9 actions:
+	 * - 1 action to alloc memory for new entries
+	 * - 2 actions to set new oid pointing to new entries
+	 * - 2 actions to set oid pointing to old entries
+	 * - 1 action to set new capacity
+	 * - 1 action to set new resize threshold
+	 * - 1 action to set old capacity
+	 * - 1 action to set migration progress marker
+	 */
+	struct pobj_action actv[9];
+	size_t actv_cnt = 0;
+	struct hashmap_rp *map = D_RW(hashmap);
+
+	TOID(struct entry) entries_new = POBJ_XRESERVE_ALLOC(pop, struct entry,
+			sizeof(struct entry) * capacity_new, &actv[actv_cnt],
+			POBJ_XALLOC_ZERO);
+	if (TOID_IS_NULL(entries_new)) {
+		fprintf(stderr, "hashmap resize failed: %s\n",
+			pmemobj_errormsg());
+		return -1;
+	}
+	actv_cnt++;
+
+#ifdef DEBUG
+	free(swaps_array);
+	swaps_array = (int *)calloc(capacity_new, sizeof(int));
+	if (!swaps_array) {
+		pmemobj_cancel(pop, actv, actv_cnt);
+		return -1;
+	}
+#endif
+
+	pmemobj_set_value(pop, &actv[actv_cnt++],
+		&map->entries_old.oid.pool_uuid_lo,
+		map->entries.oid.pool_uuid_lo);
+	pmemobj_set_value(pop, &actv[actv_cnt++], &map->entries_old.oid.off,
+		map->entries.oid.off);
+	pmemobj_set_value(pop, &actv[actv_cnt++], &map->capacity_old,
+		map->capacity);
+	/* index 0 is never used */
+	pmemobj_set_value(pop, &actv[actv_cnt++], &map->migrated, 1);
+
+	pmemobj_set_value(pop, &actv[actv_cnt++],
+		&map->entries.oid.pool_uuid_lo, entries_new.oid.pool_uuid_lo);
+	pmemobj_set_value(pop, &actv[actv_cnt++], &map->entries.oid.off,
+		entries_new.oid.off);
+	pmemobj_set_value(pop, &actv[actv_cnt++], &map->capacity,
+		capacity_new);
+	pmemobj_set_value(pop, &actv[actv_cnt++], &map->resize_threshold,
+		(uint64_t)(capacity_new * HASHMAP_RP_LOAD_FACTOR));
+
+	HM_ASSERT(sizeof(actv) / sizeof(actv[0]) >= actv_cnt);
+	pmemobj_publish(pop, actv, actv_cnt);
+
+	return 0;
+}
+
 /*
  * hm_rp_rebuild -- rebuilds the hashmap with a new capacity.
  * Returns 0 on success, -1 otherwise.
@@ -436,6 +642,10 @@ static int
 hm_rp_rebuild(PMEMobjpool *pop, TOID(struct hashmap_rp) hashmap,
 		size_t capacity_new)
 {
+	/* rebuild works on a single table */
+	if (hm_rp_migrate(pop, hashmap, UINT64_MAX) != 0)
+		return -1;
+
 	/*
 	 * We will need 6 actions:
 	 * - 1 action to set new capacity
@@ -535,6 +745,7 @@ hm_rp_check(PMEMobjpool *pop, TOID(struct hashmap_rp) hashmap)
 /*
  * hm_rp_init -- recovers hashmap state, called after pmemobj_open.
  * Since hashmap_rp is performing rebuild/insertion completely or not at all,
+ * and an interrupted resize is resumed by the following operations,
  * function is dummy and simply returns 0.
  */
 int
@@ -554,14 +765,32 @@ int
 hm_rp_insert(PMEMobjpool *pop, TOID(struct hashmap_rp) hashmap,
 		uint64_t key, PMEMoid value)
 {
+	if (hm_rp_migrate(pop, hashmap, HASHMAP_RP_MIGRATE_STEP) != 0)
+		return -1;
+
 	if (D_RO(hashmap)->count + 1 >= D_RO(hashmap)->resize_threshold) {
 		uint64_t capacity_new = D_RO(hashmap)->capacity * 2;
-		if (hm_rp_rebuild(pop, hashmap, capacity_new) != 0)
+		if (hm_rp_resize(pop, hashmap, capacity_new) != 0)
 			return -1;
 	}
 
+	/* key which was not migrated yet is updated in the old entries */
+	uint64_t pos = old_index_lookup(D_RO(hashmap), key);
+	if (pos != 0) {
+		struct entry *entry_p = D_RW(D_RW(hashmap)->entries_old) + pos;
+		struct pobj_action actv[2];
+
+		pmemobj_set_value(pop, &actv[0], &entry_p->value.pool_uuid_lo,
+			value.pool_uuid_lo);
+		pmemobj_set_value(pop, &actv[1], &entry_p->value.off,
+			value.off);
+		pmemobj_publish(pop, actv, 2);
+
+		return 1;
+	}
+
 	return insert_helper(pop, D_RW(hashmap), key, value,
-		HASHMAP_RP_NO_REBUILD);
+		HASHMAP_RP_NO_REBUILD, 0);
 }
 
 /*
@@ -574,13 +803,14 @@ PMEMoid
 hm_rp_remove(PMEMobjpool *pop, TOID(struct hashmap_rp) hashmap,
 		uint64_t key)
 {
-	const uint64_t pos = index_lookup(D_RO(hashmap), key);
+	if (hm_rp_migrate(pop, hashmap, HASHMAP_RP_MIGRATE_STEP) != 0)
+		return OID_NULL;
+
+	struct entry *entry_p = entry_find(D_RW(hashmap), key);
 
-	if (pos == 0)
+	if (entry_p == NULL)
 		return OID_NULL;
 
-	struct entry *entry_p = D_RW(D_RW(hashmap)->entries);
-	entry_p += pos;
 	PMEMoid ret = entry_p->value;
 
 	size_t actvcnt = 0;
@@ -603,9 +833,14 @@ hm_rp_remove(PMEMobjpool *pop, TOID(struct hashmap_rp) hashmap,
 		(((uint64_t)(D_RO(hashmap)->capacity / 2))
 			* HASHMAP_RP_LOAD_FACTOR);
 
+	/*
+	 * Shrink only when the reduced hashmap would be half full at most,
+	 * so that the following insertions do not grow it right back.
+	 */
 	if (reduced_threshold >= INIT_ENTRIES_NUM_RP &&
-		D_RW(hashmap)->count < reduced_threshold &&
-		hm_rp_rebuild(pop, hashmap, D_RO(hashmap)->capacity / 2))
+		D_RW(hashmap)->count < reduced_threshold / 2 &&
+		TOID_IS_NULL(D_RO(hashmap)->entries_old) &&
+		hm_rp_resize(pop, hashmap, D_RO(hashmap)->capacity / 2))
 		return OID_NULL;
 
 	return ret;
@@ -619,11 +854,9 @@ PMEMoid
 hm_rp_get(PMEMobjpool *pop, TOID(struct hashmap_rp) hashmap,
 		uint64_t key)
 {
-	struct entry *entry_p =
-		(struct entry *)pmemobj_direct(D_RW(hashmap)->entries.oid);
+	struct entry *entry_p = entry_find(D_RW(hashmap), key);
 
-	uint64_t pos = index_lookup(D_RO(hashmap), key);
-	return pos == 0 ? OID_NULL : (entry_p + pos)->value;
+	return entry_p == NULL ? OID_NULL : entry_p->value;
 }
 
 /*
@@ -634,7 +867,7 @@ int
 hm_rp_lookup(PMEMobjpool *pop, TOID(struct hashmap_rp) hashmap,
 		uint64_t key)
 {
-	return index_lookup(D_RO(hashmap), key) != 0;
+	return entry_find(D_RW(hashmap), key) != NULL;
 }
 
 /*
@@ -657,6 +890,19 @@ hm_rp_foreach(PMEMobjpool *pop, TOID(struct hashmap_rp) hashmap,
 			return ret;
 	}
 
+	/* old entries which were not migrated yet */
+	entry_p = (struct entry *)
+		pmemobj_direct(D_RO(hashmap)->entries_old.oid);
+	for (size_t i = D_RO(hashmap)->migrated;
+			i < D_RO(hashmap)->capacity_old; ++i) {
+		uint64_t hash = entry_p[i].hash;
+		if (entry_is_empty(hash))
+			continue;
+		ret = cb(entry_p[i].key, entry_p[i].value, arg);
+		if (ret)
+			return ret;
+	}
+
 	return 0;
 }
 
@@ -689,6 +935,21 @@ hm_rp_debug(PMEMobjpool *pop, TOID(struct hashmap_rp) hashmap, FILE *out)
 			probe_distance(D_RO(hashmap), hash, i));
 #endif
 	}
+
+	if (TOID_IS_NULL(D_RO(hashmap)->entries_old))
+		return;
+
+	fprintf(out, "resizing from: %" PRIu64 ", migrated: %" PRIu64 "\n",
+		D_RO(hashmap)->capacity_old, D_RO(hashmap)->migrated);
+
+	entry_p = D_RW((D_RW(hashmap)->entries_old));
+	for (size_t i = D_RO(hashmap)->migrated;
+			i < D_RO(hashmap)->capacity_old; ++i) {
+		if (entry_is_empty(entry_p[i].hash))
+			continue;
+
+		fprintf(out, "old %zu: %" PRIu64 "\n", i, entry_p[i].key);
+	}
 }
 
 /*
@@ -44,6 +44,8 @@
 /* Flags to indicate if insertion is being made during rebuild process */
 #define HASHMAP_RP_REBUILD 1
 #define HASHMAP_RP_NO_REBUILD 0
+/* Flag to indicate that an entry is moved from the table being migrated */
+#define HASHMAP_RP_MIGRATE 2
 /* Initial number of entries for hashamap_rp */
 #define INIT_ENTRIES_NUM_RP 16
 /* Load factor to indicate resize threshold */
@@ -52,6 +54,8 @@
 #define HASHMAP_RP_MAX_SWAPS 150
 /* Size of an action array used during single insertion */
 #define HASHMAP_RP_MAX_ACTIONS (4 * HASHMAP_RP_MAX_SWAPS + 5)
+/* Number of old entries migrated per operation while the hashmap resizes */
+#define HASHMAP_RP_MIGRATE_STEP 8
 
 struct hashmap_rp;
 TOID_DECLARE(struct hashmap_rp, HASHMAP_RP_TYPE_OFFSET + 0);
@@ -75,6 +75,12 @@ struct hashmap_tx {
 
 	/* buckets */
 	TOID(struct buckets) buckets;
+
+	/* buckets which are being migrated, NULL if no resize is in progress */
+	TOID(struct buckets) buckets_old;
+
+	/* number of buckets_old buckets already migrated to buckets */
+	uint64_t migrated;
 };
 
 /*
@@ -123,23 +129,145 @@ hash(const TOID(struct hashmap_tx) *hashmap,
 }
 
 /*
- * hm_tx_rebuild -- rebuilds the hashmap with a new number of buckets
+ * hm_tx_bucket -- returns the list the key belongs to, it's in the old
+ * table as long as the old bucket was not migrated yet
+ */
+static TOID(struct entry) *
+hm_tx_bucket(TOID(struct hashmap_tx) hashmap, uint64_t key)
+{
+	TOID(struct buckets) buckets_old = D_RO(hashmap)->buckets_old;
+	if (!TOID_IS_NULL(buckets_old)) {
+		uint64_t h = hash(&hashmap, &buckets_old, key);
+		if (h >= D_RO(hashmap)->migrated)
+			return &D_RW(buckets_old)->bucket[h];
+	}
+
+	TOID(struct buckets) buckets = D_RO(hashmap)->buckets;
+
+	return &D_RW(buckets)->bucket[hash(&hashmap, &buckets, key)];
+}
+
+/*
+ * hm_tx_migrate -- moves entries of up to nbuckets old buckets to the new
+ * table and frees the old table once it's empty, must be called within
+ * a transaction
  */
 static void
-hm_tx_rebuild(PMEMobjpool *pop, TOID(struct hashmap_tx) hashmap, size_t new_len)
+hm_tx_migrate(PMEMobjpool *pop, TOID(struct hashmap_tx) hashmap,
+	size_t nbuckets)
+{
+	TOID(struct buckets) buckets_old = D_RO(hashmap)->buckets_old;
+	if (TOID_IS_NULL(buckets_old))
+		return;
+
+	TOID(struct buckets) buckets = D_RO(hashmap)->buckets;
+	size_t i = D_RO(hashmap)->migrated;
+	size_t end = D_RO(buckets_old)->nbuckets;
+	if (end - i > nbuckets)
+		end = i + nbuckets;
+
+	/*
+	 * Heads of the migrated old buckets are left as they are, they are
+	 * never accessed again.
+	 */
+	for (; i < end; ++i) {
+		TOID(struct entry) en = D_RO(buckets_old)->bucket[i];
+		while (!TOID_IS_NULL(en)) {
+			TOID(struct entry) next = D_RO(en)->next;
+			uint64_t h = hash(&hashmap, &buckets, D_RO(en)->key);
+
+			TX_ADD_FIELD(en, next);
+			TX_ADD_FIELD(buckets, bucket[h]);
+			D_RW(en)->next = D_RO(buckets)->bucket[h];
+			D_RW(buckets)->bucket[h] = en;
+
+			en = next;
+		}
+	}
+
+	TX_ADD_FIELD(hashmap, migrated);
+	D_RW(hashmap)->migrated = end;
+
+	if (end == D_RO(buckets_old)->nbuckets) {
+		TX_ADD_FIELD(hashmap, buckets_old);
+		D_RW(hashmap)->buckets_old = TOID_NULL(struct buckets);
+		D_RW(hashmap)->migrated = 0;
+		TX_FREE(buckets_old);
+	}
+}
+
+/*
+ * hm_tx_migrate_step -- migrates the next few old buckets, if the hashmap
+ * is being resized
+ */
+static void
+hm_tx_migrate_step(PMEMobjpool *pop, TOID(struct hashmap_tx) hashmap)
 {
-	TOID(struct buckets) buckets_old = D_RO(hashmap)->buckets;
+	if (TOID_IS_NULL(D_RO(hashmap)->buckets_old))
+		return;
 
-	if (new_len == 0)
-		new_len = D_RO(buckets_old)->nbuckets;
+	TX_BEGIN(pop) {
+		hm_tx_migrate(pop, hashmap, MIGRATE_BUCKETS_NUM);
+	} TX_ONABORT {
+		fprintf(stderr, "%s: transaction aborted: %s\n", __func__,
+			pmemobj_errormsg());
+	} TX_END
+}
 
-	size_t sz_old = sizeof(struct buckets) +
-			D_RO(buckets_old)->nbuckets *
-			sizeof(TOID(struct entry));
+/*
+ * hm_tx_resize -- starts incremental migration of the hashmap to a new
+ * table with new_len buckets, subsequent operations move the entries
+ */
+static void
+hm_tx_resize(PMEMobjpool *pop, TOID(struct hashmap_tx) hashmap, size_t new_len)
+{
 	size_t sz_new = sizeof(struct buckets) +
 			new_len * sizeof(TOID(struct entry));
 
 	TX_BEGIN(pop) {
+		TX_ADD_FIELD(hashmap, buckets);
+		TX_ADD_FIELD(hashmap, buckets_old);
+		TX_ADD_FIELD(hashmap, migrated);
+
+		TOID(struct buckets) buckets_new =
+				TX_ZALLOC(struct buckets, sz_new);
+		D_RW(buckets_new)->nbuckets = new_len;
+
+		D_RW(hashmap)->buckets_old = D_RO(hashmap)->buckets;
+		D_RW(hashmap)->buckets = buckets_new;
+		D_RW(hashmap)->migrated = 0;
+	} TX_ONABORT {
+		fprintf(stderr, "%s: transaction aborted: %s\n", __func__,
+			pmemobj_errormsg());
+		/*
+		 * We don't need to do anything here, because everything is
+		 * consistent. The only thing affected is performance.
+		 */
+	} TX_END
+}
+
+/*
+ * hm_tx_rebuild -- rebuilds the whole hashmap with a new number of buckets
+ * in a single transaction, used only on demand
+ */
+static void
+hm_tx_rebuild(PMEMobjpool *pop, TOID(struct hashmap_tx) hashmap, size_t new_len)
+{
+	TX_BEGIN(pop) {
+		/* finish the resize in progress, if any */
+		hm_tx_migrate(pop, hashmap, SIZE_MAX);
+
+		TOID(struct buckets) buckets_old = D_RO(hashmap)->buckets;
+
+		if (new_len == 0)
+			new_len = D_RO(buckets_old)->nbuckets;
+
+		size_t sz_old = sizeof(struct buckets) +
+				D_RO(buckets_old)->nbuckets *
+				sizeof(TOID(struct entry));
+		size_t sz_new = sizeof(struct buckets) +
+				new_len * sizeof(TOID(struct entry));
+
 		TX_ADD_FIELD(hashmap, buckets);
 		TOID(struct buckets) buckets_new =
 				TX_ZALLOC(struct buckets, sz_new);
@@ -185,13 +313,15 @@ int
 hm_tx_insert(PMEMobjpool *pop, TOID(struct hashmap_tx) hashmap,
 	uint64_t key, PMEMoid value)
 {
+	hm_tx_migrate_step(pop, hashmap);
+
 	TOID(struct buckets) buckets = D_RO(hashmap)->buckets;
+	TOID(struct entry) *bucket = hm_tx_bucket(hashmap, key);
 	TOID(struct entry) var;
 
-	uint64_t h = hash(&hashmap, &buckets, key);
 	int num = 0;
 
-	for (var = D_RO(buckets)->bucket[h];
+	for (var = *bucket;
 			!TOID_IS_NULL(var);
 			var = D_RO(var)->next) {
 		if (D_RO(var)->key == key)
@@ -201,14 +331,14 @@ hm_tx_insert(PMEMobjpool *pop, TOID(struct hashmap_tx) hashmap,
 
 	int ret = 0;
 	TX_BEGIN(pop) {
-		TX_ADD_FIELD(D_RO(hashmap)->buckets, bucket[h]);
+		TX_ADD_DIRECT(bucket);
 		TX_ADD_FIELD(hashmap, count);
 
 		TOID(struct entry) e = TX_NEW(struct entry);
 		D_RW(e)->key = key;
 		D_RW(e)->value = value;
-		D_RW(e)->next = D_RO(buckets)->bucket[h];
-		D_RW(buckets)->bucket[h] = e;
+		D_RW(e)->next = *bucket;
+		*bucket = e;
 
 		D_RW(hashmap)->count++;
 		num++;
@@ -221,10 +351,14 @@ hm_tx_insert(PMEMobjpool *pop, TOID(struct hashmap_tx) hashmap,
 	if (ret)
 		return ret;
 
+	/* the next resize can start only after the previous one is done */
+	if (!TOID_IS_NULL(D_RO(hashmap)->buckets_old))
+		return 0;
+
 	if (num > MAX_HASHSET_THRESHOLD ||
 			(num > MIN_HASHSET_THRESHOLD &&
 			D_RO(hashmap)->count > 2 * D_RO(buckets)->nbuckets))
-		hm_tx_rebuild(pop, hashmap, D_RO(buckets)->nbuckets * 2);
+		hm_tx_resize(pop, hashmap, D_RO(buckets)->nbuckets * 2);
 
 	return 0;
 }
@@ -238,11 +372,13 @@ hm_tx_insert(PMEMobjpool *pop, TOID(struct hashmap_tx) hashmap,
 PMEMoid
 hm_tx_remove(PMEMobjpool *pop, TOID(struct hashmap_tx) hashmap, uint64_t key)
 {
+	hm_tx_migrate_step(pop, hashmap);
+
 	TOID(struct buckets) buckets = D_RO(hashmap)->buckets;
+	TOID(struct entry) *bucket = hm_tx_bucket(hashmap, key);
 	TOID(struct entry) var, prev = TOID_NULL(struct entry);
 
-	uint64_t h = hash(&hashmap, &buckets, key);
-	for (var = D_RO(buckets)->bucket[h];
+	for (var = *bucket;
 			!TOID_IS_NULL(var);
 			prev = var, var = D_RO(var)->next) {
 		if (D_RO(var)->key == key)
@@ -256,13 +392,13 @@ hm_tx_remove(PMEMobjpool *pop, TOID(struct hashmap_tx) hashmap, uint64_t key)
 	PMEMoid retoid = D_RO(var)->value;
 	TX_BEGIN(pop) {
 		if (TOID_IS_NULL(prev))
-			TX_ADD_FIELD(D_RO(hashmap)->buckets, bucket[h]);
+			TX_ADD_DIRECT(bucket);
 		else
 			TX_ADD_FIELD(prev, next);
 		TX_ADD_FIELD(hashmap, count);
 
 		if (TOID_IS_NULL(prev))
-			D_RW(buckets)->bucket[h] = D_RO(var)->next;
+			*bucket = D_RO(var)->next;
 		else
 			D_RW(prev)->next = D_RO(var)->next;
 		D_RW(hashmap)->count--;
@@ -276,24 +412,30 @@ hm_tx_remove(PMEMobjpool *pop, TOID(struct hashmap_tx) hashmap, uint64_t key)
 	if (ret)
 		return OID_NULL;
 
-	if (D_RO(hashmap)->count < D_RO(buckets)->nbuckets)
-		hm_tx_rebuild(pop, hashmap, D_RO(buckets)->nbuckets / 2);
+	/*
+	 * Shrink only below half of the load which would trigger the shrink,
+	 * so that the table is not resized back and forth.
+	 */
+	if (TOID_IS_NULL(D_RO(hashmap)->buckets_old) &&
+			D_RO(buckets)->nbuckets / 2 >= INIT_BUCKETS_NUM &&
+			D_RO(hashmap)->count < D_RO(buckets)->nbuckets / 2)
+		hm_tx_resize(pop, hashmap, D_RO(buckets)->nbuckets / 2);
 
 	return retoid;
 }
 
 /*
- * hm_tx_foreach -- prints all values from the hashmap
+ * hm_tx_foreach_buckets -- calls cb for all values from the buckets,
+ * starting with the bucket with given index
  */
-int
-hm_tx_foreach(PMEMobjpool *pop, TOID(struct hashmap_tx) hashmap,
+static int
+hm_tx_foreach_buckets(TOID(struct buckets) buckets, size_t first,
 	int (*cb)(uint64_t key, PMEMoid value, void *arg), void *arg)
 {
-	TOID(struct buckets) buckets = D_RO(hashmap)->buckets;
 	TOID(struct entry) var;
 
 	int ret = 0;
-	for (size_t i = 0; i < D_RO(buckets)->nbuckets; ++i) {
+	for (size_t i = first; i < D_RO(buckets)->nbuckets; ++i) {
 		if (TOID_IS_NULL(D_RO(buckets)->bucket[i]))
 			continue;
 
@@ -301,13 +443,32 @@ hm_tx_foreach(PMEMobjpool *pop, TOID(struct hashmap_tx) hashmap,
 				var = D_RO(var)->next) {
 			ret = cb(D_RO(var)->key, D_RO(var)->value, arg);
 			if (ret)
-				break;
+				return ret;
 		}
 	}
 
 	return ret;
 }
 
+/*
+ * hm_tx_foreach -- prints all values from the hashmap
+ */
+int
+hm_tx_foreach(PMEMobjpool *pop, TOID(struct hashmap_tx) hashmap,
+	int (*cb)(uint64_t key, PMEMoid value, void *arg), void *arg)
+{
+	TOID(struct buckets) buckets = D_RO(hashmap)->buckets;
+	TOID(struct buckets) buckets_old = D_RO(hashmap)->buckets_old;
+
+	int ret = hm_tx_foreach_buckets(buckets, 0, cb, arg);
+	if (ret || TOID_IS_NULL(buckets_old))
+		return ret;
+
+	/* the old buckets which were not migrated yet */
+	return hm_tx_foreach_buckets(buckets_old, D_RO(hashmap)->migrated,
+			cb, arg);
+}
+
 /*
  * hm_tx_debug -- prints complete hashmap state
  */
@@ -322,6 +483,11 @@ hm_tx_debug(PMEMobjpool *pop, TOID(struct hashmap_tx) hashmap, FILE *out)
 	fprintf(out, "count: %" PRIu64 ", buckets: %zu\n",
 		D_RO(hashmap)->count, D_RO(buckets)->nbuckets);
 
+	TOID(struct buckets) buckets_old = D_RO(hashmap)->buckets_old;
+	if (!TOID_IS_NULL(buckets_old))
+		fprintf(out, "resizing from: %zu, migrated: %" PRIu64 "\n",
+			D_RO(buckets_old)->nbuckets, D_RO(hashmap)->migrated);
+
 	for (size_t i = 0; i < D_RO(buckets)->nbuckets; ++i) {
 		if (TOID_IS_NULL(D_RO(buckets)->bucket[i]))
 			continue;
@@ -335,6 +501,24 @@ hm_tx_debug(PMEMobjpool *pop, TOID(struct hashmap_tx) hashmap, FILE *out)
 		}
 		fprintf(out, "(%d)\n", num);
 	}
+
+	if (TOID_IS_NULL(buckets_old))
+		return;
+
+	for (size_t i = D_RO(hashmap)->migrated;
+			i < D_RO(buckets_old)->nbuckets; ++i) {
+		if (TOID_IS_NULL(D_RO(buckets_old)->bucket[i]))
+			continue;
+
+		int num = 0;
+		fprintf(out, "old %zu: ", i);
+		for (var = D_RO(buckets_old)->bucket[i]; !TOID_IS_NULL(var);
+				var = D_RO(var)->next) {
+			fprintf(out, "%" PRIu64 " ", D_RO(var)->key);
+			num++;
+		}
+		fprintf(out, "(%d)\n", num);
+	}
 }
 
 /*
@@ -343,12 +527,9 @@ hm_tx_debug(PMEMobjpool *pop, TOID(struct hashmap_tx) hashmap, FILE *out)
 PMEMoid
 hm_tx_get(PMEMobjpool *pop, TOID(struct hashmap_tx) hashmap, uint64_t key)
 {
-	TOID(struct buckets) buckets = D_RO(hashmap)->buckets;
 	TOID(struct entry) var;
 
-	uint64_t h = hash(&hashmap, &buckets, key);
-
-	for (var = D_RO(buckets)->bucket[h];
+	for (var = *hm_tx_bucket(hashmap, key);
 			!TOID_IS_NULL(var);
 			var = D_RO(var)->next)
 		if (D_RO(var)->key == key)
@@ -363,12 +544,9 @@ hm_tx_get(PMEMobjpool *pop, TOID(struct hashmap_tx) hashmap, uint64_t key)
 int
 hm_tx_lookup(PMEMobjpool *pop, TOID(struct hashmap_tx) hashmap, uint64_t key)
 {
-	TOID(struct buckets) buckets = D_RO(hashmap)->buckets;
 	TOID(struct entry) var;
 
-	uint64_t h = hash(&hashmap, &buckets, key);
-
-	for (var = D_RO(buckets)->bucket[h];
+	for (var = *hm_tx_bucket(hashmap, key);
 			!TOID_IS_NULL(var);
 			var = D_RO(var)->next)
 		if (D_RO(var)->key == key)
@@ -45,8 +45,11 @@
 #include "map_ctree.h"
 #include "map_btree.h"
 #include "map_rbtree.h"
+#include "map_bptree.h"
+#include "map_art.h"
 #include "map_hashmap_atomic.h"
 #include "map_hashmap_tx.h"
+#include "map_hashmap_mt.h"
 #include "map_hashmap_rp.h"
 #include "map_skiplist.h"
 
@@ -113,12 +116,18 @@ parse_map_type(const char *type)
 		return MAP_BTREE;
 	else if (strcmp(type, "rbtree") == 0)
 		return MAP_RBTREE;
+	else if (strcmp(type, "bptree") == 0)
+		return MAP_BPTREE;
+	else if (strcmp(type, "art") == 0)
+		return MAP_ART;
 	else if (strcmp(type, "hashmap_atomic") == 0)
 		return MAP_HASHMAP_ATOMIC;
 	else if (strcmp(type, "hashmap_tx") == 0)
 		return MAP_HASHMAP_TX;
 	else if (strcmp(type, "hashmap_rp") == 0)
 		return MAP_HASHMAP_RP;
+	else if (strcmp(type, "hashmap_mt") == 0)
+		return MAP_HASHMAP_MT;
 	else if (strcmp(type, "skiplist") == 0)
 		return MAP_SKIPLIST;
 	return NULL;
@@ -128,8 +137,9 @@ parse_map_type(const char *type)
 int main(int argc, const char *argv[]) {
 	if (argc < 3) {
 		printf("usage: %s "
-			"<ctree|btree|rbtree|hashmap_atomic|hashmap_rp|"
-			"hashmap_tx|skiplist> file-name [nops]\n", argv[0]);
+			"<ctree|btree|rbtree|bptree|art|hashmap_atomic|hashmap_rp|"
+			"hashmap_tx|hashmap_mt|skiplist> file-name [nops]\n",
+			argv[0]);
 		return 1;
 	}
 
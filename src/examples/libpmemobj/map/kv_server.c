@@ -32,6 +32,12 @@
 
 /*
  * kv_server.c -- persistent tcp key-value store server
+ *
+ * The server runs a number of worker threads, each with its own event loop
+ * listening on the same port (SO_REUSEPORT), so the kernel balances incoming
+ * connections between them. All complete messages received by a single read
+ * are executed in one transaction (group commit) and their responses are
+ * sent back after it commits.
  */
 
 #include <uv.h>
@@ -40,6 +46,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
 
 #include "libpmemobj.h"
 
@@ -48,8 +56,11 @@
 #include "map_btree.h"
 #include "map_rtree.h"
 #include "map_rbtree.h"
+#include "map_bptree.h"
+#include "map_art.h"
 #include "map_hashmap_atomic.h"
 #include "map_hashmap_tx.h"
+#include "map_hashmap_mt.h"
 #include "map_hashmap_rp.h"
 #include "map_skiplist.h"
 
@@ -77,8 +88,32 @@ static struct map_ctx *mapc;
 static PMEMobjpool *pop;
 static TOID(struct map) map;
 
-static uv_tcp_t server;
-static uv_loop_t *loop;
+/*
+ * Maps which are not safe for concurrent use are accessed by a single worker
+ * at a time. Concurrent maps take their locks within the transaction and
+ * hold them until it ends, so to avoid lock-order deadlocks only the groups
+ * of a single message run in parallel.
+ */
+static int map_concurrent;
+static uv_rwlock_t map_lock;
+
+/*
+ * Only maps which modify the pool in transactions can have several messages
+ * grouped in one outer transaction, the atomic ones persist their changes
+ * immediately and would not be rolled back if the group aborted.
+ */
+static int map_transactional;
+
+struct worker {
+	uv_thread_t thread;
+	uv_loop_t loop;
+	uv_tcp_t server;
+	uv_async_t stop; /* wakes up the loop to shut the server down */
+	uv_buf_t read_buf; /* single buffer for all incoming data of the loop */
+};
+
+static struct worker *workers;
+static unsigned nworkers;
 
 typedef int (*msg_handler)(uv_stream_t *client, const char *msg, size_t len);
 
@@ -87,10 +122,22 @@ struct write_req {
 	uv_buf_t buf;
 };
 
+enum client_close {
+	CLIENT_OPEN,
+	CLIENT_CLOSE, /* close the connection once responses are sent */
+	CLIENT_CLOSE_SERVER /* ... and shut the server down */
+};
+
 struct client_data {
-	char *buf; /* current message, always NULL terminated */
+	char *buf; /* pending messages, always NULL terminated */
 	size_t buf_len; /* sizeof(buf) */
-	size_t len; /* actual length of the message (while parsing) */
+	size_t len; /* actual length of the pending messages */
+
+	char *resp; /* responses waiting for the group to commit */
+	size_t resp_size; /* sizeof(resp) */
+	size_t resp_len; /* actual length of the responses */
+
+	enum client_close close;
 };
 
 /*
@@ -115,6 +162,7 @@ static void
 write_done_cb(uv_write_t *req, int status)
 {
 	struct write_req *wr = (struct write_req *)req;
+	free(wr->buf.base);
 	free(wr);
 
 	if (status == -1) {
@@ -130,20 +178,55 @@ client_close_cb(uv_handle_t *handle)
 {
 	struct client_data *d = handle->data;
 	free(d->buf);
+	free(d->resp);
 	free(handle->data);
 	free(handle);
 }
 
 /*
- * response_write -- response writing helper
+ * response_write -- response writing helper, the response is sent once
+ * the group of messages it belongs to is committed
  */
 static void
 response_write(uv_stream_t *client, char *resp, size_t len)
 {
+	struct client_data *d = client->data;
+
+	if (d->resp_size < d->resp_len + len) {
+		size_t size = d->resp_size ? d->resp_size : MAX_KEY_LEN;
+		while (size < d->resp_len + len)
+			size *= 2;
+
+		char *cresp = realloc(d->resp, size);
+		assert(cresp != NULL);
+
+		d->resp = cresp;
+		d->resp_size = size;
+	}
+
+	memcpy(d->resp + d->resp_len, resp, len);
+	d->resp_len += len;
+}
+
+/*
+ * response_flush -- sends all the pending responses in a single write
+ */
+static void
+response_flush(uv_stream_t *client)
+{
+	struct client_data *d = client->data;
+	if (d->resp_len == 0)
+		return;
+
 	struct write_req *wr = malloc(sizeof(struct write_req));
 	assert(wr != NULL);
 
-	wr->buf = uv_buf_init(resp, len);
+	/* the buffer is released once the write completes */
+	wr->buf = uv_buf_init(d->resp, d->resp_len);
+	d->resp = NULL;
+	d->resp_size = 0;
+	d->resp_len = 0;
+
 	uv_write(&wr->req, client, &wr->buf, 1, write_done_cb);
 }
 
@@ -241,7 +324,8 @@ cmsg_get_handler(uv_stream_t *client, const char *msg, size_t len)
 static int
 cmsg_bye_handler(uv_stream_t *client, const char *msg, size_t len)
 {
-	uv_close((uv_handle_t *)client, client_close_cb);
+	struct client_data *d = client->data;
+	d->close = CLIENT_CLOSE;
 
 	return 0;
 }
@@ -252,8 +336,8 @@ cmsg_bye_handler(uv_stream_t *client, const char *msg, size_t len)
 static int
 cmsg_kill_handler(uv_stream_t *client, const char *msg, size_t len)
 {
-	uv_close((uv_handle_t *)client, client_close_cb);
-	uv_close((uv_handle_t *)&server, NULL);
+	struct client_data *d = client->data;
+	d->close = CLIENT_CLOSE_SERVER;
 
 	return 0;
 }
@@ -268,67 +352,125 @@ static msg_handler protocol_impl[MAX_CMSG] = {
 };
 
 /*
- * cmsg_handle -- handles current client message
+ * cmsg_handle -- handles a single client message
  */
 static int
-cmsg_handle(uv_stream_t *client, struct client_data *data)
+cmsg_handle(uv_stream_t *client, const char *msg, size_t len)
 {
-	int ret = 0;
 	int i;
 	for (i = 0; i < MAX_CMSG; ++i)
-		if (strncmp(kv_cmsg_token[i], data->buf,
+		if (strncmp(kv_cmsg_token[i], msg,
 			strlen(kv_cmsg_token[i])) == 0)
 			break;
 
 	if (i == MAX_CMSG) {
 		response_msg(client, RESP_MSG_UNKNOWN);
-	} else {
-		ret = protocol_impl[i](client, data->buf, data->len);
+		return 0;
 	}
 
-	data->len = 0; /* reset the message length */
-
-	return ret;
+	return protocol_impl[i](client, msg, len);
 }
 
 /*
- * cmsg_handle_stream -- handle incoming tcp stream from clients
+ * cmsg_handle_pending -- handles all complete messages of the client,
+ * returns the number of consumed bytes
  */
-static int
-cmsg_handle_stream(uv_stream_t *client, struct client_data *data,
-	const char *buf, ssize_t nread)
+static size_t
+cmsg_handle_pending(uv_stream_t *client, struct client_data *data)
 {
+	size_t off = 0;
 	char *last;
-	int ret;
-	size_t len;
 
 	/*
 	 * A single read operation can contain zero or more operations, so this
 	 * has to be handled appropriately. Client messages are terminated by
 	 * newline character.
 	 */
-	while ((last = memchr(buf, '\n', nread)) != NULL) {
-		len = last - buf + 1;
-		nread -= len;
-		assert(data->len + len <= data->buf_len);
-		memcpy(data->buf + data->len, buf, len);
-		data->len += len;
+	while (data->close == CLIENT_OPEN && (last = memchr(data->buf + off,
+			'\n', data->len - off)) != NULL) {
+		size_t len = (size_t)(last - (data->buf + off)) + 1;
+
+		cmsg_handle(client, data->buf + off, len);
+		off += len;
+	}
 
-		if ((ret = cmsg_handle(client, data)) != 0)
-			return ret;
+	return off;
+}
 
-		buf = last + 1;
+/*
+ * cmsg_handle_group -- handles all complete messages of the client in one
+ * transaction, so that they are committed together. If the group aborts,
+ * the messages are retried one by one, each in its own transaction. Messages
+ * for maps which are not transactional are always handled one by one.
+ * Returns the number of consumed bytes.
+ */
+static size_t
+cmsg_handle_group(uv_stream_t *client, struct client_data *data,
+	size_t nmsgs)
+{
+	int group = map_transactional && nmsgs > 1;
+	int exclusive = !map_concurrent || group;
+	if (exclusive)
+		uv_rwlock_wrlock(&map_lock);
+	else
+		uv_rwlock_rdlock(&map_lock);
+
+	size_t off = 0;
+	volatile int aborted = 0;
+
+	if (!group) {
+		off = cmsg_handle_pending(client, data);
+	} else {
+		TX_BEGIN(pop) {
+			off = cmsg_handle_pending(client, data);
+		} TX_ONABORT {
+			aborted = 1;
+		} TX_END
 	}
 
-	if (nread != 0) {
-		memcpy(data->buf + data->len, buf, nread);
-		data->len += nread;
+	if (aborted) {
+		data->resp_len = 0;
+		data->close = CLIENT_OPEN;
+		off = cmsg_handle_pending(client, data);
 	}
 
-	return 0;
+	if (exclusive)
+		uv_rwlock_wrunlock(&map_lock);
+	else
+		uv_rwlock_rdunlock(&map_lock);
+
+	return off;
 }
 
-static uv_buf_t msg_buf = {0};
+/*
+ * server_stop_cb -- closes the server of the worker, the loop ends once all
+ * of its clients disconnect
+ */
+static void
+server_stop_cb(uv_async_t *handle)
+{
+	struct worker *w = handle->loop->data;
+
+	uv_close((uv_handle_t *)&w->server, NULL);
+	uv_close((uv_handle_t *)&w->stop, NULL);
+}
+
+/*
+ * server_stop -- shuts the server down in all the workers
+ */
+static void
+server_stop(void)
+{
+	static int stopped;
+
+	uv_rwlock_wrlock(&map_lock);
+	if (!stopped) {
+		stopped = 1;
+		for (unsigned i = 0; i < nworkers; ++i)
+			uv_async_send(&workers[i].stop);
+	}
+	uv_rwlock_wrunlock(&map_lock);
+}
 
 /*
  * get_read_buf_cb -- returns buffer for incoming client message
@@ -336,8 +478,10 @@ static uv_buf_t msg_buf = {0};
 static void
 get_read_buf_cb(uv_handle_t *handle, size_t size, uv_buf_t *buf)
 {
-	buf->base = msg_buf.base;
-	buf->len = msg_buf.len;
+	struct worker *w = handle->loop->data;
+
+	buf->base = w->read_buf.base;
+	buf->len = w->read_buf.len;
 }
 
 /*
@@ -356,20 +500,37 @@ read_cb(uv_stream_t *client, ssize_t nread, const uv_buf_t *buf)
 	struct client_data *d = client->data;
 
 	if (d->buf_len < (d->len + nread + 1)) {
-		char *cbuf = realloc(d->buf, d->buf_len + nread + 1);
+		char *cbuf = realloc(d->buf, d->len + nread + 1);
 		assert(cbuf != NULL);
 
-		/* zero only the new memory */
-		memset(cbuf + d->buf_len, 0, nread + 1);
-
-		d->buf_len += nread + 1;
+		d->buf_len = d->len + nread + 1;
 		d->buf = cbuf;
 	}
 
-	if (cmsg_handle_stream(client, client->data, buf->base, nread)) {
-		printf("client disconnect\n");
+	memcpy(d->buf + d->len, buf->base, nread);
+	d->len += nread;
+	d->buf[d->len] = '\0';
+
+	size_t nmsgs = 0;
+	for (const char *c = d->buf; (c = strchr(c, '\n')) != NULL; ++c)
+		nmsgs++;
+
+	if (nmsgs == 0)
+		return;
+
+	size_t off = cmsg_handle_group(client, d, nmsgs);
+
+	/* keep the incomplete message for the next read */
+	memmove(d->buf, d->buf + off, d->len - off + 1);
+	d->len -= off;
+
+	response_flush(client);
+
+	if (d->close == CLIENT_CLOSE_SERVER)
+		server_stop();
+
+	if (d->close != CLIENT_OPEN)
 		uv_close((uv_handle_t *)client, client_close_cb);
-	}
 }
 
 /*
@@ -389,7 +550,7 @@ connection_cb(uv_stream_t *server, int status)
 	client->data = calloc(1, sizeof(struct client_data));
 	assert(client->data != NULL);
 
-	uv_tcp_init(loop, client);
+	uv_tcp_init(server->loop, client);
 
 	if (uv_accept(server, (uv_stream_t *)client) == 0) {
 		uv_read_start((uv_stream_t *)client, get_read_buf_cb, read_cb);
@@ -401,30 +562,90 @@ connection_cb(uv_stream_t *server, int status)
 static const struct {
 	struct map_ops *ops;
 	const char *name;
+	int concurrent;
+	int transactional;
 } maps[] = {
-	{MAP_HASHMAP_TX, "hashmap_tx"},
-	{MAP_HASHMAP_ATOMIC, "hashmap_atomic"},
-	{MAP_HASHMAP_RP, "hashmap_rp"},
-	{MAP_CTREE, "ctree"},
-	{MAP_BTREE, "btree"},
-	{MAP_RTREE, "rtree"},
-	{MAP_RBTREE, "rbtree"},
-	{MAP_SKIPLIST, "skiplist"}
+	{MAP_HASHMAP_TX, "hashmap_tx", 0, 1},
+	{MAP_HASHMAP_ATOMIC, "hashmap_atomic", 0, 0},
+	{MAP_HASHMAP_RP, "hashmap_rp", 0, 0},
+	{MAP_HASHMAP_MT, "hashmap_mt", 1, 1},
+	{MAP_CTREE, "ctree", 0, 1},
+	{MAP_BTREE, "btree", 0, 1},
+	{MAP_RTREE, "rtree", 0, 1},
+	{MAP_RBTREE, "rbtree", 0, 1},
+	{MAP_BPTREE, "bptree", 0, 1},
+	{MAP_ART, "art", 0, 1},
+	{MAP_SKIPLIST, "skiplist", 0, 1}
 };
 
 /*
- * get_map_ops_by_string -- parse the type string and return the associated ops
+ * get_map_ops_by_string -- parse the type string and return the associated ops,
+ * also records whether the map can be used concurrently and whether its
+ * operations are transactional
  */
 static const struct map_ops *
 get_map_ops_by_string(const char *type)
 {
 	for (int i = 0; i < COUNT_OF(maps); ++i)
-		if (strcmp(maps[i].name, type) == 0)
+		if (strcmp(maps[i].name, type) == 0) {
+			map_concurrent = maps[i].concurrent;
+			map_transactional = maps[i].transactional;
 			return maps[i].ops;
+		}
 
 	return NULL;
 }
 
+/*
+ * worker_listen -- initializes the worker's loop and starts listening, all
+ * the workers share the port
+ */
+static int
+worker_listen(struct worker *w, int port)
+{
+	if (uv_loop_init(&w->loop) != 0)
+		return -1;
+	w->loop.data = w;
+
+	if (uv_async_init(&w->loop, &w->stop, server_stop_cb) != 0)
+		return -1;
+
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+		return -1;
+
+	int on = 1;
+	if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) != 0) {
+		close(fd);
+		return -1;
+	}
+
+	uv_tcp_init(&w->loop, &w->server);
+	if (uv_tcp_open(&w->server, fd) != 0) {
+		close(fd);
+		return -1;
+	}
+
+	struct sockaddr_in bind_addr;
+	uv_ip4_addr("0.0.0.0", port, &bind_addr);
+	if (uv_tcp_bind(&w->server, (const struct sockaddr *)&bind_addr, 0))
+		return -1;
+
+	return uv_listen((uv_stream_t *)&w->server, SOMAXCONN, connection_cb);
+}
+
+/*
+ * worker_run -- runs the worker's loop until the server is shut down
+ */
+static void
+worker_run(void *arg)
+{
+	struct worker *w = arg;
+
+	int ret = uv_run(&w->loop, UV_RUN_DEFAULT);
+	assert(ret == 0);
+}
+
 #define KV_SIZE	(PMEMOBJ_MIN_POOL)
 
 #define MAX_READ_LEN (64 * 1024) /* 64 kilobytes */
@@ -432,9 +653,11 @@ get_map_ops_by_string(const char *type)
 int
 main(int argc, char *argv[])
 {
-	if (argc < 4) {
+	if (argc < 4 || argc > 5) {
 		printf("usage: %s hashmap_tx|hashmap_atomic|hashmap_rp|"
-				"ctree|btree|rtree|rbtree|skiplist file-name port\n",
+				"hashmap_mt|"
+				"ctree|btree|rtree|rbtree|bptree|art|skiplist"
+				" file-name port [threads]\n",
 				argv[0]);
 		return 1;
 	}
@@ -442,12 +665,11 @@ main(int argc, char *argv[])
 	const char *path = argv[2];
 	const char *type = argv[1];
 	int port = atoi(argv[3]);
-
-	/* use only a single buffer for all incoming data */
-	void *read_buf = malloc(MAX_READ_LEN);
-	assert(read_buf != NULL);
-
-	msg_buf = uv_buf_init(read_buf, MAX_READ_LEN);
+	nworkers = argc > 4 ? (unsigned)atoi(argv[4]) : 1;
+	if (nworkers == 0) {
+		fprintf(stderr, "invalid number of threads\n");
+		return 1;
+	}
 
 	if (access(path, F_OK) != 0) {
 		pop = pmemobj_create(path, POBJ_LAYOUT_NAME(kv_server),
@@ -482,28 +704,42 @@ main(int argc, char *argv[])
 	}
 	map = D_RO(root)->map;
 
-	loop = uv_default_loop();
+	int ret = uv_rwlock_init(&map_lock);
+	assert(ret == 0);
+
+	workers = calloc(nworkers, sizeof(*workers));
+	assert(workers != NULL);
 
 	/* tcp server initialization */
-	uv_tcp_init(loop, &server);
+	for (unsigned i = 0; i < nworkers; ++i) {
+		void *read_buf = malloc(MAX_READ_LEN);
+		assert(read_buf != NULL);
 
-	struct sockaddr_in bind_addr;
-	uv_ip4_addr("0.0.0.0", port, &bind_addr);
-	int ret = uv_tcp_bind(&server, (const struct sockaddr *)&bind_addr, 0);
-	assert(ret == 0);
+		workers[i].read_buf = uv_buf_init(read_buf, MAX_READ_LEN);
 
-	ret = uv_listen((uv_stream_t *)&server, SOMAXCONN, connection_cb);
-	assert(ret == 0);
+		ret = worker_listen(&workers[i], port);
+		assert(ret == 0);
+	}
 
-	ret = uv_run(loop, UV_RUN_DEFAULT);
-	assert(ret == 0);
+	for (unsigned i = 0; i < nworkers; ++i) {
+		ret = uv_thread_create(&workers[i].thread, worker_run,
+				&workers[i]);
+		assert(ret == 0);
+	}
+
+	for (unsigned i = 0; i < nworkers; ++i)
+		uv_thread_join(&workers[i].thread);
 
-	/* no more events in the loop, release resources and quit */
-	uv_loop_delete(loop);
+	/* no more events in the loops, release resources and quit */
+	for (unsigned i = 0; i < nworkers; ++i) {
+		uv_loop_close(&workers[i].loop);
+		free(workers[i].read_buf.base);
+	}
+
+	free(workers);
+	uv_rwlock_destroy(&map_lock);
 	map_ctx_free(mapc);
 	pmemobj_close(pop);
 
-	free(read_buf);
-
 	return 0;
 }
@@ -1,6 +1,6 @@
 #!/usr/bin/env bash
 #
-# Copyright 2015-2016, Intel Corporation
+# Copyright 2015-2018, Intel Corporation
 #
 # Redistribution and use in source and binary forms, with or without
 # modification, are permitted provided that the following conditions
@@ -31,14 +31,25 @@
 # OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #
 
+#
+# usage: kv_server_test.sh pool [threads] [clients] [ops]
+#
+# If the number of clients is given, each of them sends 'ops' pipelined
+# INSERT and GET requests and the throughput and the mean request latency
+# are reported.
+#
+
 set -euo pipefail
 
 MAP=ctree
 PORT=9100
 POOL=$1
+THREADS=${2:-1}
+CLIENTS=${3:-0}
+OPS=${4:-1000}
 
 # start a new server instance
-./kv_server $MAP $POOL $PORT &
+./kv_server $MAP $POOL $PORT $THREADS &
 
 # wait for the server to properly start
 sleep 1
@@ -47,6 +58,36 @@ sleep 1
 RESP=`echo -e "INSERT foo bar\nGET foo\nBYE" | nc 127.0.0.1 $PORT`
 echo $RESP
 
+if [ $CLIENTS -gt 0 ]; then
+	# prepare the pipelined requests of every client
+	for c in `seq $CLIENTS`; do
+		for i in `seq $OPS`; do
+			echo "INSERT key$c.$i value$i"
+			echo "GET key$c.$i"
+		done > $POOL.req$c
+		echo "BYE" >> $POOL.req$c
+	done
+
+	PIDS=""
+	START=`date +%s%N`
+	for c in `seq $CLIENTS`; do
+		nc 127.0.0.1 $PORT < $POOL.req$c > $POOL.resp$c &
+		PIDS="$PIDS $!"
+	done
+	wait $PIDS
+	END=`date +%s%N`
+
+	TOTAL=$((CLIENTS * OPS * 2))
+	ELAPSED_US=$(((END - START) / 1000 + 1))
+	FAILED=`cat $POOL.resp* | grep -c -e FAIL -e NULL || true`
+
+	echo "requests: $TOTAL, failed: $FAILED"
+	echo "ops/s: $((TOTAL * 1000000 / ELAPSED_US))"
+	echo "mean latency [us]: $((ELAPSED_US * CLIENTS / TOTAL))"
+
+	rm -f $POOL.req* $POOL.resp*
+fi
+
 # remove previously inserted key value pair and shutdown the server
 RESP=`echo -e "GET foo\nREMOVE foo\nGET foo\nKILL" | nc 127.0.0.1 $PORT`
 echo $RESP
@@ -201,6 +201,20 @@ map_foreach(struct map_ctx *mapc, TOID(struct map) map,
 	return mapc->ops->foreach(mapc->pop, map, cb, arg);
 }
 
+/*
+ * map_range -- iterate through key value pairs with keys from the [min, max]
+ * range, in the key order
+ */
+int
+map_range(struct map_ctx *mapc, TOID(struct map) map,
+		uint64_t min, uint64_t max,
+		int (*cb)(uint64_t key, PMEMoid value, void *arg),
+		void *arg)
+{
+	ABORT_NOT_IMPLEMENTED(mapc, range);
+	return mapc->ops->range(mapc->pop, map, min, max, cb, arg);
+}
+
 /*
  * map_is_empty -- check if map is empty
  */
@@ -76,6 +76,10 @@ struct map_ops {
 	int(*foreach)(PMEMobjpool *pop, TOID(struct map) map,
 		int(*cb)(uint64_t key, PMEMoid value, void *arg),
 		void *arg);
+	int(*range)(PMEMobjpool *pop, TOID(struct map) map,
+		uint64_t min, uint64_t max,
+		int(*cb)(uint64_t key, PMEMoid value, void *arg),
+		void *arg);
 	int(*is_empty)(PMEMobjpool *pop, TOID(struct map) map);
 	size_t(*count)(PMEMobjpool *pop, TOID(struct map) map);
 	int(*cmd)(PMEMobjpool *pop, TOID(struct map) map,
@@ -108,6 +112,10 @@ int map_lookup(struct map_ctx *mapc, TOID(struct map) map, uint64_t key);
 int map_foreach(struct map_ctx *mapc, TOID(struct map) map,
 	int(*cb)(uint64_t key, PMEMoid value, void *arg),
 	void *arg);
+int map_range(struct map_ctx *mapc, TOID(struct map) map,
+	uint64_t min, uint64_t max,
+	int(*cb)(uint64_t key, PMEMoid value, void *arg),
+	void *arg);
 int map_is_empty(struct map_ctx *mapc, TOID(struct map) map);
 size_t map_count(struct map_ctx *mapc, TOID(struct map) map);
 int map_cmd(struct map_ctx *mapc, TOID(struct map) map,
@@ -179,6 +179,21 @@ map_btree_foreach(PMEMobjpool *pop, TOID(struct map) map,
 	return btree_map_foreach(pop, btree_map, cb, arg);
 }
 
+/*
+ * map_btree_range -- wrapper for btree_map_range
+ */
+static int
+map_btree_range(PMEMobjpool *pop, TOID(struct map) map,
+		uint64_t min, uint64_t max,
+		int (*cb)(uint64_t key, PMEMoid value, void *arg),
+		void *arg)
+{
+	TOID(struct btree_map) btree_map;
+	TOID_ASSIGN(btree_map, map.oid);
+
+	return btree_map_range(pop, btree_map, min, max, cb, arg);
+}
+
 /*
  * map_btree_is_empty -- wrapper for btree_map_is_empty
  */
@@ -204,6 +219,7 @@ struct map_ops btree_map_ops = {
 	/* .get		= */ map_btree_get,
 	/* .lookup	= */ map_btree_lookup,
 	/* .foreach	= */ map_btree_foreach,
+	/* .range	= */ map_btree_range,
 	/* .is_empty	= */ map_btree_is_empty,
 	/* .count	= */ NULL,
 	/* .cmd		= */ NULL,
@@ -179,6 +179,21 @@ map_ctree_foreach(PMEMobjpool *pop, TOID(struct map) map,
 	return ctree_map_foreach(pop, ctree_map, cb, arg);
 }
 
+/*
+ * map_ctree_range -- wrapper for ctree_map_range
+ */
+static int
+map_ctree_range(PMEMobjpool *pop, TOID(struct map) map,
+		uint64_t min, uint64_t max,
+		int (*cb)(uint64_t key, PMEMoid value, void *arg),
+		void *arg)
+{
+	TOID(struct ctree_map) ctree_map;
+	TOID_ASSIGN(ctree_map, map.oid);
+
+	return ctree_map_range(pop, ctree_map, min, max, cb, arg);
+}
+
 /*
  * map_ctree_is_empty -- wrapper for ctree_map_is_empty
  */
@@ -204,6 +219,7 @@ struct map_ops ctree_map_ops = {
 	/* .get		= */ map_ctree_get,
 	/* .lookup	= */ map_ctree_lookup,
 	/* .foreach	= */ map_ctree_foreach,
+	/* .range	= */ map_ctree_range,
 	/* .is_empty	= */ map_ctree_is_empty,
 	/* .count	= */ NULL,
 	/* .cmd		= */ NULL,
@@ -176,6 +176,7 @@ struct map_ops hashmap_atomic_ops = {
 	/* .get		= */ map_hm_atomic_get,
 	/* .lookup	= */ map_hm_atomic_lookup,
 	/* .foreach	= */ map_hm_atomic_foreach,
+	/* .range	= */ NULL,
 	/* .is_empty	= */ NULL,
 	/* .count	= */ map_hm_atomic_count,
 	/* .cmd		= */ map_hm_atomic_cmd,
@@ -176,6 +176,7 @@ struct map_ops hashmap_rp_ops = {
 	/* .get		= */ map_hm_rp_get,
 	/* .lookup	= */ map_hm_rp_lookup,
 	/* .foreach	= */ map_hm_rp_foreach,
+	/* .range	= */ NULL,
 	/* .is_empty	= */ NULL,
 	/* .count	= */ map_hm_rp_count,
 	/* .cmd		= */ map_hm_rp_cmd,
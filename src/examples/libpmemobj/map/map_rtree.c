@@ -229,6 +229,7 @@ struct map_ops rtree_map_ops = {
 /*	.get		= */map_rtree_get,
 /*	.lookup		= */map_rtree_lookup,
 /*	.foreach	= */map_rtree_foreach,
+/*	.range		= */NULL,
 /*	.is_empty	= */map_rtree_is_empty,
 /*	.count		= */NULL,
 /*	.cmd		= */NULL,
@@ -179,6 +179,21 @@ map_skiplist_foreach(PMEMobjpool *pop, TOID(struct map) map,
 	return skiplist_map_foreach(pop, skiplist_map, cb, arg);
 }
 
+/*
+ * map_skiplist_range -- wrapper for skiplist_map_range
+ */
+static int
+map_skiplist_range(PMEMobjpool *pop, TOID(struct map) map,
+		uint64_t min, uint64_t max,
+		int (*cb)(uint64_t key, PMEMoid value, void *arg),
+		void *arg)
+{
+	TOID(struct skiplist_map_node) skiplist_map;
+	TOID_ASSIGN(skiplist_map, map.oid);
+
+	return skiplist_map_range(pop, skiplist_map, min, max, cb, arg);
+}
+
 /*
  * map_skiplist_is_empty -- wrapper for skiplist_map_is_empty
  */
@@ -204,6 +219,7 @@ struct map_ops skiplist_map_ops = {
 	/* .get		= */ map_skiplist_get,
 	/* .lookup	= */ map_skiplist_lookup,
 	/* .foreach	= */ map_skiplist_foreach,
+	/* .range	= */ map_skiplist_range,
 	/* .is_empty	= */ map_skiplist_is_empty,
 	/* .count	= */ NULL,
 	/* .cmd		= */ NULL,
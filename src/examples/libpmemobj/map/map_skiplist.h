@@ -39,8 +39,16 @@
 
 #include "map.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 extern struct map_ops skiplist_map_ops;
 
 #define MAP_SKIPLIST (&skiplist_map_ops)
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* MAP_SKIPLIST_H */
@@ -45,9 +45,12 @@
 #include "map_btree.h"
 #include "map_rtree.h"
 #include "map_rbtree.h"
+#include "map_bptree.h"
+#include "map_art.h"
 #include "map_hashmap_atomic.h"
 #include "map_hashmap_tx.h"
 #include "map_hashmap_rp.h"
+#include "map_hashmap_mt.h"
 #include "map_skiplist.h"
 #include "hashmap/hashmap.h"
 
@@ -173,6 +176,7 @@ help(void)
 	printf("c $value - check $value, returns 0/1\n");
 	printf("n $value - insert $value random values\n");
 	printf("p - print all values\n");
+	printf("s $min $max - print values from the [$min, $max] range\n");
 	printf("d - print debug info\n");
 	printf("b [$value] - rebuild $value (default: 1) times\n");
 	printf("q - quit\n");
@@ -200,14 +204,30 @@ print_all(void)
 	printf("\n");
 }
 
+/*
+ * str_print_range -- prints all values from the range specified as string
+ */
+static void
+str_print_range(const char *str)
+{
+	uint64_t min;
+	uint64_t max;
+	if (sscanf(str, "%" PRIu64 " %" PRIu64, &min, &max) == 2) {
+		map_range(mapc, map, min, max, hashmap_print, NULL);
+		printf("\n");
+	} else {
+		fprintf(stderr, "range: invalid syntax\n");
+	}
+}
+
 #define INPUT_BUF_LEN 1000
 int
 main(int argc, char *argv[])
 {
 	if (argc < 3 || argc > 4) {
 		printf("usage: %s "
-			"hashmap_tx|hashmap_atomic|hashmap_rp|"
-			"ctree|btree|rtree|rbtree|skiplist"
+			"hashmap_tx|hashmap_atomic|hashmap_rp|hashmap_mt|"
+			"ctree|btree|rtree|rbtree|bptree|art|skiplist"
 				" file-name [<seed>]\n", argv[0]);
 		return 1;
 	}
@@ -221,6 +241,8 @@ main(int argc, char *argv[])
 		ops = MAP_HASHMAP_ATOMIC;
 	} else if (strcmp(type, "hashmap_rp") == 0) {
 		ops = MAP_HASHMAP_RP;
+	} else if (strcmp(type, "hashmap_mt") == 0) {
+		ops = MAP_HASHMAP_MT;
 	} else if (strcmp(type, "ctree") == 0) {
 		ops = MAP_CTREE;
 	} else if (strcmp(type, "btree") == 0) {
@@ -229,6 +251,10 @@ main(int argc, char *argv[])
 		ops = MAP_RTREE;
 	} else if (strcmp(type, "rbtree") == 0) {
 		ops = MAP_RBTREE;
+	} else if (strcmp(type, "bptree") == 0) {
+		ops = MAP_BPTREE;
+	} else if (strcmp(type, "art") == 0) {
+		ops = MAP_ART;
 	} else if (strcmp(type, "skiplist") == 0) {
 		ops = MAP_SKIPLIST;
 	} else {
@@ -265,7 +291,9 @@ main(int argc, char *argv[])
 		root = POBJ_ROOT(pop, struct root);
 
 		printf("seed: %u\n", args.seed);
-		map_create(mapc, &D_RW(root)->map, &args);
+		/* the seed is meaningful only for hashmaps */
+		map_create(mapc, &D_RW(root)->map,
+			ops == MAP_BPTREE ? NULL : &args);
 
 		map = D_RO(root)->map;
 	} else {
@@ -311,6 +339,9 @@ main(int argc, char *argv[])
 			case 'p':
 				print_all();
 				break;
+			case 's':
+				str_print_range(buf + 1);
+				break;
 			case 'd':
 				map_cmd(mapc, map, HASHMAP_CMD_DEBUG,
 						(uint64_t)stdout);
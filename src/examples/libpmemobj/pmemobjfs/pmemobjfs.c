@@ -175,8 +175,6 @@ for ((entry) = ((head)).first; !TOID_IS_NULL(entry) &&\
 	}\
 } while (0)
 
-typedef uint8_t objfs_block_t;
-
 /*
  * pmemobjfs persistent layout
  */
@@ -184,12 +182,15 @@ POBJ_LAYOUT_BEGIN(pmemobjfs);
 POBJ_LAYOUT_ROOT(pmemobjfs, struct objfs_super);
 POBJ_LAYOUT_TOID(pmemobjfs, struct objfs_inode);
 POBJ_LAYOUT_TOID(pmemobjfs, struct objfs_dir_entry);
-POBJ_LAYOUT_TOID(pmemobjfs, objfs_block_t);
+POBJ_LAYOUT_TOID(pmemobjfs, struct objfs_extent);
 POBJ_LAYOUT_TOID(pmemobjfs, char);
 POBJ_LAYOUT_END(pmemobjfs);
 
 #define PMEMOBJFS_MIN_BLOCK_SIZE ((size_t)(512 - 64))
 
+/* maximum size of data allocated at once for a file */
+#define PMEMOBJFS_MAX_EXTENT_SIZE ((size_t)(1 << 20))
+
 /*
  * struct objfs_super -- pmemobjfs super (root) object
  */
@@ -216,15 +217,27 @@ struct objfs_dir {
 };
 
 /*
- * key == 0 for ctree_map is not allowed
+ * Extents are indexed by their first block in the reversed order, so the
+ * extent which may contain a block is the first one in the range of keys
+ * starting at the block. The key is never 0, which is not allowed for
+ * ctree_map.
+ */
+#define EXTENT_KEY(block_id) (UINT64_MAX - (block_id))
+#define EXTENT_BLOCK(key) (UINT64_MAX - (key))
+
+/*
+ * struct objfs_extent -- contiguous blocks of file data
  */
-#define GET_KEY(off) ((off) + 1)
+struct objfs_extent {
+	uint64_t nblocks;	/* number of blocks */
+	uint8_t data[];		/* data */
+};
 
 /*
  * struct objfs_file -- pmemobjfs file structure
  */
 struct objfs_file {
-	TOID(struct map) blocks;	/* blocks map */
+	TOID(struct map) blocks;	/* extents map */
 };
 
 /*
@@ -627,45 +640,131 @@ pmemobjfs_inode_lookup(struct pmemobjfs *objfs, const char *path,
 }
 
 /*
- * pmemobjfs_file_get_block -- get block at given offset
+ * struct objfs_extent_arg -- extent found by pmemobjfs_file_find_extent
+ */
+struct objfs_extent_arg {
+	uint64_t key;
+	PMEMoid oid;
+};
+
+/*
+ * pmemobjfs_file_find_extent_cb -- stop at the first extent in the range
+ */
+static int
+pmemobjfs_file_find_extent_cb(uint64_t key, PMEMoid value, void *arg)
+{
+	struct objfs_extent_arg *ext_arg = arg;
+	ext_arg->key = key;
+	ext_arg->oid = value;
+
+	return 1;
+}
+
+/*
+ * pmemobjfs_file_find_extent -- get extent with the highest first block
+ * from given range of blocks
  */
-static TOID(objfs_block_t)
-pmemobjfs_file_get_block(struct pmemobjfs *objfs,
+static TOID(struct objfs_extent)
+pmemobjfs_file_find_extent(struct pmemobjfs *objfs,
 		TOID(struct objfs_inode) inode,
-		uint64_t offset)
+		uint64_t first, uint64_t last, uint64_t *startp)
 {
-	TOID(objfs_block_t) block;
-	PMEMoid block_oid =
-		map_get(objfs->mapc, D_RO(inode)->file.blocks, GET_KEY(offset));
-	TOID_ASSIGN(block, block_oid);
-	return block;
+	struct objfs_extent_arg ext_arg = { 0, OID_NULL };
+	map_range(objfs->mapc, D_RO(inode)->file.blocks,
+			EXTENT_KEY(last), EXTENT_KEY(first),
+			pmemobjfs_file_find_extent_cb, &ext_arg);
+
+	TOID(struct objfs_extent) ext;
+	TOID_ASSIGN(ext, ext_arg.oid);
+	*startp = EXTENT_BLOCK(ext_arg.key);
+
+	return ext;
 }
 
 /*
- * pmemobjfs_file_get_block_for_write -- get or allocate block at given offset
+ * pmemobjfs_file_get_extent -- get extent which contains given block
  */
-static TOID(objfs_block_t)
-pmemobjfs_file_get_block_for_write(struct pmemobjfs *objfs,
-		TOID(struct objfs_inode) inode, uint64_t offset)
+static TOID(struct objfs_extent)
+pmemobjfs_file_get_extent(struct pmemobjfs *objfs,
+		TOID(struct objfs_inode) inode,
+		uint64_t block_id, uint64_t *startp)
 {
-	TOID(objfs_block_t) block =
-		pmemobjfs_file_get_block(objfs, inode, offset);
-	if (TOID_IS_NULL(block)) {
-		TX_BEGIN(objfs->pop) {
-			block = TX_ALLOC(objfs_block_t,
-					objfs->block_size);
-			map_insert(objfs->mapc, D_RW(inode)->file.blocks,
-					GET_KEY(offset), block.oid);
-		} TX_ONABORT {
-			block = TOID_NULL(objfs_block_t);
-		} TX_END
-	} else {
-#if PMEMOBJFS_TRACK_BLOCKS
-		TX_ADD(block);
-#endif
+	TOID(struct objfs_extent) ext = pmemobjfs_file_find_extent(objfs,
+			inode, 0, block_id, startp);
+
+	if (!TOID_IS_NULL(ext) && *startp + D_RO(ext)->nblocks <= block_id)
+		return TOID_NULL(struct objfs_extent);
+
+	return ext;
+}
+
+/*
+ * pmemobjfs_file_new_extent -- allocate extent starting at given block
+ *
+ * The extent is shortened so it does not overlap with the next one. Data
+ * from buff is written at off, the rest of the extent is zeroed. The data is
+ * written directly to the reserved object without snapshotting it and the
+ * object is published when the transaction commits.
+ */
+static TOID(struct objfs_extent)
+pmemobjfs_file_new_extent(struct pmemobjfs *objfs,
+		TOID(struct objfs_inode) inode, uint64_t block_id,
+		uint64_t nblocks, const char *buff, size_t size, uint64_t off)
+{
+	uint64_t next;
+	while (nblocks > 1 && !TOID_IS_NULL(pmemobjfs_file_find_extent(objfs,
+			inode, block_id + 1, block_id + nblocks - 1, &next)))
+		nblocks = next - block_id;
+
+	uint64_t ext_size = nblocks * objfs->block_size;
+
+	struct pobj_action act;
+	TOID(struct objfs_extent) ext = POBJ_RESERVE_ALLOC(objfs->pop,
+			struct objfs_extent,
+			sizeof(struct objfs_extent) + ext_size, &act);
+	if (TOID_IS_NULL(ext))
+		pmemobj_tx_abort(ENOSPC);
+
+	if (pmemobj_tx_publish(&act, 1)) {
+		pmemobj_cancel(objfs->pop, &act, 1);
+		pmemobj_tx_abort(ENOMEM);
 	}
 
-	return block;
+	D_RW(ext)->nblocks = nblocks;
+	pmemobj_persist(objfs->pop, &D_RW(ext)->nblocks,
+			sizeof(D_RW(ext)->nblocks));
+
+	if (size > ext_size - off)
+		size = ext_size - off;
+
+	uint8_t *data = D_RW(ext)->data;
+	pmemobj_memset_persist(objfs->pop, data, 0, off);
+	pmemobj_memcpy_persist(objfs->pop, data + off, buff, size);
+	pmemobj_memset_persist(objfs->pop, data + off + size, 0,
+			ext_size - off - size);
+
+	map_insert(objfs->mapc, D_RW(inode)->file.blocks,
+			EXTENT_KEY(block_id), ext.oid);
+
+	return ext;
+}
+
+/*
+ * pmemobjfs_file_new_extent_blocks -- number of blocks for a new extent
+ * which would hold size bytes at offset off of the first block
+ */
+static uint64_t
+pmemobjfs_file_new_extent_blocks(struct pmemobjfs *objfs,
+		uint64_t off, uint64_t size)
+{
+	uint64_t nblocks = (off + size + objfs->block_size - 1) /
+		objfs->block_size;
+	uint64_t max = PMEMOBJFS_MAX_EXTENT_SIZE / objfs->block_size;
+
+	if (max == 0)
+		max = 1;
+
+	return nblocks < max ? nblocks : max;
 }
 
 /*
@@ -690,13 +789,34 @@ pmemobjfs_truncate(struct pmemobjfs *objfs,
 	TX_BEGIN(objfs->pop) {
 		uint64_t old_off = D_RO(inode)->size;
 		if (old_off > off) {
-			/* release blocks */
-			uint64_t old_boff = (old_off - 1) / objfs->block_size;
-			uint64_t boff = (off + 1) / objfs->block_size;
+			uint64_t bsize = objfs->block_size;
+			uint64_t first = (off + bsize - 1) / bsize;
+			uint64_t last = (old_off - 1) / bsize;
+			uint64_t start;
+
+			/* clear the tail of the last extent which is kept */
+			TOID(struct objfs_extent) ext =
+				pmemobjfs_file_get_extent(objfs, inode,
+						off / bsize, &start);
+			if (!TOID_IS_NULL(ext) && start * bsize < off) {
+				uint64_t ext_off = off - start * bsize;
+				uint64_t ext_end = D_RO(ext)->nblocks * bsize;
+				if (ext_end > old_off - start * bsize)
+					ext_end = old_off - start * bsize;
+
+				pmemobj_tx_add_range_direct(
+					&D_RW(ext)->data[ext_off],
+					ext_end - ext_off);
+				memset(&D_RW(ext)->data[ext_off], 0,
+					ext_end - ext_off);
+			}
 
-			for (uint64_t o = boff; o <= old_boff; o++) {
+			/* release extents past the end of file */
+			while (!TOID_IS_NULL(ext = pmemobjfs_file_find_extent(
+					objfs, inode, first, last, &start))) {
 				map_remove_free(objfs->mapc,
-					D_RW(inode)->file.blocks, GET_KEY(o));
+					D_RW(inode)->file.blocks,
+					EXTENT_KEY(start));
 			}
 		}
 
@@ -745,26 +865,34 @@ pmemobjfs_read(struct pmemobjfs *objfs, TOID(struct objfs_inode) inode,
 			break;
 
 		uint64_t block_id = off / objfs->block_size;
-		uint64_t block_off = off % objfs->block_size;
-		uint64_t block_size = sz < objfs->block_size ?
-			sz : objfs->block_size;
+		uint64_t len = sz < fsize - off ? sz : fsize - off;
+		uint64_t start;
 
-		TOID(objfs_block_t) block =
-			pmemobjfs_file_get_block(objfs, inode, block_id);
+		TOID(struct objfs_extent) ext =
+			pmemobjfs_file_get_extent(objfs, inode, block_id,
+					&start);
 
-		if (block_off + block_size > objfs->block_size)
-			block_size = objfs->block_size - block_off;
+		if (TOID_IS_NULL(ext)) {
+			/* hole, read zeros up to the end of the block */
+			uint64_t block_off = off % objfs->block_size;
+			if (len > objfs->block_size - block_off)
+				len = objfs->block_size - block_off;
 
-		if (TOID_IS_NULL(block)) {
-			memset(buff, 0, block_size);
+			memset(buff, 0, len);
 		} else {
-			memcpy(buff, &D_RW(block)[block_off], block_size);
+			/* copy as much as possible from the whole extent */
+			uint64_t ext_off = off - start * objfs->block_size;
+			uint64_t ext_size =
+				D_RO(ext)->nblocks * objfs->block_size;
+			if (len > ext_size - ext_off)
+				len = ext_size - ext_off;
+
+			memcpy(buff, &D_RO(ext)->data[ext_off], len);
 		}
 
-
-		buff += block_size;
-		off += block_size;
-		sz -= block_size;
+		buff += len;
+		off += len;
+		sz -= len;
 	}
 
 	return size - sz;
@@ -794,25 +922,49 @@ pmemobjfs_write(struct pmemobjfs *objfs, TOID(struct objfs_inode) inode,
 		off_t off = offset;
 		while (sz > 0) {
 			uint64_t block_id = off / objfs->block_size;
-			uint64_t block_off = off % objfs->block_size;
-			uint64_t block_size = sz < objfs->block_size ?
-				sz : objfs->block_size;
-
-			TOID(objfs_block_t) block =
-				pmemobjfs_file_get_block_for_write(objfs,
-						inode, block_id);
-
-			if (TOID_IS_NULL(block))
-				return -ENOSPC;
-
-			if (block_off + block_size > objfs->block_size)
-				block_size = objfs->block_size - block_off;
-
-			memcpy(&D_RW(block)[block_off], buff, block_size);
+			uint64_t start;
+			uint64_t len;
+
+			TOID(struct objfs_extent) ext =
+				pmemobjfs_file_get_extent(objfs, inode,
+						block_id, &start);
+
+			if (TOID_IS_NULL(ext)) {
+				/* fresh data goes directly to a new extent */
+				uint64_t block_off = off % objfs->block_size;
+				uint64_t nblocks =
+					pmemobjfs_file_new_extent_blocks(objfs,
+							block_off, sz);
+
+				ext = pmemobjfs_file_new_extent(objfs, inode,
+						block_id, nblocks, buff, sz,
+						block_off);
+
+				len = D_RO(ext)->nblocks * objfs->block_size -
+					block_off;
+				if (len > sz)
+					len = sz;
+			} else {
+				uint64_t ext_off =
+					off - start * objfs->block_size;
+				len = D_RO(ext)->nblocks * objfs->block_size -
+					ext_off;
+				if (len > sz)
+					len = sz;
+
+				uint8_t *data = &D_RW(ext)->data[ext_off];
+#if PMEMOBJFS_TRACK_BLOCKS
+				pmemobj_tx_add_range_direct(data, len);
+				memcpy(data, buff, len);
+#else
+				pmemobj_memcpy_persist(objfs->pop, data, buff,
+						len);
+#endif
+			}
 
-			buff += block_size;
-			off += block_size;
-			sz -= block_size;
+			buff += len;
+			off += len;
+			sz -= len;
 		}
 
 		time_t t = time(NULL);
@@ -859,11 +1011,29 @@ pmemobjfs_fallocate(struct pmemobjfs *objfs,
 	int ret = 0;
 
 	TX_BEGIN(objfs->pop) {
-		/* allocate blocks from requested range */
+		/* allocate zeroed extents in the holes of requested range */
 		uint64_t b_off = offset / objfs->block_size;
-		uint64_t e_off = (offset + size) / objfs->block_size;
-		for (uint64_t off = b_off; off <= e_off; off++)
-			pmemobjfs_file_get_block_for_write(objfs, inode, off);
+		uint64_t e_off = (offset + size - 1) / objfs->block_size;
+		uint64_t off = b_off;
+		while (off <= e_off) {
+			uint64_t start;
+			TOID(struct objfs_extent) ext =
+				pmemobjfs_file_get_extent(objfs, inode, off,
+						&start);
+			if (TOID_IS_NULL(ext)) {
+				uint64_t len = (e_off - off + 1) *
+					objfs->block_size;
+				uint64_t nblocks =
+					pmemobjfs_file_new_extent_blocks(objfs,
+							0, len);
+
+				ext = pmemobjfs_file_new_extent(objfs, inode,
+						off, nblocks, NULL, 0, 0);
+				start = off;
+			}
+
+			off = start + D_RO(ext)->nblocks;
+		}
 
 		time_t t = time(NULL);
 		/* update modification time */
@@ -875,8 +1045,10 @@ pmemobjfs_fallocate(struct pmemobjfs *objfs,
 		D_RW(inode)->ctime = t;
 
 		/* update inode size */
-		D_RW(inode)->size = offset + size;
-		TX_ADD_FIELD(inode, size);
+		if (offset + size > D_RO(inode)->size) {
+			TX_ADD_FIELD(inode, size);
+			D_RW(inode)->size = offset + size;
+		}
 	} TX_ONABORT {
 		ret = -ECANCELED;
 	} TX_END
@@ -0,0 +1,1305 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * art_map.c -- adaptive radix tree
+ *
+ * Inner nodes come in four sizes (4, 16, 48 and 256 children) and are
+ * replaced by a bigger or a smaller one as children are added or removed.
+ * Paths of nodes with a single child are compressed into a prefix stored in
+ * the node, only the first ART_MAP_MAX_PREFIX_LEN bytes of it are kept and
+ * the rest is checked against the full key stored in the leaf. A key which
+ * is a prefix of other keys is kept in the node in which it ends.
+ *
+ * All modifications are transactional, only the fields and child slots which
+ * are actually changed are added to the transaction.
+ */
+
+#include <ex_common.h>
+#include <assert.h>
+#include <string.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define ART_MAP_SSE2
+#endif
+
+#include "art_map.h"
+
+/* number of bytes of the compressed path stored in the node */
+#define ART_MAP_MAX_PREFIX_LEN 8
+
+enum art_map_node_type {
+	ART_MAP_NODE4,
+	ART_MAP_NODE16,
+	ART_MAP_NODE48,
+	ART_MAP_NODE256,
+	ART_MAP_LEAF,
+
+	MAX_ART_MAP_NODE_TYPE
+};
+
+TOID_DECLARE(struct art_map_node, ART_MAP_TYPE_OFFSET + 1);
+TOID_DECLARE(struct art_map_leaf, ART_MAP_TYPE_OFFSET + 5);
+
+/*
+ * Header of all inner nodes. Children point either to inner nodes or to
+ * leaves, both start with the type of the node.
+ */
+struct art_map_node {
+	uint8_t type;
+	uint8_t unused;
+	uint16_t num_children;
+	uint32_t prefix_len; /* length of the compressed path */
+	unsigned char prefix[ART_MAP_MAX_PREFIX_LEN];
+	TOID(struct art_map_leaf) leaf; /* key which ends in this node */
+};
+
+struct art_map_node4 {
+	struct art_map_node n;
+	unsigned char keys[4]; /* sorted */
+	TOID(struct art_map_node) children[4];
+};
+
+struct art_map_node16 {
+	struct art_map_node n;
+	unsigned char keys[16]; /* sorted */
+	TOID(struct art_map_node) children[16];
+};
+
+struct art_map_node48 {
+	struct art_map_node n;
+	unsigned char index[256]; /* 1-based index in children, 0 if empty */
+	TOID(struct art_map_node) children[48];
+};
+
+struct art_map_node256 {
+	struct art_map_node n;
+	TOID(struct art_map_node) children[256];
+};
+
+struct art_map_leaf {
+	uint8_t type;
+	PMEMoid value;
+	uint64_t key_size;
+	unsigned char key[];
+};
+
+struct art_map {
+	TOID(struct art_map_node) root;
+};
+
+struct art_map_range_args {
+	const unsigned char *min;
+	uint64_t min_size;
+	const unsigned char *max;
+	uint64_t max_size;
+	int (*cb)(const unsigned char *key, uint64_t key_size,
+			PMEMoid value, void *arg);
+	void *arg;
+};
+
+static const size_t art_map_node_size[MAX_ART_MAP_NODE_TYPE] = {
+	sizeof(struct art_map_node4),
+	sizeof(struct art_map_node16),
+	sizeof(struct art_map_node48),
+	sizeof(struct art_map_node256),
+	sizeof(struct art_map_leaf),
+};
+
+/* the number of children at which a node is replaced by a smaller one */
+static const unsigned art_map_shrink_at[MAX_ART_MAP_NODE_TYPE] = {
+	0, 3, 12, 37, 0
+};
+
+/* capacity of the inner nodes */
+static const unsigned art_map_capacity[MAX_ART_MAP_NODE_TYPE] = {
+	4, 16, 48, 256, 0
+};
+
+/*
+ * art_map_ctz -- (internal) returns the number of trailing zero bits
+ */
+static inline unsigned
+art_map_ctz(unsigned v)
+{
+#ifdef _MSC_VER
+	unsigned long i;
+	_BitScanForward(&i, v);
+	return (unsigned)i;
+#else
+	return (unsigned)__builtin_ctz(v);
+#endif
+}
+
+/*
+ * art_map_min -- (internal) returns the smaller of two sizes
+ */
+static inline uint64_t
+art_map_min(uint64_t a, uint64_t b)
+{
+	return a < b ? a : b;
+}
+
+/*
+ * art_map_is_leaf -- (internal) checks whether the node is a leaf
+ */
+static inline int
+art_map_is_leaf(TOID(struct art_map_node) node)
+{
+	return D_RO(node)->type == ART_MAP_LEAF;
+}
+
+/*
+ * art_map_as_leaf -- (internal) converts the node to a leaf
+ */
+static inline TOID(struct art_map_leaf)
+art_map_as_leaf(TOID(struct art_map_node) node)
+{
+	TOID(struct art_map_leaf) leaf;
+	TOID_ASSIGN(leaf, node.oid);
+
+	return leaf;
+}
+
+/*
+ * art_map_as_node -- (internal) converts the leaf to a node
+ */
+static inline TOID(struct art_map_node)
+art_map_as_node(TOID(struct art_map_leaf) leaf)
+{
+	TOID(struct art_map_node) node;
+	TOID_ASSIGN(node, leaf.oid);
+
+	return node;
+}
+
+/*
+ * art_map_leaf_matches -- (internal) checks whether the leaf has given key
+ */
+static int
+art_map_leaf_matches(TOID(struct art_map_leaf) leaf,
+	const unsigned char *key, uint64_t key_size)
+{
+	return !TOID_IS_NULL(leaf) && D_RO(leaf)->key_size == key_size &&
+		memcmp(D_RO(leaf)->key, key, key_size) == 0;
+}
+
+/*
+ * art_map_new_leaf -- (internal) allocates a new leaf
+ */
+static TOID(struct art_map_leaf)
+art_map_new_leaf(const unsigned char *key, uint64_t key_size, PMEMoid value)
+{
+	TOID(struct art_map_leaf) leaf;
+	TOID_ASSIGN(leaf, pmemobj_tx_alloc(sizeof(struct art_map_leaf) +
+		key_size, ART_MAP_TYPE_OFFSET + ART_MAP_LEAF + 1));
+
+	D_RW(leaf)->type = ART_MAP_LEAF;
+	D_RW(leaf)->value = value;
+	D_RW(leaf)->key_size = key_size;
+	memcpy(D_RW(leaf)->key, key, key_size);
+
+	return leaf;
+}
+
+/*
+ * art_map_new_node -- (internal) allocates a new, empty inner node
+ */
+static TOID(struct art_map_node)
+art_map_new_node(enum art_map_node_type type)
+{
+	TOID(struct art_map_node) node;
+	TOID_ASSIGN(node, pmemobj_tx_zalloc(art_map_node_size[type],
+		ART_MAP_TYPE_OFFSET + type + 1));
+
+	D_RW(node)->type = (uint8_t)type;
+
+	return node;
+}
+
+/*
+ * art_map_node16_find -- (internal) returns the index of the key in a node16,
+ *	or the number of children if there is no such key
+ */
+static inline unsigned
+art_map_node16_find(const struct art_map_node16 *n, unsigned char c)
+{
+	unsigned num = n->n.num_children;
+#ifdef ART_MAP_SSE2
+	__m128i cmp = _mm_cmpeq_epi8(_mm_set1_epi8((char)c),
+		_mm_loadu_si128((const __m128i *)n->keys));
+	unsigned mask = (unsigned)_mm_movemask_epi8(cmp) & ((1U << num) - 1);
+
+	return mask ? art_map_ctz(mask) : num;
+#else
+	for (unsigned i = 0; i < num; ++i)
+		if (n->keys[i] == c)
+			return i;
+
+	return num;
+#endif
+}
+
+/*
+ * art_map_node16_lower -- (internal) returns the number of keys in a node16
+ *	which are lower than the given one
+ */
+static inline unsigned
+art_map_node16_lower(const struct art_map_node16 *n, unsigned char c)
+{
+	unsigned num = n->n.num_children;
+#ifdef ART_MAP_SSE2
+	/* the comparison is signed, flip the top bits to compare unsigned */
+	__m128i bias = _mm_set1_epi8((char)0x80);
+	__m128i cmp = _mm_cmplt_epi8(
+		_mm_xor_si128(_mm_loadu_si128((const __m128i *)n->keys), bias),
+		_mm_xor_si128(_mm_set1_epi8((char)c), bias));
+	unsigned mask = (unsigned)_mm_movemask_epi8(cmp) & ((1U << num) - 1);
+
+	/* the keys are sorted, so the lower ones are all at the front */
+	return art_map_ctz(~mask);
+#else
+	unsigned i = 0;
+	while (i < num && n->keys[i] < c)
+		i++;
+
+	return i;
+#endif
+}
+
+/*
+ * art_map_find_child -- (internal) returns the slot of the child for given
+ *	byte of the key, NULL if there is no such child
+ */
+static TOID(struct art_map_node) *
+art_map_find_child(struct art_map_node *n, unsigned char c)
+{
+	switch (n->type) {
+		case ART_MAP_NODE4: {
+			struct art_map_node4 *n4 = (struct art_map_node4 *)n;
+			for (unsigned i = 0; i < n->num_children; ++i)
+				if (n4->keys[i] == c)
+					return &n4->children[i];
+			return NULL;
+		}
+		case ART_MAP_NODE16: {
+			struct art_map_node16 *n16 =
+				(struct art_map_node16 *)n;
+			unsigned i = art_map_node16_find(n16, c);
+			return i < n->num_children ? &n16->children[i] : NULL;
+		}
+		case ART_MAP_NODE48: {
+			struct art_map_node48 *n48 =
+				(struct art_map_node48 *)n;
+			return n48->index[c] ?
+				&n48->children[n48->index[c] - 1] : NULL;
+		}
+		case ART_MAP_NODE256: {
+			struct art_map_node256 *n256 =
+				(struct art_map_node256 *)n;
+			return TOID_IS_NULL(n256->children[c]) ?
+				NULL : &n256->children[c];
+		}
+		default:
+			assert(0);
+			return NULL;
+	}
+}
+
+/*
+ * art_map_child_at -- (internal) returns the i-th slot of the node in the key
+ *	order, NULL if the slot is empty. The byte of the key is stored in *c.
+ */
+static TOID(struct art_map_node) *
+art_map_child_at(struct art_map_node *n, unsigned i, unsigned char *c)
+{
+	switch (n->type) {
+		case ART_MAP_NODE4: {
+			struct art_map_node4 *n4 = (struct art_map_node4 *)n;
+			*c = n4->keys[i];
+			return &n4->children[i];
+		}
+		case ART_MAP_NODE16: {
+			struct art_map_node16 *n16 =
+				(struct art_map_node16 *)n;
+			*c = n16->keys[i];
+			return &n16->children[i];
+		}
+		case ART_MAP_NODE48: {
+			struct art_map_node48 *n48 =
+				(struct art_map_node48 *)n;
+			*c = (unsigned char)i;
+			return n48->index[i] ?
+				&n48->children[n48->index[i] - 1] : NULL;
+		}
+		case ART_MAP_NODE256: {
+			struct art_map_node256 *n256 =
+				(struct art_map_node256 *)n;
+			*c = (unsigned char)i;
+			return TOID_IS_NULL(n256->children[i]) ?
+				NULL : &n256->children[i];
+		}
+		default:
+			assert(0);
+			return NULL;
+	}
+}
+
+/*
+ * art_map_nslots -- (internal) returns the number of slots which have to be
+ *	visited by art_map_child_at to find all the children
+ */
+static inline unsigned
+art_map_nslots(const struct art_map_node *n)
+{
+	return n->type == ART_MAP_NODE4 || n->type == ART_MAP_NODE16 ?
+		n->num_children : 256;
+}
+
+/*
+ * art_map_minimum -- (internal) returns the leaf with the lowest key
+ */
+static TOID(struct art_map_leaf)
+art_map_minimum(TOID(struct art_map_node) node)
+{
+	unsigned char c;
+
+	while (!art_map_is_leaf(node)) {
+		struct art_map_node *n = D_RW(node);
+		if (!TOID_IS_NULL(n->leaf))
+			return n->leaf;
+
+		TOID(struct art_map_node) *child = NULL;
+		for (unsigned i = 0; child == NULL; ++i)
+			child = art_map_child_at(n, i, &c);
+
+		node = *child;
+	}
+
+	return art_map_as_leaf(node);
+}
+
+/*
+ * art_map_prefix_at -- (internal) returns i-th byte of the compressed path of
+ *	the node which starts at given depth
+ */
+static unsigned char
+art_map_prefix_at(TOID(struct art_map_node) node, uint64_t depth, uint64_t i)
+{
+	if (i < ART_MAP_MAX_PREFIX_LEN)
+		return D_RO(node)->prefix[i];
+
+	/* the rest of the path is the same for all the keys below the node */
+	return D_RO(art_map_minimum(node))->key[depth + i];
+}
+
+/*
+ * art_map_prefix_mismatch -- (internal) returns the length of the common part
+ *	of the compressed path of the node and the key
+ */
+static uint64_t
+art_map_prefix_mismatch(TOID(struct art_map_node) node,
+	const unsigned char *key, uint64_t key_size, uint64_t depth)
+{
+	uint64_t max = art_map_min(D_RO(node)->prefix_len, key_size - depth);
+	uint64_t i = 0;
+
+	while (i < max && art_map_prefix_at(node, depth, i) == key[depth + i])
+		i++;
+
+	return i;
+}
+
+/*
+ * art_map_check_prefix -- (internal) checks the stored part of the compressed
+ *	path of the node, the rest is verified by comparing the key in the leaf
+ */
+static int
+art_map_check_prefix(const struct art_map_node *n,
+	const unsigned char *key, uint64_t key_size, uint64_t depth)
+{
+	if (key_size - depth < n->prefix_len)
+		return 0;
+
+	uint64_t len = art_map_min(n->prefix_len, ART_MAP_MAX_PREFIX_LEN);
+
+	return memcmp(n->prefix, key + depth, len) == 0;
+}
+
+/*
+ * art_map_set_prefix -- (internal) sets the compressed path of the node
+ */
+static void
+art_map_set_prefix(struct art_map_node *n, const unsigned char *prefix,
+	uint64_t len)
+{
+	n->prefix_len = (uint32_t)len;
+	memcpy(n->prefix, prefix, art_map_min(len, ART_MAP_MAX_PREFIX_LEN));
+}
+
+/*
+ * art_map_put_child -- (internal) stores the child in a node which is not full,
+ *	only the slots which are changed are added to the transaction
+ */
+static void
+art_map_put_child(struct art_map_node *n, unsigned char c,
+	TOID(struct art_map_node) child)
+{
+	unsigned num = n->num_children;
+	assert(num < art_map_capacity[n->type]);
+
+	TX_ADD_DIRECT(&n->num_children);
+
+	switch (n->type) {
+		case ART_MAP_NODE4:
+		case ART_MAP_NODE16: {
+			unsigned char *keys;
+			TOID(struct art_map_node) *children;
+			unsigned pos = 0;
+			if (n->type == ART_MAP_NODE4) {
+				struct art_map_node4 *n4 =
+					(struct art_map_node4 *)n;
+				keys = n4->keys;
+				children = n4->children;
+				while (pos < num && keys[pos] < c)
+					pos++;
+			} else {
+				struct art_map_node16 *n16 =
+					(struct art_map_node16 *)n;
+				keys = n16->keys;
+				children = n16->children;
+				pos = art_map_node16_lower(n16, c);
+			}
+
+			/* shift the greater keys to make room for this one */
+			pmemobj_tx_add_range_direct(&keys[pos], num - pos + 1);
+			pmemobj_tx_add_range_direct(&children[pos],
+				(num - pos + 1) * sizeof(children[0]));
+			memmove(&keys[pos + 1], &keys[pos], num - pos);
+			memmove(&children[pos + 1], &children[pos],
+				(num - pos) * sizeof(children[0]));
+			keys[pos] = c;
+			children[pos] = child;
+			break;
+		}
+		case ART_MAP_NODE48: {
+			struct art_map_node48 *n48 =
+				(struct art_map_node48 *)n;
+			unsigned pos = 0;
+			while (!TOID_IS_NULL(n48->children[pos]))
+				pos++;
+
+			TX_ADD_DIRECT(&n48->children[pos]);
+			TX_ADD_DIRECT(&n48->index[c]);
+			n48->children[pos] = child;
+			n48->index[c] = (unsigned char)(pos + 1);
+			break;
+		}
+		case ART_MAP_NODE256: {
+			struct art_map_node256 *n256 =
+				(struct art_map_node256 *)n;
+			TX_ADD_DIRECT(&n256->children[c]);
+			n256->children[c] = child;
+			break;
+		}
+		default:
+			assert(0);
+	}
+
+	n->num_children++;
+}
+
+/*
+ * art_map_resize -- (internal) replaces the node with a node of another type
+ */
+static void
+art_map_resize(TOID(struct art_map_node) *ref, enum art_map_node_type type)
+{
+	TOID(struct art_map_node) old = *ref;
+	TOID(struct art_map_node) node = art_map_new_node(type);
+	struct art_map_node *o = D_RW(old);
+	struct art_map_node *n = D_RW(node);
+
+	n->prefix_len = o->prefix_len;
+	memcpy(n->prefix, o->prefix, sizeof(n->prefix));
+	n->leaf = o->leaf;
+
+	unsigned char c;
+	unsigned nslots = art_map_nslots(o);
+	for (unsigned i = 0; i < nslots; ++i) {
+		TOID(struct art_map_node) *child = art_map_child_at(o, i, &c);
+		if (child != NULL)
+			art_map_put_child(n, c, *child);
+	}
+
+	TX_ADD_DIRECT(ref);
+	*ref = node;
+	TX_FREE(old);
+}
+
+/*
+ * art_map_add_child -- (internal) adds a child to the node, which is replaced
+ *	by a bigger one if it's full
+ */
+static void
+art_map_add_child(TOID(struct art_map_node) *ref, unsigned char c,
+	TOID(struct art_map_node) child)
+{
+	struct art_map_node *n = D_RW(*ref);
+
+	if (n->num_children == art_map_capacity[n->type]) {
+		art_map_resize(ref, (enum art_map_node_type)(n->type + 1));
+		n = D_RW(*ref);
+	}
+
+	art_map_put_child(n, c, child);
+}
+
+/*
+ * art_map_attach -- (internal) puts the node (or leaf) with given key into
+ *	the node in which the key ends or below it
+ */
+static void
+art_map_attach(TOID(struct art_map_node) *ref, TOID(struct art_map_node) child,
+	const unsigned char *key, uint64_t key_size, uint64_t depth)
+{
+	if (depth == key_size) {
+		TX_ADD_FIELD(*ref, leaf);
+		D_RW(*ref)->leaf = art_map_as_leaf(child);
+	} else {
+		art_map_add_child(ref, key[depth], child);
+	}
+}
+
+/*
+ * art_map_compact -- (internal) shrinks the node after one of its children
+ *	was removed, a node4 with a single child is merged with it
+ */
+static void
+art_map_compact(TOID(struct art_map_node) *ref)
+{
+	TOID(struct art_map_node) node = *ref;
+	struct art_map_node *n = D_RW(node);
+
+	if (n->type != ART_MAP_NODE4) {
+		if (n->num_children == art_map_shrink_at[n->type])
+			art_map_resize(ref,
+				(enum art_map_node_type)(n->type - 1));
+		return;
+	}
+
+	if (n->num_children == 0) {
+		TX_ADD_DIRECT(ref);
+		*ref = art_map_as_node(n->leaf);
+		TX_FREE(node);
+		return;
+	}
+
+	if (n->num_children > 1 || !TOID_IS_NULL(n->leaf))
+		return;
+
+	struct art_map_node4 *n4 = (struct art_map_node4 *)n;
+	TOID(struct art_map_node) child = n4->children[0];
+
+	if (!art_map_is_leaf(child)) {
+		/* the path to the child is a part of its compressed path now */
+		struct art_map_node *c = D_RW(child);
+		unsigned char prefix[ART_MAP_MAX_PREFIX_LEN];
+		uint64_t len = art_map_min(n->prefix_len,
+			ART_MAP_MAX_PREFIX_LEN);
+
+		memcpy(prefix, n->prefix, len);
+		if (len < ART_MAP_MAX_PREFIX_LEN)
+			prefix[len++] = n4->keys[0];
+		if (len < ART_MAP_MAX_PREFIX_LEN)
+			memcpy(prefix + len, c->prefix, art_map_min(
+				ART_MAP_MAX_PREFIX_LEN - len, c->prefix_len));
+
+		TX_ADD_FIELD(child, prefix_len);
+		TX_ADD_FIELD(child, prefix);
+		c->prefix_len += n->prefix_len + 1;
+		memcpy(c->prefix, prefix, sizeof(prefix));
+	}
+
+	TX_ADD_DIRECT(ref);
+	*ref = child;
+	TX_FREE(node);
+}
+
+/*
+ * art_map_remove_child -- (internal) removes the child for given byte of
+ *	the key from the node
+ */
+static void
+art_map_remove_child(TOID(struct art_map_node) *ref, unsigned char c)
+{
+	struct art_map_node *n = D_RW(*ref);
+	unsigned num = n->num_children;
+
+	TX_ADD_DIRECT(&n->num_children);
+
+	switch (n->type) {
+		case ART_MAP_NODE4:
+		case ART_MAP_NODE16: {
+			unsigned char *keys;
+			TOID(struct art_map_node) *children;
+			unsigned pos;
+			if (n->type == ART_MAP_NODE4) {
+				struct art_map_node4 *n4 =
+					(struct art_map_node4 *)n;
+				keys = n4->keys;
+				children = n4->children;
+				pos = 0;
+				while (keys[pos] != c)
+					pos++;
+			} else {
+				struct art_map_node16 *n16 =
+					(struct art_map_node16 *)n;
+				keys = n16->keys;
+				children = n16->children;
+				pos = art_map_node16_find(n16, c);
+			}
+			assert(pos < num);
+
+			pmemobj_tx_add_range_direct(&keys[pos], num - pos);
+			pmemobj_tx_add_range_direct(&children[pos],
+				(num - pos) * sizeof(children[0]));
+			memmove(&keys[pos], &keys[pos + 1], num - pos - 1);
+			memmove(&children[pos], &children[pos + 1],
+				(num - pos - 1) * sizeof(children[0]));
+			children[num - 1] = TOID_NULL(struct art_map_node);
+			break;
+		}
+		case ART_MAP_NODE48: {
+			struct art_map_node48 *n48 =
+				(struct art_map_node48 *)n;
+			unsigned pos = n48->index[c] - 1;
+
+			TX_ADD_DIRECT(&n48->children[pos]);
+			TX_ADD_DIRECT(&n48->index[c]);
+			n48->children[pos] = TOID_NULL(struct art_map_node);
+			n48->index[c] = 0;
+			break;
+		}
+		case ART_MAP_NODE256: {
+			struct art_map_node256 *n256 =
+				(struct art_map_node256 *)n;
+			TX_ADD_DIRECT(&n256->children[c]);
+			n256->children[c] = TOID_NULL(struct art_map_node);
+			break;
+		}
+		default:
+			assert(0);
+	}
+
+	n->num_children--;
+
+	art_map_compact(ref);
+}
+
+/*
+ * art_map_create -- allocates a new art map instance
+ */
+int
+art_map_create(PMEMobjpool *pop, TOID(struct art_map) *map, void *arg)
+{
+	int ret = 0;
+
+	TX_BEGIN(pop) {
+		TX_ADD_DIRECT(map);
+		*map = TX_ZNEW(struct art_map);
+	} TX_ONABORT {
+		ret = 1;
+	} TX_END
+
+	return ret;
+}
+
+/*
+ * art_map_clear_node -- (internal) frees the node and all of its children
+ */
+static void
+art_map_clear_node(TOID(struct art_map_node) node)
+{
+	if (TOID_IS_NULL(node))
+		return;
+
+	if (!art_map_is_leaf(node)) {
+		struct art_map_node *n = D_RW(node);
+		unsigned char c;
+		unsigned nslots = art_map_nslots(n);
+
+		for (unsigned i = 0; i < nslots; ++i) {
+			TOID(struct art_map_node) *child =
+				art_map_child_at(n, i, &c);
+			if (child != NULL)
+				art_map_clear_node(*child);
+		}
+
+		if (!TOID_IS_NULL(n->leaf))
+			TX_FREE(n->leaf);
+	}
+
+	TX_FREE(node);
+}
+
+/*
+ * art_map_clear -- removes all elements from the map
+ */
+int
+art_map_clear(PMEMobjpool *pop, TOID(struct art_map) map)
+{
+	int ret = 0;
+
+	TX_BEGIN(pop) {
+		art_map_clear_node(D_RO(map)->root);
+
+		TX_ADD_FIELD(map, root);
+		D_RW(map)->root = TOID_NULL(struct art_map_node);
+	} TX_ONABORT {
+		ret = 1;
+	} TX_END
+
+	return ret;
+}
+
+/*
+ * art_map_destroy -- cleanups and frees art map instance
+ */
+int
+art_map_destroy(PMEMobjpool *pop, TOID(struct art_map) *map)
+{
+	int ret = 0;
+
+	TX_BEGIN(pop) {
+		art_map_clear(pop, *map);
+		TX_ADD_DIRECT(map);
+		TX_FREE(*map);
+		*map = TOID_NULL(struct art_map);
+	} TX_ONABORT {
+		ret = 1;
+	} TX_END
+
+	return ret;
+}
+
+/*
+ * art_map_insert_node -- (internal) inserts the key into the subtree
+ */
+static void
+art_map_insert_node(TOID(struct art_map_node) *ref,
+	const unsigned char *key, uint64_t key_size, uint64_t depth,
+	PMEMoid value)
+{
+	TOID(struct art_map_node) node = *ref;
+
+	if (TOID_IS_NULL(node)) {
+		TX_ADD_DIRECT(ref);
+		*ref = art_map_as_node(art_map_new_leaf(key, key_size, value));
+		return;
+	}
+
+	if (art_map_is_leaf(node)) {
+		TOID(struct art_map_leaf) leaf = art_map_as_leaf(node);
+		if (art_map_leaf_matches(leaf, key, key_size)) {
+			TX_ADD_FIELD(leaf, value);
+			D_RW(leaf)->value = value;
+			return;
+		}
+
+		/* replace the leaf by a node with the common part as prefix */
+		const unsigned char *lkey = D_RO(leaf)->key;
+		uint64_t lkey_size = D_RO(leaf)->key_size;
+		uint64_t max = art_map_min(lkey_size, key_size) - depth;
+		uint64_t len = 0;
+		while (len < max && lkey[depth + len] == key[depth + len])
+			len++;
+
+		TOID(struct art_map_node) n = art_map_new_node(ART_MAP_NODE4);
+		art_map_set_prefix(D_RW(n), key + depth, len);
+		art_map_attach(&n, node, lkey, lkey_size, depth + len);
+		art_map_attach(&n, art_map_as_node(art_map_new_leaf(key,
+			key_size, value)), key, key_size, depth + len);
+
+		TX_ADD_DIRECT(ref);
+		*ref = n;
+		return;
+	}
+
+	struct art_map_node *n = D_RW(node);
+
+	if (n->prefix_len != 0) {
+		uint64_t len = art_map_prefix_mismatch(node, key, key_size,
+			depth);
+
+		if (len < n->prefix_len) {
+			/* split the compressed path where the key diverges */
+			TOID(struct art_map_node) split =
+				art_map_new_node(ART_MAP_NODE4);
+			art_map_set_prefix(D_RW(split), key + depth, len);
+
+			unsigned char c = art_map_prefix_at(node, depth, len);
+			uint64_t rest = n->prefix_len - len - 1;
+			unsigned char prefix[ART_MAP_MAX_PREFIX_LEN];
+			for (uint64_t i = 0; i < art_map_min(rest,
+					ART_MAP_MAX_PREFIX_LEN); ++i)
+				prefix[i] = art_map_prefix_at(node, depth,
+					len + 1 + i);
+
+			TX_ADD_FIELD(node, prefix_len);
+			TX_ADD_FIELD(node, prefix);
+			art_map_set_prefix(n, prefix, rest);
+
+			art_map_add_child(&split, c, node);
+			art_map_attach(&split, art_map_as_node(
+				art_map_new_leaf(key, key_size, value)),
+				key, key_size, depth + len);
+
+			TX_ADD_DIRECT(ref);
+			*ref = split;
+			return;
+		}
+
+		depth += n->prefix_len;
+	}
+
+	if (depth == key_size) {
+		if (TOID_IS_NULL(n->leaf)) {
+			TX_ADD_FIELD(node, leaf);
+			n->leaf = art_map_new_leaf(key, key_size, value);
+		} else {
+			TX_ADD_FIELD(n->leaf, value);
+			D_RW(n->leaf)->value = value;
+		}
+		return;
+	}
+
+	TOID(struct art_map_node) *child = art_map_find_child(n, key[depth]);
+	if (child != NULL) {
+		art_map_insert_node(child, key, key_size, depth + 1, value);
+		return;
+	}
+
+	art_map_add_child(ref, key[depth],
+		art_map_as_node(art_map_new_leaf(key, key_size, value)));
+}
+
+/*
+ * art_map_is_empty -- checks whether the map is empty
+ */
+int
+art_map_is_empty(PMEMobjpool *pop, TOID(struct art_map) map)
+{
+	return TOID_IS_NULL(D_RO(map)->root);
+}
+
+/*
+ * art_map_insert -- inserts a new key-value pair into the map, the value of
+ *	an existing key is replaced
+ */
+int
+art_map_insert(PMEMobjpool *pop, TOID(struct art_map) map,
+	const unsigned char *key, uint64_t key_size, PMEMoid value)
+{
+	int ret = 0;
+
+	TX_BEGIN(pop) {
+		art_map_insert_node(&D_RW(map)->root, key, key_size, 0, value);
+	} TX_ONABORT {
+		ret = 1;
+	} TX_END
+
+	return ret;
+}
+
+/*
+ * art_map_insert_new -- allocates a new object and inserts it into the map
+ */
+int
+art_map_insert_new(PMEMobjpool *pop, TOID(struct art_map) map,
+		const unsigned char *key, uint64_t key_size,
+		size_t size, unsigned type_num,
+		void (*constructor)(PMEMobjpool *pop, void *ptr, void *arg),
+		void *arg)
+{
+	int ret = 0;
+
+	TX_BEGIN(pop) {
+		PMEMoid n = pmemobj_tx_alloc(size, type_num);
+		constructor(pop, pmemobj_direct(n), arg);
+		art_map_insert(pop, map, key, key_size, n);
+	} TX_ONABORT {
+		ret = 1;
+	} TX_END
+
+	return ret;
+}
+
+/*
+ * art_map_remove_node -- (internal) removes the key from the subtree,
+ *	returns 1 if the key was found
+ */
+static int
+art_map_remove_node(TOID(struct art_map_node) *ref,
+	const unsigned char *key, uint64_t key_size, uint64_t depth,
+	PMEMoid *value)
+{
+	TOID(struct art_map_node) node = *ref;
+
+	if (TOID_IS_NULL(node))
+		return 0;
+
+	if (art_map_is_leaf(node)) {
+		TOID(struct art_map_leaf) leaf = art_map_as_leaf(node);
+		if (!art_map_leaf_matches(leaf, key, key_size))
+			return 0;
+
+		*value = D_RO(leaf)->value;
+		TX_ADD_DIRECT(ref);
+		*ref = TOID_NULL(struct art_map_node);
+		TX_FREE(leaf);
+
+		return 1;
+	}
+
+	struct art_map_node *n = D_RW(node);
+
+	if (!art_map_check_prefix(n, key, key_size, depth))
+		return 0;
+
+	depth += n->prefix_len;
+
+	if (depth == key_size) {
+		if (!art_map_leaf_matches(n->leaf, key, key_size))
+			return 0;
+
+		*value = D_RO(n->leaf)->value;
+		TX_FREE(n->leaf);
+		TX_ADD_FIELD(node, leaf);
+		n->leaf = TOID_NULL(struct art_map_leaf);
+		art_map_compact(ref);
+
+		return 1;
+	}
+
+	TOID(struct art_map_node) *child = art_map_find_child(n, key[depth]);
+	if (child == NULL ||
+	    !art_map_remove_node(child, key, key_size, depth + 1, value))
+		return 0;
+
+	if (TOID_IS_NULL(*child))
+		art_map_remove_child(ref, key[depth]);
+
+	return 1;
+}
+
+/*
+ * art_map_remove -- removes key-value pair from the map
+ */
+PMEMoid
+art_map_remove(PMEMobjpool *pop, TOID(struct art_map) map,
+		const unsigned char *key, uint64_t key_size)
+{
+	PMEMoid ret = OID_NULL;
+
+	TX_BEGIN(pop) {
+		art_map_remove_node(&D_RW(map)->root, key, key_size, 0, &ret);
+	} TX_END
+
+	return ret;
+}
+
+/*
+ * art_map_remove_free -- removes and frees an object from the map
+ */
+int
+art_map_remove_free(PMEMobjpool *pop, TOID(struct art_map) map,
+		const unsigned char *key, uint64_t key_size)
+{
+	int ret = 0;
+
+	TX_BEGIN(pop) {
+		pmemobj_tx_free(art_map_remove(pop, map, key, key_size));
+	} TX_ONABORT {
+		ret = 1;
+	} TX_END
+
+	return ret;
+}
+
+/*
+ * art_map_search -- (internal) returns the leaf with given key
+ */
+static TOID(struct art_map_leaf)
+art_map_search(TOID(struct art_map) map, const unsigned char *key,
+	uint64_t key_size)
+{
+	TOID(struct art_map_node) node = D_RO(map)->root;
+	uint64_t depth = 0;
+
+	while (!TOID_IS_NULL(node)) {
+		if (art_map_is_leaf(node))
+			break;
+
+		struct art_map_node *n = D_RW(node);
+		if (!art_map_check_prefix(n, key, key_size, depth))
+			return TOID_NULL(struct art_map_leaf);
+
+		depth += n->prefix_len;
+		if (depth == key_size)
+			return art_map_leaf_matches(n->leaf, key, key_size) ?
+				n->leaf : TOID_NULL(struct art_map_leaf);
+
+		TOID(struct art_map_node) *child =
+			art_map_find_child(n, key[depth]);
+		if (child == NULL)
+			return TOID_NULL(struct art_map_leaf);
+
+		node = *child;
+		depth++;
+	}
+
+	TOID(struct art_map_leaf) leaf = art_map_as_leaf(node);
+
+	return art_map_leaf_matches(leaf, key, key_size) ?
+		leaf : TOID_NULL(struct art_map_leaf);
+}
+
+/*
+ * art_map_get -- searches for a value of the key
+ */
+PMEMoid
+art_map_get(PMEMobjpool *pop, TOID(struct art_map) map,
+		const unsigned char *key, uint64_t key_size)
+{
+	TOID(struct art_map_leaf) leaf = art_map_search(map, key, key_size);
+
+	return TOID_IS_NULL(leaf) ? OID_NULL : D_RO(leaf)->value;
+}
+
+/*
+ * art_map_lookup -- searches if key exists
+ */
+int
+art_map_lookup(PMEMobjpool *pop, TOID(struct art_map) map,
+		const unsigned char *key, uint64_t key_size)
+{
+	return !TOID_IS_NULL(art_map_search(map, key, key_size));
+}
+
+/*
+ * art_map_foreach_node -- (internal) traverses the subtree in the key order
+ */
+static int
+art_map_foreach_node(TOID(struct art_map_node) node,
+	int (*cb)(const unsigned char *key, uint64_t key_size,
+			PMEMoid, void *arg),
+	void *arg)
+{
+	if (TOID_IS_NULL(node))
+		return 0;
+
+	if (art_map_is_leaf(node)) {
+		const struct art_map_leaf *l = D_RO(art_map_as_leaf(node));
+		return cb(l->key, l->key_size, l->value, arg);
+	}
+
+	struct art_map_node *n = D_RW(node);
+	if (art_map_foreach_node(art_map_as_node(n->leaf), cb, arg))
+		return 1;
+
+	unsigned char c;
+	unsigned nslots = art_map_nslots(n);
+	for (unsigned i = 0; i < nslots; ++i) {
+		TOID(struct art_map_node) *child = art_map_child_at(n, i, &c);
+		if (child != NULL && art_map_foreach_node(*child, cb, arg))
+			return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * art_map_foreach -- calls cb for all key-value pairs in the key order
+ */
+int
+art_map_foreach(PMEMobjpool *pop, TOID(struct art_map) map,
+	int (*cb)(const unsigned char *key, uint64_t key_size,
+			PMEMoid value, void *arg),
+	void *arg)
+{
+	return art_map_foreach_node(D_RO(map)->root, cb, arg);
+}
+
+/*
+ * art_map_key_cmp -- (internal) compares two keys in the lexicographic order
+ */
+static int
+art_map_key_cmp(const unsigned char *k1, uint64_t s1,
+	const unsigned char *k2, uint64_t s2)
+{
+	int ret = memcmp(k1, k2, art_map_min(s1, s2));
+	if (ret != 0)
+		return ret;
+
+	return s1 < s2 ? -1 : s1 > s2;
+}
+
+/*
+ * art_map_path_cmp -- (internal) compares the path with the part of the key
+ *	of the same length, a key which ends within the path is lower
+ */
+static int
+art_map_path_cmp(const unsigned char *path, uint64_t len,
+	const unsigned char *key, uint64_t key_size)
+{
+	int ret = memcmp(path, key, art_map_min(len, key_size));
+	if (ret != 0)
+		return ret;
+
+	return key_size < len;
+}
+
+/*
+ * art_map_range_node -- (internal) traverses the subtree in the key order,
+ *	calling the callback for the keys from the [min, max] range
+ *
+ * The part of the path to the node shared with min (or max) is tracked by
+ * lo (or hi), the children which are entirely outside of the range are
+ * skipped without being visited. Returns -1 once a key above max is reached.
+ */
+static int
+art_map_range_node(TOID(struct art_map_node) node, uint64_t depth,
+	const struct art_map_range_args *r, int lo, int hi)
+{
+	if (TOID_IS_NULL(node))
+		return 0;
+
+	if (art_map_is_leaf(node)) {
+		const struct art_map_leaf *l = D_RO(art_map_as_leaf(node));
+		if (art_map_key_cmp(l->key, l->key_size,
+				r->max, r->max_size) > 0)
+			return -1;
+
+		if (art_map_key_cmp(l->key, l->key_size,
+				r->min, r->min_size) < 0)
+			return 0;
+
+		return r->cb(l->key, l->key_size, l->value, r->arg) != 0;
+	}
+
+	struct art_map_node *n = D_RW(node);
+
+	if (n->prefix_len != 0 && (lo || hi)) {
+		const unsigned char *path =
+			D_RO(art_map_minimum(node))->key + depth;
+
+		if (lo) {
+			int cmp = art_map_path_cmp(path, n->prefix_len,
+				r->min + depth, r->min_size - depth);
+			if (cmp < 0)
+				return 0;
+			lo = cmp == 0;
+		}
+
+		if (hi) {
+			int cmp = art_map_path_cmp(path, n->prefix_len,
+				r->max + depth, r->max_size - depth);
+			if (cmp > 0)
+				return -1;
+			hi = cmp == 0;
+		}
+	}
+
+	depth += n->prefix_len;
+
+	int ret = art_map_range_node(art_map_as_node(n->leaf), depth, r,
+		lo, hi);
+	if (ret != 0)
+		return ret;
+
+	/* all the children are longer than the path to them */
+	lo = lo && depth < r->min_size;
+	if (hi && depth == r->max_size)
+		return -1;
+
+	unsigned char c;
+	unsigned nslots = art_map_nslots(n);
+	for (unsigned i = 0; i < nslots; ++i) {
+		TOID(struct art_map_node) *child = art_map_child_at(n, i, &c);
+		if (child == NULL || (lo && c < r->min[depth]))
+			continue;
+
+		if (hi && c > r->max[depth])
+			return -1;
+
+		ret = art_map_range_node(*child, depth + 1, r,
+			lo && c == r->min[depth], hi && c == r->max[depth]);
+		if (ret != 0)
+			return ret;
+	}
+
+	return 0;
+}
+
+/*
+ * art_map_range -- calls cb for all keys from the [min, max] range in the key
+ *	order
+ */
+int
+art_map_range(PMEMobjpool *pop, TOID(struct art_map) map,
+	const unsigned char *min, uint64_t min_size,
+	const unsigned char *max, uint64_t max_size,
+	int (*cb)(const unsigned char *key, uint64_t key_size,
+			PMEMoid value, void *arg),
+	void *arg)
+{
+	struct art_map_range_args r = {
+		min, min_size, max, max_size, cb, arg
+	};
+
+	return art_map_range_node(D_RO(map)->root, 0, &r, 1, 1) > 0;
+}
+
+/*
+ * art_map_check -- check if given persistent object is an art map
+ */
+int
+art_map_check(PMEMobjpool *pop, TOID(struct art_map) map)
+{
+	return TOID_IS_NULL(map) || !TOID_VALID(map);
+}
@@ -0,0 +1,630 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * bptree_map.c -- B+tree with configurable node size
+ *
+ * All key-value pairs are stored in the leaves, internal nodes only hold
+ * separator keys. Within a node, the keys are kept in a contiguous array that
+ * is separate from the values (or child pointers), so that a search within a
+ * node touches as few cache lines as possible and small nodes can be scanned
+ * with a branchless, vectorizable loop. The leaves are linked into a list,
+ * which makes in-order traversal a simple walk over the leaf level.
+ *
+ * Nodes are split preemptively on the way down during insertion. On removal
+ * the nodes are not rebalanced, leaves are allowed to become underfull or
+ * even empty, which keeps deletions cheap.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include "bptree_map.h"
+
+TOID_DECLARE(struct bptree_map_node, BPTREE_MAP_TYPE_OFFSET + 1);
+
+/* nodes with up to this many keys are searched linearly */
+#define BPTREE_LINEAR_SEARCH_MAX 16
+
+struct bptree_map_node {
+	uint32_t n; /* number of occupied key slots */
+	uint32_t leaf; /* nonzero if the node is a leaf */
+	TOID(struct bptree_map_node) next; /* right sibling of a leaf */
+
+	/*
+	 * Followed by 'order' keys and 'order + 1' slots, which in internal
+	 * nodes point to the children and in leaves contain the values.
+	 */
+	uint64_t keys[];
+};
+
+struct bptree_map {
+	uint64_t node_size; /* size of a single node, in bytes */
+	uint64_t order; /* maximum number of keys in a node */
+	TOID(struct bptree_map_node) root;
+};
+
+/*
+ * bptree_map_node_slots -- (internal) returns the slots array of the node
+ */
+static inline PMEMoid *
+bptree_map_node_slots(const struct bptree_map *map,
+	const struct bptree_map_node *node)
+{
+	return (PMEMoid *)&node->keys[map->order];
+}
+
+/*
+ * bptree_map_order -- (internal) calculates how many keys fit in a node
+ */
+static uint64_t
+bptree_map_order(size_t node_size)
+{
+	return (node_size - sizeof(struct bptree_map_node) - sizeof(PMEMoid)) /
+		(sizeof(uint64_t) + sizeof(PMEMoid));
+}
+
+/*
+ * bptree_map_count_less -- (internal) returns the number of keys in the node
+ *	that are less than (or equal to, if 'inclusive' is set) the given key
+ */
+static uint32_t
+bptree_map_count_less(const struct bptree_map_node *node, uint64_t key,
+	int inclusive)
+{
+	const uint64_t *keys = node->keys;
+	uint32_t n = node->n;
+
+	if (inclusive) {
+		if (key == UINT64_MAX)
+			return n;
+		key += 1;
+	}
+
+	if (n <= BPTREE_LINEAR_SEARCH_MAX) {
+		uint32_t cnt = 0;
+		for (uint32_t i = 0; i < n; ++i)
+			cnt += keys[i] < key;
+
+		return cnt;
+	}
+
+	uint32_t lo = 0;
+	uint32_t hi = n;
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		if (keys[mid] < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/*
+ * bptree_map_child -- (internal) returns the index of the child of an
+ *	internal node that can contain the given key
+ */
+static inline uint32_t
+bptree_map_child(const struct bptree_map_node *node, uint64_t key)
+{
+	return bptree_map_count_less(node, key, 1);
+}
+
+/*
+ * bptree_map_node_add -- (internal) snapshots the header of the node and the
+ *	given ranges of keys and slots
+ */
+static void
+bptree_map_node_add(const struct bptree_map *map, struct bptree_map_node *node,
+	uint32_t kfirst, uint32_t klast, uint32_t sfirst, uint32_t slast)
+{
+	pmemobj_tx_add_range_direct(node, sizeof(*node));
+
+	if (klast > kfirst)
+		pmemobj_tx_add_range_direct(&node->keys[kfirst],
+			sizeof(uint64_t) * (klast - kfirst));
+
+	if (slast > sfirst)
+		pmemobj_tx_add_range_direct(
+			&bptree_map_node_slots(map, node)[sfirst],
+			sizeof(PMEMoid) * (slast - sfirst));
+}
+
+/*
+ * bptree_map_node_new -- (internal) allocates a new, empty node
+ */
+static struct bptree_map_node *
+bptree_map_node_new(const struct bptree_map *map, int leaf, PMEMoid *oid)
+{
+	*oid = pmemobj_tx_alloc(map->node_size,
+		TOID_TYPE_NUM(struct bptree_map_node));
+
+	struct bptree_map_node *node = pmemobj_direct(*oid);
+	node->n = 0;
+	node->leaf = leaf ? 1 : 0;
+	TOID_ASSIGN(node->next, OID_NULL);
+
+	return node;
+}
+
+/*
+ * bptree_map_create -- allocates a new B+tree instance
+ */
+int
+bptree_map_create(PMEMobjpool *pop, TOID(struct bptree_map) *map, void *arg)
+{
+	struct bptree_map_args *args = arg;
+	size_t node_size = args ? args->node_size :
+		BPTREE_MAP_DEFAULT_NODE_SIZE;
+
+	if (node_size < BPTREE_MAP_MIN_NODE_SIZE ||
+			node_size > BPTREE_MAP_MAX_NODE_SIZE) {
+		errno = EINVAL;
+		return 1;
+	}
+
+	int ret = 0;
+
+	TX_BEGIN(pop) {
+		pmemobj_tx_add_range_direct(map, sizeof(*map));
+		*map = TX_ZNEW(struct bptree_map);
+		D_RW(*map)->node_size = node_size;
+		D_RW(*map)->order = bptree_map_order(node_size);
+	} TX_ONABORT {
+		ret = 1;
+	} TX_END
+
+	return ret;
+}
+
+/*
+ * bptree_map_clear_node -- (internal) frees the node and all of its children
+ */
+static void
+bptree_map_clear_node(const struct bptree_map *map, PMEMoid oid)
+{
+	struct bptree_map_node *node = pmemobj_direct(oid);
+
+	if (!node->leaf) {
+		PMEMoid *slots = bptree_map_node_slots(map, node);
+		for (uint32_t i = 0; i <= node->n; ++i)
+			bptree_map_clear_node(map, slots[i]);
+	}
+
+	pmemobj_tx_free(oid);
+}
+
+/*
+ * bptree_map_clear -- removes all elements from the map
+ */
+int
+bptree_map_clear(PMEMobjpool *pop, TOID(struct bptree_map) map)
+{
+	int ret = 0;
+
+	TX_BEGIN(pop) {
+		if (!TOID_IS_NULL(D_RO(map)->root))
+			bptree_map_clear_node(D_RO(map),
+				D_RO(map)->root.oid);
+
+		TX_ADD_FIELD(map, root);
+		D_RW(map)->root = TOID_NULL(struct bptree_map_node);
+	} TX_ONABORT {
+		ret = 1;
+	} TX_END
+
+	return ret;
+}
+
+/*
+ * bptree_map_destroy -- cleanups and frees B+tree instance
+ */
+int
+bptree_map_destroy(PMEMobjpool *pop, TOID(struct bptree_map) *map)
+{
+	int ret = 0;
+
+	TX_BEGIN(pop) {
+		bptree_map_clear(pop, *map);
+		pmemobj_tx_add_range_direct(map, sizeof(*map));
+		TX_FREE(*map);
+		*map = TOID_NULL(struct bptree_map);
+	} TX_ONABORT {
+		ret = 1;
+	} TX_END
+
+	return ret;
+}
+
+/*
+ * bptree_map_split_child -- (internal) splits the full i-th child of
+ *	the parent node, the parent node itself must not be full
+ */
+static void
+bptree_map_split_child(const struct bptree_map *map,
+	struct bptree_map_node *parent, uint32_t i)
+{
+	PMEMoid *pslots = bptree_map_node_slots(map, parent);
+	struct bptree_map_node *left = pmemobj_direct(pslots[i]);
+	PMEMoid *lslots = bptree_map_node_slots(map, left);
+
+	PMEMoid roid;
+	struct bptree_map_node *right =
+		bptree_map_node_new(map, left->leaf, &roid);
+	PMEMoid *rslots = bptree_map_node_slots(map, right);
+
+	uint64_t separator;
+	uint32_t nleft;
+
+	if (left->leaf) {
+		/* the separator is copied up, it stays in the right leaf */
+		nleft = left->n / 2;
+		right->n = left->n - nleft;
+		memcpy(right->keys, &left->keys[nleft],
+			sizeof(uint64_t) * right->n);
+		memcpy(rslots, &lslots[nleft], sizeof(PMEMoid) * right->n);
+		separator = right->keys[0];
+
+		right->next = left->next;
+		pmemobj_tx_add_range_direct(left, sizeof(*left));
+		TOID_ASSIGN(left->next, roid);
+	} else {
+		/* the separator is moved up */
+		nleft = left->n / 2;
+		separator = left->keys[nleft];
+		right->n = left->n - nleft - 1;
+		memcpy(right->keys, &left->keys[nleft + 1],
+			sizeof(uint64_t) * right->n);
+		memcpy(rslots, &lslots[nleft + 1],
+			sizeof(PMEMoid) * (right->n + 1));
+
+		pmemobj_tx_add_range_direct(left, sizeof(*left));
+	}
+
+	left->n = nleft;
+
+	/* make room for the separator and the new child in the parent */
+	bptree_map_node_add(map, parent, i, parent->n + 1,
+		i + 1, parent->n + 2);
+	memmove(&parent->keys[i + 1], &parent->keys[i],
+		sizeof(uint64_t) * (parent->n - i));
+	memmove(&pslots[i + 2], &pslots[i + 1],
+		sizeof(PMEMoid) * (parent->n - i));
+	parent->keys[i] = separator;
+	pslots[i + 1] = roid;
+	parent->n += 1;
+}
+
+/*
+ * bptree_map_insert_leaf -- (internal) inserts or replaces the key-value pair
+ *	in a leaf that is not full
+ */
+static void
+bptree_map_insert_leaf(const struct bptree_map *map,
+	struct bptree_map_node *leaf, uint64_t key, PMEMoid value)
+{
+	PMEMoid *values = bptree_map_node_slots(map, leaf);
+	uint32_t pos = bptree_map_count_less(leaf, key, 0);
+
+	if (pos < leaf->n && leaf->keys[pos] == key) {
+		pmemobj_tx_add_range_direct(&values[pos], sizeof(PMEMoid));
+		values[pos] = value;
+		return;
+	}
+
+	bptree_map_node_add(map, leaf, pos, leaf->n + 1, pos, leaf->n + 1);
+	memmove(&leaf->keys[pos + 1], &leaf->keys[pos],
+		sizeof(uint64_t) * (leaf->n - pos));
+	memmove(&values[pos + 1], &values[pos],
+		sizeof(PMEMoid) * (leaf->n - pos));
+	leaf->keys[pos] = key;
+	values[pos] = value;
+	leaf->n += 1;
+}
+
+/*
+ * bptree_map_insert -- inserts a new key-value pair into the map, the value of
+ *	an already existing key is replaced
+ */
+int
+bptree_map_insert(PMEMobjpool *pop, TOID(struct bptree_map) map,
+	uint64_t key, PMEMoid value)
+{
+	int ret = 0;
+
+	TX_BEGIN(pop) {
+		const struct bptree_map *m = D_RO(map);
+		PMEMoid oid;
+		struct bptree_map_node *node;
+
+		if (TOID_IS_NULL(m->root)) {
+			node = bptree_map_node_new(m, 1, &oid);
+			TX_ADD_FIELD(map, root);
+			TOID_ASSIGN(D_RW(map)->root, oid);
+		} else if (D_RO(m->root)->n == m->order) {
+			/* the root is full, the tree grows in height */
+			node = bptree_map_node_new(m, 0, &oid);
+			bptree_map_node_slots(m, node)[0] = m->root.oid;
+			bptree_map_split_child(m, node, 0);
+			TX_ADD_FIELD(map, root);
+			TOID_ASSIGN(D_RW(map)->root, oid);
+		} else {
+			node = pmemobj_direct(m->root.oid);
+		}
+
+		while (!node->leaf) {
+			uint32_t i = bptree_map_child(node, key);
+			PMEMoid *slots = bptree_map_node_slots(m, node);
+			struct bptree_map_node *child =
+				pmemobj_direct(slots[i]);
+
+			if (child->n == m->order) {
+				bptree_map_split_child(m, node, i);
+				if (key >= node->keys[i])
+					i += 1;
+				child = pmemobj_direct(slots[i]);
+			}
+
+			node = child;
+		}
+
+		bptree_map_insert_leaf(m, node, key, value);
+	} TX_ONABORT {
+		ret = 1;
+	} TX_END
+
+	return ret;
+}
+
+/*
+ * bptree_map_find_leaf -- (internal) returns the leaf that can contain the key
+ */
+static struct bptree_map_node *
+bptree_map_find_leaf(const struct bptree_map *map, uint64_t key)
+{
+	if (TOID_IS_NULL(map->root))
+		return NULL;
+
+	struct bptree_map_node *node = pmemobj_direct(map->root.oid);
+	while (!node->leaf) {
+		uint32_t i = bptree_map_child(node, key);
+		node = pmemobj_direct(bptree_map_node_slots(map, node)[i]);
+	}
+
+	return node;
+}
+
+/*
+ * bptree_map_find -- (internal) returns the position of the key in the leaf
+ *	or -1 if it's not there
+ */
+static int
+bptree_map_find(const struct bptree_map_node *leaf, uint64_t key)
+{
+	uint32_t pos = bptree_map_count_less(leaf, key, 0);
+	if (pos < leaf->n && leaf->keys[pos] == key)
+		return (int)pos;
+
+	return -1;
+}
+
+/*
+ * bptree_map_remove -- removes key-value pair from the map
+ */
+PMEMoid
+bptree_map_remove(PMEMobjpool *pop, TOID(struct bptree_map) map, uint64_t key)
+{
+	PMEMoid ret = OID_NULL;
+
+	TX_BEGIN(pop) {
+		const struct bptree_map *m = D_RO(map);
+		struct bptree_map_node *leaf = bptree_map_find_leaf(m, key);
+		int pos = leaf ? bptree_map_find(leaf, key) : -1;
+
+		if (pos >= 0) {
+			uint32_t p = (uint32_t)pos;
+			PMEMoid *values = bptree_map_node_slots(m, leaf);
+			ret = values[p];
+
+			bptree_map_node_add(m, leaf, p, leaf->n, p, leaf->n);
+			memmove(&leaf->keys[p], &leaf->keys[p + 1],
+				sizeof(uint64_t) * (leaf->n - p - 1));
+			memmove(&values[p], &values[p + 1],
+				sizeof(PMEMoid) * (leaf->n - p - 1));
+			leaf->n -= 1;
+		}
+	} TX_END
+
+	return ret;
+}
+
+/*
+ * bptree_map_get -- searches for a value of the key
+ */
+PMEMoid
+bptree_map_get(PMEMobjpool *pop, TOID(struct bptree_map) map, uint64_t key)
+{
+	const struct bptree_map *m = D_RO(map);
+	struct bptree_map_node *leaf = bptree_map_find_leaf(m, key);
+	if (leaf == NULL)
+		return OID_NULL;
+
+	int pos = bptree_map_find(leaf, key);
+	if (pos < 0)
+		return OID_NULL;
+
+	return bptree_map_node_slots(m, leaf)[pos];
+}
+
+/*
+ * bptree_map_lookup -- searches if key exists
+ */
+int
+bptree_map_lookup(PMEMobjpool *pop, TOID(struct bptree_map) map, uint64_t key)
+{
+	struct bptree_map_node *leaf = bptree_map_find_leaf(D_RO(map), key);
+
+	return leaf != NULL && bptree_map_find(leaf, key) >= 0;
+}
+
+/*
+ * bptree_map_first_leaf -- (internal) returns the leftmost leaf
+ */
+static struct bptree_map_node *
+bptree_map_first_leaf(const struct bptree_map *map)
+{
+	if (TOID_IS_NULL(map->root))
+		return NULL;
+
+	struct bptree_map_node *node = pmemobj_direct(map->root.oid);
+	while (!node->leaf)
+		node = pmemobj_direct(bptree_map_node_slots(map, node)[0]);
+
+	return node;
+}
+
+/*
+ * bptree_map_foreach -- walks the leaf level in the key order
+ */
+int
+bptree_map_foreach(PMEMobjpool *pop, TOID(struct bptree_map) map,
+	int (*cb)(uint64_t key, PMEMoid value, void *arg), void *arg)
+{
+	const struct bptree_map *m = D_RO(map);
+
+	for (struct bptree_map_node *leaf = bptree_map_first_leaf(m);
+			leaf != NULL; leaf = D_RW(leaf->next)) {
+		PMEMoid *values = bptree_map_node_slots(m, leaf);
+		for (uint32_t i = 0; i < leaf->n; ++i) {
+			if (cb(leaf->keys[i], values[i], arg) != 0)
+				return 1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * bptree_map_range -- walks the leaf level in the key order, starting from
+ *	the leaf that can contain min and stopping at the first key above max
+ */
+int
+bptree_map_range(PMEMobjpool *pop, TOID(struct bptree_map) map,
+	uint64_t min, uint64_t max,
+	int (*cb)(uint64_t key, PMEMoid value, void *arg), void *arg)
+{
+	const struct bptree_map *m = D_RO(map);
+	struct bptree_map_node *leaf = bptree_map_find_leaf(m, min);
+	if (leaf == NULL)
+		return 0;
+
+	uint32_t i = bptree_map_count_less(leaf, min, 0);
+	for (; leaf != NULL; leaf = D_RW(leaf->next), i = 0) {
+		PMEMoid *values = bptree_map_node_slots(m, leaf);
+		for (; i < leaf->n; ++i) {
+			if (leaf->keys[i] > max)
+				return 0;
+
+			if (cb(leaf->keys[i], values[i], arg) != 0)
+				return 1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * bptree_map_is_empty -- checks whether the tree map is empty
+ */
+int
+bptree_map_is_empty(PMEMobjpool *pop, TOID(struct bptree_map) map)
+{
+	/* leaves are not merged on removal, so there might be empty ones */
+	for (struct bptree_map_node *leaf = bptree_map_first_leaf(D_RO(map));
+			leaf != NULL; leaf = D_RW(leaf->next)) {
+		if (leaf->n != 0)
+			return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * bptree_map_check -- check if given persistent object is a tree map
+ */
+int
+bptree_map_check(PMEMobjpool *pop, TOID(struct bptree_map) map)
+{
+	return TOID_IS_NULL(map) || !TOID_VALID(map);
+}
+
+/*
+ * bptree_map_insert_new -- allocates a new object and inserts it into the tree
+ */
+int
+bptree_map_insert_new(PMEMobjpool *pop, TOID(struct bptree_map) map,
+		uint64_t key, size_t size, unsigned type_num,
+		void (*constructor)(PMEMobjpool *pop, void *ptr, void *arg),
+		void *arg)
+{
+	int ret = 0;
+
+	TX_BEGIN(pop) {
+		PMEMoid n = pmemobj_tx_alloc(size, type_num);
+		constructor(pop, pmemobj_direct(n), arg);
+		bptree_map_insert(pop, map, key, n);
+	} TX_ONABORT {
+		ret = 1;
+	} TX_END
+
+	return ret;
+}
+
+/*
+ * bptree_map_remove_free -- removes and frees an object from the tree
+ */
+int
+bptree_map_remove_free(PMEMobjpool *pop, TOID(struct bptree_map) map,
+		uint64_t key)
+{
+	int ret = 0;
+
+	TX_BEGIN(pop) {
+		PMEMoid val = bptree_map_remove(pop, map, key);
+		pmemobj_tx_free(val);
+	} TX_ONABORT {
+		ret = 1;
+	} TX_END
+
+	return ret;
+}
@@ -632,6 +632,58 @@ btree_map_foreach(PMEMobjpool *pop, TOID(struct btree_map) map,
 	return btree_map_foreach_node(D_RO(map)->root, cb, arg);
 }
 
+/*
+ * btree_map_range_node -- (internal) recursively traverses the part of the
+ *	tree that can contain keys from the [min, max] range, returns -1 once a
+ *	key above max is reached
+ */
+static int
+btree_map_range_node(const TOID(struct tree_map_node) p,
+	uint64_t min, uint64_t max,
+	int (*cb)(uint64_t key, PMEMoid value, void *arg), void *arg)
+{
+	if (TOID_IS_NULL(p))
+		return 0;
+
+	const struct tree_map_node *node = D_RO(p);
+
+	/* skip the items, and the subtrees on their left, below the range */
+	int i = 0;
+	while (i < node->n && node->items[i].key < min)
+		++i;
+
+	for (; i <= node->n; ++i) {
+		int ret = btree_map_range_node(node->slots[i], min, max,
+				cb, arg);
+		if (ret != 0)
+			return ret;
+
+		if (i == node->n)
+			break;
+
+		const struct tree_map_node_item *item = &node->items[i];
+		if (item->key > max)
+			return -1;
+
+		if (item->key != 0 && cb(item->key, item->value, arg) != 0)
+			return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * btree_map_range -- traverses the tree in the key order, calling the
+ *	callback only for the keys from the [min, max] range
+ */
+int
+btree_map_range(PMEMobjpool *pop, TOID(struct btree_map) map,
+	uint64_t min, uint64_t max,
+	int (*cb)(uint64_t key, PMEMoid value, void *arg), void *arg)
+{
+	return btree_map_range_node(D_RO(map)->root, min, max, cb, arg) == 1;
+}
+
 /*
  * ctree_map_check -- check if given persistent object is a tree map
  */
@@ -66,6 +66,9 @@ int btree_map_lookup(PMEMobjpool *pop, TOID(struct btree_map) map,
 		uint64_t key);
 int btree_map_foreach(PMEMobjpool *pop, TOID(struct btree_map) map,
 	int (*cb)(uint64_t key, PMEMoid value, void *arg), void *arg);
+int btree_map_range(PMEMobjpool *pop, TOID(struct btree_map) map,
+	uint64_t min, uint64_t max,
+	int (*cb)(uint64_t key, PMEMoid value, void *arg), void *arg);
 int btree_map_is_empty(PMEMobjpool *pop, TOID(struct btree_map) map);
 
 #endif /* BTREE_MAP_H */
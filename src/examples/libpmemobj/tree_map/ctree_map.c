@@ -381,6 +381,101 @@ ctree_map_foreach(PMEMobjpool *pop, TOID(struct ctree_map) map,
 	return ctree_map_foreach_node(D_RO(map)->root, cb, arg);
 }
 
+/*
+ * ctree_map_range_node -- (internal) traverses the whole subtree in the key
+ *	order, returns -1 once a key above max is reached
+ */
+static int
+ctree_map_range_node(struct tree_map_entry e, uint64_t max,
+	int (*cb)(uint64_t key, PMEMoid value, void *arg), void *arg)
+{
+	if (!OID_IS_NULL(e.slot) &&
+			OID_INSTANCEOF(e.slot, struct tree_map_node)) {
+		TOID(struct tree_map_node) node;
+		TOID_ASSIGN(node, e.slot);
+
+		int ret = ctree_map_range_node(D_RO(node)->entries[0],
+				max, cb, arg);
+		if (ret == 0)
+			ret = ctree_map_range_node(D_RO(node)->entries[1],
+					max, cb, arg);
+
+		return ret;
+	}
+
+	if (e.key > max)
+		return -1;
+
+	return cb(e.key, e.slot, arg) != 0;
+}
+
+/*
+ * ctree_map_range_seek -- (internal) follows the path of min down to the
+ *	subtree in which it would be inserted, skipping everything below min
+ *
+ * All keys in that subtree differ from min at the critical bit 'crit',
+ * which alone decides if the subtree lies entirely above or below min.
+ */
+static int
+ctree_map_range_seek(struct tree_map_entry e, uint64_t min, uint64_t max,
+	int crit, int (*cb)(uint64_t key, PMEMoid value, void *arg), void *arg)
+{
+	if (!OID_IS_NULL(e.slot) &&
+			OID_INSTANCEOF(e.slot, struct tree_map_node)) {
+		TOID(struct tree_map_node) node;
+		TOID_ASSIGN(node, e.slot);
+
+		int diff = D_RO(node)->diff;
+		if (diff > crit) {
+			if (BIT_IS_SET(min, diff))
+				return ctree_map_range_seek(
+					D_RO(node)->entries[1],
+					min, max, crit, cb, arg);
+
+			int ret = ctree_map_range_seek(D_RO(node)->entries[0],
+					min, max, crit, cb, arg);
+			if (ret == 0)
+				ret = ctree_map_range_node(
+					D_RO(node)->entries[1], max, cb, arg);
+
+			return ret;
+		}
+	}
+
+	/* crit is negative only if min itself is in the tree */
+	if (crit >= 0 && BIT_IS_SET(min, crit))
+		return 0;
+
+	return ctree_map_range_node(e, max, cb, arg);
+}
+
+/*
+ * ctree_map_range -- traverses the tree in the key order, calling the
+ *	callback only for the keys from the [min, max] range
+ */
+int
+ctree_map_range(PMEMobjpool *pop, TOID(struct ctree_map) map,
+	uint64_t min, uint64_t max,
+	int (*cb)(uint64_t key, PMEMoid value, void *arg), void *arg)
+{
+	struct tree_map_entry e = D_RO(map)->root;
+	if (e.key == 0 && OID_IS_NULL(e.slot))
+		return 0;
+
+	/* find the leaf which shares the longest prefix with min */
+	TOID(struct tree_map_node) node;
+	while (!OID_IS_NULL(e.slot) &&
+			OID_INSTANCEOF(e.slot, struct tree_map_node)) {
+		TOID_ASSIGN(node, e.slot);
+		e = D_RO(node)->entries[BIT_IS_SET(min, D_RO(node)->diff)];
+	}
+
+	int crit = e.key == min ? -1 : find_crit_bit(e.key, min);
+
+	return ctree_map_range_seek(D_RO(map)->root, min, max, crit,
+			cb, arg) == 1;
+}
+
 /*
  * ctree_map_is_empty -- checks whether the tree map is empty
  */
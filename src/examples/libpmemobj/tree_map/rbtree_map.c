@@ -496,6 +496,49 @@ rbtree_map_foreach(PMEMobjpool *pop, TOID(struct rbtree_map) map,
 	return rbtree_map_foreach_node(map, RB_FIRST(map), cb, arg);
 }
 
+/*
+ * rbtree_map_lower_bound -- (internal) returns the node with the smallest key
+ *	that is not less than the given one
+ */
+static TOID(struct tree_map_node)
+rbtree_map_lower_bound(TOID(struct rbtree_map) map, uint64_t key)
+{
+	TOID(struct tree_map_node) dst = RB_FIRST(map);
+	TOID(struct tree_map_node) s = D_RO(map)->sentinel;
+	TOID(struct tree_map_node) found = s;
+
+	while (!NODE_IS_NULL(dst)) {
+		if (D_RO(dst)->key >= key) {
+			found = dst;
+			dst = D_RO(dst)->slots[RB_LEFT];
+		} else {
+			dst = D_RO(dst)->slots[RB_RIGHT];
+		}
+	}
+
+	return found;
+}
+
+/*
+ * rbtree_map_range -- visits the nodes from the [min, max] range in the key
+ *	order, starting from the lower bound of min
+ */
+int
+rbtree_map_range(PMEMobjpool *pop, TOID(struct rbtree_map) map,
+	uint64_t min, uint64_t max,
+	int (*cb)(uint64_t key, PMEMoid value, void *arg), void *arg)
+{
+	for (TOID(struct tree_map_node) n = rbtree_map_lower_bound(map, min);
+			!TOID_EQUALS(n, D_RO(map)->sentinel) &&
+			D_RO(n)->key <= max;
+			n = rbtree_map_successor(map, n)) {
+		if (cb(D_RO(n)->key, D_RO(n)->value, arg) != 0)
+			return 1;
+	}
+
+	return 0;
+}
+
 /*
  * rbtree_map_is_empty -- checks whether the tree map is empty
  */
@@ -69,6 +69,14 @@ int pmemobj_xalloc(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
 	uint64_t type_num, uint64_t flags,
 	pmemobj_constr constructor, void *arg);
 
+/*
+ * Allocates with flags n new objects of the same size from the pool.
+ * The objects are published in atomic batches of up to 1024 objects.
+ */
+int pmemobj_xalloc_n(PMEMobjpool *pop, PMEMoid *oidv, size_t n, size_t size,
+	uint64_t type_num, uint64_t flags,
+	pmemobj_constr constructor, void *arg);
+
 /*
  * Allocates a new zeroed object from the pool.
  */
@@ -179,6 +179,22 @@ size_t pmemobj_alloc_usable_size(PMEMoid oid);
  */
 uint64_t pmemobj_type_num(PMEMoid oid);
 
+/*
+ * Result of the heap defragmentation.
+ */
+struct pobj_defrag_result {
+	size_t total; /* number of processed objects */
+	size_t relocated; /* number of relocated objects */
+	size_t reclaimed; /* number of bytes returned to the heap */
+};
+
+/*
+ * Relocates the referenced objects out of sparsely populated runs and
+ * updates the references in place.
+ */
+int pmemobj_defrag(PMEMobjpool *pop, PMEMoid **oidv, size_t oidcnt,
+	struct pobj_defrag_result *result);
+
 /*
  * Pmemobj specific low-level memory manipulation functions.
  *
@@ -214,6 +214,34 @@ int pmemobj_tx_xadd_range(PMEMoid oid, uint64_t off, size_t size,
  */
 int pmemobj_tx_xadd_range_direct(const void *ptr, size_t size, uint64_t flags);
 
+/*
+ * Writes 'size' bytes from 'src' to the persistent memory at 'ptr' using the
+ * redo log. Unless the memory was already added to the transaction, or
+ * belongs to an object allocated in it, the write is buffered and applied
+ * only when the transaction commits. Use pmemobj_tx_redo_read to read the
+ * memory along with the pending writes.
+ *
+ * If successful, returns zero.
+ * Otherwise, state changes to TX_STAGE_ONABORT and an error number is
+ * returned.
+ *
+ * This function must be called during TX_STAGE_WORK.
+ */
+int pmemobj_tx_redo_write(void *ptr, const void *src, size_t size);
+
+/*
+ * Copies 'size' bytes of the persistent memory at 'ptr' to 'dest', including
+ * the modifications made with pmemobj_tx_redo_write in the current
+ * transaction.
+ *
+ * If successful, returns zero.
+ * Otherwise, state changes to TX_STAGE_ONABORT and an error number is
+ * returned.
+ *
+ * This function must be called during TX_STAGE_WORK.
+ */
+int pmemobj_tx_redo_read(void *dest, const void *ptr, size_t size);
+
 /*
  * Transactionally allocates a new object.
  *
@@ -301,6 +301,7 @@ enum pmempool_feature {
 	PMEMPOOL_FEAT_CKSUM_2K,
 	PMEMPOOL_FEAT_SHUTDOWN_STATE,
 	PMEMPOOL_FEAT_CHECK_BAD_BLOCKS,
+	PMEMPOOL_FEAT_ULOG_GEN,
 };
 
 /* PMEMPOOL FEATURE ENABLE */
@@ -131,6 +131,21 @@ static struct {
 
 #define ALLOC_CLASS_DEFAULT_FLAGS CHUNK_FLAG_FLEX_BITMAP
 
+/*
+ * The allocation size profiler only proposes a tight-fitting class for a size
+ * that makes up at least this percentage of all the sampled allocations,
+ * and only if such class reduces the memory used by each object of that size
+ * by at least 1/(2^ALLOC_PROFILE_MIN_SAVINGS_SHIFT).
+ */
+#define ALLOC_PROFILE_MIN_SHARE_PCT 1
+#define ALLOC_PROFILE_MIN_SAVINGS_SHIFT 4
+
+struct alloc_class_profile {
+	int enabled;
+	size_t nsizes;
+	uint64_t *counts; /* number of sampled allocations per class map index */
+};
+
 struct alloc_class_collection {
 	size_t granularity;
 
@@ -150,6 +165,8 @@ struct alloc_class_collection {
 
 	int fail_on_missing_class;
 	int autogenerate_on_missing_class;
+
+	struct alloc_class_profile profile;
 };
 
 /*
@@ -287,17 +304,13 @@ alloc_class_delete(struct alloc_class_collection *ac,
 }
 
 /*
- * alloc_class_find_or_create -- (internal) searches for the
- * biggest allocation class for which unit_size is evenly divisible by n.
- * If no such class exists, create one.
+ * alloc_class_run_size_idx -- (internal) calculates the number of chunks
+ *	required for a run of the given unit size to fit RUN_MIN_NALLOCS units
  */
-static struct alloc_class *
-alloc_class_find_or_create(struct alloc_class_collection *ac, size_t n)
+static uint32_t
+alloc_class_run_size_idx(size_t unit_size)
 {
-	LOG(10, NULL);
-
-	COMPILE_ERROR_ON(MAX_ALLOCATION_CLASSES > UINT8_MAX);
-	uint64_t required_size_bytes = n * RUN_MIN_NALLOCS;
+	uint64_t required_size_bytes = unit_size * RUN_MIN_NALLOCS;
 	uint32_t required_size_idx = 1;
 	if (required_size_bytes > RUN_DEFAULT_SIZE) {
 		required_size_bytes -= RUN_DEFAULT_SIZE;
@@ -307,6 +320,22 @@ alloc_class_find_or_create(struct alloc_class_collection *ac, size_t n)
 			required_size_idx = RUN_SIZE_IDX_CAP;
 	}
 
+	return required_size_idx;
+}
+
+/*
+ * alloc_class_find_or_create -- (internal) searches for the
+ * biggest allocation class for which unit_size is evenly divisible by n.
+ * If no such class exists, create one.
+ */
+static struct alloc_class *
+alloc_class_find_or_create(struct alloc_class_collection *ac, size_t n)
+{
+	LOG(10, NULL);
+
+	COMPILE_ERROR_ON(MAX_ALLOCATION_CLASSES > UINT8_MAX);
+	uint32_t required_size_idx = alloc_class_run_size_idx(n);
+
 	for (int i = MAX_ALLOCATION_CLASSES - 1; i >= 0; --i) {
 		struct alloc_class *c = ac->aclasses[i];
 
@@ -552,6 +581,7 @@ alloc_class_collection_delete(struct alloc_class_collection *ac)
 
 	cuckoo_delete(ac->class_map_by_unit_size);
 	Free(ac->class_map_by_alloc_size);
+	Free(ac->profile.counts);
 	Free(ac);
 }
 
@@ -659,3 +689,260 @@ alloc_class_calc_size_idx(struct alloc_class *c, size_t size)
 
 	return size_idx;
 }
+
+/*
+ * alloc_class_profile_enable -- enables or disables sampling of requested
+ *	allocation sizes
+ */
+int
+alloc_class_profile_enable(struct alloc_class_collection *ac, int enable)
+{
+	struct alloc_class_profile *p = &ac->profile;
+
+	/* the counters are allocated only when first needed */
+	if (enable && p->counts == NULL) {
+		size_t nsizes = SIZE_TO_CLASS_MAP_INDEX(ac->last_run_max_size,
+			ac->granularity) + 1;
+		p->counts = Zalloc(nsizes * sizeof(*p->counts));
+		if (p->counts == NULL) {
+			ERR("!Zalloc");
+			return -1;
+		}
+		p->nsizes = nsizes;
+	}
+
+	p->enabled = enable;
+
+	return 0;
+}
+
+/*
+ * alloc_class_profile_is_enabled -- returns whether or not allocation sizes
+ *	are being sampled
+ */
+int
+alloc_class_profile_is_enabled(struct alloc_class_collection *ac)
+{
+	return ac->profile.enabled;
+}
+
+/*
+ * alloc_class_profile_reset -- discards all the sampled allocation sizes
+ */
+void
+alloc_class_profile_reset(struct alloc_class_collection *ac)
+{
+	struct alloc_class_profile *p = &ac->profile;
+
+	if (p->counts != NULL)
+		memset(p->counts, 0, p->nsizes * sizeof(*p->counts));
+}
+
+/*
+ * alloc_class_profile_record -- samples a requested allocation size, only
+ *	sizes handled by runs are taken into account
+ */
+void
+alloc_class_profile_record(struct alloc_class_collection *ac, size_t size)
+{
+	struct alloc_class_profile *p = &ac->profile;
+
+	if (!p->enabled || size == 0 || size >= ac->last_run_max_size)
+		return;
+
+	util_fetch_and_add64(&p->counts[
+		SIZE_TO_CLASS_MAP_INDEX(size, ac->granularity)], 1);
+}
+
+/*
+ * alloc_class_profile_used -- (internal) returns the number of bytes that an
+ *	allocation of the given size occupies when served from the class
+ */
+static size_t
+alloc_class_profile_used(struct alloc_class *c, size_t size)
+{
+	size_t real_size = size + header_type_to_size[c->header_type];
+
+	return CALC_SIZE_IDX(c->unit_size, real_size) * c->unit_size;
+}
+
+/*
+ * alloc_class_profile_current -- (internal) returns the allocation class that
+ *	currently handles the allocations from the given class map index
+ */
+static struct alloc_class *
+alloc_class_profile_current(struct alloc_class_collection *ac, size_t idx)
+{
+	uint8_t class_id = ac->class_map_by_alloc_size[idx];
+	if (class_id == MAX_ALLOCATION_CLASSES)
+		return alloc_class_find_min_frag(ac, idx * ac->granularity);
+
+	return ac->aclasses[class_id];
+}
+
+/*
+ * alloc_class_profile_tight_size -- (internal) returns the unit size of the
+ *	allocation class that fits the given allocation size exactly
+ */
+static size_t
+alloc_class_profile_tight_size(struct alloc_class_collection *ac, size_t size)
+{
+	return ALIGN_UP(size + header_type_to_size[HEADER_COMPACT],
+		ac->granularity);
+}
+
+/*
+ * alloc_class_profile_frag -- estimates the internal fragmentation, as
+ *	a fraction of the used memory, of the sampled allocations given the
+ *	current allocation classes
+ *
+ * Sizes are sampled with the granularity of the class map, and so every
+ * allocation is assumed to be of the largest size within its granule.
+ */
+double
+alloc_class_profile_frag(struct alloc_class_collection *ac)
+{
+	struct alloc_class_profile *p = &ac->profile;
+	if (p->counts == NULL)
+		return 0;
+
+	uint64_t used = 0;
+	uint64_t wasted = 0;
+	for (size_t i = 1; i < p->nsizes; ++i) {
+		if (p->counts[i] == 0)
+			continue;
+
+		size_t size = i * ac->granularity;
+		struct alloc_class *c = alloc_class_profile_current(ac, i);
+		size_t c_used = alloc_class_profile_used(c, size);
+
+		used += p->counts[i] * c_used;
+		wasted += p->counts[i] * (c_used - size);
+	}
+
+	return used == 0 ? 0 : (double)wasted / (double)used;
+}
+
+/*
+ * alloc_class_profile_propose -- finds up to max allocation sizes for which
+ *	a tight-fitting allocation class would save the most memory, sorted
+ *	from the largest savings
+ */
+size_t
+alloc_class_profile_propose(struct alloc_class_collection *ac,
+	size_t *sizes, size_t max)
+{
+	struct alloc_class_profile *p = &ac->profile;
+	if (p->counts == NULL || max == 0)
+		return 0;
+
+	ASSERT(max <= ALLOC_CLASS_MAX_PROPOSALS);
+
+	uint64_t total = 0;
+	for (size_t i = 1; i < p->nsizes; ++i)
+		total += p->counts[i];
+
+	uint64_t savings[ALLOC_CLASS_MAX_PROPOSALS];
+	size_t nproposals = 0;
+
+	for (size_t i = 1; i < p->nsizes; ++i) {
+		uint64_t count = p->counts[i];
+		if (count == 0 ||
+		    count * 100 < total * ALLOC_PROFILE_MIN_SHARE_PCT)
+			continue;
+
+		size_t size = i * ac->granularity;
+		struct alloc_class *c = alloc_class_profile_current(ac, i);
+		size_t c_used = alloc_class_profile_used(c, size);
+		size_t tight_used = alloc_class_profile_tight_size(ac, size);
+
+		if (c_used <= tight_used ||
+		    (c_used - tight_used) <
+		    (c_used >> ALLOC_PROFILE_MIN_SAVINGS_SHIFT))
+			continue;
+
+		uint64_t saved = count * (c_used - tight_used);
+
+		/* insertion into the sorted array of the best proposals */
+		size_t pos = nproposals;
+		while (pos > 0 && savings[pos - 1] < saved) {
+			if (pos < max) {
+				savings[pos] = savings[pos - 1];
+				sizes[pos] = sizes[pos - 1];
+			}
+			pos--;
+		}
+		if (pos < max) {
+			savings[pos] = saved;
+			sizes[pos] = size;
+			if (nproposals < max)
+				nproposals++;
+		}
+	}
+
+	return nproposals;
+}
+
+/*
+ * alloc_class_by_tight_fit -- returns an existing allocation class that fits
+ *	the given allocation size exactly, if any
+ */
+struct alloc_class *
+alloc_class_by_tight_fit(struct alloc_class_collection *ac, size_t size)
+{
+	size = SIZE_TO_CLASS_MAP_INDEX(size, ac->granularity) *
+		ac->granularity;
+
+	for (int i = MAX_ALLOCATION_CLASSES - 1; i >= 0; --i) {
+		struct alloc_class *c = ac->aclasses[i];
+
+		if (c == NULL || c == ACLASS_RESERVED ||
+		    c->type != CLASS_RUN || c->header_type == HEADER_NONE ||
+		    (c->flags & CHUNK_FLAG_ALIGNED))
+			continue;
+
+		if (alloc_class_profile_used(c, size) ==
+		    alloc_class_profile_tight_size(ac, size))
+			return c;
+	}
+
+	return NULL;
+}
+
+/*
+ * alloc_class_new_tight_fit -- creates a new allocation class that fits the
+ *	given allocation size exactly
+ *
+ * The class is not used for allocations of that size until it is assigned
+ * with alloc_class_assign_size, which allows the caller to prepare all the
+ * required runtime state beforehand.
+ */
+struct alloc_class *
+alloc_class_new_tight_fit(struct alloc_class_collection *ac, size_t size)
+{
+	size_t unit_size = alloc_class_profile_tight_size(ac, size);
+
+	return alloc_class_new(-1, ac, CLASS_RUN, HEADER_COMPACT, unit_size, 0,
+		alloc_class_run_size_idx(unit_size));
+}
+
+/*
+ * alloc_class_assign_size -- makes the allocation class handle all the
+ *	allocations of the given size that do not specify a class explicitly
+ */
+void
+alloc_class_assign_size(struct alloc_class_collection *ac, size_t size,
+	struct alloc_class *c)
+{
+	ASSERT(size < ac->last_run_max_size);
+	ASSERTeq(c->type, CLASS_RUN);
+
+	size_t class_map_index = SIZE_TO_CLASS_MAP_INDEX(size,
+		ac->granularity);
+
+	/*
+	 * Concurrent allocations of this size either still use the previous
+	 * class or already use the new one, both of which are valid.
+	 */
+	ac->class_map_by_alloc_size[class_map_index] = c->id;
+}
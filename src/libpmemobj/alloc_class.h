@@ -50,6 +50,12 @@ extern "C" {
 #define DEFAULT_ALLOC_CLASS_ID (0)
 #define RUN_UNIT_MAX RUN_BITS_PER_VALUE
 
+/*
+ * Maximum number of allocation classes proposed by the allocation size
+ * profiler at once.
+ */
+#define ALLOC_CLASS_MAX_PROPOSALS 16
+
 struct alloc_class_collection;
 
 enum alloc_class_type {
@@ -104,6 +110,22 @@ alloc_class_new(int id, struct alloc_class_collection *ac,
 void alloc_class_delete(struct alloc_class_collection *ac,
 	struct alloc_class *c);
 
+int alloc_class_profile_enable(struct alloc_class_collection *ac, int enable);
+int alloc_class_profile_is_enabled(struct alloc_class_collection *ac);
+void alloc_class_profile_reset(struct alloc_class_collection *ac);
+void alloc_class_profile_record(struct alloc_class_collection *ac,
+	size_t size);
+double alloc_class_profile_frag(struct alloc_class_collection *ac);
+size_t alloc_class_profile_propose(struct alloc_class_collection *ac,
+	size_t *sizes, size_t max);
+
+struct alloc_class *alloc_class_by_tight_fit(
+	struct alloc_class_collection *ac, size_t size);
+struct alloc_class *alloc_class_new_tight_fit(
+	struct alloc_class_collection *ac, size_t size);
+void alloc_class_assign_size(struct alloc_class_collection *ac, size_t size,
+	struct alloc_class *c);
+
 
 #ifdef __cplusplus
 }
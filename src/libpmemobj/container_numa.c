@@ -0,0 +1,218 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * container_numa.c -- implementation of NUMA-aware block container
+ */
+
+#include "container_numa.h"
+#include "container_ravl.h"
+#include "heap.h"
+#include "out.h"
+
+struct block_container_numa {
+	struct block_container super;
+	unsigned nnodes;
+	struct block_container *nodes[];
+};
+
+/*
+ * container_numa_of -- (internal) returns the per-node container that holds
+ *	the given memory block
+ */
+static struct block_container *
+container_numa_of(struct block_container_numa *c,
+	const struct memory_block *m)
+{
+	unsigned node = heap_zone_numa_node(c->super.heap, m->zone_id);
+	ASSERT(node < c->nnodes);
+
+	return c->nodes[node];
+}
+
+/*
+ * container_numa_insert_block -- (internal) inserts a new memory block
+ *	into the container of the node the block resides on
+ */
+static int
+container_numa_insert_block(struct block_container *bc,
+	const struct memory_block *m)
+{
+	struct block_container_numa *c = (struct block_container_numa *)bc;
+	struct block_container *n = container_numa_of(c, m);
+
+	return n->c_ops->insert(n, m);
+}
+
+/*
+ * container_numa_get_rm_block_bestfit -- (internal) removes and returns the
+ *	best-fit memory block for size, preferring the node of the calling
+ *	thread
+ */
+static int
+container_numa_get_rm_block_bestfit(struct block_container *bc,
+	struct memory_block *m)
+{
+	struct block_container_numa *c = (struct block_container_numa *)bc;
+
+	unsigned local = heap_thread_numa_node(c->super.heap);
+
+	for (unsigned i = 0; i < c->nnodes; ++i) {
+		struct block_container *n = c->nodes[(local + i) % c->nnodes];
+		if (n->c_ops->get_rm_bestfit(n, m) == 0)
+			return 0;
+	}
+
+	return ENOMEM;
+}
+
+/*
+ * container_numa_get_rm_block_exact --
+ *	(internal) removes exact match memory block
+ */
+static int
+container_numa_get_rm_block_exact(struct block_container *bc,
+	const struct memory_block *m)
+{
+	struct block_container_numa *c = (struct block_container_numa *)bc;
+	struct block_container *n = container_numa_of(c, m);
+
+	return n->c_ops->get_rm_exact(n, m);
+}
+
+/*
+ * container_numa_get_block_exact -- (internal) finds exact match memory block
+ */
+static int
+container_numa_get_block_exact(struct block_container *bc,
+	const struct memory_block *m)
+{
+	struct block_container_numa *c = (struct block_container_numa *)bc;
+	struct block_container *n = container_numa_of(c, m);
+
+	return n->c_ops->get_exact(n, m);
+}
+
+/*
+ * container_numa_is_empty -- (internal) checks whether the container is empty
+ */
+static int
+container_numa_is_empty(struct block_container *bc)
+{
+	struct block_container_numa *c = (struct block_container_numa *)bc;
+
+	for (unsigned i = 0; i < c->nnodes; ++i) {
+		if (!c->nodes[i]->c_ops->is_empty(c->nodes[i]))
+			return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * container_numa_rm_all -- (internal) removes all elements from the container
+ */
+static void
+container_numa_rm_all(struct block_container *bc)
+{
+	struct block_container_numa *c = (struct block_container_numa *)bc;
+
+	for (unsigned i = 0; i < c->nnodes; ++i)
+		c->nodes[i]->c_ops->rm_all(c->nodes[i]);
+}
+
+/*
+ * container_numa_destroy -- (internal) deletes the container
+ */
+static void
+container_numa_destroy(struct block_container *bc)
+{
+	struct block_container_numa *c = (struct block_container_numa *)bc;
+
+	for (unsigned i = 0; i < c->nnodes; ++i)
+		c->nodes[i]->c_ops->destroy(c->nodes[i]);
+
+	Free(bc);
+}
+
+/*
+ * NUMA-aware block container, keeps a separate tree-based container for each
+ * node of the heap. Blocks are always stored in the container of the node on
+ * which they reside, which means that neighbouring blocks of a zone end up in
+ * the same container and can be coalesced. The best-fit search first looks
+ * for memory local to the calling thread and only then falls back to the
+ * remaining nodes in the order of their ids.
+ */
+static struct block_container_ops container_numa_ops = {
+	.insert = container_numa_insert_block,
+	.get_rm_exact = container_numa_get_rm_block_exact,
+	.get_rm_bestfit = container_numa_get_rm_block_bestfit,
+	.get_exact = container_numa_get_block_exact,
+	.is_empty = container_numa_is_empty,
+	.rm_all = container_numa_rm_all,
+	.destroy = container_numa_destroy,
+};
+
+/*
+ * container_new_numa -- allocates and initializes a NUMA-aware container
+ */
+struct block_container *
+container_new_numa(struct palloc_heap *heap)
+{
+	unsigned nnodes = heap_numa_nnodes(heap);
+
+	struct block_container_numa *bc = Malloc(sizeof(*bc) +
+		sizeof(bc->nodes[0]) * nnodes);
+	if (bc == NULL)
+		goto error_container_malloc;
+
+	bc->super.heap = heap;
+	bc->super.c_ops = &container_numa_ops;
+	bc->nnodes = nnodes;
+
+	unsigned i;
+	for (i = 0; i < nnodes; ++i) {
+		bc->nodes[i] = container_new_ravl(heap);
+		if (bc->nodes[i] == NULL)
+			goto error_node_new;
+	}
+
+	return (struct block_container *)&bc->super;
+
+error_node_new:
+	while (i-- > 0)
+		bc->nodes[i]->c_ops->destroy(bc->nodes[i]);
+	Free(bc);
+
+error_container_malloc:
+	return NULL;
+}
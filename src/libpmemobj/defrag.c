@@ -0,0 +1,548 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * defrag.c -- implementation of the online heap defragmentation
+ *
+ * Objects that live in sparsely populated runs are moved, in a single
+ * transaction, to blocks provided by the regular allocator. This means that
+ * the relocated objects end up in runs that are already well utilized and
+ * that the evacuated runs become empty. Those are then turned back into free
+ * chunks, which can be reused by allocations of any size.
+ *
+ * Only the runs whose all allocated blocks are referenced by the provided
+ * table of pointers are evacuated, everything else is left intact.
+ */
+
+#include <inttypes.h>
+#include <stdlib.h>
+
+#include "alloc_class.h"
+#include "heap.h"
+#include "memblock.h"
+#include "obj.h"
+#include "out.h"
+#include "recycler.h"
+#include "stats.h"
+#include "vec.h"
+#include "valgrind_internal.h"
+
+/*
+ * Runs that are filled above this percentage are never evacuated.
+ */
+#define DEFRAG_MAX_RUN_FILL_PCT 50
+
+enum defrag_run_state {
+	DEFRAG_RUN_IGNORED, /* not a candidate for evacuation */
+	DEFRAG_RUN_PENDING, /* candidate, not yet processed */
+	DEFRAG_RUN_DESTINATION, /* received a relocated object, kept intact */
+	DEFRAG_RUN_EVACUATED, /* objects are scheduled for relocation */
+};
+
+/* a single entry of the reference table */
+struct defrag_ref {
+	uint64_t off; /* offset of the referenced object */
+	size_t idx; /* position in the user provided table */
+};
+
+struct defrag_run {
+	uint32_t zone_id;
+	uint32_t chunk_id;
+
+	uint32_t nallocs; /* number of units in the run */
+	uint32_t used; /* number of allocated units */
+	uint32_t tracked; /* number of units covered by the references */
+
+	/* range of the references to objects from this run */
+	size_t ref_begin;
+	size_t ref_end;
+
+	enum defrag_run_state state;
+};
+
+/* a scheduled relocation of a single object */
+struct defrag_move {
+	uint64_t old_off;
+	uint64_t new_off;
+	size_t size;
+
+	/* range of the references to the relocated object */
+	size_t ref_begin;
+	size_t ref_end;
+};
+
+/* blocks reserved only to keep them away from the relocated objects */
+VEC(defrag_pinned, uint64_t);
+
+/*
+ * defrag_ref_cmp -- (internal) orders references by the object offset
+ */
+static int
+defrag_ref_cmp(const void *lhs, const void *rhs)
+{
+	const struct defrag_ref *l = lhs;
+	const struct defrag_ref *r = rhs;
+
+	if (l->off != r->off)
+		return l->off > r->off ? 1 : -1;
+
+	if (l->idx != r->idx)
+		return l->idx > r->idx ? 1 : -1;
+
+	return 0;
+}
+
+/*
+ * defrag_run_cmp -- (internal) orders runs by their location in the heap
+ */
+static int
+defrag_run_cmp(const void *lhs, const void *rhs)
+{
+	const struct defrag_run *l = lhs;
+	const struct defrag_run *r = rhs;
+
+	if (l->zone_id != r->zone_id)
+		return l->zone_id > r->zone_id ? 1 : -1;
+
+	if (l->chunk_id != r->chunk_id)
+		return l->chunk_id > r->chunk_id ? 1 : -1;
+
+	return 0;
+}
+
+/*
+ * defrag_run_fill_cmp -- (internal) orders runs by their fill ratio, the
+ *	sparsest ones first
+ */
+static int
+defrag_run_fill_cmp(const void *lhs, const void *rhs)
+{
+	const struct defrag_run *l = *(struct defrag_run * const *)lhs;
+	const struct defrag_run *r = *(struct defrag_run * const *)rhs;
+
+	uint64_t lfill = (uint64_t)l->used * r->nallocs;
+	uint64_t rfill = (uint64_t)r->used * l->nallocs;
+
+	if (lfill != rfill)
+		return lfill > rfill ? 1 : -1;
+
+	return defrag_run_cmp(l, r);
+}
+
+/*
+ * defrag_run_init -- (internal) reads the occupancy of the run that contains
+ *	the given memory block
+ */
+static void
+defrag_run_init(struct palloc_heap *heap, const struct memory_block *m,
+	struct defrag_run *run)
+{
+	struct memory_block rm = MEMORY_BLOCK_NONE;
+	rm.zone_id = m->zone_id;
+	rm.chunk_id = m->chunk_id;
+	rm.size_idx = heap_get_chunk_hdr(heap, m)->size_idx;
+	memblock_rebuild_state(heap, &rm);
+
+	struct run_bitmap b;
+	rm.m_ops->get_bitmap(&rm, &b);
+
+	struct recycler_element e = recycler_element_new(heap, &rm);
+
+	run->zone_id = m->zone_id;
+	run->chunk_id = m->chunk_id;
+	run->nallocs = b.nbits;
+	run->used = b.nbits - e.free_space;
+	run->tracked = 0;
+
+	struct chunk_run *crun = heap_get_chunk_run(heap, m);
+	struct chunk_header *hdr = heap_get_chunk_hdr(heap, m);
+	struct alloc_class *c = alloc_class_by_run(heap_alloc_classes(heap),
+		crun->hdr.block_size, hdr->flags, hdr->size_idx);
+
+	run->state = c == NULL ? DEFRAG_RUN_IGNORED : DEFRAG_RUN_PENDING;
+}
+
+/*
+ * defrag_collect_runs -- (internal) groups the sorted references into runs,
+ *	returns the number of runs found
+ */
+static size_t
+defrag_collect_runs(PMEMobjpool *pop, const struct defrag_ref *refs,
+	size_t nrefs, struct defrag_run *runs, size_t *nobjs)
+{
+	struct palloc_heap *heap = &pop->heap;
+	struct defrag_run *run = NULL;
+	size_t nruns = 0;
+
+	*nobjs = 0;
+	for (size_t i = 0; i < nrefs; ++i) {
+		if (i != 0 && refs[i].off == refs[i - 1].off) {
+			if (run != NULL)
+				run->ref_end = i + 1;
+			continue;
+		}
+
+		*nobjs += 1;
+
+		struct memory_block m = memblock_from_offset(heap, refs[i].off);
+		if (m.type != MEMORY_BLOCK_RUN) {
+			run = NULL;
+			continue;
+		}
+
+		if (run == NULL || run->zone_id != m.zone_id ||
+		    run->chunk_id != m.chunk_id) {
+			run = &runs[nruns++];
+			defrag_run_init(heap, &m, run);
+			run->ref_begin = i;
+		}
+
+		run->ref_end = i + 1;
+		run->tracked += m.size_idx;
+
+		/* internal objects must stay where they are */
+		if (m.m_ops->get_flags(&m) & OBJ_INTERNAL_OBJECT_MASK)
+			run->state = DEFRAG_RUN_IGNORED;
+	}
+
+	return nruns;
+}
+
+/*
+ * defrag_run_find -- (internal) returns the run that contains the memory
+ *	block, if it is one of the runs referenced by the table
+ */
+static struct defrag_run *
+defrag_run_find(struct defrag_run *runs, size_t nruns,
+	const struct memory_block *m)
+{
+	if (m->type != MEMORY_BLOCK_RUN)
+		return NULL;
+
+	struct defrag_run key;
+	key.zone_id = m->zone_id;
+	key.chunk_id = m->chunk_id;
+
+	return bsearch(&key, runs, nruns, sizeof(*runs), defrag_run_cmp);
+}
+
+/*
+ * defrag_evacuate_run -- (internal) allocates new locations for all objects
+ *	from the run, returns -1 if the transaction was aborted
+ */
+static int
+defrag_evacuate_run(PMEMobjpool *pop, struct defrag_run *run,
+	struct defrag_run *runs, size_t nruns, const struct defrag_ref *refs,
+	struct defrag_move *moves, size_t *nmoves,
+	struct defrag_pinned *pinned)
+{
+	struct palloc_heap *heap = &pop->heap;
+
+	run->state = DEFRAG_RUN_EVACUATED;
+
+	for (size_t i = run->ref_begin; i < run->ref_end; ) {
+		size_t end = i + 1;
+		while (end < run->ref_end && refs[end].off == refs[i].off)
+			end++;
+
+		struct memory_block m = memblock_from_offset(heap, refs[i].off);
+
+		struct chunk_run *crun = heap_get_chunk_run(heap, &m);
+		struct chunk_header *hdr = heap_get_chunk_hdr(heap, &m);
+		struct alloc_class *c = alloc_class_by_run(
+			heap_alloc_classes(heap),
+			crun->hdr.block_size, hdr->flags, hdr->size_idx);
+		ASSERTne(c, NULL);
+
+		size_t size = m.m_ops->get_user_size(&m);
+		PMEMoid noid;
+		struct defrag_run *dest;
+		for (;;) {
+			noid = pmemobj_tx_xalloc(size, m.m_ops->get_extra(&m),
+				POBJ_CLASS_ID(c->id));
+			if (OID_IS_NULL(noid))
+				return -1;
+
+			struct memory_block nm =
+				memblock_from_offset(heap, noid.off);
+			dest = defrag_run_find(runs, nruns, &nm);
+			if (dest == NULL || dest->state != DEFRAG_RUN_EVACUATED)
+				break;
+
+			/*
+			 * The block belongs to a run that is supposed to
+			 * become empty. It stays reserved until the end of
+			 * the transaction so that the allocator moves on.
+			 */
+			if (VEC_PUSH_BACK(pinned, noid.off) != 0) {
+				ERR("!Malloc");
+				pmemobj_tx_abort(ENOMEM);
+				return -1;
+			}
+		}
+
+		if (dest != NULL && dest->state == DEFRAG_RUN_PENDING)
+			dest->state = DEFRAG_RUN_DESTINATION;
+
+		struct defrag_move *mv = &moves[(*nmoves)++];
+		mv->old_off = refs[i].off;
+		mv->new_off = noid.off;
+		mv->size = size;
+		mv->ref_begin = i;
+		mv->ref_end = end;
+
+		i = end;
+	}
+
+	return 0;
+}
+
+/*
+ * defrag_relocate -- (internal) moves the objects out of the candidate runs
+ *	and updates all persistent references, everything in one transaction
+ */
+static int
+defrag_relocate(PMEMobjpool *pop, PMEMoid **oidv,
+	const struct defrag_ref *refs, struct defrag_run *runs, size_t nruns,
+	struct defrag_run **candidates, size_t ncandidates,
+	struct defrag_move *moves, size_t *nmoves)
+{
+	struct defrag_pinned pinned;
+	VEC_INIT(&pinned);
+
+	int ret = pmemobj_tx_begin(pop, NULL, TX_PARAM_NONE);
+	if (ret != 0)
+		goto end;
+
+	for (size_t i = 0; i < ncandidates; ++i) {
+		if (candidates[i]->state != DEFRAG_RUN_PENDING)
+			continue;
+
+		if (defrag_evacuate_run(pop, candidates[i], runs, nruns, refs,
+				moves, nmoves, &pinned) != 0)
+			goto end;
+	}
+
+	/*
+	 * References have to be updated before the objects are copied so that
+	 * the ones stored inside of the relocated objects are carried over.
+	 */
+	for (size_t i = 0; i < *nmoves; ++i) {
+		for (size_t r = moves[i].ref_begin; r < moves[i].ref_end; ++r) {
+			PMEMoid *oidp = oidv[refs[r].idx];
+			if (!OBJ_PTR_FROM_POOL(pop, oidp))
+				continue;
+
+			if (pmemobj_tx_add_range_direct(oidp,
+					sizeof(*oidp)) != 0)
+				goto end;
+
+			oidp->off = moves[i].new_off;
+		}
+	}
+
+	for (size_t i = 0; i < *nmoves; ++i) {
+		/* the new objects are flushed on commit */
+		pmemops_memcpy(&pop->p_ops,
+			OBJ_OFF_TO_PTR(pop, moves[i].new_off),
+			OBJ_OFF_TO_PTR(pop, moves[i].old_off),
+			moves[i].size, PMEMOBJ_F_MEM_NOFLUSH);
+
+		PMEMoid oid = {pop->uuid_lo, moves[i].old_off};
+		if (pmemobj_tx_free(oid) != 0)
+			goto end;
+	}
+
+	uint64_t off;
+	VEC_FOREACH(off, &pinned) {
+		PMEMoid oid = {pop->uuid_lo, off};
+		if (pmemobj_tx_free(oid) != 0)
+			goto end;
+	}
+
+	pmemobj_tx_commit();
+
+end:
+	VEC_DELETE(&pinned);
+
+	ret = pmemobj_tx_end();
+	if (ret != 0) {
+		ERR("defragmentation transaction aborted");
+		errno = ret;
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * pmemobj_defrag -- moves the referenced objects out of sparsely populated
+ *	runs and reclaims the memory freed this way
+ */
+int
+pmemobj_defrag(PMEMobjpool *pop, PMEMoid **oidv, size_t oidcnt,
+	struct pobj_defrag_result *result)
+{
+	LOG(3, "pop %p oidv %p oidcnt %zu", pop, oidv, oidcnt);
+
+	if (result != NULL) {
+		result->total = 0;
+		result->relocated = 0;
+		result->reclaimed = 0;
+	}
+
+	if (oidcnt == 0)
+		return 0;
+
+	if (oidv == NULL) {
+		ERR("invalid reference table");
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (pmemobj_tx_stage() != TX_STAGE_NONE) {
+		ERR("defragmentation cannot be performed inside of a "
+			"transaction");
+		errno = EINVAL;
+		return -1;
+	}
+
+	PMEMOBJ_API_START();
+
+	int ret = -1;
+	struct defrag_ref *refs = NULL;
+	struct defrag_run *runs = NULL;
+	struct defrag_run **candidates = NULL;
+	struct defrag_move *moves = NULL;
+
+	if ((refs = Malloc(oidcnt * sizeof(*refs))) == NULL) {
+		ERR("!Malloc");
+		goto out;
+	}
+
+	size_t nrefs = 0;
+	for (size_t i = 0; i < oidcnt; ++i) {
+		if (oidv[i] == NULL || OID_IS_NULL(*oidv[i]))
+			continue;
+
+		if (oidv[i]->pool_uuid_lo != pop->uuid_lo ||
+		    !OBJ_OFF_FROM_HEAP(pop, oidv[i]->off)) {
+			ERR("object %zu does not belong to the pool", i);
+			errno = EINVAL;
+			goto out;
+		}
+
+		refs[nrefs].off = oidv[i]->off;
+		refs[nrefs].idx = i;
+		nrefs++;
+	}
+
+	if (nrefs == 0) {
+		ret = 0;
+		goto out;
+	}
+
+	qsort(refs, nrefs, sizeof(*refs), defrag_ref_cmp);
+
+	/* there can't be more runs or relocations than references */
+	runs = Malloc(nrefs * sizeof(*runs));
+	candidates = Malloc(nrefs * sizeof(*candidates));
+	moves = Malloc(nrefs * sizeof(*moves));
+	if (runs == NULL || candidates == NULL || moves == NULL) {
+		ERR("!Malloc");
+		goto out;
+	}
+
+	size_t nobjs;
+	size_t nruns = defrag_collect_runs(pop, refs, nrefs, runs, &nobjs);
+
+	size_t ncandidates = 0;
+	for (size_t i = 0; i < nruns; ++i) {
+		struct defrag_run *run = &runs[i];
+
+		/*
+		 * An object that isn't referenced by the table can't be
+		 * relocated, which means that the run wouldn't become empty.
+		 */
+		if (run->state != DEFRAG_RUN_PENDING ||
+		    run->tracked != run->used ||
+		    (uint64_t)run->used * 100 >
+		    (uint64_t)run->nallocs * DEFRAG_MAX_RUN_FILL_PCT) {
+			run->state = DEFRAG_RUN_IGNORED;
+			continue;
+		}
+
+		candidates[ncandidates++] = run;
+	}
+
+	qsort(candidates, ncandidates, sizeof(*candidates),
+		defrag_run_fill_cmp);
+
+	size_t nmoves = 0;
+	if (defrag_relocate(pop, oidv, refs, runs, nruns, candidates,
+			ncandidates, moves, &nmoves) != 0)
+		goto out;
+
+	/* the transaction is committed, it's safe to update the rest */
+	size_t relocated = 0;
+	for (size_t i = 0; i < nmoves; ++i) {
+		for (size_t r = moves[i].ref_begin; r < moves[i].ref_end; ++r) {
+			PMEMoid *oidp = oidv[refs[r].idx];
+			if (!OBJ_PTR_FROM_POOL(pop, oidp))
+				oidp->off = moves[i].new_off;
+		}
+
+		relocated += moves[i].size;
+	}
+
+	size_t reclaimed = heap_force_recycle(&pop->heap);
+
+	STATS_INC(pop->stats, transient, heap_defrag_relocated, relocated);
+	STATS_INC(pop->stats, transient, heap_defrag_reclaimed, reclaimed);
+
+	if (result != NULL) {
+		result->total = nobjs;
+		result->relocated = nmoves;
+		result->reclaimed = reclaimed;
+	}
+
+	ret = 0;
+
+out:
+	Free(moves);
+	Free(candidates);
+	Free(runs);
+	Free(refs);
+
+	PMEMOBJ_API_END();
+	return ret;
+}
@@ -48,9 +48,11 @@
 #include "recycler.h"
 #include "container_ravl.h"
 #include "container_seglists.h"
+#include "container_numa.h"
 #include "alloc_class.h"
 #include "os_thread.h"
 #include "set.h"
+#include "os_numa.h"
 
 #define MAX_RUN_LOCKS MAX_CHUNK
 #define MAX_RUN_LOCKS_VG 1024 /* avoid perf issues /w drd */
@@ -60,15 +62,28 @@
  */
 #define HEAP_DEFAULT_GROW_SIZE (1 << 27) /* 128 megabytes */
 
+/*
+ * The upper bound on the number of distinct NUMA nodes the heap keeps separate
+ * free chunk containers for, higher node ids are folded onto this range.
+ */
+#define HEAP_MAX_NUMA_NODES 64
+
+/* placeholder for zones whose NUMA node hasn't been queried yet */
+#define HEAP_NUMA_NODE_UNKNOWN UINT_MAX
+
 /*
  * Arenas store the collection of buckets for allocation classes. Each thread
- * is assigned an arena on its first allocator operation.
+ * is assigned an arena on its first allocator operation. If the heap spans
+ * multiple NUMA nodes, arenas are grouped by the node of their cpu and threads
+ * prefer the arenas local to the node they are running on.
  */
 struct arena {
 	/* one bucket per allocation class */
 	struct bucket *buckets[MAX_ALLOCATION_CLASSES];
 
 	size_t nthreads;
+
+	unsigned node;
 };
 
 struct heap_rt {
@@ -92,6 +107,19 @@ struct heap_rt {
 	unsigned nzones;
 	unsigned zones_exhausted;
 	unsigned narenas;
+
+	/* number of NUMA nodes the heap is aware of, 1 if NUMA-unaware */
+	unsigned nnodes;
+
+	/* mask of the nodes the parts of the pool reside on */
+	uint64_t part_nodes;
+
+	/*
+	 * NUMA node of each zone, detected when the zone is first used,
+	 * protected by the default bucket lock
+	 */
+	unsigned *zone_nodes;
+	unsigned nzone_nodes;
 };
 
 /*
@@ -108,9 +136,10 @@ heap_alloc_classes(struct palloc_heap *heap)
  * heap_arena_init -- (internal) initializes arena instance
  */
 static void
-heap_arena_init(struct arena *arena)
+heap_arena_init(struct arena *arena, unsigned node)
 {
 	arena->nthreads = 0;
+	arena->node = node;
 
 	for (int i = 0; i < MAX_ALLOCATION_CLASSES; ++i)
 		arena->buckets[i] = NULL;
@@ -147,6 +176,19 @@ heap_thread_arena_destructor(void *arg)
 	util_fetch_and_sub64(&a->nthreads, 1);
 }
 
+/*
+ * heap_numa_node_idx -- folds the os node number into the range of nodes
+ *	tracked by the heap, unknown nodes are mapped to the first one
+ */
+unsigned
+heap_numa_node_idx(unsigned nnodes, int node)
+{
+	if (node < 0)
+		return 0;
+
+	return (unsigned)node % nnodes;
+}
+
 /*
  * heap_thread_arena_assign -- (internal) assigns the least used arena
  *	to current thread
@@ -155,6 +197,9 @@ heap_thread_arena_destructor(void *arg)
  * used arena, a lock is used, but the nthreads counter of the arena is still
  * bumped using atomic instruction because it can happen in parallel to a
  * destructor of a thread, which also touches that variable.
+ *
+ * On NUMA-aware heaps the search is first limited to the arenas of the node
+ * the thread is currently running on.
  */
 static struct arena *
 heap_thread_arena_assign(struct heap_rt *heap)
@@ -167,10 +212,28 @@ heap_thread_arena_assign(struct heap_rt *heap)
 
 	ASSERTne(heap->narenas, 0);
 
-	for (unsigned i = 0; i < heap->narenas; ++i) {
-		a = &heap->arenas[i];
-		if (least_used == NULL || a->nthreads < least_used->nthreads)
-			least_used = a;
+	if (heap->nnodes > 1) {
+		unsigned node = heap_numa_node_idx(heap->nnodes,
+			os_numa_current_node());
+
+		for (unsigned i = 0; i < heap->narenas; ++i) {
+			a = &heap->arenas[i];
+			if (a->node != node)
+				continue;
+			if (least_used == NULL ||
+			    a->nthreads < least_used->nthreads)
+				least_used = a;
+		}
+	}
+
+	/* NUMA-unaware heap or no arena on the local node */
+	if (least_used == NULL) {
+		for (unsigned i = 0; i < heap->narenas; ++i) {
+			a = &heap->arenas[i];
+			if (least_used == NULL ||
+			    a->nthreads < least_used->nthreads)
+				least_used = a;
+		}
 	}
 
 	LOG(4, "assigning %p arena to current thread", least_used);
@@ -198,6 +261,148 @@ heap_thread_arena(struct heap_rt *heap)
 	return a;
 }
 
+/*
+ * heap_numa_nnodes -- returns the number of NUMA nodes the heap distinguishes
+ */
+unsigned
+heap_numa_nnodes(struct palloc_heap *heap)
+{
+	return heap->rt->nnodes;
+}
+
+/*
+ * heap_thread_numa_node -- returns the NUMA node of the arena assigned to the
+ *	current thread
+ */
+unsigned
+heap_thread_numa_node(struct palloc_heap *heap)
+{
+	return heap_thread_arena(heap->rt)->node;
+}
+
+/*
+ * heap_zone_numa_node -- returns the NUMA node the given zone resides on
+ *
+ * The node is queried from the os the first time a zone is looked up, which
+ * happens only once the zone is in use and its header has been accessed, so
+ * that no memory is faulted in just for the sake of the query.
+ *
+ * The caller must hold the default bucket lock.
+ */
+unsigned
+heap_zone_numa_node(struct palloc_heap *heap, uint32_t zone_id)
+{
+	struct heap_rt *h = heap->rt;
+
+	if (zone_id >= h->nzone_nodes)
+		return 0;
+
+	if (h->zone_nodes[zone_id] == HEAP_NUMA_NODE_UNKNOWN) {
+		struct zone *z = ZID_TO_ZONE(heap->layout, zone_id);
+		h->zone_nodes[zone_id] = heap_numa_node_idx(h->nnodes,
+			os_numa_addr_node(z));
+	}
+
+	return h->zone_nodes[zone_id];
+}
+
+/*
+ * heap_numa_part_nodes -- (internal) returns the mask of the nodes the parts
+ *	of the pool reside on, only the first page of every part is queried
+ */
+static uint64_t
+heap_numa_part_nodes(struct palloc_heap *heap, unsigned nnodes)
+{
+	if (heap->set == NULL)
+		return 0;
+
+	struct pool_replica *rep = heap->set->replica[0];
+
+	uint64_t mask = 0;
+	for (unsigned p = 0; p < rep->nparts; ++p) {
+		int node = os_numa_addr_node(rep->part[p].addr);
+		if (node >= 0)
+			mask |= 1ULL << heap_numa_node_idx(nnodes, node);
+	}
+
+	return mask;
+}
+
+/*
+ * heap_numa_init -- (internal) prepares the tracking of the zone NUMA
+ *	placement
+ *
+ * The heap becomes NUMA-aware only if the parts of the pool reside on more
+ * than one node. The placement of the individual zones is only detected when
+ * they are used.
+ */
+static void
+heap_numa_init(struct palloc_heap *heap)
+{
+	struct heap_rt *h = heap->rt;
+
+	h->nnodes = 1;
+	h->part_nodes = 0;
+	h->zone_nodes = NULL;
+	h->nzone_nodes = 0;
+
+	unsigned nnodes = os_numa_nnodes();
+	if (nnodes <= 1)
+		return;
+
+	nnodes = nnodes < HEAP_MAX_NUMA_NODES ? nnodes : HEAP_MAX_NUMA_NODES;
+
+	uint64_t part_nodes = heap_numa_part_nodes(heap, nnodes);
+	if (util_popcount64(part_nodes) <= 1) {
+		LOG(3, "heap resides on a single NUMA node");
+		return;
+	}
+
+	h->zone_nodes = Malloc(sizeof(*h->zone_nodes) * h->nzones);
+	if (h->zone_nodes == NULL) {
+		LOG(3, "unable to track zone NUMA placement");
+		return;
+	}
+
+	for (uint32_t i = 0; i < h->nzones; ++i)
+		h->zone_nodes[i] = HEAP_NUMA_NODE_UNKNOWN;
+
+	h->nnodes = nnodes;
+	h->part_nodes = part_nodes;
+	h->nzone_nodes = h->nzones;
+
+	LOG(3, "heap tracks %u NUMA nodes", h->nnodes);
+}
+
+/*
+ * heap_numa_extend -- (internal) records the NUMA node of a newly
+ *	created zone
+ */
+static void
+heap_numa_extend(struct palloc_heap *heap, uint32_t nzones)
+{
+	struct heap_rt *h = heap->rt;
+
+	if (h->nnodes <= 1)
+		return;
+
+	unsigned *nodes = Realloc(h->zone_nodes,
+		sizeof(*h->zone_nodes) * nzones);
+	if (nodes == NULL) {
+		LOG(3, "unable to track zone NUMA placement");
+		return;
+	}
+
+	h->zone_nodes = nodes;
+	for (uint32_t i = h->nzone_nodes; i < nzones; ++i)
+		h->zone_nodes[i] = HEAP_NUMA_NODE_UNKNOWN;
+
+	h->nzone_nodes = nzones;
+
+	/* the new zone has just been initialized, querying it is free */
+	h->part_nodes |= 1ULL << heap_zone_numa_node(heap, nzones - 1);
+}
+
 /*
  * heap_bucket_acquire_by_id -- fetches by id a bucket exclusive for the thread
  *	until heap_bucket_release is called
@@ -513,17 +718,37 @@ heap_populate_bucket(struct palloc_heap *heap, struct bucket *bucket)
 	if (h->zones_exhausted == h->nzones)
 		return ENOMEM;
 
-	uint32_t zone_id = h->zones_exhausted++;
-	struct zone *z = ZID_TO_ZONE(heap->layout, zone_id);
+	/*
+	 * Zones are processed one by one, but on NUMA-aware heaps up to one
+	 * zone per node of the pool is processed in search of a zone local to
+	 * the calling thread, so that its chunks are found before the remote
+	 * ones are handed out. Threads on nodes without any part of the pool
+	 * have nothing to search for.
+	 */
+	unsigned local = 0;
+	unsigned nsearch = 1;
+	if (h->nnodes > 1) {
+		local = heap_thread_numa_node(heap);
+		if (h->part_nodes & (1ULL << local))
+			nsearch = util_popcount64(h->part_nodes);
+	}
 
-	/* ignore zone and chunk headers */
-	VALGRIND_ADD_TO_GLOBAL_TX_IGNORE(z, sizeof(z->header) +
-		sizeof(z->chunk_headers));
+	unsigned processed = 0;
+	uint32_t zone_id;
+	do {
+		zone_id = h->zones_exhausted++;
+		struct zone *z = ZID_TO_ZONE(heap->layout, zone_id);
 
-	if (z->header.magic != ZONE_HEADER_MAGIC)
-		heap_zone_init(heap, zone_id, 0);
+		/* ignore zone and chunk headers */
+		VALGRIND_ADD_TO_GLOBAL_TX_IGNORE(z, sizeof(z->header) +
+			sizeof(z->chunk_headers));
+
+		if (z->header.magic != ZONE_HEADER_MAGIC)
+			heap_zone_init(heap, zone_id, 0);
 
-	heap_reclaim_zone_garbage(heap, bucket, zone_id);
+		heap_reclaim_zone_garbage(heap, bucket, zone_id);
+	} while (++processed < nsearch && h->zones_exhausted != h->nzones &&
+		heap_zone_numa_node(heap, zone_id) != local);
 
 	/*
 	 * It doesn't matter that this function might not have found any
@@ -539,22 +764,26 @@ heap_populate_bucket(struct palloc_heap *heap, struct bucket *bucket)
  *
  * If force is not set, this function might effectively be a noop if not enough
  * of space was freed.
+ *
+ * Returns the number of bytes turned into free chunks.
  */
-static int
+static size_t
 heap_recycle_unused(struct palloc_heap *heap, struct recycler *recycler,
 	struct bucket *defb, int force)
 {
 	struct empty_runs r = recycler_recalc(recycler, force);
 	if (VEC_SIZE(&r) == 0)
-		return ENOMEM;
+		return 0;
 
 	struct bucket *nb = defb == NULL ? heap_bucket_acquire_by_id(heap,
 		DEFAULT_ALLOC_CLASS_ID) : NULL;
 
 	ASSERT(defb != NULL || nb != NULL);
 
+	size_t reclaimed = 0;
 	struct memory_block *nm;
 	VEC_FOREACH_BY_PTR(nm, &r) {
+		reclaimed += heap_get_chunk_hdr(heap, nm)->size_idx * CHUNKSIZE;
 		heap_run_into_free_chunk(heap, defb ? defb : nb, nm);
 	}
 
@@ -563,7 +792,7 @@ heap_recycle_unused(struct palloc_heap *heap, struct recycler *recycler,
 
 	VEC_DELETE(&r);
 
-	return 0;
+	return reclaimed;
 }
 
 /*
@@ -578,13 +807,37 @@ heap_reclaim_garbage(struct palloc_heap *heap, struct bucket *bucket)
 		if ((r = heap->rt->recyclers[i]) == NULL)
 			continue;
 
-		if (heap_recycle_unused(heap, r, bucket, 1) == 0)
+		if (heap_recycle_unused(heap, r, bucket, 1) != 0)
 			ret = 0;
 	}
 
 	return ret;
 }
 
+/*
+ * heap_force_recycle -- turns all of the empty runs back into free chunks,
+ *	returns the number of bytes reclaimed this way
+ */
+size_t
+heap_force_recycle(struct palloc_heap *heap)
+{
+	struct bucket *defb = heap_bucket_acquire_by_id(heap,
+		DEFAULT_ALLOC_CLASS_ID);
+
+	size_t reclaimed = 0;
+	struct recycler *r;
+	for (size_t i = 0; i < MAX_ALLOCATION_CLASSES; ++i) {
+		if ((r = heap->rt->recyclers[i]) == NULL)
+			continue;
+
+		reclaimed += heap_recycle_unused(heap, r, defb, 1);
+	}
+
+	heap_bucket_release(heap, defb);
+
+	return reclaimed;
+}
+
 /*
  * heap_ensure_huge_bucket_filled --
  *	(internal) refills the default bucket if needed
@@ -982,7 +1235,10 @@ heap_buckets_init(struct palloc_heap *heap)
 		}
 	}
 
-	h->default_bucket = bucket_new(container_new_ravl(heap),
+	struct block_container *defc = h->nnodes > 1 ?
+		container_new_numa(heap) : container_new_ravl(heap);
+
+	h->default_bucket = bucket_new(defc,
 		alloc_class_by_id(h->alloc_classes, DEFAULT_ALLOC_CLASS_ID));
 
 	if (h->default_bucket == NULL)
@@ -1028,6 +1284,7 @@ heap_extend(struct palloc_heap *heap, struct bucket *b, size_t size)
 	heap_zone_init(heap, zone_id, chunk_id);
 
 	if (heap->rt->nzones != nzones) {
+		heap_numa_extend(heap, nzones);
 		heap->rt->nzones = nzones;
 		return 0;
 	}
@@ -1136,8 +1393,13 @@ heap_boot(struct palloc_heap *heap, void *heap_start, uint64_t heap_size,
 	heap->alloc_pattern = PALLOC_CTL_DEBUG_NO_PATTERN;
 	VALGRIND_DO_CREATE_MEMPOOL(heap->layout, 0, 0);
 
-	for (unsigned i = 0; i < h->narenas; ++i)
-		heap_arena_init(&h->arenas[i]);
+	heap_numa_init(heap);
+
+	for (unsigned i = 0; i < h->narenas; ++i) {
+		unsigned node = h->nnodes > 1 ?
+			heap_numa_node_idx(h->nnodes, os_numa_cpu_node(i)) : 0;
+		heap_arena_init(&h->arenas[i], node);
+	}
 
 	for (unsigned i = 0; i < MAX_ALLOCATION_CLASSES; ++i)
 		h->recyclers[i] = NULL;
@@ -1237,6 +1499,8 @@ heap_cleanup(struct palloc_heap *heap)
 
 	Free(rt->arenas);
 
+	Free(rt->zone_nodes);
+
 	for (int i = 0; i < MAX_ALLOCATION_CLASSES; ++i) {
 		if (heap->rt->recyclers[i] == NULL)
 			continue;
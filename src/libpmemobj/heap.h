@@ -84,6 +84,13 @@ heap_bucket_acquire_by_id(struct palloc_heap *heap, uint8_t class_id);
 void
 heap_bucket_release(struct palloc_heap *heap, struct bucket *b);
 
+size_t heap_force_recycle(struct palloc_heap *heap);
+
+unsigned heap_numa_node_idx(unsigned nnodes, int node);
+unsigned heap_numa_nnodes(struct palloc_heap *heap);
+unsigned heap_thread_numa_node(struct palloc_heap *heap);
+unsigned heap_zone_numa_node(struct palloc_heap *heap, uint32_t zone_id);
+
 int heap_get_bestfit_block(struct palloc_heap *heap, struct bucket *b,
 	struct memory_block *m);
 struct memory_block
@@ -253,6 +253,8 @@ lane_init(PMEMobjpool *pop, struct lane *lane, struct lane_layout *layout)
 	if (lane->undo == NULL)
 		goto error_undo_new;
 
+	operation_set_ulog_gen(lane->undo, pop->ulog_gen);
+
 	return 0;
 
 error_undo_new:
@@ -416,6 +418,7 @@ lane_recover_and_section_boot(PMEMobjpool *pop)
 				i, err);
 			return err;
 		}
+		operation_set_ulog_gen(ctx, pop->ulog_gen);
 		operation_resume(ctx);
 		operation_process(ctx);
 		operation_finish(ctx);
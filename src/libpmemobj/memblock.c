@@ -677,17 +677,17 @@ huge_prep_operation_hdr(const struct memory_block *m, enum memblock_state op,
 }
 
 /*
- * run_prep_operation_hdr -- prepares the new value for a select few bytes of
- *	a run bitmap that will be set after the operation concludes.
+ * memblock_run_bitmap_word -- returns the 8-byte value of a run bitmap that
+ *	contains the bits representing the memory block, and sets the mask
+ *	that selects those bits.
  *
- * It's VERY important to keep in mind that the particular value of the
- * bitmap this method is modifying must not be changed after this function
- * is called and before the operation is processed.
+ * Like get_bitmap, this exposes implementation details of runs and should be
+ * used only where the bitmap updates of many blocks need to be combined.
  */
-static void
-run_prep_operation_hdr(const struct memory_block *m, enum memblock_state op,
-	struct operation_context *ctx)
+uint64_t *
+memblock_run_bitmap_word(const struct memory_block *m, uint64_t *bmask)
 {
+	ASSERTeq(m->type, MEMORY_BLOCK_RUN);
 	ASSERT(m->size_idx <= RUN_BITS_PER_VALUE);
 
 	/*
@@ -699,12 +699,11 @@ run_prep_operation_hdr(const struct memory_block *m, enum memblock_state op,
 	 * the block offset are tied 1:1 to the bitmap this operation is
 	 * relatively simple.
 	 */
-	uint64_t bmask;
 	if (m->size_idx == RUN_BITS_PER_VALUE) {
 		ASSERTeq(m->block_off % RUN_BITS_PER_VALUE, 0);
-		bmask = UINT64_MAX;
+		*bmask = UINT64_MAX;
 	} else {
-		bmask = ((1ULL << m->size_idx) - 1ULL) <<
+		*bmask = ((1ULL << m->size_idx) - 1ULL) <<
 				(m->block_off % RUN_BITS_PER_VALUE);
 	}
 
@@ -717,13 +716,29 @@ run_prep_operation_hdr(const struct memory_block *m, enum memblock_state op,
 	struct run_bitmap b;
 	run_get_bitmap(m, &b);
 
+	return &b.values[bpos];
+}
+
+/*
+ * run_prep_operation_hdr -- prepares the new value for a select few bytes of
+ *	a run bitmap that will be set after the operation concludes.
+ *
+ * It's VERY important to keep in mind that the particular value of the
+ * bitmap this method is modifying must not be changed after this function
+ * is called and before the operation is processed.
+ */
+static void
+run_prep_operation_hdr(const struct memory_block *m, enum memblock_state op,
+	struct operation_context *ctx)
+{
+	uint64_t bmask;
+	uint64_t *value = memblock_run_bitmap_word(m, &bmask);
+
 	/* the bit mask is applied immediately by the add entry operations */
 	if (op == MEMBLOCK_ALLOCATED) {
-		operation_add_entry(ctx, &b.values[bpos],
-			bmask, ULOG_OPERATION_OR);
+		operation_add_entry(ctx, value, bmask, ULOG_OPERATION_OR);
 	} else if (op == MEMBLOCK_FREE) {
-		operation_add_entry(ctx, &b.values[bpos],
-			~bmask, ULOG_OPERATION_AND);
+		operation_add_entry(ctx, value, ~bmask, ULOG_OPERATION_AND);
 	} else {
 		ASSERT(0);
 	}
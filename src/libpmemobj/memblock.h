@@ -314,6 +314,9 @@ void memblock_run_bitmap(uint32_t *size_idx, uint16_t flags,
 	uint64_t unit_size, uint64_t alignment, void *content,
 	struct run_bitmap *b);
 
+uint64_t *memblock_run_bitmap_word(const struct memory_block *m,
+	uint64_t *bmask);
+
 #ifdef __cplusplus
 }
 #endif
@@ -47,10 +47,16 @@
 #include "obj.h"
 #include "out.h"
 #include "valgrind_internal.h"
-#include "vecq.h"
 
 #define ULOG_BASE_SIZE 1024
-#define OP_MERGE_SEARCH 64
+#define OP_MERGE_INIT_CAPACITY 64 /* initial number of merge index slots */
+
+/*
+ * Redo logs with entries that, along with the terminating zero entry, fit in
+ * a single cacheline are stored and processed in a compact manner.
+ */
+#define OP_COMPACT_REDO_NBYTES\
+	(CACHELINE_SIZE - sizeof(struct ulog_entry_base))
 
 struct operation_log {
 	size_t capacity; /* capacity of the ulog log */
@@ -58,6 +64,15 @@ struct operation_log {
 	struct ulog *ulog; /* DRAM allocated log of modifications */
 };
 
+/*
+ * operation_merge_slot -- slot of the index of mergeable log entries
+ */
+struct operation_merge_slot {
+	uint64_t offset; /* pool offset of the modified 8-byte word */
+	size_t pos; /* position of the entry in the shadow ulog data */
+	uint64_t epoch; /* the slot is empty if it's not the current epoch */
+};
+
 /*
  * operation_context -- context of an ongoing palloc operation
  */
@@ -82,13 +97,26 @@ struct operation_context {
 
 	struct ulog_next next; /* vector of 'next' fields of persistent ulog */
 
+	size_t ulog_retain; /* capacity of next ulogs kept between operations */
+	size_t ulog_decay; /* idle operations after which they are released */
+	size_t ulog_idle; /* operations in a row that fit in the first ulogs */
+
+	int ulog_gen; /* invalidate the ulog by starting a new generation */
+
 	int in_progress; /* operation sanity check */
 
 	struct operation_log pshadow_ops; /* shadow copy of persistent ulog */
 	struct operation_log transient_ops; /* log of transient changes */
 
-	/* collection used to look for potential merge candidates */
-	VECQ(, struct ulog_entry_val *) merge_entries;
+	/* open-addressed offset index used to look for merge candidates */
+	struct operation_merge_slot *merge_slots;
+	size_t merge_capacity; /* number of slots, always a power of two */
+	size_t merge_count; /* slots used in the current epoch */
+	uint64_t merge_epoch; /* incremented at the start of each operation */
+
+	/* checksum of the shadow ulog header, 0 if not calculated yet */
+	uint64_t compact_csum;
+	uint64_t compact_next; /* next ulog for which the checksum is valid */
 };
 
 /*
@@ -203,7 +231,17 @@ operation_new(struct ulog *ulog, size_t ulog_base_nbytes,
 	ctx->s_ops.flush = operation_transient_clean;
 	ctx->s_ops.memcpy = operation_transient_memcpy;
 
-	VECQ_INIT(&ctx->merge_entries);
+	ctx->merge_capacity = OP_MERGE_INIT_CAPACITY;
+	ctx->merge_count = 0;
+	ctx->merge_epoch = 0;
+	ctx->compact_csum = 0;
+	ctx->compact_next = 0;
+	ctx->merge_slots = Zalloc(sizeof(struct operation_merge_slot) *
+		ctx->merge_capacity);
+	if (ctx->merge_slots == NULL) {
+		ERR("!Zalloc");
+		goto error_ulog_alloc;
+	}
 
 	if (operation_log_transient_init(&ctx->transient_ops) != 0)
 		goto error_ulog_alloc;
@@ -226,7 +264,7 @@ error_ctx_alloc:
 void
 operation_delete(struct operation_context *ctx)
 {
-	VECQ_DELETE(&ctx->merge_entries);
+	Free(ctx->merge_slots);
 	VEC_DELETE(&ctx->next);
 	Free(ctx->pshadow_ops.ulog);
 	Free(ctx->transient_ops.ulog);
@@ -257,51 +295,167 @@ operation_merge(struct ulog_entry_base *entry, uint64_t value,
 	}
 }
 
+/*
+ * operation_merge_hash -- (internal) hashes the offset of a log entry
+ */
+static inline size_t
+operation_merge_hash(uint64_t offset)
+{
+	/* offsets are 8-byte aligned, fibonacci hashing spreads the rest */
+	return (size_t)(((offset >> 3) * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+/*
+ * operation_merge_find -- (internal) returns the slot used by the offset
+ *	or the empty slot into which the offset should be inserted
+ */
+static struct operation_merge_slot *
+operation_merge_find(struct operation_context *ctx, uint64_t offset)
+{
+	size_t mask = ctx->merge_capacity - 1;
+	size_t i = operation_merge_hash(offset) & mask;
+
+	for (;;) {
+		struct operation_merge_slot *slot = &ctx->merge_slots[i];
+		if (slot->epoch != ctx->merge_epoch || slot->offset == offset)
+			return slot;
+
+		i = (i + 1) & mask;
+	}
+}
+
+/*
+ * operation_merge_grow -- (internal) doubles the capacity of the merge index
+ */
+static int
+operation_merge_grow(struct operation_context *ctx)
+{
+	struct operation_merge_slot *old = ctx->merge_slots;
+	size_t old_capacity = ctx->merge_capacity;
+
+	struct operation_merge_slot *slots = Zalloc(
+		sizeof(struct operation_merge_slot) * old_capacity * 2);
+	if (slots == NULL)
+		return -1;
+
+	ctx->merge_slots = slots;
+	ctx->merge_capacity = old_capacity * 2;
+
+	for (size_t i = 0; i < old_capacity; ++i) {
+		if (old[i].epoch == ctx->merge_epoch)
+			*operation_merge_find(ctx, old[i].offset) = old[i];
+	}
+
+	Free(old);
+
+	return 0;
+}
+
+/*
+ * operation_merge_lookup -- (internal) finds the merge index slot for the
+ *	offset, returns NULL if the entry cannot be tracked
+ *
+ * The index is kept at most half full so that the linear probing sequences
+ * stay short. The slots are reused across operations, which means that once
+ * the index has grown large enough for the workload, no allocations happen.
+ */
+static struct operation_merge_slot *
+operation_merge_lookup(struct operation_context *ctx, uint64_t offset)
+{
+	if ((ctx->merge_count + 1) * 2 > ctx->merge_capacity &&
+	    operation_merge_grow(ctx) != 0) {
+		/* this is fine, only runtime perf will get slower */
+		LOG(2, "out of memory - unable to grow the merge index");
+		if (ctx->merge_count + 1 >= ctx->merge_capacity)
+			return NULL;
+	}
+
+	return operation_merge_find(ctx, offset);
+}
+
 /*
  * operation_try_merge_entry -- tries to merge the incoming log entry with
- *	existing entries
+ *	the most recent existing entry for the same offset
  *
- * Because this requires a reverse foreach, it cannot be implemented using
- * the on-media ulog log structure since there's no way to find what's
- * the previous entry in the log. Instead, the last N entries are stored
- * in a collection and traversed backwards.
+ * Because this requires looking back at previous entries, it cannot be
+ * implemented using the on-media ulog log structure since there's no way to
+ * find what's the previous entry in the log. Instead, the position of the
+ * last entry for every offset is stored in an index, unless the log is small
+ * enough to be simply searched.
  */
 static int
-operation_try_merge_entry(struct operation_context *ctx,
-	void *ptr, uint64_t value, ulog_operation_type type)
-{
-	int ret = 0;
-	uint64_t offset = OBJ_PTR_TO_OFF(ctx->p_ops->base, ptr);
-
-	struct ulog_entry_val *e;
-	VECQ_FOREACH_REVERSE(e, &ctx->merge_entries) {
-		if (ulog_entry_offset(&e->base) == offset) {
-			if (ulog_entry_type(&e->base) == type) {
-				operation_merge(&e->base, value, type);
-				return 1;
-			} else {
-				break;
-			}
-		}
+operation_try_merge_entry(struct ulog_entry_val *e, uint64_t value,
+	ulog_operation_type type)
+{
+	if (e == NULL || ulog_entry_type(&e->base) != type)
+		return 0;
+
+	operation_merge(&e->base, value, type);
+
+	return 1;
+}
+
+/*
+ * operation_compact_find -- (internal) returns the most recent entry for the
+ *	offset in a shadow log that isn't indexed yet
+ */
+static struct ulog_entry_val *
+operation_compact_find(struct operation_context *ctx, uint64_t offset)
+{
+	struct operation_log *plog = &ctx->pshadow_ops;
+
+	for (size_t pos = plog->offset; pos != 0; ) {
+		pos -= sizeof(struct ulog_entry_val);
+		struct ulog_entry_val *e = (struct ulog_entry_val *)
+			(plog->ulog->data + pos);
+		if (ulog_entry_offset(&e->base) == offset)
+			return e;
 	}
 
-	return ret;
+	return NULL;
 }
 
 /*
- * operation_merge_entry_add -- adds a new entry to the merge collection,
- *	keeps capacity at OP_MERGE_SEARCH. Removes old entries in FIFO fashion.
+ * operation_merge_entry_add -- (internal) makes the entry at the given
+ *	position the merge candidate for its offset
  */
 static void
 operation_merge_entry_add(struct operation_context *ctx,
-	struct ulog_entry_val *entry)
+	struct operation_merge_slot *slot, uint64_t offset, size_t pos)
 {
-	if (VECQ_SIZE(&ctx->merge_entries) == OP_MERGE_SEARCH)
-		(void) VECQ_DEQUEUE(&ctx->merge_entries);
+	if (slot->epoch != ctx->merge_epoch) {
+		slot->epoch = ctx->merge_epoch;
+		slot->offset = offset;
+		ctx->merge_count++;
+	}
 
-	if (VECQ_ENQUEUE(&ctx->merge_entries, entry) != 0) {
-		/* this is fine, only runtime perf will get slower */
-		LOG(2, "out of memory - unable to track entries");
+	slot->pos = pos;
+}
+
+/*
+ * operation_merge_index_entries -- (internal) indexes the entries which were
+ *	added while the shadow log was small enough to be searched
+ */
+static void
+operation_merge_index_entries(struct operation_context *ctx)
+{
+	struct operation_log *plog = &ctx->pshadow_ops;
+
+	struct ulog_entry_base *e;
+	for (size_t pos = 0; pos < plog->offset; pos += ulog_entry_size(e)) {
+		e = (struct ulog_entry_base *)(plog->ulog->data + pos);
+
+		/* only the value entries can be merged */
+		ulog_operation_type t = ulog_entry_type(e);
+		if (t == ULOG_OPERATION_BUF_CPY || t == ULOG_OPERATION_BUF_SET)
+			continue;
+
+		uint64_t offset = ulog_entry_offset(e);
+
+		struct operation_merge_slot *slot =
+			operation_merge_lookup(ctx, offset);
+		if (slot != NULL)
+			operation_merge_entry_add(ctx, slot, offset, pos);
 	}
 }
 
@@ -332,22 +486,46 @@ operation_add_typed_entry(struct operation_context *ctx,
 		oplog->ulog = ulog;
 
 		/*
-		 * Realloc invalidated the ulog entries that are inside of this
-		 * vector, need to clear it to avoid use after free.
+		 * The transient log is processed directly, so its entries
+		 * are iterated up to the capacity of the ulog itself.
 		 */
-		VECQ_CLEAR(&ctx->merge_entries);
+		if (log_type == LOG_TRANSIENT)
+			ulog->capacity = oplog->capacity;
 	}
 
-	if (log_type == LOG_PERSISTENT &&
-		operation_try_merge_entry(ctx, ptr, value, type) != 0)
-		return 0;
+	/*
+	 * The index stores positions of the entries rather than pointers,
+	 * so it remains valid across reallocations of the shadow log.
+	 */
+	struct operation_merge_slot *slot = NULL;
+	uint64_t offset = 0;
+	if (log_type == LOG_PERSISTENT) {
+		offset = OBJ_PTR_TO_OFF(ctx->p_ops->base, ptr);
+		struct ulog_entry_val *e = NULL;
+
+		if (oplog->offset < OP_COMPACT_REDO_NBYTES) {
+			/* searching a few entries is cheaper than indexing */
+			e = operation_compact_find(ctx, offset);
+		} else {
+			if (ctx->merge_count == 0)
+				operation_merge_index_entries(ctx);
+
+			slot = operation_merge_lookup(ctx, offset);
+			if (slot != NULL && slot->epoch == ctx->merge_epoch)
+				e = (struct ulog_entry_val *)
+					(oplog->ulog->data + slot->pos);
+		}
+
+		if (operation_try_merge_entry(e, value, type) != 0)
+			return 0;
+	}
 
 	struct ulog_entry_val *entry = ulog_entry_val_create(
 		oplog->ulog, oplog->offset, ptr, value, type,
 		log_type == LOG_TRANSIENT ? &ctx->t_ops : &ctx->s_ops);
 
-	if (log_type == LOG_PERSISTENT)
-		operation_merge_entry_add(ctx, entry);
+	if (slot != NULL)
+		operation_merge_entry_add(ctx, slot, offset, oplog->offset);
 
 	oplog->offset += ulog_entry_size(&entry->base);
 
@@ -372,6 +550,81 @@ operation_add_entry(struct operation_context *ctx, void *ptr, uint64_t value,
 		from_pool ? LOG_PERSISTENT : LOG_TRANSIENT);
 }
 
+/*
+ * operation_ulog_space -- (internal) returns the number of bytes left in the
+ *	persistent ulog in which the shadow log data at the given offset is
+ *	stored
+ */
+static size_t
+operation_ulog_space(struct operation_context *ctx, size_t offset)
+{
+	struct ulog *ulog = ctx->ulog;
+	size_t end = ctx->ulog_base_nbytes;
+
+	while (offset >= end) {
+		ulog = ulog_next(ulog, ctx->p_ops);
+		ASSERTne(ulog, NULL);
+
+		end += ulog->capacity;
+	}
+
+	return end - offset;
+}
+
+/*
+ * operation_add_redo_buffer -- (internal) adds a buffer operation to the
+ *	shadow copy of the redo log
+ *
+ * The shadow log is stored in the persistent ulogs only when the operation is
+ * processed, and so, unlike in the undo log, the buffer entries are split at
+ * the boundaries of the ulogs upfront. Buffer entries have to start at
+ * a cacheline, which is why they must be added before any value entries.
+ */
+static int
+operation_add_redo_buffer(struct operation_context *ctx,
+	void *dest, const void *src, size_t size, ulog_operation_type type)
+{
+	struct operation_log *plog = &ctx->pshadow_ops;
+	ASSERTeq(plog->offset % CACHELINE_SIZE, 0);
+
+	while (size != 0) {
+		size_t real_size = ALIGN_UP(
+			sizeof(struct ulog_entry_buf) + size, CACHELINE_SIZE);
+
+		/* the spare cacheline is used to zero out the next entry */
+		size_t nbytes = plog->offset + real_size + CACHELINE_SIZE;
+		if (operation_reserve(ctx, nbytes) != 0)
+			return -1;
+
+		if (nbytes > plog->capacity) {
+			size_t ncapacity = ALIGN_UP(nbytes,
+				(size_t)ULOG_BASE_SIZE);
+			struct ulog *ulog = Realloc(plog->ulog,
+				SIZEOF_ULOG(ncapacity));
+			if (ulog == NULL)
+				return -1;
+			plog->capacity = ncapacity;
+			plog->ulog = ulog;
+		}
+
+		size_t entry_size = MIN(real_size,
+			operation_ulog_space(ctx, plog->offset));
+		size_t data_size = MIN(size,
+			entry_size - sizeof(struct ulog_entry_buf));
+
+		struct ulog_entry_buf *e = ulog_entry_buf_create_shadow(
+			plog->ulog, plog->offset, ctx->ulog->gen_num,
+			dest, src, data_size, type, &ctx->s_ops);
+		plog->offset += ulog_entry_size(&e->base);
+
+		dest = (char *)dest + data_size;
+		src = (const char *)src + data_size;
+		size -= data_size;
+	}
+
+	return 0;
+}
+
 /*
  * operation_add_buffer -- adds a buffer operation to the log
  */
@@ -379,6 +632,9 @@ int
 operation_add_buffer(struct operation_context *ctx,
 	void *dest, void *src, size_t size, ulog_operation_type type)
 {
+	if (ctx->type == LOG_TYPE_REDO)
+		return operation_add_redo_buffer(ctx, dest, src, size, type);
+
 	size_t real_size = size + sizeof(struct ulog_entry_buf);
 
 	/* if there's no space left in the log, reserve some more */
@@ -398,7 +654,7 @@ operation_add_buffer(struct operation_context *ctx,
 
 	/* create a persistent log entry */
 	struct ulog_entry_buf *e = ulog_entry_buf_create(ctx->ulog_curr,
-		ctx->ulog_curr_offset,
+		ctx->ulog_curr_offset, ctx->ulog->gen_num,
 		dest, src, data_size,
 		type, ctx->p_ops);
 	size_t entry_size = ALIGN_UP(curr_size, CACHELINE_SIZE);
@@ -437,6 +693,36 @@ operation_process_persistent_redo(struct operation_context *ctx)
 	ulog_clobber(ctx->ulog, &ctx->next, ctx->p_ops);
 }
 
+/*
+ * operation_process_compact_redo -- (internal) process a redo log whose
+ *	entries fit in the first cacheline of the persistent ulog
+ *
+ * This is the common case of a single allocation or free, which modifies one
+ * word of a run bitmap and the destination offset. The header of the shadow
+ * log only changes along with the next ulog, so its checksum is calculated
+ * once and then only extended with the few entries.
+ */
+static void
+operation_process_compact_redo(struct operation_context *ctx)
+{
+	struct ulog *src = ctx->pshadow_ops.ulog;
+	size_t nbytes = ctx->pshadow_ops.offset;
+	uint64_t next = VEC_SIZE(&ctx->next) == 0 ? 0 : VEC_FRONT(&ctx->next);
+
+	if (ctx->compact_csum == 0 || ctx->compact_next != next) {
+		src->next = next;
+		ctx->compact_next = next;
+		ctx->compact_csum = ulog_header_checksum(src);
+	}
+
+	ulog_store_compact(ctx->ulog, src, nbytes, ctx->compact_csum,
+		ctx->p_ops);
+
+	ulog_process(src, OBJ_OFF_IS_VALID_FROM_CTX, ctx->p_ops);
+
+	ulog_clobber(ctx->ulog, &ctx->next, ctx->p_ops);
+}
+
 /*
  * operation_process_persistent_undo -- (internal) process using ulog
  */
@@ -470,6 +756,70 @@ operation_reserve(struct operation_context *ctx, size_t new_capacity)
 	return 0;
 }
 
+/*
+ * operation_reserve_entries -- reserves the capacity for the given number of
+ *	value entries on top of what is already in the shadow log
+ */
+int
+operation_reserve_entries(struct operation_context *ctx, size_t nentries)
+{
+	return operation_reserve(ctx, ctx->pshadow_ops.offset +
+		nentries * sizeof(struct ulog_entry_val));
+}
+
+/*
+ * operation_set_ulog_retention -- sets how much of the extended ulog capacity
+ *	is kept at the end of the operation instead of being freed
+ */
+void
+operation_set_ulog_retention(struct operation_context *ctx,
+	size_t retain_nbytes, size_t decay)
+{
+	ctx->ulog_retain = retain_nbytes;
+	ctx->ulog_decay = decay;
+}
+
+/*
+ * operation_set_ulog_gen -- sets whether the undo ulog is invalidated at the
+ *	end of the operation by starting a new generation of entries instead of
+ *	zeroing out the logged data
+ */
+void
+operation_set_ulog_gen(struct operation_context *ctx, int ulog_gen)
+{
+	ctx->ulog_gen = ulog_gen;
+}
+
+/*
+ * operation_ulog_retain -- (internal) returns the number of bytes of the next
+ *	ulogs that should be retained at the end of the current operation
+ *
+ * The logs kept on top of the first next ulog are released once 'ulog_decay'
+ * operations in a row didn't need them.
+ */
+static size_t
+operation_ulog_retain(struct operation_context *ctx)
+{
+	if (ctx->ulog_retain == 0 || ctx->ulog_decay == 0)
+		return ctx->ulog_retain;
+
+	size_t used = ctx->ulog_base_nbytes;
+	if (VEC_SIZE(&ctx->next) != 0)
+		used += ulog_next(ctx->ulog, ctx->p_ops)->capacity;
+
+	if (ctx->total_logged > used) {
+		ctx->ulog_idle = 0;
+		return ctx->ulog_retain;
+	}
+
+	if (++ctx->ulog_idle < ctx->ulog_decay)
+		return ctx->ulog_retain;
+
+	ctx->ulog_idle = 0;
+
+	return 0;
+}
+
 /*
  * operation_init -- initializes runtime state of an operation
  */
@@ -486,7 +836,9 @@ operation_init(struct operation_context *ctx)
 		plog->capacity);
 	tlog->offset = 0;
 	plog->offset = 0;
-	VECQ_REINIT(&ctx->merge_entries);
+	/* starting a new epoch empties the whole merge index at once */
+	ctx->merge_epoch++;
+	ctx->merge_count = 0;
 
 	ctx->ulog_curr_offset = 0;
 	ctx->ulog_curr_capacity = 0;
@@ -554,7 +906,11 @@ operation_process(struct operation_context *ctx)
 		}
 	}
 
-	if (redo_process)
+	if (redo_process &&
+	    ctx->pshadow_ops.offset <= OP_COMPACT_REDO_NBYTES &&
+	    ctx->ulog_base_nbytes >= CACHELINE_SIZE)
+		operation_process_compact_redo(ctx);
+	else if (redo_process)
 		operation_process_persistent_redo(ctx);
 	else if (ctx->type == LOG_TYPE_UNDO)
 		operation_process_persistent_undo(ctx);
@@ -575,10 +931,21 @@ operation_finish(struct operation_context *ctx)
 
 	if (ctx->type == LOG_TYPE_REDO && ctx->pshadow_ops.offset != 0) {
 		operation_process(ctx);
-	} else if (ctx->type == LOG_TYPE_UNDO && ctx->total_logged != 0) {
+	} else if (ctx->type == LOG_TYPE_UNDO) {
+		size_t retain = operation_ulog_retain(ctx);
+		if (ctx->total_logged == 0 &&
+		    (retain == ctx->ulog_retain || VEC_SIZE(&ctx->next) < 2))
+			return;
+
+		size_t clobber_nbytes = ctx->total_logged;
+		if (ctx->ulog_gen && clobber_nbytes != 0) {
+			ulog_inc_gen(ctx->ulog, ctx->p_ops);
+			clobber_nbytes = 0;
+		}
+
 		ulog_clobber_data(ctx->ulog,
-			ctx->total_logged, ctx->ulog_base_nbytes,
-			&ctx->next, ctx->ulog_free, ctx->p_ops);
+			clobber_nbytes, ctx->ulog_base_nbytes,
+			&ctx->next, ctx->ulog_free, retain, ctx->p_ops);
 		/* clobbering might have shrunk the ulog */
 		ctx->ulog_capacity = ulog_capacity(ctx->ulog,
 			ctx->ulog_base_nbytes, ctx->p_ops);
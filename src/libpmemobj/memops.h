@@ -86,6 +86,10 @@ int operation_add_typed_entry(struct operation_context *ctx,
 	ulog_operation_type type, enum operation_log_type log_type);
 
 int operation_reserve(struct operation_context *ctx, size_t new_capacity);
+int operation_reserve_entries(struct operation_context *ctx, size_t nentries);
+void operation_set_ulog_retention(struct operation_context *ctx,
+	size_t retain_nbytes, size_t decay);
+void operation_set_ulog_gen(struct operation_context *ctx, int ulog_gen);
 void operation_process(struct operation_context *ctx);
 void operation_finish(struct operation_context *ctx);
 void operation_cancel(struct operation_context *ctx);
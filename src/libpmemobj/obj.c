@@ -75,6 +75,12 @@
 
 #define OBJ_X_VALID_FLAGS PMEMOBJ_F_RELAXED
 
+/* maximum number of objects allocated by a single *_n call */
+#define OBJ_ALLOC_N_MAX ((size_t)1 << 20)
+
+/* number of objects published in one redo log operation by *_n calls */
+#define OBJ_ALLOC_N_BATCH 1024
+
 static const struct pool_attr Obj_create_attr = {
 		OBJ_HDR_SIG,
 		OBJ_FORMAT_MAJOR,
@@ -1225,6 +1231,8 @@ obj_runtime_init(PMEMobjpool *pop, int rdonly, int boot, unsigned nlanes)
 	pop->rdonly = rdonly;
 
 	pop->uuid_lo = pmemobj_get_uuid_lo(pop);
+	pop->ulog_gen =
+		(pop->hdr.features.incompat & POOL_FEAT_ULOG_GEN) != 0;
 
 	pop->lanes_desc.runtime_nlanes = nlanes;
 
@@ -2274,6 +2282,144 @@ pmemobj_xalloc(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
 	return ret;
 }
 
+/*
+ * obj_alloc_construct_n -- (internal) allocates n objects of the same size
+ *
+ * All of the objects are reserved up front, but they are published in
+ * batches of at most OBJ_ALLOC_N_BATCH objects, so that the redo log never has
+ * to grow past the size of a single batch. Only each batch is fail-safe
+ * atomic, an interruption leaves the batches published so far allocated.
+ */
+static int
+obj_alloc_construct_n(PMEMobjpool *pop, PMEMoid *oidv, size_t n, size_t size,
+	type_num_t type_num, uint64_t flags,
+	pmemobj_constr constructor, void *arg)
+{
+	if (size > PMEMOBJ_MAX_ALLOC_SIZE) {
+		ERR("requested size too large");
+		errno = ENOMEM;
+		return -1;
+	}
+
+	struct pobj_action *actv = Malloc(sizeof(struct pobj_action) * n);
+	if (actv == NULL) {
+		ERR("!Malloc");
+		return -1;
+	}
+
+	struct constr_args carg;
+
+	carg.zero_init = flags & POBJ_FLAG_ZERO;
+	carg.constructor = constructor;
+	carg.arg = arg;
+
+	int ret = palloc_reserve_n(&pop->heap, size, constructor_alloc, &carg,
+		type_num, 0, CLASS_ID_FROM_FLAG(flags), actv, n);
+	if (ret != 0)
+		goto out;
+
+	/*
+	 * There is at most one run bitmap modification per object. The two
+	 * fields of every oid are logged in the persistent redo log only if
+	 * the array resides in the pool, otherwise they are stored through
+	 * the transient log.
+	 */
+	size_t nentries_obj = 1;
+	if (OBJ_PTR_FROM_POOL(pop, oidv) ||
+	    OBJ_PTR_FROM_POOL(pop, oidv + n - 1))
+		nentries_obj += 2;
+
+	size_t batch = n < OBJ_ALLOC_N_BATCH ? n : OBJ_ALLOC_N_BATCH;
+
+	struct operation_context *ctx = pmalloc_operation_hold(pop);
+
+	/*
+	 * The log is extended for the largest batch before anything is
+	 * published, the following batches fit in the same capacity.
+	 */
+	if (operation_reserve(ctx,
+	    batch * nentries_obj * sizeof(struct ulog_entry_val)) != 0) {
+		operation_cancel(ctx);
+		pmalloc_operation_release(pop);
+		palloc_cancel(&pop->heap, actv, n);
+		ret = -1;
+		goto out;
+	}
+
+	for (size_t b = 0; b < n; b += batch) {
+		size_t nb = n - b < batch ? n - b : batch;
+
+		if (b != 0)
+			operation_start(ctx);
+
+		for (size_t i = b; i < b + nb; ++i) {
+			operation_add_entry(ctx, &oidv[i].pool_uuid_lo,
+				pop->uuid_lo, ULOG_OPERATION_SET);
+			operation_add_entry(ctx, &oidv[i].off,
+				actv[i].heap.offset, ULOG_OPERATION_SET);
+		}
+
+		palloc_publish(&pop->heap, actv + b, nb, ctx);
+	}
+
+	pmalloc_operation_release(pop);
+
+out:
+	Free(actv);
+
+	return ret;
+}
+
+/*
+ * pmemobj_xalloc_n -- allocates n objects with flags
+ */
+int
+pmemobj_xalloc_n(PMEMobjpool *pop, PMEMoid *oidv, size_t n, size_t size,
+	uint64_t type_num, uint64_t flags,
+	pmemobj_constr constructor, void *arg)
+{
+	LOG(3, "pop %p oidv %p n %zu size %zu type_num %llx flags %llx "
+		"constructor %p arg %p",
+		pop, oidv, n, size, (unsigned long long)type_num,
+		(unsigned long long)flags,
+		constructor, arg);
+
+	/* log notice message if used inside a transaction */
+	_POBJ_DEBUG_NOTICE_IN_TX();
+
+	if (size == 0) {
+		ERR("allocation with size 0");
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (n == 0 || oidv == NULL) {
+		ERR("empty array of objects");
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (n > OBJ_ALLOC_N_MAX) {
+		ERR("too many objects requested");
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (flags & ~POBJ_TX_XALLOC_VALID_FLAGS) {
+		ERR("unknown flags 0x%" PRIx64,
+				flags & ~POBJ_TX_XALLOC_VALID_FLAGS);
+		errno = EINVAL;
+		return -1;
+	}
+
+	PMEMOBJ_API_START();
+	int ret = obj_alloc_construct_n(pop, oidv, n, size, type_num,
+			flags, constructor, arg);
+
+	PMEMOBJ_API_END();
+	return ret;
+}
+
 /* arguments for constructor_realloc and constructor_zrealloc */
 struct carg_realloc {
 	void *ptr;
@@ -3040,6 +3186,68 @@ pmemobj_xreserve(PMEMobjpool *pop, struct pobj_action *act,
 	return oid;
 }
 
+/*
+ * pmemobj_xreserve_n -- reserves n objects of the same size
+ */
+int
+pmemobj_xreserve_n(PMEMobjpool *pop, struct pobj_action *actv,
+	PMEMoid *oidv, size_t n, size_t size, uint64_t type_num,
+	uint64_t flags)
+{
+	LOG(3, "pop %p actv %p oidv %p n %zu size %zu type_num %llx "
+		"flags %llx",
+		pop, actv, oidv, n, size,
+		(unsigned long long)type_num, (unsigned long long)flags);
+
+	if (size == 0) {
+		ERR("allocation with size 0");
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (n == 0 || actv == NULL) {
+		ERR("empty array of actions");
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (n > OBJ_ALLOC_N_MAX) {
+		ERR("too many objects requested");
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (flags & ~POBJ_ACTION_XRESERVE_VALID_FLAGS) {
+		ERR("unknown flags 0x%" PRIx64,
+				flags & ~POBJ_ACTION_XRESERVE_VALID_FLAGS);
+		errno = EINVAL;
+		return -1;
+	}
+
+	PMEMOBJ_API_START();
+	struct constr_args carg;
+
+	carg.zero_init = flags & POBJ_FLAG_ZERO;
+	carg.constructor = NULL;
+	carg.arg = NULL;
+
+	if (palloc_reserve_n(&pop->heap, size, constructor_alloc, &carg,
+		type_num, 0, CLASS_ID_FROM_FLAG(flags), actv, n) != 0) {
+		PMEMOBJ_API_END();
+		return -1;
+	}
+
+	if (oidv != NULL) {
+		for (size_t i = 0; i < n; ++i) {
+			oidv[i].off = actv[i].heap.offset;
+			oidv[i].pool_uuid_lo = pop->uuid_lo;
+		}
+	}
+
+	PMEMOBJ_API_END();
+	return 0;
+}
+
 /*
  * pmemobj_set_value -- creates an action to set a value
  */
@@ -158,6 +158,7 @@ struct pmemobjpool {
 	struct lane_descriptor lanes_desc;
 	uint64_t uuid_lo;
 	int is_dev_dax;		/* true if mapped on device dax */
+	int ulog_gen;		/* true if undo logs use generations */
 
 	struct ctl *ctl;	/* top level node of the ctl tree structure */
 	struct stats *stats;
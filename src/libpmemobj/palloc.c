@@ -65,6 +65,17 @@
 #include "sys_util.h"
 #include "palloc.h"
 
+/*
+ * Publishing at least this many actions at once takes the batched path, which
+ * sorts the actions in linear time and combines run bitmap modifications.
+ */
+#define PALLOC_BATCH_MIN_ACTIONS 64
+
+#define PALLOC_RADIX_BITS 8
+#define PALLOC_RADIX_BUCKETS (1 << PALLOC_RADIX_BITS)
+#define PALLOC_RADIX_KEY_DIGITS (sizeof(uint64_t) * 8 / PALLOC_RADIX_BITS)
+#define PALLOC_RADIX_DIGITS (PALLOC_RADIX_KEY_DIGITS * 2)
+
 struct pobj_action_internal {
 	/* type of operation (alloc/free vs set) */
 	enum pobj_action_type type;
@@ -175,8 +186,51 @@ alloc_prep_block(struct palloc_heap *heap, const struct memory_block *m,
 }
 
 /*
- * palloc_reservation_create -- creates a volatile reservation of a
- *	memory block.
+ * palloc_restore_free_chunk_state -- updates the runtime state of a free chunk.
+ *
+ * This function also takes care of coalescing of huge chunks.
+ */
+static void
+palloc_restore_free_chunk_state(struct palloc_heap *heap,
+	struct memory_block *m)
+{
+	if (m->type == MEMORY_BLOCK_HUGE) {
+		struct bucket *b = heap_bucket_acquire_by_id(heap,
+			DEFAULT_ALLOC_CLASS_ID);
+		if (heap_free_chunk_reuse(heap, b, m) != 0) {
+			if (errno == EEXIST) {
+				FATAL(
+					"duplicate runtime chunk state, possible double free");
+			} else {
+				LOG(2, "unable to track runtime chunk state");
+			}
+		}
+		heap_bucket_release(heap, b);
+	}
+}
+
+/*
+ * palloc_heap_action_on_cancel -- restores the state of the heap
+ */
+static void
+palloc_heap_action_on_cancel(struct palloc_heap *heap,
+	struct pobj_action_internal *act)
+{
+	if (act->new_state == MEMBLOCK_ALLOCATED) {
+		VALGRIND_DO_MEMPOOL_FREE(heap->layout,
+			act->m.m_ops->get_user_data(&act->m));
+
+		act->m.m_ops->invalidate(&act->m);
+		palloc_restore_free_chunk_state(heap, &act->m);
+	}
+
+	if (act->resvp)
+		util_fetch_and_sub64(act->resvp, 1);
+}
+
+/*
+ * palloc_reservation_create_n -- creates volatile reservations of n memory
+ *	blocks of the same size.
  *
  * The first step in the allocation of a new block is reserving it in
  * the transient heap - which is represented by the bucket abstraction.
@@ -189,19 +243,24 @@ alloc_prep_block(struct palloc_heap *heap, const struct memory_block *m,
  * Once the bucket is selected, just enough memory is reserved for the
  * requested size. The underlying block allocation algorithm
  * (best-fit, next-fit, ...) varies depending on the bucket container.
+ *
+ * All of the blocks are reserved while holding the bucket only once, so for
+ * small sizes they are carved out of the same ranges of free run bits, which
+ * means that their bitmap modifications can be combined once published.
+ * Either all of the blocks are reserved or none.
  */
 static int
-palloc_reservation_create(struct palloc_heap *heap, size_t size,
+palloc_reservation_create_n(struct palloc_heap *heap, size_t size,
 	palloc_constr constructor, void *arg,
 	uint64_t extra_field, uint16_t object_flags, uint16_t class_id,
-	struct pobj_action_internal *out)
+	struct pobj_action_internal *out, size_t n)
 {
 	int err = 0;
 
-	struct memory_block *new_block = &out->m;
-	out->type = POBJ_ACTION_TYPE_HEAP;
-
 	ASSERT(class_id < UINT8_MAX);
+	if (class_id == 0)
+		alloc_class_profile_record(heap_alloc_classes(heap), size);
+
 	struct alloc_class *c = class_id == 0 ?
 		heap_get_best_class(heap, size) :
 		alloc_class_by_id(heap_alloc_classes(heap),
@@ -229,57 +288,81 @@ palloc_reservation_create(struct palloc_heap *heap, size_t size,
 		return -1;
 	}
 	ASSERT(size_idx <= UINT32_MAX);
-	*new_block = MEMORY_BLOCK_NONE;
-	new_block->size_idx = (uint32_t)size_idx;
 
 	struct bucket *b = heap_bucket_acquire(heap, c);
 
-	err = heap_get_bestfit_block(heap, b, new_block);
-	if (err != 0)
-		goto out;
+	size_t nreserved;
+	for (nreserved = 0; nreserved < n; ++nreserved) {
+		struct pobj_action_internal *act = &out[nreserved];
+		struct memory_block *new_block = &act->m;
+		act->type = POBJ_ACTION_TYPE_HEAP;
 
-	if (alloc_prep_block(heap, new_block, constructor, arg,
-		extra_field, object_flags, &out->offset) != 0) {
-		/*
-		 * Constructor returned non-zero value which means
-		 * the memory block reservation has to be rolled back.
-		 */
-		if (new_block->type == MEMORY_BLOCK_HUGE) {
-			bucket_insert_block(b, new_block);
+		*new_block = MEMORY_BLOCK_NONE;
+		new_block->size_idx = (uint32_t)size_idx;
+
+		err = heap_get_bestfit_block(heap, b, new_block);
+		if (err != 0)
+			break;
+
+		if (alloc_prep_block(heap, new_block, constructor, arg,
+			extra_field, object_flags, &act->offset) != 0) {
+			/*
+			 * Constructor returned non-zero value which means
+			 * the memory block reservation has to be rolled back.
+			 */
+			if (new_block->type == MEMORY_BLOCK_HUGE) {
+				bucket_insert_block(b, new_block);
+			}
+			err = ECANCELED;
+			break;
 		}
-		err = ECANCELED;
-		goto out;
-	}
 
-	/*
-	 * Each as of yet unfulfilled reservation needs to be tracked in the
-	 * runtime state.
-	 * The memory block cannot be put back into the global state unless
-	 * there are no active reservations.
-	 */
-	if ((out->resvp = bucket_current_resvp(b)) != NULL)
-		util_fetch_and_add64(out->resvp, 1);
+		/*
+		 * Each as of yet unfulfilled reservation needs to be tracked
+		 * in the runtime state.
+		 * The memory block cannot be put back into the global state
+		 * unless there are no active reservations.
+		 */
+		if ((act->resvp = bucket_current_resvp(b)) != NULL)
+			util_fetch_and_add64(act->resvp, 1);
 
-	out->lock = new_block->m_ops->get_lock(new_block);
-	out->new_state = MEMBLOCK_ALLOCATED;
+		act->lock = new_block->m_ops->get_lock(new_block);
+		act->new_state = MEMBLOCK_ALLOCATED;
+	}
 
-out:
 	heap_bucket_release(heap, b);
 
 	if (err == 0)
 		return 0;
 
+	/* the bucket must not be held while the reservations are canceled */
+	for (size_t i = 0; i < nreserved; ++i)
+		palloc_heap_action_on_cancel(heap, &out[i]);
+
 	errno = err;
 	return -1;
 }
 
 /*
- * palloc_heap_action_exec -- executes a single heap action (alloc, free)
+ * palloc_reservation_create -- creates a volatile reservation of a
+ *	memory block.
  */
-static void
-palloc_heap_action_exec(struct palloc_heap *heap,
-	const struct pobj_action_internal *act,
-	struct operation_context *ctx)
+static int
+palloc_reservation_create(struct palloc_heap *heap, size_t size,
+	palloc_constr constructor, void *arg,
+	uint64_t extra_field, uint16_t object_flags, uint16_t class_id,
+	struct pobj_action_internal *out)
+{
+	return palloc_reservation_create_n(heap, size, constructor, arg,
+		extra_field, object_flags, class_id, out, 1);
+}
+
+/*
+ * palloc_heap_action_verify -- (internal) checks that the heap action changes
+ *	the state of its memory block, in debug builds only
+ */
+static inline void
+palloc_heap_action_verify(const struct pobj_action_internal *act)
 {
 #ifdef DEBUG
 	if (act->m.m_ops->get_state(&act->m) == act->new_state) {
@@ -287,6 +370,17 @@ palloc_heap_action_exec(struct palloc_heap *heap,
 		ASSERT(0);
 	}
 #endif /* DEBUG */
+}
+
+/*
+ * palloc_heap_action_exec -- executes a single heap action (alloc, free)
+ */
+static void
+palloc_heap_action_exec(struct palloc_heap *heap,
+	const struct pobj_action_internal *act,
+	struct operation_context *ctx)
+{
+	palloc_heap_action_verify(act);
 
 	/*
 	 * The actual required metadata modifications are chunk-type
@@ -297,30 +391,6 @@ palloc_heap_action_exec(struct palloc_heap *heap,
 	act->m.m_ops->prep_hdr(&act->m, act->new_state, ctx);
 }
 
-/*
- * palloc_restore_free_chunk_state -- updates the runtime state of a free chunk.
- *
- * This function also takes care of coalescing of huge chunks.
- */
-static void
-palloc_restore_free_chunk_state(struct palloc_heap *heap,
-	struct memory_block *m)
-{
-	if (m->type == MEMORY_BLOCK_HUGE) {
-		struct bucket *b = heap_bucket_acquire_by_id(heap,
-			DEFAULT_ALLOC_CLASS_ID);
-		if (heap_free_chunk_reuse(heap, b, m) != 0) {
-			if (errno == EEXIST) {
-				FATAL(
-					"duplicate runtime chunk state, possible double free");
-			} else {
-				LOG(2, "unable to track runtime chunk state");
-			}
-		}
-		heap_bucket_release(heap, b);
-	}
-}
-
 /*
  * palloc_mem_action_noop -- empty handler for unused memory action funcs
  */
@@ -331,25 +401,6 @@ palloc_mem_action_noop(struct palloc_heap *heap,
 
 }
 
-/*
- * palloc_heap_action_on_cancel -- restores the state of the heap
- */
-static void
-palloc_heap_action_on_cancel(struct palloc_heap *heap,
-	struct pobj_action_internal *act)
-{
-	if (act->new_state == MEMBLOCK_ALLOCATED) {
-		VALGRIND_DO_MEMPOOL_FREE(heap->layout,
-			act->m.m_ops->get_user_data(&act->m));
-
-		act->m.m_ops->invalidate(&act->m);
-		palloc_restore_free_chunk_state(heap, &act->m);
-	}
-
-	if (act->resvp)
-		util_fetch_and_sub64(act->resvp, 1);
-}
-
 /*
  * palloc_heap_action_on_process -- performs finalization steps under a lock
  *	on the persistent state
@@ -477,6 +528,188 @@ palloc_action_compare(const void *lhs, const void *rhs)
 	return 0;
 }
 
+/*
+ * palloc_batch_entry -- sort record of an action in a batched publish
+ */
+struct palloc_batch_entry {
+	uint64_t lock_key; /* address of the action lock, primary sort key */
+	uint64_t word_key; /* address of the modified run bitmap value or 0 */
+	uint64_t bmask; /* bits of the run bitmap value owned by the block */
+	struct pobj_action_internal *act;
+};
+
+/*
+ * palloc_batch_digit -- (internal) returns the n-th least significant digit
+ *	of the combined (lock_key, word_key) sort key
+ */
+static inline unsigned
+palloc_batch_digit(const struct palloc_batch_entry *e, unsigned n)
+{
+	uint64_t key = n < PALLOC_RADIX_KEY_DIGITS ? e->word_key : e->lock_key;
+	unsigned shift = (n % PALLOC_RADIX_KEY_DIGITS) * PALLOC_RADIX_BITS;
+
+	return (unsigned)(key >> shift) & (PALLOC_RADIX_BUCKETS - 1);
+}
+
+/*
+ * palloc_batch_sort -- (internal) stable LSD radix sort of the batch entries,
+ *	returns whichever of the two buffers ended up holding the result
+ *
+ * Histograms of all digits are computed in a single pass so that digits
+ * which are the same in all of the keys, like the high bytes of addresses,
+ * can be skipped altogether.
+ */
+static struct palloc_batch_entry *
+palloc_batch_sort(struct palloc_batch_entry *src,
+	struct palloc_batch_entry *tmp, size_t n,
+	size_t (*counts)[PALLOC_RADIX_BUCKETS])
+{
+	memset(counts, 0,
+		sizeof(size_t) * PALLOC_RADIX_DIGITS * PALLOC_RADIX_BUCKETS);
+
+	for (size_t i = 0; i < n; ++i) {
+		for (unsigned d = 0; d < PALLOC_RADIX_DIGITS; ++d)
+			counts[d][palloc_batch_digit(&src[i], d)]++;
+	}
+
+	for (unsigned d = 0; d < PALLOC_RADIX_DIGITS; ++d) {
+		if (counts[d][palloc_batch_digit(&src[0], d)] == n)
+			continue;
+
+		size_t pos = 0;
+		for (unsigned b = 0; b < PALLOC_RADIX_BUCKETS; ++b) {
+			size_t count = counts[d][b];
+			counts[d][b] = pos;
+			pos += count;
+		}
+
+		for (size_t i = 0; i < n; ++i) {
+			unsigned digit = palloc_batch_digit(&src[i], d);
+			tmp[counts[d][digit]++] = src[i];
+		}
+
+		struct palloc_batch_entry *sorted = tmp;
+		tmp = src;
+		src = sorted;
+	}
+
+	return src;
+}
+
+/*
+ * palloc_exec_actions_batch -- (internal) perform a large number of free/alloc
+ *	operations at once, returns -1 if the batch cannot be prepared, in which
+ *	case nothing was done
+ *
+ * Instead of comparison-sorting the actions, they are radix-sorted by lock and
+ * then by the run bitmap value they modify. This way each lock is taken once,
+ * and the modifications of a single bitmap value by all of the actions in the
+ * batch are combined into one entry per operation type.
+ */
+static int
+palloc_exec_actions_batch(struct palloc_heap *heap,
+	struct operation_context *ctx,
+	struct pobj_action_internal *actv,
+	size_t actvcnt)
+{
+	size_t counts_size =
+		sizeof(size_t) * PALLOC_RADIX_DIGITS * PALLOC_RADIX_BUCKETS;
+	void *buf = Malloc(counts_size +
+		sizeof(struct palloc_batch_entry) * actvcnt * 2);
+	if (buf == NULL) {
+		LOG(2, "unable to allocate batch of %zu actions", actvcnt);
+		return -1;
+	}
+
+	size_t (*counts)[PALLOC_RADIX_BUCKETS] = buf;
+	struct palloc_batch_entry *entries = (struct palloc_batch_entry *)
+		((char *)buf + counts_size);
+
+	struct pobj_action_internal *act;
+	for (size_t i = 0; i < actvcnt; ++i) {
+		act = &actv[i];
+		struct palloc_batch_entry *e = &entries[i];
+		e->act = act;
+		e->lock_key = (uintptr_t)act->lock;
+		e->bmask = 0;
+		e->word_key = 0;
+		if (act->type == POBJ_ACTION_TYPE_HEAP &&
+		    act->m.type == MEMORY_BLOCK_RUN) {
+			e->word_key = (uintptr_t)
+				memblock_run_bitmap_word(&act->m, &e->bmask);
+		}
+	}
+
+	struct palloc_batch_entry *sorted = palloc_batch_sort(entries,
+		entries + actvcnt, actvcnt, counts);
+
+	uint64_t alloc_mask = 0;
+	uint64_t free_mask = 0;
+	for (size_t i = 0; i < actvcnt; ++i) {
+		struct palloc_batch_entry *e = &sorted[i];
+		act = e->act;
+
+		/* see the comment in palloc_exec_actions */
+		if (i == 0 || act->lock != sorted[i - 1].act->lock) {
+			if (act->lock)
+				util_mutex_lock(act->lock);
+		}
+
+		if (e->word_key == 0) {
+			action_funcs[act->type].exec(heap, act, ctx);
+			continue;
+		}
+
+		palloc_heap_action_verify(act);
+
+		if (act->new_state == MEMBLOCK_ALLOCATED)
+			alloc_mask |= e->bmask;
+		else
+			free_mask |= e->bmask;
+
+		/* the entries are created once the whole value is processed */
+		if (i + 1 < actvcnt && sorted[i + 1].word_key == e->word_key)
+			continue;
+
+		uint64_t *value = (uint64_t *)(uintptr_t)e->word_key;
+		if (alloc_mask != 0) {
+			operation_add_entry(ctx, value, alloc_mask,
+				ULOG_OPERATION_OR);
+		}
+		if (free_mask != 0) {
+			operation_add_entry(ctx, value, ~free_mask,
+				ULOG_OPERATION_AND);
+		}
+
+		alloc_mask = 0;
+		free_mask = 0;
+	}
+
+	/* wait for all allocated object headers to be persistent */
+	pmemops_drain(&heap->p_ops);
+
+	/* perform all persistent memory operations */
+	operation_finish(ctx);
+
+	for (size_t i = 0; i < actvcnt; ++i) {
+		act = sorted[i].act;
+
+		action_funcs[act->type].on_process(heap, act);
+
+		if (i == 0 || act->lock != sorted[i - 1].act->lock) {
+			if (act->lock)
+				util_mutex_unlock(act->lock);
+		}
+	}
+
+	for (size_t i = 0; i < actvcnt; ++i)
+		action_funcs[actv[i].type].on_unlock(heap, &actv[i]);
+
+	Free(buf);
+
+	return 0;
+}
+
 /*
  * palloc_exec_actions -- perform the provided free/alloc operations
  */
@@ -486,6 +719,10 @@ palloc_exec_actions(struct palloc_heap *heap,
 	struct pobj_action_internal *actv,
 	size_t actvcnt)
 {
+	if (actvcnt >= PALLOC_BATCH_MIN_ACTIONS &&
+	    palloc_exec_actions_batch(heap, ctx, actv, actvcnt) == 0)
+		return;
+
 	/*
 	 * The operations array is sorted so that proper lock ordering is
 	 * ensured.
@@ -554,6 +791,21 @@ palloc_reserve(struct palloc_heap *heap, size_t size,
 		(struct pobj_action_internal *)act);
 }
 
+/*
+ * palloc_reserve_n -- creates n reservations of the same size, either all of
+ *	them are created or none
+ */
+int
+palloc_reserve_n(struct palloc_heap *heap, size_t size,
+	palloc_constr constructor, void *arg,
+	uint64_t extra_field, uint16_t object_flags, uint16_t class_id,
+	struct pobj_action *actv, size_t n)
+{
+	return palloc_reservation_create_n(heap, size, constructor, arg,
+		extra_field, object_flags, class_id,
+		(struct pobj_action_internal *)actv, n);
+}
+
 /*
  * palloc_defer_free -- creates an internal deferred free action
  */
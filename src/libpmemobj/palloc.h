@@ -83,6 +83,12 @@ palloc_reserve(struct palloc_heap *heap, size_t size,
 	uint64_t extra_field, uint16_t object_flags, uint16_t class_id,
 	struct pobj_action *act);
 
+int
+palloc_reserve_n(struct palloc_heap *heap, size_t size,
+	palloc_constr constructor, void *arg,
+	uint64_t extra_field, uint16_t object_flags, uint16_t class_id,
+	struct pobj_action *actv, size_t n);
+
 void
 palloc_defer_free(struct palloc_heap *heap, uint64_t off,
 	struct pobj_action *act);
@@ -446,9 +446,154 @@ static const struct ctl_node CTL_NODE(new)[] = {
 	CTL_NODE_END
 };
 
+/*
+ * CTL_READ_HANDLER(enabled) -- returns whether or not the requested
+ *	allocation sizes are being sampled
+ */
+static int
+CTL_READ_HANDLER(enabled)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	int *arg_out = arg;
+
+	*arg_out = alloc_class_profile_is_enabled(
+		heap_alloc_classes(&pop->heap));
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(enabled) -- enables or disables sampling of the
+ *	requested allocation sizes
+ */
+static int
+CTL_WRITE_HANDLER(enabled)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	int arg_in = *(int *)arg;
+
+	return alloc_class_profile_enable(heap_alloc_classes(&pop->heap),
+		arg_in > 0);
+}
+
+static struct ctl_argument CTL_ARG(enabled) = CTL_ARG_BOOLEAN;
+
+/*
+ * CTL_RUNNABLE_HANDLER(reset) -- discards all the sampled allocation sizes
+ */
+static int
+CTL_RUNNABLE_HANDLER(reset)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	alloc_class_profile_reset(heap_alloc_classes(&pop->heap));
+
+	return 0;
+}
+
+/*
+ * CTL_READ_HANDLER(frag) -- returns the estimated internal fragmentation of
+ *	the sampled allocations
+ */
+static int
+CTL_READ_HANDLER(frag)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	double *arg_out = arg;
+
+	*arg_out = alloc_class_profile_frag(heap_alloc_classes(&pop->heap));
+
+	return 0;
+}
+
+/*
+ * CTL_READ_HANDLER(propose) -- returns the description of an allocation
+ *	class that would reduce the internal fragmentation the most
+ */
+static int
+CTL_READ_HANDLER(propose)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	size_t size;
+	if (alloc_class_profile_propose(heap_alloc_classes(&pop->heap),
+			&size, 1) == 0) {
+		ERR("no allocation class to propose");
+		errno = ENOENT;
+		return -1;
+	}
+
+	struct pobj_alloc_class_desc *p = arg;
+	p->unit_size = size + header_type_to_size[HEADER_COMPACT];
+	p->alignment = 0;
+	p->units_per_block = 0;
+	p->header_type = POBJ_HEADER_COMPACT;
+	p->class_id = 0;
+
+	return 0;
+}
+
+/*
+ * CTL_RUNNABLE_HANDLER(tune) -- creates tight-fitting allocation classes for
+ *	the sampled allocation sizes that would benefit from them the most
+ */
+static int
+CTL_RUNNABLE_HANDLER(tune)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+	struct alloc_class_collection *ac = heap_alloc_classes(&pop->heap);
+
+	size_t sizes[ALLOC_CLASS_MAX_PROPOSALS];
+	size_t nsizes = alloc_class_profile_propose(ac, sizes,
+		ALLOC_CLASS_MAX_PROPOSALS);
+
+	for (size_t i = 0; i < nsizes; ++i) {
+		struct alloc_class *c = alloc_class_by_tight_fit(ac, sizes[i]);
+		if (c == NULL) {
+			c = alloc_class_new_tight_fit(ac, sizes[i]);
+			if (c == NULL) {
+				ERR("no available free allocation class "
+					"identifier");
+				errno = EINVAL;
+				return -1;
+			}
+
+			if (heap_create_alloc_class_buckets(&pop->heap,
+					c) != 0) {
+				alloc_class_delete(ac, c);
+				return -1;
+			}
+		}
+
+		alloc_class_assign_size(ac, sizes[i], c);
+	}
+
+	return 0;
+}
+
+static const struct ctl_node CTL_NODE(profile)[] = {
+	CTL_LEAF_RW(enabled),
+	CTL_LEAF_RUNNABLE(reset),
+	CTL_LEAF_RO(frag),
+	CTL_LEAF_RO(propose),
+	CTL_LEAF_RUNNABLE(tune),
+
+	CTL_NODE_END
+};
+
 static const struct ctl_node CTL_NODE(alloc_class)[] = {
 	CTL_INDEXED(class_id),
 	CTL_INDEXED(new),
+	CTL_CHILD(profile),
 
 	CTL_NODE_END
 };
@@ -526,9 +671,33 @@ static const struct ctl_node CTL_NODE(size)[] = {
 	CTL_NODE_END
 };
 
+/*
+ * CTL_READ_HANDLER(nodes) -- returns the number of NUMA nodes the heap keeps
+ *	separate free chunks for
+ */
+static int
+CTL_READ_HANDLER(nodes)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	unsigned *arg_out = arg;
+
+	*arg_out = heap_numa_nnodes(&pop->heap);
+
+	return 0;
+}
+
+static const struct ctl_node CTL_NODE(numa)[] = {
+	CTL_LEAF_RO(nodes),
+
+	CTL_NODE_END
+};
+
 static const struct ctl_node CTL_NODE(heap)[] = {
 	CTL_CHILD(alloc_class),
 	CTL_CHILD(size),
+	CTL_CHILD(numa),
 
 	CTL_NODE_END
 };
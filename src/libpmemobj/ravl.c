@@ -104,7 +104,7 @@ ravl_clear_node(struct ravl_node *n, ravl_cb cb, void *arg)
 
 	ravl_clear_node(n->slots[RAVL_LEFT], cb, arg);
 	if (cb)
-		cb((void *)n->data, arg);
+		cb(ravl_data(n), arg);
 	ravl_clear_node(n->slots[RAVL_RIGHT], cb, arg);
 
 	Free(n);
@@ -120,6 +120,29 @@ ravl_clear(struct ravl *ravl)
 	ravl->root = NULL;
 }
 
+/*
+ * ravl_foreach_node -- (internal) recursively traverses the given subtree
+ */
+static void
+ravl_foreach_node(struct ravl_node *n, ravl_cb cb, void *arg)
+{
+	if (n == NULL)
+		return;
+
+	ravl_foreach_node(n->slots[RAVL_LEFT], cb, arg);
+	cb(ravl_data(n), arg);
+	ravl_foreach_node(n->slots[RAVL_RIGHT], cb, arg);
+}
+
+/*
+ * ravl_foreach -- calls the callback for every element in ascending order
+ */
+void
+ravl_foreach(struct ravl *ravl, ravl_cb cb, void *arg)
+{
+	ravl_foreach_node(ravl->root, cb, arg);
+}
+
 /*
  * ravl_delete_cb -- clears and deletes the given ravl instance, calls callback
  */
@@ -207,8 +207,10 @@ static void
 recycler_pending_check(struct recycler *r)
 {
 	struct memory_block_reserved *mr = NULL;
-	size_t pos;
-	VEC_FOREACH_BY_POS(pos, &r->pending) {
+	size_t pos = 0;
+
+	/* erasing moves the last element into the current position */
+	while (pos < VEC_SIZE(&r->pending)) {
 		mr = VEC_ARR(&r->pending)[pos];
 		if (mr->nresv == 0) {
 			struct recycler_element e = recycler_element_new(
@@ -219,6 +221,8 @@ recycler_pending_check(struct recycler *r)
 			}
 			Free(mr);
 			VEC_ERASE_BY_POS(&r->pending, pos);
+		} else {
+			pos++;
 		}
 	}
 }
@@ -291,7 +295,13 @@ recycler_recalc(struct recycler *r, int force)
 	if (util_mutex_trylock(&r->lock) != 0)
 		return runs;
 
-	/* If the search is forced, recalculate everything */
+	/*
+	 * If the search is forced, recalculate everything, including the runs
+	 * whose reservations were fulfilled since they were detached.
+	 */
+	if (force)
+		recycler_pending_check(r);
+
 	uint64_t search_limit = force ? UINT64_MAX : units;
 
 	uint64_t found_units = 0;
@@ -324,7 +334,11 @@ recycler_recalc(struct recycler *r, int force)
 		uint64_t free_space_diff = e.free_space - existing_free_space;
 		found_units += free_space_diff;
 
-		if (free_space_diff == 0)
+		/*
+		 * Runs put into the recycler after the objects were already
+		 * freed have up-to-date scores, but might still be empty.
+		 */
+		if (free_space_diff == 0 && e.free_space != r->nallocs)
 			continue;
 
 		/*
@@ -38,9 +38,15 @@
 #include "stats.h"
 
 STATS_CTL_HANDLER(persistent, curr_allocated, heap_curr_allocated);
+STATS_CTL_HANDLER(transient, defrag_relocated, heap_defrag_relocated);
+STATS_CTL_HANDLER(transient, defrag_reclaimed, heap_defrag_reclaimed);
+STATS_CTL_HANDLER(transient, snapshot_bytes, tx_snapshot_bytes);
+STATS_CTL_HANDLER(transient, snapshot_skipped, tx_snapshot_skipped);
 
 static const struct ctl_node CTL_NODE(heap)[] = {
 	STATS_CTL_LEAF(persistent, curr_allocated),
+	STATS_CTL_LEAF(transient, defrag_relocated),
+	STATS_CTL_LEAF(transient, defrag_reclaimed),
 
 	CTL_NODE_END
 };
@@ -81,8 +87,328 @@ CTL_WRITE_HANDLER(enabled)(void *ctx,
 
 static struct ctl_argument CTL_ARG(enabled) = CTL_ARG_BOOLEAN;
 
+/*
+ * Values that can be read from the merged latency histogram of a phase.
+ */
+enum stats_latency_field {
+	STATS_LATENCY_COUNT,
+	STATS_LATENCY_TOTAL,
+	STATS_LATENCY_MAX,
+	STATS_LATENCY_P50,
+	STATS_LATENCY_P99,
+	STATS_LATENCY_P999,
+};
+
+/*
+ * stats_latency_bucket -- (internal) returns the histogram bucket for a value
+ */
+static unsigned
+stats_latency_bucket(uint64_t ticks)
+{
+	if (ticks < STATS_LATENCY_SUB_BUCKETS)
+		return (unsigned)ticks;
+
+	unsigned msb = util_mssb_index64(ticks);
+	if (msb > STATS_LATENCY_MAX_BITS)
+		return STATS_LATENCY_NBUCKETS - 1;
+
+	unsigned shift = msb - STATS_LATENCY_SUB_BITS;
+
+	return (shift + 1) * STATS_LATENCY_SUB_BUCKETS +
+		(unsigned)((ticks >> shift) & (STATS_LATENCY_SUB_BUCKETS - 1));
+}
+
+/*
+ * stats_latency_bucket_max -- (internal) returns the largest value that is
+ *	recorded in the given histogram bucket
+ */
+static uint64_t
+stats_latency_bucket_max(unsigned bucket)
+{
+	if (bucket < STATS_LATENCY_SUB_BUCKETS)
+		return bucket;
+
+	unsigned shift = bucket / STATS_LATENCY_SUB_BUCKETS - 1;
+	uint64_t sub = bucket % STATS_LATENCY_SUB_BUCKETS;
+
+	return ((STATS_LATENCY_SUB_BUCKETS + sub) << shift) +
+		(1ULL << shift) - 1;
+}
+
+/*
+ * stats_latency_percentile -- (internal) returns the upper bound of the value
+ *	below which the given permille of samples in the histogram fall
+ */
+static uint64_t
+stats_latency_percentile(const struct stats_latency_hist *h, uint64_t permille)
+{
+	uint64_t target = (h->count * permille + 999) / 1000;
+	uint64_t seen = 0;
+
+	unsigned b;
+	for (b = 0; b < STATS_LATENCY_NBUCKETS - 1; ++b) {
+		seen += h->buckets[b];
+		if (seen >= target)
+			break;
+	}
+
+	uint64_t value = stats_latency_bucket_max(b);
+
+	return value < h->max ? value : h->max;
+}
+
+/*
+ * stats_latency_record -- records a single sample in the histogram of a lane
+ *
+ * The caller must hold the lane, which guarantees exclusive access.
+ */
+void
+stats_latency_record(struct stats *stats, unsigned lane_idx,
+	enum stats_tx_latency_phase phase, uint64_t ticks)
+{
+	struct stats_transient *t = stats->transient;
+	ASSERT(lane_idx < t->tx_latency_nlanes);
+
+	struct stats_latency_hist *h = &t->tx_latency[lane_idx].phase[phase];
+
+	h->count++;
+	h->total += ticks;
+	if (ticks > h->max)
+		h->max = ticks;
+	h->buckets[stats_latency_bucket(ticks)]++;
+}
+
+/*
+ * stats_timer_nsec -- (internal) returns the monotonic clock in nanoseconds
+ */
+static uint64_t
+stats_timer_nsec(void)
+{
+	struct timespec t;
+	os_clock_gettime(CLOCK_MONOTONIC, &t);
+
+	return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+}
+
+/*
+ * stats_latency_reset -- (internal) clears all the histograms and resets
+ *	the timer base used to convert timer ticks into nanoseconds
+ */
+static void
+stats_latency_reset(struct stats_transient *t)
+{
+	if (t->tx_latency != NULL)
+		memset(t->tx_latency, 0,
+			t->tx_latency_nlanes * sizeof(*t->tx_latency));
+
+	t->tx_latency_ticks_base = stats_timer_ticks();
+	t->tx_latency_nsec_base = stats_timer_nsec();
+}
+
+/*
+ * stats_latency_query -- (internal) merges the histograms of all lanes for the
+ *	given phase and computes the requested value, durations are returned
+ *	in nanoseconds
+ */
+static int
+stats_latency_query(struct stats *stats, enum stats_tx_latency_phase phase,
+	enum stats_latency_field field, uint64_t *value)
+{
+	struct stats_transient *t = stats->transient;
+
+	*value = 0;
+	if (t->tx_latency == NULL)
+		return 0;
+
+	struct stats_latency_hist merged;
+	memset(&merged, 0, sizeof(merged));
+
+	for (unsigned l = 0; l < t->tx_latency_nlanes; ++l) {
+		struct stats_latency_hist *h = &t->tx_latency[l].phase[phase];
+		if (h->count == 0)
+			continue;
+
+		merged.count += h->count;
+		merged.total += h->total;
+		if (h->max > merged.max)
+			merged.max = h->max;
+		for (unsigned b = 0; b < STATS_LATENCY_NBUCKETS; ++b)
+			merged.buckets[b] += h->buckets[b];
+	}
+
+	if (field == STATS_LATENCY_COUNT) {
+		*value = merged.count;
+		return 0;
+	}
+
+	if (merged.count == 0)
+		return 0;
+
+	/*
+	 * The timer frequency is derived from the time elapsed since the
+	 * histograms were last reset, so that no calibration is needed.
+	 */
+	uint64_t ticks = stats_timer_ticks() - t->tx_latency_ticks_base;
+	uint64_t nsec = stats_timer_nsec() - t->tx_latency_nsec_base;
+	double nsec_per_tick = ticks != 0 && nsec != 0 ?
+		(double)nsec / (double)ticks : 1.0;
+
+	uint64_t result;
+	switch (field) {
+		case STATS_LATENCY_TOTAL:
+			result = merged.total;
+			break;
+		case STATS_LATENCY_MAX:
+			result = merged.max;
+			break;
+		case STATS_LATENCY_P50:
+			result = stats_latency_percentile(&merged, 500);
+			break;
+		case STATS_LATENCY_P99:
+			result = stats_latency_percentile(&merged, 990);
+			break;
+		case STATS_LATENCY_P999:
+			result = stats_latency_percentile(&merged, 999);
+			break;
+		default:
+			ASSERT(0);
+			return -1;
+	}
+
+	*value = (uint64_t)((double)result * nsec_per_tick);
+
+	return 0;
+}
+
+#define STATS_LATENCY_CTL_HANDLER(phase, name, phase_id, field)\
+static int CTL_READ_HANDLER(phase##_##name)(void *ctx,\
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)\
+{\
+	PMEMobjpool *pop = ctx;\
+	return stats_latency_query(pop->stats, (phase_id), (field), arg);\
+}
+
+#define STATS_LATENCY_CTL_PHASE(phase, phase_id)\
+STATS_LATENCY_CTL_HANDLER(phase, count, phase_id, STATS_LATENCY_COUNT)\
+STATS_LATENCY_CTL_HANDLER(phase, total, phase_id, STATS_LATENCY_TOTAL)\
+STATS_LATENCY_CTL_HANDLER(phase, max, phase_id, STATS_LATENCY_MAX)\
+STATS_LATENCY_CTL_HANDLER(phase, p50, phase_id, STATS_LATENCY_P50)\
+STATS_LATENCY_CTL_HANDLER(phase, p99, phase_id, STATS_LATENCY_P99)\
+STATS_LATENCY_CTL_HANDLER(phase, p999, phase_id, STATS_LATENCY_P999)\
+static const struct ctl_node CTL_NODE(phase)[] = {\
+	STATS_CTL_LEAF(phase, count),\
+	STATS_CTL_LEAF(phase, total),\
+	STATS_CTL_LEAF(phase, max),\
+	STATS_CTL_LEAF(phase, p50),\
+	STATS_CTL_LEAF(phase, p99),\
+	STATS_CTL_LEAF(phase, p999),\
+	CTL_NODE_END\
+};
+
+STATS_LATENCY_CTL_PHASE(add_range, STATS_TX_LATENCY_ADD_RANGE)
+STATS_LATENCY_CTL_PHASE(pre_commit, STATS_TX_LATENCY_PRE_COMMIT)
+STATS_LATENCY_CTL_PHASE(process, STATS_TX_LATENCY_PROCESS)
+STATS_LATENCY_CTL_PHASE(lock, STATS_TX_LATENCY_LOCK)
+
+/*
+ * CTL_READ_HANDLER(latency_enabled) -- returns whether or not transaction
+ *	latency histograms are enabled
+ */
+static int
+CTL_READ_HANDLER(latency_enabled)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	int *arg_out = arg;
+
+	*arg_out = pop->stats->transient->tx_latency_enabled > 0;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(latency_enabled) -- enables or disables collection of
+ *	transaction latency histograms
+ */
+static int
+CTL_WRITE_HANDLER(latency_enabled)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+	struct stats_transient *t = pop->stats->transient;
+
+	int arg_in = *(int *)arg;
+
+	/*
+	 * The histograms are allocated only when first needed. Concurrent
+	 * writers race to publish them, the losers free their copies.
+	 */
+	if (arg_in > 0 && t->tx_latency == NULL) {
+		unsigned nlanes = pop->lanes_desc.runtime_nlanes;
+		struct stats_latency_lane *hist =
+			Zalloc(nlanes * sizeof(*hist));
+		if (hist == NULL) {
+			ERR("!Zalloc");
+			return -1;
+		}
+
+		t->tx_latency_nlanes = nlanes;
+		if (util_bool_compare_and_swap64(&t->tx_latency, NULL, hist))
+			stats_latency_reset(t);
+		else
+			Free(hist);
+	}
+
+	t->tx_latency_enabled = arg_in > 0;
+
+	return 0;
+}
+
+static struct ctl_argument CTL_ARG(latency_enabled) = CTL_ARG_BOOLEAN;
+
+/*
+ * CTL_RUNNABLE_HANDLER(reset) -- clears transaction latency histograms
+ */
+static int
+CTL_RUNNABLE_HANDLER(reset)(void *ctx,
+	enum ctl_query_source source, void *arg,
+	struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	stats_latency_reset(pop->stats->transient);
+
+	return 0;
+}
+
+static const struct ctl_node CTL_NODE(latency)[] = {
+	{CTL_STR(enabled), CTL_NODE_LEAF,
+		{CTL_READ_HANDLER(latency_enabled),
+		CTL_WRITE_HANDLER(latency_enabled), NULL},
+		&CTL_ARG(latency_enabled), NULL},
+	CTL_LEAF_RUNNABLE(reset),
+	CTL_CHILD(add_range),
+	CTL_CHILD(pre_commit),
+	CTL_CHILD(process),
+	CTL_CHILD(lock),
+
+	CTL_NODE_END
+};
+
+static const struct ctl_node CTL_NODE(tx)[] = {
+	CTL_CHILD(latency),
+	STATS_CTL_LEAF(transient, snapshot_bytes),
+	STATS_CTL_LEAF(transient, snapshot_skipped),
+
+	CTL_NODE_END
+};
+
 static const struct ctl_node CTL_NODE(stats)[] = {
 	CTL_CHILD(heap),
+	CTL_CHILD(tx),
 	CTL_LEAF_RW(enabled),
 
 	CTL_NODE_END
@@ -116,6 +442,7 @@ stats_delete(PMEMobjpool *pop, struct stats *s)
 {
 	pmemops_persist(&pop->p_ops, s->persistent,
 	sizeof(struct stats_persistent));
+	Free(s->transient->tx_latency);
 	Free(s->transient);
 	Free(s);
 }
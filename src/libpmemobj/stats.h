@@ -38,13 +38,73 @@
 #define LIBPMEMOBJ_STATS_H 1
 
 #include "ctl.h"
+#include "os.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__)
+#include <x86intrin.h>
+#endif
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/*
+ * Transaction phases for which latency histograms are collected.
+ */
+enum stats_tx_latency_phase {
+	STATS_TX_LATENCY_ADD_RANGE, /* pmemobj_tx_add_common */
+	STATS_TX_LATENCY_PRE_COMMIT, /* flushing of the snapshotted ranges */
+	STATS_TX_LATENCY_PROCESS, /* processing of the redo log on commit */
+	STATS_TX_LATENCY_LOCK, /* lock acquisition in add_to_tx_and_lock */
+
+	MAX_STATS_TX_LATENCY_PHASE
+};
+
+/*
+ * The latency histograms are log-linear: every power of two is split into
+ * 2^STATS_LATENCY_SUB_BITS equally sized buckets, which bounds the relative
+ * error of a recorded value to 1 / 2^STATS_LATENCY_SUB_BITS.
+ * Values above 2^STATS_LATENCY_MAX_BITS timer ticks end up in the last bucket.
+ */
+#define STATS_LATENCY_SUB_BITS 3
+#define STATS_LATENCY_SUB_BUCKETS (1 << STATS_LATENCY_SUB_BITS)
+#define STATS_LATENCY_MAX_BITS 36
+#define STATS_LATENCY_NBUCKETS\
+	((STATS_LATENCY_MAX_BITS - STATS_LATENCY_SUB_BITS + 2) *\
+	STATS_LATENCY_SUB_BUCKETS)
+
+struct stats_latency_hist {
+	uint64_t count;
+	uint64_t total;
+	uint64_t max;
+	uint64_t buckets[STATS_LATENCY_NBUCKETS];
+};
+
+/*
+ * Histograms of a single lane. Each lane is used by at most one thread at
+ * a time, which makes it possible to record samples without any
+ * synchronization. The histograms of all lanes are merged on read.
+ */
+struct stats_latency_lane {
+	struct stats_latency_hist phase[MAX_STATS_TX_LATENCY_PHASE];
+};
+
 struct stats_transient {
-	int unused;
+	int tx_latency_enabled;
+	struct stats_latency_lane *tx_latency; /* one entry per lane */
+	unsigned tx_latency_nlanes;
+
+	/* timer readings from the moment the histograms were reset */
+	uint64_t tx_latency_ticks_base;
+	uint64_t tx_latency_nsec_base;
+
+	uint64_t heap_defrag_relocated; /* bytes moved by pmemobj_defrag */
+	uint64_t heap_defrag_reclaimed; /* bytes returned to the free chunks */
+
+	uint64_t tx_snapshot_bytes; /* bytes saved in the undo logs */
+	uint64_t tx_snapshot_skipped; /* bytes already covered by the tx */
 };
 
 struct stats_persistent {
@@ -89,6 +149,41 @@ static int CTL_READ_HANDLER(type##_##name)(void *ctx,\
 	return 0;\
 }
 
+/*
+ * stats_timer_ticks -- returns the current value of a cheap, monotonic timer
+ */
+static inline uint64_t
+stats_timer_ticks(void)
+{
+#if defined(__x86_64__) || defined(_M_X64)
+	return __rdtsc();
+#else
+	struct timespec t;
+	os_clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec * 1000000000ULL + (uint64_t)t.tv_nsec;
+#endif
+}
+
+/*
+ * STATS_LATENCY_START -- returns the start timestamp of a measured phase,
+ *	or 0 if latency histograms are disabled
+ */
+#define STATS_LATENCY_START(stats)\
+((stats)->transient->tx_latency_enabled ? stats_timer_ticks() : 0)
+
+/*
+ * STATS_LATENCY_END -- records the duration of a phase started with
+ *	STATS_LATENCY_START in the histogram of the given lane
+ */
+#define STATS_LATENCY_END(stats, lane_idx, phase, start) do {\
+	if ((start) != 0)\
+		stats_latency_record((stats), (lane_idx), (phase),\
+			stats_timer_ticks() - (start));\
+} while (0)
+
+void stats_latency_record(struct stats *stats, unsigned lane_idx,
+	enum stats_tx_latency_phase phase, uint64_t ticks);
+
 void stats_ctl_register(PMEMobjpool *pop);
 
 struct stats *stats_new(PMEMobjpool *pop);
@@ -40,8 +40,10 @@
 #include "queue.h"
 #include "ravl.h"
 #include "obj.h"
+#include "os_thread.h"
 #include "out.h"
 #include "pmalloc.h"
+#include "sys_util.h"
 #include "tx.h"
 #include "valgrind_internal.h"
 #include "memops.h"
@@ -60,6 +62,8 @@ struct tx {
 	SLIST_HEAD(txd, tx_data) tx_entries;
 
 	struct ravl *ranges;
+	struct ravl *redo; /* deferred writes, NULL if there are none */
+	size_t flush_size; /* number of bytes to be flushed on commit */
 
 	VEC(, struct pobj_action) actions;
 
@@ -125,6 +129,269 @@ tx_range_def_cmp(const void *lhs, const void *rhs)
 	return 0;
 }
 
+/*
+ * tx_redo_range -- new contents of a persistent memory range, which are
+ *	written to the redo log and applied on commit
+ */
+struct tx_redo_range {
+	uint64_t offset;
+	uint64_t size;
+	char data[];
+};
+
+/*
+ * tx_redo_range_cmp -- compares two deferred writes
+ */
+static int
+tx_redo_range_cmp(const void *lhs, const void *rhs)
+{
+	const struct tx_redo_range *l = lhs;
+	const struct tx_redo_range *r = rhs;
+
+	if (l->offset > r->offset)
+		return 1;
+	else if (l->offset < r->offset)
+		return -1;
+
+	return 0;
+}
+
+/*
+ * Ranges flushed by the helper threads are split into chunks of at most this
+ * size, so that a single large range is also spread among all the threads.
+ */
+#define TX_FLUSH_CHUNK_SIZE (1 << 18)
+
+struct tx_flush_chunk {
+	void *addr;
+	size_t size;
+};
+
+/*
+ * tx_flush_pool -- helper threads which flush the ranges of large
+ *	transactions on commit
+ *
+ * The pool serves one commit at a time. The committing thread publishes
+ * the chunks to be flushed, wakes up all the helpers and takes part in
+ * flushing itself. Every helper drains its own flushes before reporting
+ * that it is done, the committer drains afterwards as usual.
+ */
+struct tx_flush_pool {
+	os_mutex_t lock; /* held by the commit using the pool */
+
+	os_mutex_t work_lock;
+	os_cond_t work_cond; /* signalled when a new job is published */
+	os_cond_t done_cond; /* signalled when the last helper is done */
+	uint64_t job; /* sequence number of the last published job */
+	unsigned busy; /* number of helpers still working on the job */
+	int stop;
+
+	PMEMobjpool *pop;
+	VEC(, struct tx_flush_chunk) chunks;
+	uint64_t next; /* index of the next chunk to be flushed */
+
+	unsigned nthreads;
+	os_thread_t threads[];
+};
+
+/*
+ * tx_flush_pool_run -- (internal) flushes chunks of the current job until
+ *	there are none left
+ */
+static void
+tx_flush_pool_run(struct tx_flush_pool *fp)
+{
+	uint64_t i;
+	while ((i = util_fetch_and_add64(&fp->next, 1)) <
+			VEC_SIZE(&fp->chunks)) {
+		struct tx_flush_chunk *c = VEC_GET(&fp->chunks, i);
+		pmemops_xflush(&fp->pop->p_ops, c->addr, c->size,
+			PMEMOBJ_F_RELAXED);
+	}
+}
+
+/*
+ * tx_flush_pool_worker -- (internal) helper thread function
+ */
+static void *
+tx_flush_pool_worker(void *arg)
+{
+	struct tx_flush_pool *fp = arg;
+	uint64_t job = 0;
+
+	util_mutex_lock(&fp->work_lock);
+	for (;;) {
+		while (!fp->stop && fp->job == job)
+			os_cond_wait(&fp->work_cond, &fp->work_lock);
+
+		if (fp->stop)
+			break;
+
+		job = fp->job;
+		util_mutex_unlock(&fp->work_lock);
+
+		tx_flush_pool_run(fp);
+		pmemops_drain(&fp->pop->p_ops);
+
+		util_mutex_lock(&fp->work_lock);
+		if (--fp->busy == 0)
+			os_cond_signal(&fp->done_cond);
+	}
+	util_mutex_unlock(&fp->work_lock);
+
+	return NULL;
+}
+
+/*
+ * tx_flush_pool_stop -- (internal) stops and joins the first n threads
+ */
+static void
+tx_flush_pool_stop(struct tx_flush_pool *fp, unsigned n)
+{
+	util_mutex_lock(&fp->work_lock);
+	fp->stop = 1;
+	os_cond_broadcast(&fp->work_cond);
+	util_mutex_unlock(&fp->work_lock);
+
+	for (unsigned i = 0; i < n; ++i)
+		os_thread_join(&fp->threads[i], NULL);
+}
+
+/*
+ * tx_flush_pool_delete -- (internal) stops the helper threads and deletes
+ *	the pool
+ */
+static void
+tx_flush_pool_delete(struct tx_flush_pool *fp)
+{
+	tx_flush_pool_stop(fp, fp->nthreads);
+
+	VEC_DELETE(&fp->chunks);
+	os_cond_destroy(&fp->done_cond);
+	os_cond_destroy(&fp->work_cond);
+	util_mutex_destroy(&fp->work_lock);
+	util_mutex_destroy(&fp->lock);
+
+	Free(fp);
+}
+
+/*
+ * tx_flush_pool_new -- (internal) creates a pool of nthreads helper threads
+ */
+static struct tx_flush_pool *
+tx_flush_pool_new(unsigned nthreads)
+{
+	struct tx_flush_pool *fp = Malloc(sizeof(*fp) +
+		nthreads * sizeof(os_thread_t));
+	if (fp == NULL)
+		return NULL;
+
+	int ret;
+	if ((ret = os_cond_init(&fp->work_cond)) != 0)
+		goto err_work_cond;
+	if ((ret = os_cond_init(&fp->done_cond)) != 0)
+		goto err_done_cond;
+
+	util_mutex_init(&fp->lock);
+	util_mutex_init(&fp->work_lock);
+	fp->job = 0;
+	fp->busy = 0;
+	fp->stop = 0;
+	fp->pop = NULL;
+	VEC_INIT(&fp->chunks);
+	fp->next = 0;
+	fp->nthreads = nthreads;
+
+	for (unsigned i = 0; i < nthreads; ++i) {
+		ret = os_thread_create(&fp->threads[i], NULL,
+			tx_flush_pool_worker, fp);
+		if (ret != 0) {
+			errno = ret;
+			ERR("!os_thread_create");
+
+			fp->nthreads = i;
+			tx_flush_pool_delete(fp);
+			errno = ret;
+			return NULL;
+		}
+	}
+
+	return fp;
+
+err_done_cond:
+	os_cond_destroy(&fp->work_cond);
+err_work_cond:
+	Free(fp);
+	errno = ret;
+	ERR("!os_cond_init");
+	return NULL;
+}
+
+/*
+ * tx_commit_member -- a commit waiting for its ranges to be flushed by
+ *	the leader of a group
+ */
+struct tx_commit_member {
+	struct ravl *ranges;
+	struct tx_commit_member *next;
+	int done;
+};
+
+/*
+ * tx_commit_group -- state of the group commit
+ *
+ * Commits that happen at the same time are gathered in a list. One of them
+ * becomes the leader, flushes the ranges of all the gathered commits and
+ * issues a single drain for the whole group. The commits which arrive while
+ * the leader is busy form the next group.
+ */
+struct tx_commit_group {
+	os_mutex_t lock;
+	os_cond_t cond; /* signalled when a group is done */
+	struct tx_commit_member *pending; /* commits waiting for a leader */
+	int leader; /* whether a group is being flushed */
+};
+
+/*
+ * tx_commit_group_new -- (internal) creates the group commit state
+ */
+static struct tx_commit_group *
+tx_commit_group_new(void)
+{
+	struct tx_commit_group *g = Malloc(sizeof(*g));
+	if (g == NULL)
+		return NULL;
+
+	int ret = os_cond_init(&g->cond);
+	if (ret != 0) {
+		Free(g);
+		errno = ret;
+		ERR("!os_cond_init");
+		return NULL;
+	}
+
+	util_mutex_init(&g->lock);
+	g->pending = NULL;
+	g->leader = 0;
+
+	return g;
+}
+
+/*
+ * tx_commit_group_delete -- (internal) deletes the group commit state
+ */
+static void
+tx_commit_group_delete(struct tx_commit_group *g)
+{
+	ASSERTeq(g->pending, NULL);
+	ASSERTeq(g->leader, 0);
+
+	util_mutex_destroy(&g->lock);
+	os_cond_destroy(&g->cond);
+
+	Free(g);
+}
+
 /*
  * tx_params_new -- creates a new transactional parameters instance and fills it
  *	with default values.
@@ -137,16 +404,45 @@ tx_params_new(void)
 		return NULL;
 
 	tx_params->cache_size = TX_DEFAULT_RANGE_CACHE_SIZE;
+	tx_params->ulog_retain = TX_DEFAULT_ULOG_RETAIN;
+	tx_params->ulog_decay = TX_DEFAULT_ULOG_DECAY;
+	tx_params->flush_threshold = TX_DEFAULT_FLUSH_THRESHOLD;
+	tx_params->flush_threads = TX_DEFAULT_FLUSH_THREADS;
+	tx_params->commit_helpers = 0;
+	tx_params->flush_pool = NULL;
+	tx_params->commit_group = NULL;
+	util_rwlock_init(&tx_params->commit_lock);
 
 	return tx_params;
 }
 
+/*
+ * tx_params_update_helpers -- (internal) tells the commits whether they have
+ *	to look at the flush pool and the commit group, must be called with
+ *	the commit lock held for writing
+ */
+static void
+tx_params_update_helpers(struct tx_parameters *tx_params)
+{
+	uint32_t helpers = tx_params->flush_pool != NULL ||
+		tx_params->commit_group != NULL;
+
+	util_atomic_store_explicit32(&tx_params->commit_helpers, helpers,
+		memory_order_relaxed);
+}
+
 /*
  * tx_params_delete -- deletes transactional parameters instance
  */
 void
 tx_params_delete(struct tx_parameters *tx_params)
 {
+	if (tx_params->flush_pool != NULL)
+		tx_flush_pool_delete(tx_params->flush_pool);
+	if (tx_params->commit_group != NULL)
+		tx_commit_group_delete(tx_params->commit_group);
+	util_rwlock_destroy(&tx_params->commit_lock);
+
 	Free(tx_params);
 }
 
@@ -422,6 +718,156 @@ tx_clean_range(void *data, void *ctx)
 	VALGRIND_SET_CLEAN(OBJ_OFF_TO_PTR(pop, range->offset), range->size);
 }
 
+/*
+ * tx_lane_idx -- (internal) returns the index of the lane held by the tx
+ */
+static inline unsigned
+tx_lane_idx(struct tx *tx)
+{
+	return (unsigned)(tx->lane - tx->pop->lanes_desc.lane);
+}
+
+/*
+ * tx_flush_range_split -- (internal) splits one range into chunks for the
+ *	helper threads
+ */
+static void
+tx_flush_range_split(void *data, void *ctx)
+{
+	struct tx_flush_pool *fp = ctx;
+	struct tx_range_def *range = data;
+	char *addr = OBJ_OFF_TO_PTR(fp->pop, range->offset);
+
+	VALGRIND_REMOVE_FROM_TX(addr, range->size);
+
+	if (range->flags & POBJ_FLAG_NO_FLUSH)
+		return;
+
+	for (size_t off = 0; off < range->size; off += TX_FLUSH_CHUNK_SIZE) {
+		struct tx_flush_chunk c = {addr + off,
+			MIN(range->size - off, TX_FLUSH_CHUNK_SIZE)};
+
+		/* if there's no memory for the chunk, flush it right away */
+		if (VEC_PUSH_BACK(&fp->chunks, c) != 0)
+			pmemops_xflush(&fp->pop->p_ops, c.addr, c.size,
+				PMEMOBJ_F_RELAXED);
+	}
+}
+
+/*
+ * tx_flush_parallel -- (internal) flushes all ranges of the transaction with
+ *	the help of the flush pool threads
+ */
+static void
+tx_flush_parallel(struct tx *tx, struct tx_flush_pool *fp)
+{
+	fp->pop = tx->pop;
+	ravl_delete_cb(tx->ranges, tx_flush_range_split, fp);
+	tx->ranges = NULL;
+
+	fp->next = 0;
+
+	util_mutex_lock(&fp->work_lock);
+	fp->busy = fp->nthreads;
+	fp->job++;
+	os_cond_broadcast(&fp->work_cond);
+	util_mutex_unlock(&fp->work_lock);
+
+	tx_flush_pool_run(fp);
+
+	util_mutex_lock(&fp->work_lock);
+	while (fp->busy != 0)
+		os_cond_wait(&fp->done_cond, &fp->work_lock);
+	util_mutex_unlock(&fp->work_lock);
+
+	VEC_CLEAR(&fp->chunks);
+}
+
+/*
+ * tx_group_flush_range -- (internal) flushes one range of a group member
+ */
+static void
+tx_group_flush_range(void *data, void *ctx)
+{
+	PMEMobjpool *pop = ctx;
+	struct tx_range_def *range = data;
+	if (!(range->flags & POBJ_FLAG_NO_FLUSH)) {
+		pmemops_xflush(&pop->p_ops, OBJ_OFF_TO_PTR(pop, range->offset),
+				range->size, PMEMOBJ_F_RELAXED);
+	}
+}
+
+/*
+ * tx_untrack_range -- (internal) removes one flushed range from the
+ *	transaction of the current thread
+ */
+static void
+tx_untrack_range(void *data, void *ctx)
+{
+	PMEMobjpool *pop = ctx;
+	struct tx_range_def *range = data;
+	VALGRIND_REMOVE_FROM_TX(OBJ_OFF_TO_PTR(pop, range->offset),
+		range->size);
+}
+
+/*
+ * tx_flush_group -- (internal) makes the ranges of the transaction durable
+ *	together with the ranges of the concurrent commits
+ *
+ * The stores of the waiting commits are visible to the leader once it takes
+ * them off the pending list, so it can write back their cache lines and
+ * fence its own flushes on their behalf.
+ */
+static void
+tx_flush_group(struct tx *tx, struct tx_commit_group *g)
+{
+	PMEMobjpool *pop = tx->pop;
+	struct tx_commit_member self = {tx->ranges, NULL, 0};
+
+	/*
+	 * The drain of the leader only fences its own stores, the
+	 * non-temporal ones of this thread (e.g. the direct writes of
+	 * pmemobj_tx_redo_write) have to be fenced here.
+	 */
+	pmemops_drain(&pop->p_ops);
+
+	util_mutex_lock(&g->lock);
+	self.next = g->pending;
+	g->pending = &self;
+
+	while (!self.done) {
+		if (g->leader) {
+			os_cond_wait(&g->cond, &g->lock);
+			continue;
+		}
+
+		/* take all the pending commits, including this one */
+		g->leader = 1;
+		struct tx_commit_member *group = g->pending;
+		g->pending = NULL;
+		util_mutex_unlock(&g->lock);
+
+		struct tx_commit_member *m;
+		for (m = group; m != NULL; m = m->next)
+			ravl_foreach(m->ranges, tx_group_flush_range, pop);
+		pmemops_drain(&pop->p_ops);
+
+		util_mutex_lock(&g->lock);
+		m = group;
+		while (m != NULL) {
+			struct tx_commit_member *next = m->next;
+			m->done = 1;
+			m = next;
+		}
+		g->leader = 0;
+		os_cond_broadcast(&g->cond);
+	}
+	util_mutex_unlock(&g->lock);
+
+	ravl_delete_cb(tx->ranges, tx_untrack_range, pop);
+	tx->ranges = NULL;
+}
+
 /*
  * tx_pre_commit -- (internal) do pre-commit operations
  */
@@ -430,12 +876,177 @@ tx_pre_commit(struct tx *tx)
 {
 	LOG(5, NULL);
 
-	/* Flush all regions and destroy the whole tree. */
-	ravl_delete_cb(tx->ranges, tx_flush_range, tx->pop);
-	tx->ranges = NULL;
+	PMEMobjpool *pop = tx->pop;
+	struct tx_parameters *params = pop->tx_params;
+
+	uint64_t start = STATS_LATENCY_START(pop->stats);
+
+	/*
+	 * The commit lock is only taken if the flush pool or the commit group
+	 * might be set, a stale value of the flag is rechecked under the lock.
+	 */
+	uint32_t helpers;
+	util_atomic_load_explicit32(&params->commit_helpers, &helpers,
+		memory_order_relaxed);
+
+	struct tx_flush_pool *fp = NULL;
+	struct tx_commit_group *g = NULL;
+	if (helpers) {
+		util_rwlock_rdlock(&params->commit_lock);
+		fp = params->flush_pool;
+		g = params->commit_group;
+	}
+
+	/*
+	 * Large transactions are flushed in parallel, unless the pool is busy
+	 * with another commit. Remote replicas are excluded, because each
+	 * flush to them would have to hold a separate lane.
+	 */
+	if (fp != NULL && tx->flush_size >= params->flush_threshold &&
+	    !pop->has_remote_replicas && util_mutex_trylock(&fp->lock) == 0) {
+		tx_flush_parallel(tx, fp);
+		util_mutex_unlock(&fp->lock);
+		pmemops_drain(&pop->p_ops);
+	} else if (g != NULL && tx->flush_size != 0 &&
+	    !pop->has_remote_replicas) {
+		/* the group is drained by its leader */
+		tx_flush_group(tx, g);
+	} else {
+		/* Flush all regions and destroy the whole tree. */
+		ravl_delete_cb(tx->ranges, tx_flush_range, pop);
+		tx->ranges = NULL;
+		pmemops_drain(&pop->p_ops);
+	}
+
+	if (helpers)
+		util_rwlock_unlock(&params->commit_lock);
+
+	STATS_LATENCY_END(tx->pop->stats, tx_lane_idx(tx),
+		STATS_TX_LATENCY_PRE_COMMIT, start);
 }
 
 
+/*
+ * tx_redo_range_delete -- (internal) frees one deferred write
+ */
+static void
+tx_redo_range_delete(void *data, void *ctx)
+{
+	Free(data);
+}
+
+/*
+ * tx_redo_apply -- (internal) writes the parts of the deferred writes which
+ *	overlap with the range directly to persistent memory, and drops them
+ *	from the set of deferred writes
+ *
+ * This is called once the range is added to the transaction. From then on
+ * the application may modify the memory directly, and those stores must not
+ * be overwritten by older deferred writes on commit.
+ */
+static int
+tx_redo_apply(struct tx *tx, uint64_t offset, uint64_t size)
+{
+	if (tx->redo == NULL)
+		return 0;
+
+	uint64_t end = offset + size;
+
+	/* the deferred writes don't overlap, so the order doesn't matter */
+	struct tx_redo_range search = {end, 0};
+	struct ravl_node *n;
+	while ((n = ravl_find(tx->redo, &search,
+	    RAVL_PREDICATE_LESS)) != NULL) {
+		struct tx_redo_range *r = ravl_data(n);
+		uint64_t rend = r->offset + r->size;
+		if (rend <= offset)
+			break;
+
+		uint64_t s = MAX(r->offset, offset);
+		uint64_t e = MIN(rend, end);
+		pmemops_memcpy(&tx->pop->p_ops, OBJ_OFF_TO_PTR(tx->pop, s),
+			r->data + (s - r->offset), e - s,
+			PMEMOBJ_F_MEM_NODRAIN);
+
+		/* the part past the end of the range remains deferred */
+		if (rend > end) {
+			struct tx_redo_range *t =
+				Malloc(sizeof(*t) + rend - end);
+			if (t == NULL)
+				return -1;
+
+			t->offset = end;
+			t->size = rend - end;
+			memcpy(t->data, r->data + (end - r->offset), t->size);
+			if (ravl_insert(tx->redo, t) != 0) {
+				Free(t);
+				return -1;
+			}
+		}
+
+		/* and so does the part before its beginning */
+		if (r->offset < offset) {
+			r->size = offset - r->offset;
+			break;
+		}
+
+		search.offset = r->offset;
+		ravl_remove(tx->redo, n);
+		Free(r);
+	}
+
+	return 0;
+}
+
+/*
+ * tx_redo_log_args -- arguments of tx_redo_range_log
+ */
+struct tx_redo_log_args {
+	struct tx *tx;
+	int ret;
+};
+
+/*
+ * tx_redo_range_log -- (internal) logs one deferred write in the redo log
+ *	and frees it
+ */
+static void
+tx_redo_range_log(void *data, void *ctx)
+{
+	struct tx_redo_range *range = data;
+	struct tx_redo_log_args *args = ctx;
+	struct tx *tx = args->tx;
+
+	if (args->ret == 0)
+		args->ret = operation_add_buffer(tx->lane->external,
+			OBJ_OFF_TO_PTR(tx->pop, range->offset), range->data,
+			range->size, ULOG_OPERATION_BUF_CPY);
+
+	Free(range);
+}
+
+/*
+ * tx_redo_log -- (internal) logs all the deferred writes of the transaction
+ *	in the redo log which is processed on commit
+ */
+static int
+tx_redo_log(struct tx *tx)
+{
+	if (tx->redo == NULL)
+		return 0;
+
+	struct tx_redo_log_args args = {tx, 0};
+	ravl_delete_cb(tx->redo, tx_redo_range_log, &args);
+	tx->redo = NULL;
+
+	if (args.ret != 0)
+		return args.ret;
+
+	/* the value entries of the actions are logged after the buffers */
+	return operation_reserve_entries(tx->lane->external,
+		VEC_SIZE(&tx->actions));
+}
+
 /*
  * tx_abort -- (internal) abort all allocated objects
  */
@@ -448,6 +1059,11 @@ tx_abort(PMEMobjpool *pop, struct lane *lane)
 
 	tx_abort_set(pop, lane);
 
+	if (tx->redo != NULL) {
+		ravl_delete_cb(tx->redo, tx_redo_range_delete, NULL);
+		tx->redo = NULL;
+	}
+
 	ravl_delete_cb(tx->ranges, tx_clean_range, pop);
 	palloc_cancel(&pop->heap,
 		VEC_ARR(&tx->actions), VEC_SIZE(&tx->actions));
@@ -485,6 +1101,8 @@ add_to_tx_and_lock(struct tx *tx, enum pobj_tx_param type, void *lock)
 	if (txl == NULL)
 		return ENOMEM;
 
+	uint64_t start = STATS_LATENCY_START(tx->pop->stats);
+
 	txl->lock_type = type;
 	switch (txl->lock_type) {
 		case TX_PARAM_MUTEX:
@@ -511,6 +1129,9 @@ add_to_tx_and_lock(struct tx *tx, enum pobj_tx_param type, void *lock)
 			break;
 	}
 
+	STATS_LATENCY_END(tx->pop->stats, tx_lane_idx(tx),
+		STATS_TX_LATENCY_LOCK, start);
+
 	SLIST_INSERT_HEAD(&tx->tx_locks, txl, tx_lock);
 
 	return retval;
@@ -598,6 +1219,9 @@ tx_alloc_common(struct tx *tx, size_t size, type_num_t type_num,
 	if (tx_lane_ranges_insert_def(pop, tx, &r) != 0)
 		goto err_oom;
 
+	if (!(args.flags & POBJ_FLAG_NO_FLUSH))
+		tx->flush_size += size;
+
 	return retoid;
 
 err_oom:
@@ -683,6 +1307,9 @@ pmemobj_tx_begin(PMEMobjpool *pop, jmp_buf env, ...)
 
 		lane_hold(pop, &tx->lane);
 		operation_start(tx->lane->undo);
+		operation_set_ulog_retention(tx->lane->undo,
+			pop->tx_params->ulog_retain,
+			pop->tx_params->ulog_decay);
 
 		VEC_INIT(&tx->actions);
 		SLIST_INIT(&tx->tx_entries);
@@ -690,6 +1317,8 @@ pmemobj_tx_begin(PMEMobjpool *pop, jmp_buf env, ...)
 
 		tx->ranges = ravl_new_sized(tx_range_def_cmp,
 			sizeof(struct tx_range_def));
+		tx->redo = NULL;
+		tx->flush_size = 0;
 
 		tx->pop = pop;
 
@@ -900,15 +1529,28 @@ pmemobj_tx_commit(void)
 
 		PMEMobjpool *pop = tx->pop;
 
-		/* pre-commit phase */
+		operation_start(tx->lane->external);
+
+		/* deferred writes are logged while the commit can still fail */
+		if (tx_redo_log(tx) != 0) {
+			operation_cancel(tx->lane->external);
+			ERR("out of memory");
+			obj_tx_abort(ENOMEM, 0);
+			PMEMOBJ_API_END();
+			return;
+		}
+
+		/* pre-commit phase, makes the modified ranges durable */
 		tx_pre_commit(tx);
 
-		pmemops_drain(&pop->p_ops);
+		uint64_t start = STATS_LATENCY_START(pop->stats);
 
-		operation_start(tx->lane->external);
 		palloc_publish(&pop->heap, VEC_ARR(&tx->actions),
 			VEC_SIZE(&tx->actions), tx->lane->external);
 
+		STATS_LATENCY_END(pop->stats, tx_lane_idx(tx),
+			STATS_TX_LATENCY_PROCESS, start);
+
 		tx_post_commit(tx);
 
 		lane_release(pop);
@@ -1084,11 +1726,11 @@ pmemobj_tx_add_snapshot(struct tx *tx, struct tx_range_def *snapshot)
 }
 
 /*
- * pmemobj_tx_add_common -- (internal) common code for adding persistent memory
+ * tx_add_common_range -- (internal) common code for adding persistent memory
  *				into the transaction
  */
 static int
-pmemobj_tx_add_common(struct tx *tx, struct tx_range_def *args)
+tx_add_common_range(struct tx *tx, struct tx_range_def *args)
 {
 	LOG(15, NULL);
 
@@ -1106,6 +1748,13 @@ pmemobj_tx_add_common(struct tx *tx, struct tx_range_def *args)
 
 	int ret = 0;
 
+	/*
+	 * Parts of the range that are already covered by the transaction,
+	 * either because they were snapshotted before or because they belong
+	 * to an object allocated in it, are not saved in the undo log again.
+	 */
+	uint64_t snapshotted = 0;
+
 	/*
 	 * Search existing ranges backwards starting from the end of the
 	 * snapshot.
@@ -1165,6 +1814,7 @@ pmemobj_tx_add_common(struct tx *tx, struct tx_range_def *args)
 				if (ret != 0)
 					break;
 			}
+			snapshotted += r.size;
 			ret = pmemobj_tx_add_snapshot(tx, &r);
 			break;
 		} else if (fend <= rend) {
@@ -1193,6 +1843,7 @@ pmemobj_tx_add_common(struct tx *tx, struct tx_range_def *args)
 			f->size += snapshot.size;
 
 			if (snapshot.size != 0) {
+				snapshotted += snapshot.size;
 				ret = pmemobj_tx_add_snapshot(tx, &snapshot);
 				if (ret != 0)
 					break;
@@ -1241,9 +1892,44 @@ pmemobj_tx_add_common(struct tx *tx, struct tx_range_def *args)
 		return obj_tx_abort_err(ENOMEM);
 	}
 
+	/*
+	 * Deferred writes to the range are folded into it, the memory is now
+	 * covered by the undo log.
+	 */
+	if (tx_redo_apply(tx, args->offset, args->size) != 0) {
+		ERR("out of memory");
+		return obj_tx_abort_err(ENOMEM);
+	}
+
+	if (!(args->flags & POBJ_FLAG_NO_FLUSH))
+		tx->flush_size += snapshotted;
+
+	STATS_INC(tx->pop->stats, transient, tx_snapshot_bytes, snapshotted);
+	STATS_INC(tx->pop->stats, transient, tx_snapshot_skipped,
+		args->size - snapshotted);
+
 	return 0;
 }
 
+/*
+ * pmemobj_tx_add_common -- (internal) adds persistent memory range into the
+ *				transaction and records the latency of doing so
+ */
+static int
+pmemobj_tx_add_common(struct tx *tx, struct tx_range_def *args)
+{
+	uint64_t start = STATS_LATENCY_START(tx->pop->stats);
+
+	int ret = tx_add_common_range(tx, args);
+
+	/* on failure the transaction is aborted and no longer holds a lane */
+	if (ret == 0)
+		STATS_LATENCY_END(tx->pop->stats, tx_lane_idx(tx),
+			STATS_TX_LATENCY_ADD_RANGE, start);
+
+	return ret;
+}
+
 /*
  * pmemobj_tx_add_range_direct -- adds persistent memory range into the
  *					transaction
@@ -1276,16 +1962,259 @@ pmemobj_tx_add_range_direct(const void *ptr, size_t size)
 
 	int ret = pmemobj_tx_add_common(tx, &args);
 
-	PMEMOBJ_API_END();
-	return ret;
+	PMEMOBJ_API_END();
+	return ret;
+}
+
+/*
+ * pmemobj_tx_xadd_range_direct -- adds persistent memory range into the
+ *					transaction
+ */
+int
+pmemobj_tx_xadd_range_direct(const void *ptr, size_t size, uint64_t flags)
+{
+	LOG(3, NULL);
+	struct tx *tx = get_tx();
+
+	ASSERT_IN_TX(tx);
+	ASSERT_TX_STAGE_WORK(tx);
+
+	PMEMOBJ_API_START();
+	int ret;
+	if (!OBJ_PTR_FROM_POOL(tx->pop, ptr)) {
+		ERR("object outside of pool");
+		ret = obj_tx_abort_err(EINVAL);
+		PMEMOBJ_API_END();
+		return ret;
+	}
+
+	if (flags & ~POBJ_XADD_VALID_FLAGS) {
+		ERR("unknown flags 0x%" PRIx64, flags & ~POBJ_XADD_VALID_FLAGS);
+		ret = obj_tx_abort_err(EINVAL);
+		PMEMOBJ_API_END();
+		return ret;
+	}
+
+	struct tx_range_def args = {
+		.offset = (uint64_t)((char *)ptr - (char *)tx->pop),
+		.size = size,
+		.flags = flags,
+	};
+
+	ret = pmemobj_tx_add_common(tx, &args);
+
+	PMEMOBJ_API_END();
+	return ret;
+}
+
+/*
+ * pmemobj_tx_add_range -- adds persistent memory range into the transaction
+ */
+int
+pmemobj_tx_add_range(PMEMoid oid, uint64_t hoff, size_t size)
+{
+	LOG(3, NULL);
+
+	PMEMOBJ_API_START();
+	struct tx *tx = get_tx();
+
+	ASSERT_IN_TX(tx);
+	ASSERT_TX_STAGE_WORK(tx);
+
+	if (oid.pool_uuid_lo != tx->pop->uuid_lo) {
+		ERR("invalid pool uuid");
+		int ret = obj_tx_abort_err(EINVAL);
+		PMEMOBJ_API_END();
+		return ret;
+	}
+	ASSERT(OBJ_OID_IS_VALID(tx->pop, oid));
+
+	struct tx_range_def args = {
+		.offset = oid.off + hoff,
+		.size = size,
+		.flags = 0,
+	};
+
+	int ret = pmemobj_tx_add_common(tx, &args);
+
+	PMEMOBJ_API_END();
+	return ret;
+}
+
+/*
+ * pmemobj_tx_xadd_range -- adds persistent memory range into the transaction
+ */
+int
+pmemobj_tx_xadd_range(PMEMoid oid, uint64_t hoff, size_t size, uint64_t flags)
+{
+	LOG(3, NULL);
+
+	PMEMOBJ_API_START();
+	struct tx *tx = get_tx();
+
+	ASSERT_IN_TX(tx);
+	ASSERT_TX_STAGE_WORK(tx);
+
+	int ret;
+	if (oid.pool_uuid_lo != tx->pop->uuid_lo) {
+		ERR("invalid pool uuid");
+		ret = obj_tx_abort_err(EINVAL);
+		PMEMOBJ_API_END();
+		return ret;
+	}
+	ASSERT(OBJ_OID_IS_VALID(tx->pop, oid));
+
+	if (flags & ~POBJ_XADD_VALID_FLAGS) {
+		ERR("unknown flags 0x%" PRIx64, flags & ~POBJ_XADD_VALID_FLAGS);
+		ret = obj_tx_abort_err(EINVAL);
+		PMEMOBJ_API_END();
+		return ret;
+	}
+
+	struct tx_range_def args = {
+		.offset = oid.off + hoff,
+		.size = size,
+		.flags = flags,
+	};
+
+	ret = pmemobj_tx_add_common(tx, &args);
+	PMEMOBJ_API_END();
+	return ret;
+}
+
+/*
+ * tx_range_covered -- (internal) checks whether the range is entirely within
+ *	a single range of the transaction, snapshotted or allocated in it
+ */
+static int
+tx_range_covered(struct tx *tx, uint64_t offset, size_t size)
+{
+	struct tx_range_def search = {offset, 0, 0};
+	struct ravl_node *n = ravl_find(tx->ranges, &search,
+		RAVL_PREDICATE_LESS_EQUAL);
+	if (n == NULL)
+		return 0;
+
+	struct tx_range_def *r = ravl_data(n);
+
+	return r->offset + r->size >= offset + size;
+}
+
+/*
+ * tx_redo_range_valid -- (internal) checks whether the range of a deferred
+ *	write lies within the heap of the pool
+ */
+static int
+tx_redo_range_valid(PMEMobjpool *pop, const void *ptr, size_t size)
+{
+	uint64_t offset = (uint64_t)((char *)ptr - (char *)pop);
+
+	return OBJ_PTR_FROM_POOL(pop, ptr) && offset >= pop->heap_offset &&
+		size <= pop->heap_offset + pop->heap_size - offset;
+}
+
+/*
+ * tx_redo_overlaps -- (internal) checks whether there's a deferred write
+ *	overlapping with the range
+ */
+static int
+tx_redo_overlaps(struct tx *tx, uint64_t offset, size_t size)
+{
+	if (tx->redo == NULL)
+		return 0;
+
+	struct tx_redo_range search = {offset + size, 0};
+	struct ravl_node *n = ravl_find(tx->redo, &search,
+		RAVL_PREDICATE_LESS);
+	if (n == NULL)
+		return 0;
+
+	struct tx_redo_range *r = ravl_data(n);
+
+	return r->offset + r->size > offset;
+}
+
+/*
+ * tx_redo_add -- (internal) buffers a deferred write, merging it with all the
+ *	deferred writes it overlaps or is adjacent to
+ */
+static int
+tx_redo_add(struct tx *tx, uint64_t offset, const void *src, size_t size)
+{
+	if (tx->redo == NULL) {
+		tx->redo = ravl_new(tx_redo_range_cmp);
+		if (tx->redo == NULL)
+			return -1;
+	}
+
+	uint64_t end = offset + size;
+	struct tx_redo_range search = {offset, 0};
+	struct ravl_node *n = ravl_find(tx->redo, &search,
+		RAVL_PREDICATE_LESS_EQUAL);
+	struct tx_redo_range *r = n ? ravl_data(n) : NULL;
+
+	/* repeated writes of the same memory are the common case */
+	if (r != NULL && r->offset + r->size >= end) {
+		memcpy(r->data + (offset - r->offset), src, size);
+		return 0;
+	}
+
+	/* find the extent of all the deferred writes to be merged */
+	uint64_t mstart = offset;
+	uint64_t mend = end;
+	search.offset = end;
+	enum ravl_predicate p = RAVL_PREDICATE_LESS_EQUAL;
+	while ((n = ravl_find(tx->redo, &search, p)) != NULL) {
+		r = ravl_data(n);
+		if (r->offset + r->size < offset)
+			break;
+
+		mstart = MIN(mstart, r->offset);
+		mend = MAX(mend, r->offset + r->size);
+		search.offset = r->offset;
+		p = RAVL_PREDICATE_LESS;
+	}
+
+	struct tx_redo_range *m = Malloc(sizeof(*m) + mend - mstart);
+	if (m == NULL)
+		return -1;
+
+	m->offset = mstart;
+	m->size = mend - mstart;
+
+	/*
+	 * Move the data of the merged writes, which all start within the new
+	 * extent, and then apply the new data on top of them.
+	 */
+	search.offset = end;
+	while ((n = ravl_find(tx->redo, &search,
+	    RAVL_PREDICATE_LESS_EQUAL)) != NULL) {
+		r = ravl_data(n);
+		if (r->offset < mstart)
+			break;
+
+		memcpy(m->data + (r->offset - mstart), r->data, r->size);
+		ravl_remove(tx->redo, n);
+		Free(r);
+	}
+
+	memcpy(m->data + (offset - mstart), src, size);
+
+	/* on failure the transaction is aborted, so nothing is lost */
+	if (ravl_insert(tx->redo, m) != 0) {
+		Free(m);
+		return -1;
+	}
+
+	return 0;
 }
 
 /*
- * pmemobj_tx_xadd_range_direct -- adds persistent memory range into the
- *					transaction
+ * pmemobj_tx_redo_write -- writes the buffer to persistent memory on commit,
+ *	using the redo log instead of snapshotting the old contents
  */
 int
-pmemobj_tx_xadd_range_direct(const void *ptr, size_t size, uint64_t flags)
+pmemobj_tx_redo_write(void *ptr, const void *src, size_t size)
 {
 	LOG(3, NULL);
 	struct tx *tx = get_tx();
@@ -1294,106 +2223,82 @@ pmemobj_tx_xadd_range_direct(const void *ptr, size_t size, uint64_t flags)
 	ASSERT_TX_STAGE_WORK(tx);
 
 	PMEMOBJ_API_START();
-	int ret;
-	if (!OBJ_PTR_FROM_POOL(tx->pop, ptr)) {
-		ERR("object outside of pool");
-		ret = obj_tx_abort_err(EINVAL);
-		PMEMOBJ_API_END();
-		return ret;
-	}
 
-	if (flags & ~POBJ_XADD_VALID_FLAGS) {
-		ERR("unknown flags 0x%" PRIx64, flags & ~POBJ_XADD_VALID_FLAGS);
+	PMEMobjpool *pop = tx->pop;
+	uint64_t offset = (uint64_t)((char *)ptr - (char *)pop);
+
+	int ret = 0;
+	if (!tx_redo_range_valid(pop, ptr, size)) {
+		ERR("object outside of heap");
 		ret = obj_tx_abort_err(EINVAL);
-		PMEMOBJ_API_END();
-		return ret;
+	} else if (size == 0) {
+		ret = 0;
+	} else if (!tx_redo_overlaps(tx, offset, size) &&
+	    tx_range_covered(tx, offset, size)) {
+		/*
+		 * Memory that is already covered by the undo log, or that
+		 * belongs to an object allocated in this transaction, can be
+		 * modified directly.
+		 */
+		pmemops_memcpy(&pop->p_ops, ptr, src, size,
+			PMEMOBJ_F_MEM_NODRAIN);
+	} else if (tx_redo_add(tx, offset, src, size) != 0) {
+		ERR("out of memory");
+		ret = obj_tx_abort_err(ENOMEM);
 	}
 
-	struct tx_range_def args = {
-		.offset = (uint64_t)((char *)ptr - (char *)tx->pop),
-		.size = size,
-		.flags = flags,
-	};
-
-	ret = pmemobj_tx_add_common(tx, &args);
-
 	PMEMOBJ_API_END();
 	return ret;
 }
 
 /*
- * pmemobj_tx_add_range -- adds persistent memory range into the transaction
+ * pmemobj_tx_redo_read -- reads persistent memory as seen by the current
+ *	transaction, including the writes deferred until commit
  */
 int
-pmemobj_tx_add_range(PMEMoid oid, uint64_t hoff, size_t size)
+pmemobj_tx_redo_read(void *dest, const void *ptr, size_t size)
 {
 	LOG(3, NULL);
-
-	PMEMOBJ_API_START();
 	struct tx *tx = get_tx();
 
 	ASSERT_IN_TX(tx);
 	ASSERT_TX_STAGE_WORK(tx);
 
-	if (oid.pool_uuid_lo != tx->pop->uuid_lo) {
-		ERR("invalid pool uuid");
+	PMEMOBJ_API_START();
+
+	PMEMobjpool *pop = tx->pop;
+	if (!tx_redo_range_valid(pop, ptr, size)) {
+		ERR("object outside of heap");
 		int ret = obj_tx_abort_err(EINVAL);
 		PMEMOBJ_API_END();
 		return ret;
 	}
-	ASSERT(OBJ_OID_IS_VALID(tx->pop, oid));
-
-	struct tx_range_def args = {
-		.offset = oid.off + hoff,
-		.size = size,
-		.flags = 0,
-	};
-
-	int ret = pmemobj_tx_add_common(tx, &args);
-
-	PMEMOBJ_API_END();
-	return ret;
-}
 
-/*
- * pmemobj_tx_xadd_range -- adds persistent memory range into the transaction
- */
-int
-pmemobj_tx_xadd_range(PMEMoid oid, uint64_t hoff, size_t size, uint64_t flags)
-{
-	LOG(3, NULL);
+	memcpy(dest, ptr, size);
 
-	PMEMOBJ_API_START();
-	struct tx *tx = get_tx();
+	uint64_t offset = (uint64_t)((char *)ptr - (char *)pop);
+	uint64_t end = offset + size;
 
-	ASSERT_IN_TX(tx);
-	ASSERT_TX_STAGE_WORK(tx);
+	/* the deferred writes don't overlap, so the order doesn't matter */
+	struct tx_redo_range search = {end, 0};
+	struct ravl_node *n;
+	while (tx->redo != NULL && (n = ravl_find(tx->redo, &search,
+	    RAVL_PREDICATE_LESS)) != NULL) {
+		struct tx_redo_range *r = ravl_data(n);
+		uint64_t rend = r->offset + r->size;
+		if (rend <= offset)
+			break;
 
-	int ret;
-	if (oid.pool_uuid_lo != tx->pop->uuid_lo) {
-		ERR("invalid pool uuid");
-		ret = obj_tx_abort_err(EINVAL);
-		PMEMOBJ_API_END();
-		return ret;
-	}
-	ASSERT(OBJ_OID_IS_VALID(tx->pop, oid));
+		uint64_t s = MAX(r->offset, offset);
+		uint64_t e = MIN(rend, end);
+		memcpy((char *)dest + (s - offset),
+			r->data + (s - r->offset), e - s);
 
-	if (flags & ~POBJ_XADD_VALID_FLAGS) {
-		ERR("unknown flags 0x%" PRIx64, flags & ~POBJ_XADD_VALID_FLAGS);
-		ret = obj_tx_abort_err(EINVAL);
-		PMEMOBJ_API_END();
-		return ret;
+		search.offset = r->offset;
 	}
 
-	struct tx_range_def args = {
-		.offset = oid.off + hoff,
-		.size = size,
-		.flags = flags,
-	};
-
-	ret = pmemobj_tx_add_common(tx, &args);
 	PMEMOBJ_API_END();
-	return ret;
+	return 0;
 }
 
 /*
@@ -1654,6 +2559,9 @@ pmemobj_tx_free(PMEMoid oid)
 				void *ptr = OBJ_OFF_TO_PTR(pop, r->offset);
 				VALGRIND_SET_CLEAN(ptr, r->size);
 				VALGRIND_REMOVE_FROM_TX(ptr, r->size);
+				if (!(r->flags & POBJ_FLAG_NO_FLUSH))
+					tx->flush_size -= MIN(r->size,
+						tx->flush_size);
 				ravl_remove(tx->ranges, n);
 				palloc_cancel(&pop->heap, action, 1);
 				VEC_ERASE_BY_PTR(&tx->actions, action);
@@ -1770,9 +2678,260 @@ CTL_WRITE_HANDLER(threshold)(void *ctx,
 
 static struct ctl_argument CTL_ARG(threshold) = CTL_ARG_LONG_LONG;
 
+/*
+ * CTL_READ_HANDLER(retain) -- gets the undo log retention transaction parameter
+ */
+static int
+CTL_READ_HANDLER(retain)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	ssize_t *arg_out = arg;
+
+	*arg_out = (ssize_t)pop->tx_params->ulog_retain;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(retain) -- sets the undo log retention transaction
+ *	parameter
+ */
+static int
+CTL_WRITE_HANDLER(retain)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	ssize_t arg_in = *(ssize_t *)arg;
+
+	if (arg_in < 0) {
+		errno = EINVAL;
+		ERR("invalid undo log retention size, must be positive");
+		return -1;
+	}
+
+	pop->tx_params->ulog_retain = (size_t)arg_in;
+
+	return 0;
+}
+
+static struct ctl_argument CTL_ARG(retain) = CTL_ARG_LONG_LONG;
+
+/*
+ * CTL_READ_HANDLER(decay) -- gets the undo log decay transaction parameter
+ */
+static int
+CTL_READ_HANDLER(decay)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	ssize_t *arg_out = arg;
+
+	*arg_out = (ssize_t)pop->tx_params->ulog_decay;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(decay) -- sets the undo log decay transaction parameter
+ */
+static int
+CTL_WRITE_HANDLER(decay)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	ssize_t arg_in = *(ssize_t *)arg;
+
+	if (arg_in < 0) {
+		errno = EINVAL;
+		ERR("invalid undo log decay, must be positive");
+		return -1;
+	}
+
+	pop->tx_params->ulog_decay = (size_t)arg_in;
+
+	return 0;
+}
+
+static struct ctl_argument CTL_ARG(decay) = CTL_ARG_LONG_LONG;
+
 static const struct ctl_node CTL_NODE(cache)[] = {
 	CTL_LEAF_RW(size),
 	CTL_LEAF_RW(threshold),
+	CTL_LEAF_RW(retain),
+	CTL_LEAF_RW(decay),
+
+	CTL_NODE_END
+};
+
+/*
+ * CTL_READ_HANDLER(flush_threads) -- gets the number of commit flush threads
+ */
+static int
+CTL_READ_HANDLER(flush_threads)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	ssize_t *arg_out = arg;
+
+	util_rwlock_rdlock(&pop->tx_params->commit_lock);
+	*arg_out = (ssize_t)pop->tx_params->flush_threads;
+	util_rwlock_unlock(&pop->tx_params->commit_lock);
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(flush_threads) -- sets the number of commit flush threads
+ *	and restarts the helper thread pool
+ *
+ * The old pool is deleted once the commits which are using it are done.
+ */
+static int
+CTL_WRITE_HANDLER(flush_threads)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	ssize_t arg_in = *(ssize_t *)arg;
+
+	if (arg_in < 0 || arg_in > UINT_MAX) {
+		errno = EINVAL;
+		ERR("invalid number of flush threads");
+		return -1;
+	}
+
+	struct tx_parameters *params = pop->tx_params;
+	int ret = 0;
+
+	util_rwlock_wrlock(&params->commit_lock);
+
+	if (params->flush_pool != NULL) {
+		tx_flush_pool_delete(params->flush_pool);
+		params->flush_pool = NULL;
+		params->flush_threads = 0;
+	}
+
+	if (arg_in != 0) {
+		params->flush_pool = tx_flush_pool_new((unsigned)arg_in);
+		if (params->flush_pool == NULL)
+			ret = -1;
+		else
+			params->flush_threads = (unsigned)arg_in;
+	}
+
+	tx_params_update_helpers(params);
+	util_rwlock_unlock(&params->commit_lock);
+
+	return ret;
+}
+
+static struct ctl_argument CTL_ARG(flush_threads) = CTL_ARG_LONG_LONG;
+
+/*
+ * CTL_READ_HANDLER(flush_threshold) -- gets the size of a transaction above
+ *	which it is flushed in parallel
+ */
+static int
+CTL_READ_HANDLER(flush_threshold)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	ssize_t *arg_out = arg;
+
+	*arg_out = (ssize_t)pop->tx_params->flush_threshold;
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(flush_threshold) -- sets the size of a transaction above
+ *	which it is flushed in parallel
+ */
+static int
+CTL_WRITE_HANDLER(flush_threshold)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	ssize_t arg_in = *(ssize_t *)arg;
+
+	if (arg_in < 0) {
+		errno = EINVAL;
+		ERR("invalid flush threshold, must be positive");
+		return -1;
+	}
+
+	pop->tx_params->flush_threshold = (size_t)arg_in;
+
+	return 0;
+}
+
+static struct ctl_argument CTL_ARG(flush_threshold) = CTL_ARG_LONG_LONG;
+
+/*
+ * CTL_READ_HANDLER(group) -- returns whether the group commit is enabled
+ */
+static int
+CTL_READ_HANDLER(group)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	int *arg_out = arg;
+
+	util_rwlock_rdlock(&pop->tx_params->commit_lock);
+	*arg_out = pop->tx_params->commit_group != NULL;
+	util_rwlock_unlock(&pop->tx_params->commit_lock);
+
+	return 0;
+}
+
+/*
+ * CTL_WRITE_HANDLER(group) -- enables or disables the group commit
+ *
+ * The group is deleted once the commits which are flushed with it are done.
+ */
+static int
+CTL_WRITE_HANDLER(group)(void *ctx,
+	enum ctl_query_source source, void *arg, struct ctl_indexes *indexes)
+{
+	PMEMobjpool *pop = ctx;
+
+	int arg_in = *(int *)arg;
+
+	struct tx_parameters *params = pop->tx_params;
+	int ret = 0;
+
+	util_rwlock_wrlock(&params->commit_lock);
+
+	if (arg_in && params->commit_group == NULL) {
+		params->commit_group = tx_commit_group_new();
+		if (params->commit_group == NULL)
+			ret = -1;
+	} else if (!arg_in && params->commit_group != NULL) {
+		tx_commit_group_delete(params->commit_group);
+		params->commit_group = NULL;
+	}
+
+	tx_params_update_helpers(params);
+	util_rwlock_unlock(&params->commit_lock);
+
+	return ret;
+}
+
+static struct ctl_argument CTL_ARG(group) = CTL_ARG_BOOLEAN;
+
+static const struct ctl_node CTL_NODE(commit)[] = {
+	CTL_LEAF_RW(flush_threads),
+	CTL_LEAF_RW(flush_threshold),
+	CTL_LEAF_RW(group),
 
 	CTL_NODE_END
 };
@@ -1871,6 +3030,7 @@ static const struct ctl_node CTL_NODE(post_commit)[] = {
 static const struct ctl_node CTL_NODE(tx)[] = {
 	CTL_CHILD(debug),
 	CTL_CHILD(cache),
+	CTL_CHILD(commit),
 	CTL_CHILD(post_commit),
 
 	CTL_NODE_END
@@ -47,6 +47,10 @@ extern "C" {
 
 #define TX_DEFAULT_RANGE_CACHE_SIZE (1 << 15)
 #define TX_DEFAULT_RANGE_CACHE_THRESHOLD (1 << 12)
+#define TX_DEFAULT_ULOG_RETAIN 0
+#define TX_DEFAULT_ULOG_DECAY 0
+#define TX_DEFAULT_FLUSH_THREADS 0
+#define TX_DEFAULT_FLUSH_THRESHOLD (1 << 22)
 
 #define TX_RANGE_MASK (8ULL - 1)
 #define TX_RANGE_MASK_LEGACY (32ULL - 1)
@@ -55,6 +59,19 @@ extern "C" {
 
 struct tx_parameters {
 	size_t cache_size;
+	size_t ulog_retain; /* undo log capacity retained in a lane */
+	size_t ulog_decay; /* transactions after which it is released */
+	size_t flush_threshold; /* commit size above which flush is parallel */
+	unsigned flush_threads; /* number of helper threads, 0 if disabled */
+
+	/*
+	 * The lock is held for reading by the commits which use the flush
+	 * pool or the commit group, so that ctl can't delete them underneath.
+	 */
+	os_rwlock_t commit_lock;
+	uint32_t commit_helpers; /* nonzero if either of the below is set */
+	struct tx_flush_pool *flush_pool;
+	struct tx_commit_group *commit_group; /* NULL if group commit is off */
 };
 
 /*
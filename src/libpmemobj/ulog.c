@@ -34,6 +34,7 @@
  * ulog.c -- unified log implementation
  */
 
+#include <endian.h>
 #include <inttypes.h>
 #include <string.h>
 
@@ -122,13 +123,38 @@ ulog_entry_size(const struct ulog_entry_base *entry)
 	return 0;
 }
 
+/*
+ * ulog_entry_buf_checksum -- (internal) calculates the checksum of a buffer
+ *	entry, with the checksum field itself treated as zeroes
+ */
+static uint64_t
+ulog_entry_buf_checksum(const struct ulog_entry_buf *b, size_t size)
+{
+	uint64_t zero = 0;
+	uint64_t csum = util_checksum_seq(b,
+		offsetof(struct ulog_entry_buf, checksum), 0);
+	csum = util_checksum_seq(&zero, sizeof(zero), csum);
+
+	return util_checksum_seq(&b->size,
+		size - offsetof(struct ulog_entry_buf, size), csum);
+}
+
 /*
  * ulog_entry_valid -- (internal) checks if a ulog entry is valid
  * Returns 1 if the range is valid, otherwise 0 is returned.
+ *
+ * The checksum of buffer entries is tagged with the generation number of the
+ * log they were created in, entries left behind by previous generations are
+ * therefore never valid. Since such logs are not zeroed out, the data
+ * following the last valid entry is arbitrary, which is why, past the first
+ * generation, only buffer entries that fit in the log are accepted.
  */
 static int
-ulog_entry_valid(const struct ulog_entry_base *entry)
+ulog_entry_valid(struct ulog *ulog, size_t offset, uint64_t gen_num)
 {
+	struct ulog_entry_base *entry =
+		(struct ulog_entry_base *)(ulog->data + offset);
+
 	if (entry->offset == 0)
 		return 0;
 
@@ -138,12 +164,21 @@ ulog_entry_valid(const struct ulog_entry_base *entry)
 	switch (ulog_entry_type(entry)) {
 		case ULOG_OPERATION_BUF_CPY:
 		case ULOG_OPERATION_BUF_SET:
-			size = ulog_entry_size(entry);
 			b = (struct ulog_entry_buf *)entry;
-			if (!util_checksum(b, size, &b->checksum, 0, 0))
+			if (offset + sizeof(struct ulog_entry_buf) >
+			    ulog->capacity)
+				return 0;
+			if (b->size > ulog->capacity - offset -
+			    sizeof(struct ulog_entry_buf))
+				return 0;
+			size = ulog_entry_size(entry);
+			if (b->checksum !=
+			    (ulog_entry_buf_checksum(b, size) ^ gen_num))
 				return 0;
 			break;
 		default:
+			if (gen_num != 0)
+				return 0;
 			break;
 	}
 
@@ -165,6 +200,7 @@ ulog_construct(uint64_t offset, size_t capacity, int flush,
 	ulog->capacity = capacity;
 	ulog->checksum = 0;
 	ulog->next = 0;
+	ulog->gen_num = 0;
 	memset(ulog->unused, 0, sizeof(ulog->unused));
 
 	if (flush) {
@@ -187,6 +223,8 @@ ulog_construct(uint64_t offset, size_t capacity, int flush,
 
 /*
  * ulog_foreach_entry -- iterates over every existing entry in the ulog
+ *
+ * The generation of the entries is always the one of the first ulog.
  */
 int
 ulog_foreach_entry(struct ulog *ulog,
@@ -194,11 +232,12 @@ ulog_foreach_entry(struct ulog *ulog,
 {
 	struct ulog_entry_base *e;
 	int ret = 0;
+	uint64_t gen_num = ulog->gen_num;
 
 	for (struct ulog *r = ulog; r != NULL; r = ulog_next(r, ops)) {
 		for (size_t offset = 0; offset < r->capacity; ) {
 			e = (struct ulog_entry_base *)(r->data + offset);
-			if (!ulog_entry_valid(e))
+			if (!ulog_entry_valid(r, offset, gen_num))
 				return ret;
 
 			if ((ret = cb(e, arg, ops)) != 0)
@@ -357,6 +396,41 @@ ulog_store(struct ulog *dest, struct ulog *src, size_t nbytes,
 		PMEMOBJ_F_MEM_WC);
 }
 
+/*
+ * ulog_header_checksum -- calculates the partial checksum of the ulog header,
+ *	which is later extended with the entries by ulog_store_compact
+ */
+uint64_t
+ulog_header_checksum(struct ulog *ulog)
+{
+	/* the checksum itself is treated as zeros, which don't change it */
+	return util_checksum_seq(&ulog->next,
+		sizeof(struct ulog) - sizeof(ulog->checksum), 0);
+}
+
+/*
+ * ulog_store_compact -- stores the transient src ulog, whose entries fit in
+ *	the first cacheline of the data, in the persistent dest ulog
+ *
+ * This is equivalent to ulog_store, but the checksum is only calculated
+ * over the entries, starting from the precomputed checksum of the header.
+ * The header of src must not have changed since header_csum was calculated.
+ */
+void
+ulog_store_compact(struct ulog *dest, struct ulog *src, size_t nbytes,
+	uint64_t header_csum, const struct pmem_ops *p_ops)
+{
+	ASSERT(nbytes + sizeof(struct ulog_entry_base) <= CACHELINE_SIZE);
+
+	src->checksum = htole64(util_checksum_seq(src->data, nbytes,
+		header_csum));
+	ASSERT(ulog_checksum(src, nbytes, 0));
+
+	pmemops_memcpy(p_ops, dest, src,
+		SIZEOF_ULOG(CACHELINE_SIZE),
+		PMEMOBJ_F_MEM_WC);
+}
+
 /*
  * ulog_entry_val_create -- creates a new log value entry in the ulog
  *
@@ -395,10 +469,13 @@ ulog_entry_val_create(struct ulog *ulog, size_t offset, uint64_t *dest,
 
 /*
  * ulog_entry_buf_create -- atomically creates a buffer entry in the log
+ *
+ * The 'gen_num' is the current generation of the first ulog, regardless of
+ * which of the logs the entry is created in.
  */
 struct ulog_entry_buf *
-ulog_entry_buf_create(struct ulog *ulog, size_t offset, uint64_t *dest,
-	const void *src, uint64_t size,
+ulog_entry_buf_create(struct ulog *ulog, size_t offset, uint64_t gen_num,
+	uint64_t *dest, const void *src, uint64_t size,
 	ulog_operation_type type, const struct pmem_ops *p_ops)
 {
 	struct ulog_entry_buf *e =
@@ -469,6 +546,8 @@ ulog_entry_buf_create(struct ulog *ulog, size_t offset, uint64_t *dest,
 		b->checksum = util_checksum_seq(last_cacheline,
 			CACHELINE_SIZE, b->checksum);
 
+	b->checksum ^= gen_num;
+
 	ASSERT(IS_CACHELINE_ALIGNED(e));
 
 	VALGRIND_ADD_TO_TX(e, CACHELINE_SIZE);
@@ -478,7 +557,38 @@ ulog_entry_buf_create(struct ulog *ulog, size_t offset, uint64_t *dest,
 
 	pmemops_drain(p_ops);
 
-	ASSERT(ulog_entry_valid(&e->base));
+	ASSERT(ulog_entry_valid(ulog, offset, gen_num));
+
+	return e;
+}
+
+/*
+ * ulog_entry_buf_create_shadow -- creates a buffer entry in a transient,
+ *	shadow copy of a ulog
+ *
+ * The entry is later stored in the persistent ulog as a whole, so there's no
+ * need to order the writes. Just like ulog_entry_val_create, this also zeroes
+ * out the offset of the following entry, which requires the log to have
+ * enough room for it.
+ */
+struct ulog_entry_buf *
+ulog_entry_buf_create_shadow(struct ulog *ulog, size_t offset,
+	uint64_t gen_num, uint64_t *dest, const void *src, uint64_t size,
+	ulog_operation_type type, const struct pmem_ops *p_ops)
+{
+	struct ulog_entry_buf *e =
+		(struct ulog_entry_buf *)(ulog->data + offset);
+	size_t entry_size = CACHELINE_ALIGN(sizeof(*e) + size);
+
+	e->base.offset = (uint64_t)(dest) - (uint64_t)p_ops->base;
+	e->base.offset |= ULOG_OPERATION(type);
+	e->size = size;
+
+	memcpy(e->data, src, size);
+	memset(e->data + size, 0, entry_size - sizeof(*e) - size +
+		sizeof(struct ulog_entry_base));
+
+	e->checksum = ulog_entry_buf_checksum(e, entry_size) ^ gen_num;
 
 	return e;
 }
@@ -579,6 +689,26 @@ ulog_clobber(struct ulog *dest, struct ulog_next *next,
 		PMEMOBJ_F_MEM_WC);
 }
 
+/*
+ * ulog_inc_gen -- invalidates all of the entries in the ulog, including the
+ *	ones in the next ulogs, by starting a new generation
+ *
+ * This is an alternative to zeroing out the logged data with
+ * ulog_clobber_data(), which costs a single 8-byte persistent store
+ * regardless of how much was logged. All the modifications the entries
+ * protect must be persistent before the generation is changed.
+ */
+void
+ulog_inc_gen(struct ulog *ulog, const struct pmem_ops *p_ops)
+{
+	pmemops_drain(p_ops);
+
+	VALGRIND_ADD_TO_TX(&ulog->gen_num, sizeof(ulog->gen_num));
+	ulog->gen_num++;
+	pmemops_persist(p_ops, &ulog->gen_num, sizeof(ulog->gen_num));
+	VALGRIND_REMOVE_FROM_TX(&ulog->gen_num, sizeof(ulog->gen_num));
+}
+
 /*
  * ulog_clobber_data -- zeroes out 'nbytes' of data in the logs
  */
@@ -586,49 +716,64 @@ void
 ulog_clobber_data(struct ulog *dest,
 	size_t nbytes, size_t ulog_base_nbytes,
 	struct ulog_next *next, ulog_free_fn ulog_free,
-	const struct pmem_ops *p_ops)
+	size_t retain_nbytes, const struct pmem_ops *p_ops)
 {
 	size_t rcapacity = ulog_base_nbytes;
 	size_t nlog = 0;
 	ASSERTne(dest, NULL);
 
-	for (struct ulog *r = dest; r != NULL; ) {
+	/*
+	 * To make sure that transaction logs do not occupy too much of space,
+	 * only the first log past the base one, and then as many of the
+	 * following ones as fit in 'retain_nbytes', are kept at the end of the
+	 * operation. The rest is freed. The reasoning for this is that
+	 * pmalloc() is a relatively cheap operation for transactions where many
+	 * hundreds of kilobytes are being snapshot, and so, allocating and
+	 * freeing the buffer for each transaction is an acceptable overhead for
+	 * the average case. Workloads which snapshot that much in every
+	 * transaction can raise 'retain_nbytes' to avoid it.
+	 */
+	size_t nkeep = 0;
+	size_t retained = 0;
+	uint64_t offset;
+	VEC_FOREACH(offset, next) {
+		struct ulog *u = ulog_by_offset(offset, p_ops);
+		ASSERTne(u, NULL);
+
+		if (nkeep != 0 && retained + u->capacity > retain_nbytes)
+			break;
+
+		retained += u->capacity;
+		nkeep++;
+	}
+
+	/* the logs which are about to be freed don't have to be zeroed */
+	for (struct ulog *r = dest; r != NULL && nbytes != 0; ) {
 		size_t nzero = MIN(nbytes, rcapacity);
 		VALGRIND_ADD_TO_TX(r->data, nzero);
 		pmemops_memset(p_ops, r->data, 0, nzero, PMEMOBJ_F_MEM_WC);
 		VALGRIND_ADD_TO_TX(r->data, nzero);
 		nbytes -= nzero;
 
-		if (nbytes == 0)
+		if (nbytes == 0 || nlog == nkeep)
 			break;
 
 		r = ulog_by_offset(VEC_ARR(next)[nlog++], p_ops);
-		if (nlog > 1)
-			break;
-
 		ASSERTne(r, NULL);
 		rcapacity = r->capacity;
 	}
 
-	/*
-	 * To make sure that transaction logs do not occupy too much of space,
-	 * all of them, expect for the first one, are freed at the end of
-	 * the operation. The reasoning for this is that pmalloc() is
-	 * a relatively cheap operation for transactions where many hundreds of
-	 * kilobytes are being snapshot, and so, allocating and freeing the
-	 * buffer for each transaction is an acceptable overhead for the average
-	 * case.
-	 */
-	struct ulog *u = ulog_by_offset(dest->next, p_ops);
-	if (u == NULL)
+	if (nkeep == VEC_SIZE(next))
 		return;
 
-	VEC(, uint64_t *) logs_past_first;
-	VEC_INIT(&logs_past_first);
+	struct ulog *u = ulog_by_offset(VEC_ARR(next)[nkeep - 1], p_ops);
+
+	VEC(, uint64_t *) logs_to_free;
+	VEC_INIT(&logs_to_free);
 
 	size_t next_offset;
 	while (u != NULL && ((next_offset = u->next) != 0)) {
-		if (VEC_PUSH_BACK(&logs_past_first, &u->next) != 0) {
+		if (VEC_PUSH_BACK(&logs_to_free, &u->next) != 0) {
 			/* this is fine, it will just use more pmem */
 			LOG(1, "unable to free transaction logs memory");
 			goto out;
@@ -637,12 +782,12 @@ ulog_clobber_data(struct ulog *dest,
 	}
 
 	uint64_t *ulog_ptr;
-	VEC_FOREACH_REVERSE(ulog_ptr, &logs_past_first) {
+	VEC_FOREACH_REVERSE(ulog_ptr, &logs_to_free) {
 		ulog_free(p_ops->base, ulog_ptr);
 	}
 
 out:
-	VEC_DELETE(&logs_past_first);
+	VEC_DELETE(&logs_to_free);
 }
 
 /*
@@ -674,7 +819,7 @@ ulog_base_nbytes(struct ulog *ulog)
 
 	for (offset = 0; offset < ulog->capacity; ) {
 		e = (struct ulog_entry_base *)(ulog->data + offset);
-		if (!ulog_entry_valid(e))
+		if (!ulog_entry_valid(ulog, offset, ulog->gen_num))
 			break;
 
 		offset += ulog_entry_size(e);
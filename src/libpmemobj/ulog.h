@@ -75,7 +75,8 @@ struct ulog_entry_buf {
 	uint64_t checksum; /* checksum of ulog header and its entries */\
 	uint64_t next; /* offset of ulog extension */\
 	uint64_t capacity; /* capacity of this ulog in bytes */\
-	uint64_t unused[5]; /* must be 0 */\
+	uint64_t gen_num; /* generation of the valid entries */\
+	uint64_t unused[4]; /* must be 0 */\
 	uint8_t data[capacity_bytes]; /* N bytes of data */\
 }\
 
@@ -127,13 +128,17 @@ int ulog_reserve(struct ulog *ulog,
 void ulog_store(struct ulog *dest,
 	struct ulog *src, size_t nbytes, size_t ulog_base_nbytes,
 	struct ulog_next *next, const struct pmem_ops *p_ops);
+uint64_t ulog_header_checksum(struct ulog *ulog);
+void ulog_store_compact(struct ulog *dest, struct ulog *src, size_t nbytes,
+	uint64_t header_csum, const struct pmem_ops *p_ops);
 
 void ulog_clobber(struct ulog *dest, struct ulog_next *next,
 	const struct pmem_ops *p_ops);
+void ulog_inc_gen(struct ulog *ulog, const struct pmem_ops *p_ops);
 void ulog_clobber_data(struct ulog *dest,
 	size_t nbytes, size_t ulog_base_nbytes,
 	struct ulog_next *next, ulog_free_fn ulog_free,
-	const struct pmem_ops *p_ops);
+	size_t retain_nbytes, const struct pmem_ops *p_ops);
 
 void ulog_process(struct ulog *ulog, ulog_check_offset_fn check,
 	const struct pmem_ops *p_ops);
@@ -151,10 +156,15 @@ struct ulog_entry_val *ulog_entry_val_create(struct ulog *ulog,
 	const struct pmem_ops *p_ops);
 
 struct ulog_entry_buf *
-ulog_entry_buf_create(struct ulog *ulog, size_t offset,
+ulog_entry_buf_create(struct ulog *ulog, size_t offset, uint64_t gen_num,
 	uint64_t *dest, const void *src, uint64_t size,
 	ulog_operation_type type, const struct pmem_ops *p_ops);
 
+struct ulog_entry_buf *
+ulog_entry_buf_create_shadow(struct ulog *ulog, size_t offset,
+	uint64_t gen_num, uint64_t *dest, const void *src, uint64_t size,
+	ulog_operation_type type, const struct pmem_ops *p_ops);
+
 void ulog_entry_apply(const struct ulog_entry_base *e, int persist,
 	const struct pmem_ops *p_ops);
 
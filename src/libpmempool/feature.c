@@ -44,6 +44,9 @@
 #include "util_pmem.h"
 #include "pool_hdr.h"
 #include "pool.h"
+#include "obj.h"
+#include "lane.h"
+#include "ulog.h"
 
 #define RW	0
 #define RDONLY	1
@@ -55,6 +58,7 @@ static const features_t f_singlehdr = FEAT_INCOMPAT(SINGLEHDR);
 static const features_t f_cksum_2k = FEAT_INCOMPAT(CKSUM_2K);
 static const features_t f_sds = FEAT_INCOMPAT(SDS);
 static const features_t f_chkbb = FEAT_COMPAT(CHECK_BAD_BLOCKS);
+static const features_t f_ulog_gen = FEAT_INCOMPAT(ULOG_GEN);
 
 #define FEAT_INVALID \
 	{UINT32_MAX, UINT32_MAX, UINT32_MAX};
@@ -585,6 +589,153 @@ query_badblocks_checking(const char *path)
 	return query_feature(path, f_chkbb);
 }
 
+/*
+ * require_obj_pool -- (internal) check if the pool set is an obj pool set
+ */
+static int
+require_obj_pool(struct pool_set *set, features_t feature)
+{
+	if (pool_hdr_get_type(get_hdr(set, 0, 0)) == POOL_TYPE_OBJ)
+		return 1;
+
+	ERR("%s is supported only by obj pools",
+		util_feature2str(feature, NULL));
+	errno = EINVAL;
+	return 0;
+}
+
+/*
+ * enable_ulog_gen -- (internal) enable POOL_FEAT_ULOG_GEN
+ *
+ * Undo logs of the generation zero are the same in both formats, so there's
+ * nothing to convert.
+ */
+static int
+enable_ulog_gen(const char *path)
+{
+	struct pool_set *set = poolset_open(path, RW);
+	if (!set)
+		return -1;
+
+	int ret = 0;
+	if (!require_obj_pool(set, f_ulog_gen)) {
+		ret = -1;
+		goto exit;
+	}
+
+	if (require_feature_is(set, f_ulog_gen, DISABLED))
+		feature_set(set, f_ulog_gen, ENABLED);
+
+exit:
+	poolset_close(set);
+	return ret;
+}
+
+/*
+ * ulog_gen_recovery_needed -- (internal) check if any of the lanes of the
+ *	replica has to be recovered
+ */
+static int
+ulog_gen_recovery_needed(PMEMobjpool *pop)
+{
+	for (uint64_t i = 0; i < pop->nlanes; ++i) {
+		struct lane_layout *layout = (void *)((char *)pop +
+			pop->lanes_offset + sizeof(struct lane_layout) * i);
+
+		if (ulog_recovery_needed((struct ulog *)&layout->internal, 1) ||
+		    ulog_recovery_needed((struct ulog *)&layout->external, 1) ||
+		    ulog_recovery_needed((struct ulog *)&layout->undo, 0))
+			return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * ulog_gen_reset -- (internal) zero all the undo logs of the replica and
+ *	move them back to the generation zero
+ *
+ * Logs which are not zeroed out contain entries of the previous generations,
+ * and those have to be gone before the generation number is reset.
+ */
+static void
+ulog_gen_reset(PMEMobjpool *pop, struct pool_replica *rep)
+{
+	struct pmem_ops p_ops;
+	memset(&p_ops, 0, sizeof(p_ops));
+	p_ops.base = pop;
+
+	for (uint64_t i = 0; i < pop->nlanes; ++i) {
+		struct lane_layout *layout = (void *)((char *)pop +
+			pop->lanes_offset + sizeof(struct lane_layout) * i);
+		struct ulog *undo = (struct ulog *)&layout->undo;
+
+		for (struct ulog *u = undo; u != NULL;
+		    u = ulog_next(u, &p_ops)) {
+			memset(u->data, 0, u->capacity);
+			util_persist_auto(rep->is_pmem, u->data, u->capacity);
+		}
+	}
+
+	for (uint64_t i = 0; i < pop->nlanes; ++i) {
+		struct lane_layout *layout = (void *)((char *)pop +
+			pop->lanes_offset + sizeof(struct lane_layout) * i);
+
+		layout->undo.gen_num = 0;
+		util_persist_auto(rep->is_pmem, &layout->undo.gen_num,
+			sizeof(layout->undo.gen_num));
+	}
+}
+
+/*
+ * disable_ulog_gen -- (internal) disable POOL_FEAT_ULOG_GEN
+ */
+static int
+disable_ulog_gen(const char *path)
+{
+	struct pool_set *set = poolset_open(path, RW);
+	if (!set)
+		return -1;
+
+	int ret = 0;
+	if (!require_obj_pool(set, f_ulog_gen)) {
+		ret = -1;
+		goto exit;
+	}
+
+	if (!require_feature_is(set, f_ulog_gen, ENABLED))
+		goto exit;
+
+	for (unsigned r = 0; r < set->nreplicas; ++r) {
+		PMEMobjpool *pop = PART(REP(set, r), 0)->addr;
+		if (ulog_gen_recovery_needed(pop)) {
+			ERR("the pool has to be recovered by opening it "
+				"before %s can be disabled",
+				util_feature2str(f_ulog_gen, NULL));
+			errno = EINVAL;
+			ret = -1;
+			goto exit;
+		}
+	}
+
+	for (unsigned r = 0; r < set->nreplicas; ++r)
+		ulog_gen_reset(PART(REP(set, r), 0)->addr, REP(set, r));
+
+	feature_set(set, f_ulog_gen, DISABLED);
+exit:
+	poolset_close(set);
+	return ret;
+}
+
+/*
+ * query_ulog_gen -- (internal) query POOL_FEAT_ULOG_GEN
+ */
+static int
+query_ulog_gen(const char *path)
+{
+	return query_feature(path, f_ulog_gen);
+}
+
 struct feature_funcs {
 	int (*enable)(const char *);
 	int (*disable)(const char *);
@@ -612,6 +763,11 @@ static struct feature_funcs features[] = {
 			.disable = disable_badblocks_checking,
 			.query = query_badblocks_checking
 		},
+		{
+			.enable = enable_ulog_gen,
+			.disable = disable_ulog_gen,
+			.query = query_ulog_gen
+		},
 };
 
 #define FEATURE_FUNCS_MAX ARRAY_SIZE(features)
@@ -703,6 +859,7 @@ pmempool_feature_queryU(const char *path, enum pmempool_feature feature,
 	CHECK_INCOMPAT_MAPPING(SINGLEHDR, PMEMPOOL_FEAT_SINGLEHDR);
 	CHECK_INCOMPAT_MAPPING(CKSUM_2K, PMEMPOOL_FEAT_CKSUM_2K);
 	CHECK_INCOMPAT_MAPPING(SDS, PMEMPOOL_FEAT_SHUTDOWN_STATE);
+	CHECK_INCOMPAT_MAPPING(ULOG_GEN, PMEMPOOL_FEAT_ULOG_GEN);
 
 #undef CHECK_INCOMPAT_MAPPING
 #endif
@@ -214,6 +214,76 @@ test_many_sets(PMEMobjpool *pop, size_t n)
 	FREE(act);
 }
 
+/*
+ * count_objects -- returns the number of allocated objects in the pool
+ */
+static size_t
+count_objects(PMEMobjpool *pop)
+{
+	size_t n = 0;
+	for (PMEMoid oid = pmemobj_first(pop); !OID_IS_NULL(oid);
+			oid = pmemobj_next(oid))
+		n++;
+
+	return n;
+}
+
+/*
+ * test_many_mixed -- publishes frees, reservations and sets of many objects
+ *	that share run bitmap values in a single batch
+ */
+static void
+test_many_mixed(PMEMobjpool *pop, size_t n)
+{
+	struct pobj_action *act = (struct pobj_action *)
+		MALLOC(sizeof(struct pobj_action) * n * 3);
+	PMEMoid *oid = (PMEMoid *)
+		MALLOC(sizeof(PMEMoid) * n * 2);
+	PMEMoid values_oid;
+	pmemobj_alloc(pop, &values_oid, sizeof(uint64_t) * n, 0, NULL, NULL);
+	UT_ASSERT(!OID_IS_NULL(values_oid));
+	uint64_t *values = (uint64_t *)pmemobj_direct(values_oid);
+
+	size_t nobjects = count_objects(pop);
+
+	for (size_t i = 0; i < n; ++i) {
+		oid[i] = pmemobj_reserve(pop, &act[i], 1, 0);
+		UT_ASSERT(!OID_IS_NULL(oid[i]));
+	}
+
+	UT_ASSERTeq(pmemobj_publish(pop, act, n), 0);
+	UT_ASSERTeq(count_objects(pop), nobjects + n);
+
+	/* free every other object, the rest is freed later */
+	size_t nact = 0;
+	for (size_t i = 0; i < n; i += 2)
+		pmemobj_defer_free(pop, oid[i], &act[nact++]);
+
+	for (size_t i = 0; i < n; ++i) {
+		oid[n + i] = pmemobj_reserve(pop, &act[nact++], 1, 0);
+		UT_ASSERT(!OID_IS_NULL(oid[n + i]));
+		pmemobj_set_value(pop, &act[nact++], values + i, i + 1);
+	}
+
+	UT_ASSERTeq(pmemobj_publish(pop, act, nact), 0);
+	UT_ASSERTeq(count_objects(pop), nobjects + n + n / 2);
+
+	for (size_t i = 0; i < n; ++i)
+		UT_ASSERTeq(values[i], i + 1);
+
+	nact = 0;
+	for (size_t i = 1; i < n; i += 2)
+		pmemobj_defer_free(pop, oid[i], &act[nact++]);
+	for (size_t i = 0; i < n; ++i)
+		pmemobj_defer_free(pop, oid[n + i], &act[nact++]);
+
+	UT_ASSERTeq(pmemobj_publish(pop, act, nact), 0);
+	UT_ASSERTeq(count_objects(pop), nobjects);
+
+	pmemobj_free(&values_oid);
+	FREE(oid);
+	FREE(act);
+}
 
 int
 main(int argc, char *argv[])
@@ -322,6 +392,7 @@ main(int argc, char *argv[])
 
 	test_many(pop, POBJ_MAX_ACTIONS * 2);
 	test_many_sets(pop, POBJ_MAX_ACTIONS * 2);
+	test_many_mixed(pop, POBJ_MAX_ACTIONS * 20);
 
 	pmemobj_close(pop);
 
@@ -0,0 +1,392 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_alloc_n.c -- unit test for pmemobj_xalloc_n and pmemobj_xreserve_n
+ */
+
+#include "unittest.h"
+
+#define LAYOUT_NAME "obj_alloc_n"
+#define TYPE_NUM 3
+#define NOBJS 1000
+#define OBJ_SIZE 64
+#define HUGE_OBJ_SIZE (1 << 20) /* served by chunks instead of runs */
+#define HUGE_NOBJS 3
+#define FAIL_AT 500
+#define INVALID_FLAG (((uint64_t)1) << 30)
+#define BATCHES_NOBJS 2500 /* published in more than one redo operation */
+#define MAX_NOBJS ((size_t)1 << 20)
+
+struct root {
+	PMEMoid oids[NOBJS];
+};
+
+struct constr_arg {
+	size_t nconstructed;
+	size_t fail_at; /* fail when this many objects were constructed */
+};
+
+/*
+ * constructor -- stores the construction order in the object
+ */
+static int
+constructor(PMEMobjpool *pop, void *ptr, void *arg)
+{
+	struct constr_arg *carg = (struct constr_arg *)arg;
+	if (carg->nconstructed == carg->fail_at)
+		return 1;
+
+	uint64_t *val = (uint64_t *)ptr;
+	*val = ++carg->nconstructed;
+	pmemobj_persist(pop, val, sizeof(*val));
+
+	return 0;
+}
+
+/*
+ * count_objects -- returns the number of allocated objects of the type
+ */
+static size_t
+count_objects(PMEMobjpool *pop, uint64_t type_num)
+{
+	size_t n = 0;
+	PMEMoid oid;
+	POBJ_FOREACH(pop, oid) {
+		if (pmemobj_type_num(oid) == type_num)
+			n++;
+	}
+
+	return n;
+}
+
+/*
+ * check_oids -- verifies that the oids are distinct, valid objects
+ */
+static void
+check_oids(PMEMobjpool *pop, PMEMoid *oidv, size_t n, size_t size)
+{
+	for (size_t i = 0; i < n; ++i) {
+		UT_ASSERT(!OID_IS_NULL(oidv[i]));
+		UT_ASSERTeq(pmemobj_pool_by_oid(oidv[i]), pop);
+		UT_ASSERTeq(pmemobj_type_num(oidv[i]), TYPE_NUM);
+		UT_ASSERT(pmemobj_alloc_usable_size(oidv[i]) >= size);
+		if (i != 0)
+			UT_ASSERTne(oidv[i].off, oidv[i - 1].off);
+	}
+}
+
+/*
+ * free_oids -- frees all of the objects in the array
+ */
+static void
+free_oids(PMEMoid *oidv, size_t n)
+{
+	for (size_t i = 0; i < n; ++i)
+		pmemobj_free(&oidv[i]);
+}
+
+/*
+ * test_xalloc_n_persistent -- allocates objects into a pmem resident array
+ */
+static void
+test_xalloc_n_persistent(PMEMobjpool *pop, struct root *root)
+{
+	struct constr_arg carg = {0, SIZE_MAX};
+
+	int ret = pmemobj_xalloc_n(pop, root->oids, NOBJS, OBJ_SIZE,
+		TYPE_NUM, 0, constructor, &carg);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(carg.nconstructed, NOBJS);
+	UT_ASSERTeq(count_objects(pop, TYPE_NUM), NOBJS);
+
+	check_oids(pop, root->oids, NOBJS, OBJ_SIZE);
+
+	/* every object has been constructed exactly once */
+	uint64_t sum = 0;
+	for (size_t i = 0; i < NOBJS; ++i)
+		sum += *(uint64_t *)pmemobj_direct(root->oids[i]);
+	UT_ASSERTeq(sum, (uint64_t)NOBJS * (NOBJS + 1) / 2);
+}
+
+/*
+ * test_xalloc_n_volatile -- allocates zeroed objects into a volatile array
+ */
+static void
+test_xalloc_n_volatile(PMEMobjpool *pop)
+{
+	PMEMoid *oidv = (PMEMoid *)MALLOC(sizeof(PMEMoid) * NOBJS);
+
+	int ret = pmemobj_xalloc_n(pop, oidv, NOBJS, OBJ_SIZE, TYPE_NUM,
+		POBJ_XALLOC_ZERO, NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+
+	check_oids(pop, oidv, NOBJS, OBJ_SIZE);
+
+	for (size_t i = 0; i < NOBJS; ++i) {
+		char *data = (char *)pmemobj_direct(oidv[i]);
+		for (size_t j = 0; j < OBJ_SIZE; ++j)
+			UT_ASSERTeq(data[j], 0);
+	}
+
+	free_oids(oidv, NOBJS);
+	FREE(oidv);
+}
+
+/*
+ * test_xalloc_n_huge -- allocates objects that do not fit in runs
+ */
+static void
+test_xalloc_n_huge(PMEMobjpool *pop)
+{
+	PMEMoid oidv[HUGE_NOBJS];
+	struct constr_arg carg = {0, SIZE_MAX};
+
+	int ret = pmemobj_xalloc_n(pop, oidv, HUGE_NOBJS, HUGE_OBJ_SIZE,
+		TYPE_NUM, 0, constructor, &carg);
+	UT_ASSERTeq(ret, 0);
+	check_oids(pop, oidv, HUGE_NOBJS, HUGE_OBJ_SIZE);
+
+	free_oids(oidv, HUGE_NOBJS);
+
+	/* a failed constructor must give back the chunks reserved so far */
+	carg.nconstructed = 0;
+	carg.fail_at = HUGE_NOBJS - 1;
+	ret = pmemobj_xalloc_n(pop, oidv, HUGE_NOBJS, HUGE_OBJ_SIZE,
+		TYPE_NUM, 0, constructor, &carg);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, ECANCELED);
+	UT_ASSERTeq(count_objects(pop, TYPE_NUM), 0);
+
+	carg.nconstructed = 0;
+	carg.fail_at = SIZE_MAX;
+	ret = pmemobj_xalloc_n(pop, oidv, HUGE_NOBJS, HUGE_OBJ_SIZE,
+		TYPE_NUM, 0, constructor, &carg);
+	UT_ASSERTeq(ret, 0);
+
+	free_oids(oidv, HUGE_NOBJS);
+}
+
+/*
+ * test_xalloc_n_canceled -- constructor failure cancels all of the objects
+ */
+static void
+test_xalloc_n_canceled(PMEMobjpool *pop, struct root *root)
+{
+	PMEMoid first = root->oids[0];
+	struct constr_arg carg = {0, FAIL_AT};
+
+	int ret = pmemobj_xalloc_n(pop, root->oids, NOBJS, OBJ_SIZE,
+		TYPE_NUM, 0, constructor, &carg);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, ECANCELED);
+	UT_ASSERTeq(carg.nconstructed, FAIL_AT);
+
+	/* nothing was allocated and the array is left untouched */
+	UT_ASSERTeq(count_objects(pop, TYPE_NUM), NOBJS);
+	UT_ASSERT(OID_EQUALS(root->oids[0], first));
+}
+
+/*
+ * test_xalloc_n_invalid -- invalid arguments are rejected
+ */
+static void
+test_xalloc_n_invalid(PMEMobjpool *pop)
+{
+	PMEMoid oid;
+
+	errno = 0;
+	UT_ASSERTeq(pmemobj_xalloc_n(pop, &oid, 1, 0, TYPE_NUM, 0,
+		NULL, NULL), -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	errno = 0;
+	UT_ASSERTeq(pmemobj_xalloc_n(pop, &oid, 0, OBJ_SIZE, TYPE_NUM, 0,
+		NULL, NULL), -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	errno = 0;
+	UT_ASSERTeq(pmemobj_xalloc_n(pop, NULL, 1, OBJ_SIZE, TYPE_NUM, 0,
+		NULL, NULL), -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	errno = 0;
+	UT_ASSERTeq(pmemobj_xalloc_n(pop, &oid, 1, OBJ_SIZE, TYPE_NUM,
+		INVALID_FLAG, NULL, NULL), -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	errno = 0;
+	UT_ASSERTeq(pmemobj_xalloc_n(pop, &oid, MAX_NOBJS + 1, OBJ_SIZE,
+		TYPE_NUM, 0, NULL, NULL), -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	struct pobj_action act;
+	errno = 0;
+	UT_ASSERTeq(pmemobj_xreserve_n(pop, &act, &oid, 1, OBJ_SIZE,
+		TYPE_NUM, INVALID_FLAG), -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	errno = 0;
+	UT_ASSERTeq(pmemobj_xreserve_n(pop, &act, &oid, 1, 0,
+		TYPE_NUM, 0), -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	errno = 0;
+	UT_ASSERTeq(pmemobj_xreserve_n(pop, &act, &oid, 0, OBJ_SIZE,
+		TYPE_NUM, 0), -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	errno = 0;
+	UT_ASSERTeq(pmemobj_xreserve_n(pop, NULL, &oid, 1, OBJ_SIZE,
+		TYPE_NUM, 0), -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	errno = 0;
+	UT_ASSERTeq(pmemobj_xreserve_n(pop, &act, &oid, MAX_NOBJS + 1,
+		OBJ_SIZE, TYPE_NUM, 0), -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	UT_ASSERTeq(count_objects(pop, TYPE_NUM), 0);
+}
+
+/*
+ * test_xalloc_n_batches -- allocates more objects than fit in one batch,
+ *	into both a volatile and a pmem resident array
+ */
+static void
+test_xalloc_n_batches(PMEMobjpool *pop)
+{
+	PMEMoid *oidv = (PMEMoid *)MALLOC(sizeof(PMEMoid) * BATCHES_NOBJS);
+
+	int ret = pmemobj_xalloc_n(pop, oidv, BATCHES_NOBJS, OBJ_SIZE,
+		TYPE_NUM, 0, NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(count_objects(pop, TYPE_NUM), BATCHES_NOBJS);
+	check_oids(pop, oidv, BATCHES_NOBJS, OBJ_SIZE);
+
+	free_oids(oidv, BATCHES_NOBJS);
+	FREE(oidv);
+
+	PMEMoid array;
+	ret = pmemobj_zalloc(pop, &array, sizeof(PMEMoid) * BATCHES_NOBJS, 0);
+	UT_ASSERTeq(ret, 0);
+	oidv = (PMEMoid *)pmemobj_direct(array);
+
+	ret = pmemobj_xalloc_n(pop, oidv, BATCHES_NOBJS, OBJ_SIZE,
+		TYPE_NUM, 0, NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(count_objects(pop, TYPE_NUM), BATCHES_NOBJS);
+	check_oids(pop, oidv, BATCHES_NOBJS, OBJ_SIZE);
+
+	free_oids(oidv, BATCHES_NOBJS);
+	pmemobj_free(&array);
+	UT_ASSERTeq(count_objects(pop, TYPE_NUM), 0);
+}
+
+/*
+ * test_xreserve_n -- reserves objects, cancels and publishes them
+ */
+static void
+test_xreserve_n(PMEMobjpool *pop)
+{
+	struct pobj_action *actv = (struct pobj_action *)
+		MALLOC(sizeof(struct pobj_action) * NOBJS);
+	PMEMoid *oidv = (PMEMoid *)MALLOC(sizeof(PMEMoid) * NOBJS);
+
+	int ret = pmemobj_xreserve_n(pop, actv, oidv, NOBJS, OBJ_SIZE,
+		TYPE_NUM, 0);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(count_objects(pop, TYPE_NUM), 0);
+
+	pmemobj_cancel(pop, actv, NOBJS);
+	UT_ASSERTeq(count_objects(pop, TYPE_NUM), 0);
+
+	ret = pmemobj_xreserve_n(pop, actv, oidv, NOBJS, OBJ_SIZE,
+		TYPE_NUM, POBJ_XALLOC_ZERO);
+	UT_ASSERTeq(ret, 0);
+
+	for (size_t i = 0; i < NOBJS; ++i)
+		UT_ASSERTeq(*(uint64_t *)pmemobj_direct(oidv[i]), 0);
+
+	UT_ASSERTeq(pmemobj_publish(pop, actv, NOBJS), 0);
+	UT_ASSERTeq(count_objects(pop, TYPE_NUM), NOBJS);
+	check_oids(pop, oidv, NOBJS, OBJ_SIZE);
+
+	free_oids(oidv, NOBJS);
+	FREE(oidv);
+	FREE(actv);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_alloc_n");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	PMEMobjpool *pop = pmemobj_create(path, LAYOUT_NAME,
+		PMEMOBJ_MIN_POOL * 4, S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	test_xalloc_n_invalid(pop);
+	test_xreserve_n(pop);
+	test_xalloc_n_volatile(pop);
+	test_xalloc_n_huge(pop);
+	test_xalloc_n_batches(pop);
+
+	struct root *root = (struct root *)pmemobj_direct(
+		pmemobj_root(pop, sizeof(struct root)));
+	test_xalloc_n_persistent(pop, root);
+	test_xalloc_n_canceled(pop, root);
+
+	pmemobj_close(pop);
+
+	UT_ASSERTeq(pmemobj_check(path, LAYOUT_NAME), 1);
+
+	pop = pmemobj_open(path, LAYOUT_NAME);
+	UT_ASSERTne(pop, NULL);
+
+	root = (struct root *)pmemobj_direct(
+		pmemobj_root(pop, sizeof(struct root)));
+	UT_ASSERTeq(count_objects(pop, TYPE_NUM), NOBJS);
+	check_oids(pop, root->oids, NOBJS, OBJ_SIZE);
+	free_oids(root->oids, NOBJS);
+	UT_ASSERTeq(count_objects(pop, TYPE_NUM), 0);
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
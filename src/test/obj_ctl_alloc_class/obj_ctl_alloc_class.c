@@ -292,19 +292,95 @@ many(const char *path)
 	pmemobj_close(pop);
 }
 
+static void
+profile(const char *path)
+{
+	PMEMobjpool *pop;
+
+	if ((pop = pmemobj_create(path, LAYOUT, PMEMOBJ_MIN_POOL * 20,
+		S_IWUSR | S_IRUSR)) == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	int enabled;
+	int ret = pmemobj_ctl_get(pop, "heap.alloc_class.profile.enabled",
+		&enabled);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(enabled, 0);
+
+	struct pobj_alloc_class_desc proposal;
+	ret = pmemobj_ctl_get(pop, "heap.alloc_class.profile.propose",
+		&proposal);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, ENOENT);
+
+	enabled = 1;
+	ret = pmemobj_ctl_set(pop, "heap.alloc_class.profile.enabled",
+		&enabled);
+	UT_ASSERTeq(ret, 0);
+
+	PMEMoid oid;
+	for (int i = 0; i < 100; ++i) {
+		ret = pmemobj_alloc(pop, &oid, 200, 0, NULL, NULL);
+		UT_ASSERTeq(ret, 0);
+	}
+	UT_ASSERTeq(pmemobj_alloc_usable_size(oid), 240);
+
+	double frag_before;
+	ret = pmemobj_ctl_get(pop, "heap.alloc_class.profile.frag",
+		&frag_before);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERT(frag_before > 0.15);
+
+	ret = pmemobj_ctl_get(pop, "heap.alloc_class.profile.propose",
+		&proposal);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(proposal.unit_size, 224);
+	UT_ASSERTeq(proposal.header_type, POBJ_HEADER_COMPACT);
+
+	ret = pmemobj_ctl_exec(pop, "heap.alloc_class.profile.tune", NULL);
+	UT_ASSERTeq(ret, 0);
+
+	double frag_after;
+	ret = pmemobj_ctl_get(pop, "heap.alloc_class.profile.frag",
+		&frag_after);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERT(frag_after < frag_before);
+
+	ret = pmemobj_ctl_get(pop, "heap.alloc_class.profile.propose",
+		&proposal);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, ENOENT);
+
+	ret = pmemobj_alloc(pop, &oid, 200, 0, NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(pmemobj_alloc_usable_size(oid), 208);
+
+	ret = pmemobj_ctl_exec(pop, "heap.alloc_class.profile.reset", NULL);
+	UT_ASSERTeq(ret, 0);
+
+	ret = pmemobj_ctl_get(pop, "heap.alloc_class.profile.frag",
+		&frag_after);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERT(frag_after < 0.01);
+
+	pmemobj_close(pop);
+}
+
 int
 main(int argc, char *argv[])
 {
 	START(argc, argv, "obj_ctl_alloc_class");
 
 	if (argc != 3)
-		UT_FATAL("usage: %s file-name b|m", argv[0]);
+		UT_FATAL("usage: %s file-name b|m|p", argv[0]);
 
 	const char *path = argv[1];
 	if (argv[2][0] == 'b')
 		basic(path);
 	else if (argv[2][0] == 'm')
 		many(path);
+	else if (argv[2][0] == 'p')
+		profile(path);
 
 	DONE(NULL);
 }
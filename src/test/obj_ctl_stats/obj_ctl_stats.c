@@ -36,6 +36,55 @@
 
 #include "unittest.h"
 
+#define NTHREADS 8
+
+static PMEMobjpool *pop;
+
+/*
+ * latency_worker -- enables the latency histograms and commits a transaction
+ */
+static void *
+latency_worker(void *arg)
+{
+	int enabled = 1;
+	int ret = pmemobj_ctl_set(pop, "stats.tx.latency.enabled", &enabled);
+	UT_ASSERTeq(ret, 0);
+
+	TX_BEGIN(pop) {
+		pmemobj_tx_alloc(1, 0);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	return NULL;
+}
+
+/*
+ * test_latency_enable_mt -- enables the latency histograms from several
+ *	threads at once
+ */
+static void
+test_latency_enable_mt(const char *path)
+{
+	if ((pop = pmemobj_open(path, "ctl")) == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	os_thread_t threads[NTHREADS];
+	for (unsigned i = 0; i < NTHREADS; ++i)
+		PTHREAD_CREATE(&threads[i], NULL, latency_worker, NULL);
+
+	for (unsigned i = 0; i < NTHREADS; ++i)
+		PTHREAD_JOIN(&threads[i], NULL);
+
+	uint64_t count;
+	int ret = pmemobj_ctl_get(pop, "stats.tx.latency.pre_commit.count",
+		&count);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(count, NTHREADS);
+
+	pmemobj_close(pop);
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -46,7 +95,6 @@ main(int argc, char *argv[])
 
 	const char *path = argv[1];
 
-	PMEMobjpool *pop;
 	if ((pop = pmemobj_create(path, "ctl", PMEMOBJ_MIN_POOL,
 		S_IWUSR | S_IRUSR)) == NULL)
 		UT_FATAL("!pmemobj_create: %s", path);
@@ -82,7 +130,97 @@ main(int argc, char *argv[])
 	UT_ASSERTeq(ret, 0);
 	UT_ASSERTeq(allocated, 0);
 
+	ret = pmemobj_ctl_get(pop, "stats.tx.latency.enabled", &enabled);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(enabled, 0);
+
+	uint64_t count;
+	ret = pmemobj_ctl_get(pop, "stats.tx.latency.add_range.count", &count);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(count, 0);
+
+	enabled = 1;
+	ret = pmemobj_ctl_set(pop, "stats.tx.latency.enabled", &enabled);
+	UT_ASSERTeq(ret, 0);
+
+	PMEMoid root = pmemobj_root(pop, 128);
+	PMEMmutex *mtx = pmemobj_direct(root);
+	TX_BEGIN_PARAM(pop, TX_PARAM_MUTEX, mtx, TX_PARAM_NONE) {
+		pmemobj_tx_add_range(root, 64, 32);
+		pmemobj_tx_add_range(root, 96, 32);
+		pmemobj_tx_alloc(1, 0);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	ret = pmemobj_ctl_get(pop, "stats.tx.latency.add_range.count", &count);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(count, 2);
+
+	ret = pmemobj_ctl_get(pop, "stats.tx.latency.pre_commit.count", &count);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(count, 1);
+
+	ret = pmemobj_ctl_get(pop, "stats.tx.latency.process.count", &count);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(count, 1);
+
+	ret = pmemobj_ctl_get(pop, "stats.tx.latency.lock.count", &count);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(count, 1);
+
+	uint64_t p50, p99, max;
+	ret = pmemobj_ctl_get(pop, "stats.tx.latency.add_range.p50", &p50);
+	UT_ASSERTeq(ret, 0);
+	ret = pmemobj_ctl_get(pop, "stats.tx.latency.add_range.p99", &p99);
+	UT_ASSERTeq(ret, 0);
+	ret = pmemobj_ctl_get(pop, "stats.tx.latency.add_range.max", &max);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERT(p50 <= p99);
+	UT_ASSERT(p99 <= max);
+
+	ret = pmemobj_ctl_exec(pop, "stats.tx.latency.reset", NULL);
+	UT_ASSERTeq(ret, 0);
+
+	ret = pmemobj_ctl_get(pop, "stats.tx.latency.add_range.count", &count);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(count, 0);
+
+	uint64_t snapshot_bytes;
+	ret = pmemobj_ctl_get(pop, "stats.tx.snapshot_bytes", &snapshot_bytes);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(snapshot_bytes, 64);
+
+	uint64_t snapshot_skipped;
+	ret = pmemobj_ctl_get(pop, "stats.tx.snapshot_skipped",
+		&snapshot_skipped);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(snapshot_skipped, 0);
+
+	TX_BEGIN(pop) {
+		PMEMoid obj = pmemobj_tx_alloc(128, 0);
+		/* objects allocated in the transaction are not snapshotted */
+		pmemobj_tx_add_range(obj, 0, 128);
+		pmemobj_tx_add_range(obj, 32, 64);
+		/* only the part not yet added is snapshotted */
+		pmemobj_tx_add_range(root, 64, 32);
+		pmemobj_tx_add_range(root, 80, 32);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	ret = pmemobj_ctl_get(pop, "stats.tx.snapshot_bytes", &snapshot_bytes);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(snapshot_bytes, 64 + 48);
+
+	ret = pmemobj_ctl_get(pop, "stats.tx.snapshot_skipped",
+		&snapshot_skipped);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(snapshot_skipped, 128 + 64 + 16);
+
 	pmemobj_close(pop);
 
+	test_latency_enable_mt(path);
+
 	DONE(NULL);
 }
@@ -0,0 +1,201 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_defrag.c -- tests for the heap defragmentation
+ */
+
+#include "unittest.h"
+
+#define NOBJS 8192
+#define KEEP_EVERY 4
+#define NKEPT (NOBJS / KEEP_EVERY)
+#define OBJ_DATA_SIZE 200
+
+struct object {
+	uint64_t idx;
+	PMEMoid next;
+	char data[OBJ_DATA_SIZE];
+};
+
+struct root {
+	PMEMoid objs[NKEPT];
+};
+
+/*
+ * object_construct -- fills the object with a pattern derived from its index
+ */
+static int
+object_construct(PMEMobjpool *pop, void *ptr, void *arg)
+{
+	struct object *obj = ptr;
+	uint64_t idx = *(uint64_t *)arg;
+
+	obj->idx = idx;
+	obj->next = OID_NULL;
+	memset(obj->data, (int)(idx & 0xff), sizeof(obj->data));
+	pmemobj_persist(pop, obj, sizeof(*obj));
+
+	return 0;
+}
+
+/*
+ * object_check -- verifies the contents of a relocated object
+ */
+static void
+object_check(PMEMoid oid, uint64_t idx)
+{
+	struct object *obj = pmemobj_direct(oid);
+
+	UT_ASSERTeq(obj->idx, idx);
+	UT_ASSERTeq(pmemobj_type_num(oid), 1);
+	for (size_t i = 0; i < sizeof(obj->data); ++i)
+		UT_ASSERTeq(obj->data[i], (char)(idx & 0xff));
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_defrag");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	PMEMobjpool *pop;
+	if ((pop = pmemobj_create(path, "defrag", PMEMOBJ_MIN_POOL * 4,
+		S_IWUSR | S_IRUSR)) == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	int enabled = 1;
+	int ret = pmemobj_ctl_set(pop, "stats.enabled", &enabled);
+	UT_ASSERTeq(ret, 0);
+
+	struct root *rootp = pmemobj_direct(
+		pmemobj_root(pop, sizeof(struct root)));
+
+	PMEMoid *all = MALLOC(sizeof(PMEMoid) * NOBJS);
+	for (uint64_t i = 0; i < NOBJS; ++i) {
+		ret = pmemobj_alloc(pop, &all[i], sizeof(struct object), 1,
+			object_construct, &i);
+		UT_ASSERTeq(ret, 0);
+	}
+
+	/* leave only every n-th object, which makes the runs sparse */
+	for (size_t i = 0; i < NOBJS; ++i) {
+		if (i % KEEP_EVERY == 0)
+			rootp->objs[i / KEEP_EVERY] = all[i];
+		else
+			pmemobj_free(&all[i]);
+	}
+	pmemobj_persist(pop, rootp, sizeof(*rootp));
+
+	/* link the objects together, these references live in the pool */
+	for (size_t i = 0; i < NKEPT; ++i) {
+		struct object *obj = pmemobj_direct(rootp->objs[i]);
+		obj->next = rootp->objs[(i + 1) % NKEPT];
+		pmemobj_persist(pop, &obj->next, sizeof(obj->next));
+	}
+
+	/* a volatile copy of the root references */
+	PMEMoid *copy = MALLOC(sizeof(PMEMoid) * NKEPT);
+	memcpy(copy, rootp->objs, sizeof(PMEMoid) * NKEPT);
+
+	size_t nrefs = NKEPT * 3;
+	PMEMoid **refs = MALLOC(sizeof(PMEMoid *) * nrefs);
+	for (size_t i = 0; i < NKEPT; ++i) {
+		struct object *obj = pmemobj_direct(rootp->objs[i]);
+		refs[i * 3] = &rootp->objs[i];
+		refs[i * 3 + 1] = &obj->next;
+		refs[i * 3 + 2] = &copy[i];
+	}
+
+	struct pobj_defrag_result result;
+	ret = pmemobj_defrag(pop, refs, nrefs, &result);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(result.total, NKEPT);
+	UT_ASSERT(result.relocated > 0);
+	UT_ASSERT(result.relocated <= result.total);
+	UT_ASSERT(result.reclaimed > 0);
+
+	size_t moved = 0;
+	for (size_t i = 0; i < NKEPT; ++i) {
+		if (!OID_EQUALS(rootp->objs[i], all[i * KEEP_EVERY]))
+			moved++;
+
+		UT_ASSERT(OID_EQUALS(rootp->objs[i], copy[i]));
+		object_check(rootp->objs[i], i * KEEP_EVERY);
+
+		struct object *obj = pmemobj_direct(rootp->objs[i]);
+		UT_ASSERT(OID_EQUALS(obj->next,
+			rootp->objs[(i + 1) % NKEPT]));
+	}
+	UT_ASSERTeq(moved, result.relocated);
+
+	uint64_t relocated;
+	ret = pmemobj_ctl_get(pop, "stats.heap.defrag_relocated",
+		&relocated);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(relocated,
+		result.relocated * pmemobj_alloc_usable_size(rootp->objs[0]));
+
+	uint64_t reclaimed;
+	ret = pmemobj_ctl_get(pop, "stats.heap.defrag_reclaimed", &reclaimed);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(reclaimed, result.reclaimed);
+
+	/* the relocated objects must survive the reopen */
+	pmemobj_close(pop);
+
+	if ((pop = pmemobj_open(path, "defrag")) == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	rootp = pmemobj_direct(pmemobj_root(pop, sizeof(struct root)));
+	for (size_t i = 0; i < NKEPT; ++i)
+		object_check(rootp->objs[i], i * KEEP_EVERY);
+
+	/* references from outside of the table are not allowed */
+	PMEMoid bad = {rootp->objs[0].pool_uuid_lo + 1, rootp->objs[0].off};
+	PMEMoid *badp = &bad;
+	ret = pmemobj_defrag(pop, &badp, 1, NULL);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	pmemobj_close(pop);
+
+	FREE(refs);
+	FREE(copy);
+	FREE(all);
+
+	DONE(NULL);
+}
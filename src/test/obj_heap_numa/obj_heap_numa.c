@@ -0,0 +1,301 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_heap_numa.c -- unit test for NUMA-aware heap placement
+ */
+#include "container_numa.h"
+#include "heap.h"
+#include "memblock.h"
+#include "obj.h"
+#include "unittest.h"
+
+#define TEST_NNODES 3
+#define TEST_LOCAL_NODE 1
+#define TEST_NBLOCKS 6
+
+static int Mock_numa;
+
+/* topology reported by the os_numa mocks */
+enum mock_topology {
+	MOCK_TOPOLOGY_REAL,
+	MOCK_TOPOLOGY_SINGLE_NODE, /* all memory on node 0 */
+	MOCK_TOPOLOGY_SPREAD, /* consecutive queries return consecutive nodes */
+};
+
+static enum mock_topology Mock_topology;
+static unsigned Addr_queries;
+
+FUNC_MOCK(os_numa_nnodes, unsigned, void)
+	FUNC_MOCK_RUN_DEFAULT {
+		if (Mock_topology != MOCK_TOPOLOGY_REAL)
+			return TEST_NNODES;
+		return _FUNC_REAL(os_numa_nnodes)();
+	}
+FUNC_MOCK_END
+
+FUNC_MOCK(os_numa_addr_node, int, const void *addr)
+	FUNC_MOCK_RUN_DEFAULT {
+		switch (Mock_topology) {
+		case MOCK_TOPOLOGY_SINGLE_NODE:
+			Addr_queries++;
+			return 0;
+		case MOCK_TOPOLOGY_SPREAD:
+			return (int)(Addr_queries++ % TEST_NNODES);
+		default:
+			return _FUNC_REAL(os_numa_addr_node)(addr);
+		}
+	}
+FUNC_MOCK_END
+
+FUNC_MOCK(heap_numa_nnodes, unsigned, struct palloc_heap *heap)
+	FUNC_MOCK_RUN_DEFAULT {
+		if (Mock_numa)
+			return TEST_NNODES;
+		return _FUNC_REAL(heap_numa_nnodes)(heap);
+	}
+FUNC_MOCK_END
+
+FUNC_MOCK(heap_thread_numa_node, unsigned, struct palloc_heap *heap)
+	FUNC_MOCK_RUN_DEFAULT {
+		if (Mock_numa)
+			return TEST_LOCAL_NODE;
+		return _FUNC_REAL(heap_thread_numa_node)(heap);
+	}
+FUNC_MOCK_END
+
+FUNC_MOCK(heap_zone_numa_node, unsigned, struct palloc_heap *heap,
+	uint32_t zone_id)
+	FUNC_MOCK_RUN_DEFAULT {
+		if (Mock_numa)
+			return zone_id % TEST_NNODES;
+		return _FUNC_REAL(heap_zone_numa_node)(heap, zone_id);
+	}
+FUNC_MOCK_END
+
+static struct memory_block Blocks[TEST_NBLOCKS];
+
+static void *
+mock_get_user_data(const struct memory_block *m)
+{
+	return &Blocks[m->chunk_id];
+}
+
+static const struct memory_block_ops mock_ops = {
+	.get_user_data = mock_get_user_data,
+};
+
+/*
+ * test_node_idx -- verifies mapping of system node ids to heap node indexes
+ */
+static void
+test_node_idx(void)
+{
+	UT_ASSERTeq(heap_numa_node_idx(4, -1), 0);
+	UT_ASSERTeq(heap_numa_node_idx(4, 0), 0);
+	UT_ASSERTeq(heap_numa_node_idx(4, 2), 2);
+	UT_ASSERTeq(heap_numa_node_idx(4, 6), 2);
+	UT_ASSERTeq(heap_numa_node_idx(1, 5), 0);
+}
+
+/*
+ * test_container_order -- verifies that the best-fit search of the NUMA
+ *	container prefers blocks from the node of the calling thread and then
+ *	falls back to the remaining nodes in the order of their ids
+ */
+static void
+test_container_order(void)
+{
+	/*
+	 * zones are spread round-robin across the nodes, so with the thread
+	 * running on node 1 the expected order is: 1, 4 (node 1), 2, 5
+	 * (node 2) and 0, 3 (node 0)
+	 */
+	static const uint32_t expected[TEST_NBLOCKS] = {1, 4, 2, 5, 0, 3};
+
+	struct palloc_heap heap;
+	memset(&heap, 0, sizeof(heap));
+
+	Mock_numa = 1;
+
+	struct block_container *c = container_new_numa(&heap);
+	UT_ASSERTne(c, NULL);
+	UT_ASSERT(c->c_ops->is_empty(c));
+
+	for (uint32_t i = 0; i < TEST_NBLOCKS; ++i) {
+		struct memory_block m = MEMORY_BLOCK_NONE;
+		m.chunk_id = i;
+		m.zone_id = i;
+		m.size_idx = 1;
+		m.m_ops = &mock_ops;
+		UT_ASSERTeq(c->c_ops->insert(c, &m), 0);
+	}
+
+	UT_ASSERT(!c->c_ops->is_empty(c));
+
+	for (unsigned i = 0; i < TEST_NBLOCKS; ++i) {
+		struct memory_block m = MEMORY_BLOCK_NONE;
+		m.size_idx = 1;
+		UT_ASSERTeq(c->c_ops->get_rm_bestfit(c, &m), 0);
+		UT_ASSERTeq(m.zone_id, expected[i]);
+	}
+
+	struct memory_block m = MEMORY_BLOCK_NONE;
+	m.size_idx = 1;
+	UT_ASSERTeq(c->c_ops->get_rm_bestfit(c, &m), ENOMEM);
+	UT_ASSERT(c->c_ops->is_empty(c));
+
+	c->c_ops->destroy(c);
+
+	Mock_numa = 0;
+}
+
+/*
+ * test_ctl -- verifies the heap.numa.nodes ctl entry point
+ */
+static void
+test_ctl(const char *path)
+{
+	PMEMobjpool *pop = pmemobj_create(path, "heap_numa",
+		PMEMOBJ_MIN_POOL, S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	unsigned nodes = 0;
+	int ret = pmemobj_ctl_get(pop, "heap.numa.nodes", &nodes);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTne(nodes, 0);
+	UT_ASSERTeq(nodes, heap_numa_nnodes(&pop->heap));
+
+	ret = pmemobj_ctl_set(pop, "heap.numa.nodes", &nodes);
+	UT_ASSERTne(ret, 0);
+
+	/* allocations have to work regardless of the zone placement */
+	PMEMoid oid;
+	ret = pmemobj_alloc(pop, &oid, 128, 0, NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+	pmemobj_free(&oid);
+
+	pmemobj_close(pop);
+}
+
+/*
+ * test_single_node -- verifies that a pool which resides on a single node of
+ *	a multi-node system uses the plain container and doesn't track the
+ *	placement of its zones
+ */
+static void
+test_single_node(const char *path)
+{
+	Mock_topology = MOCK_TOPOLOGY_SINGLE_NODE;
+	Addr_queries = 0;
+
+	PMEMobjpool *pop = pmemobj_create(path, "heap_numa",
+		PMEMOBJ_MIN_POOL, S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	/* only the single part of the pool has been queried */
+	UT_ASSERTeq(Addr_queries, 1);
+
+	unsigned nodes = 0;
+	int ret = pmemobj_ctl_get(pop, "heap.numa.nodes", &nodes);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(nodes, 1);
+
+	PMEMoid oid;
+	ret = pmemobj_alloc(pop, &oid, 128, 0, NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+	pmemobj_free(&oid);
+
+	/* the zones aren't looked up by the ravl container */
+	UT_ASSERTeq(Addr_queries, 1);
+
+	pmemobj_close(pop);
+
+	Mock_topology = MOCK_TOPOLOGY_REAL;
+}
+
+/*
+ * test_multi_node -- verifies that a pool whose parts reside on different
+ *	nodes is NUMA-aware
+ */
+static void
+test_multi_node(const char *path)
+{
+	Mock_topology = MOCK_TOPOLOGY_SPREAD;
+	Addr_queries = 0;
+
+	PMEMobjpool *pop = pmemobj_create(path, "heap_numa", 0,
+		S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	unsigned nodes = 0;
+	int ret = pmemobj_ctl_get(pop, "heap.numa.nodes", &nodes);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(nodes, TEST_NNODES);
+
+	PMEMoid oid;
+	ret = pmemobj_alloc(pop, &oid, 128, 0, NULL, NULL);
+	UT_ASSERTeq(ret, 0);
+	pmemobj_free(&oid);
+
+	pmemobj_close(pop);
+
+	Mock_topology = MOCK_TOPOLOGY_REAL;
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_heap_numa");
+
+	if (argc != 4)
+		UT_FATAL("usage: %s file-name file-name poolset", argv[0]);
+
+	test_node_idx();
+	test_container_order();
+	test_ctl(argv[1]);
+	test_single_node(argv[2]);
+	test_multi_node(argv[3]);
+
+	DONE(NULL);
+}
+
+#ifdef _MSC_VER
+/*
+ * Since libpmemobj is linked statically, we need to invoke its ctor/dtor.
+ */
+MSVC_CONSTR(libpmemobj_init)
+MSVC_DESTR(libpmemobj_fini)
+#endif
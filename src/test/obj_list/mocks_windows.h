@@ -69,6 +69,7 @@ extern "C" {
 
 #ifndef WRAP_REAL_ULOG
 #define ulog_store __wrap_ulog_store
+#define ulog_store_compact __wrap_ulog_store_compact
 #define ulog_process __wrap_ulog_process
 #endif
 
@@ -375,6 +375,32 @@ FUNC_MOCK(ulog_store, void,
 	}
 FUNC_MOCK_END
 
+/*
+ * ulog_store_compact -- ulog_store_compact mock
+ */
+FUNC_MOCK(ulog_store_compact, void,
+	struct ulog *dest,
+	struct ulog *src, size_t nbytes, uint64_t header_csum,
+	const struct pmem_ops *p_ops)
+	FUNC_MOCK_RUN_DEFAULT {
+		switch (Ulog_fail) {
+		case FAIL_AFTER_FINISH:
+			_FUNC_REAL(ulog_store_compact)(dest, src,
+					nbytes, header_csum, p_ops);
+			DONEW(NULL);
+			break;
+		case FAIL_BEFORE_FINISH:
+			DONEW(NULL);
+			break;
+		default:
+			_FUNC_REAL(ulog_store_compact)(dest, src,
+					nbytes, header_csum, p_ops);
+			break;
+		}
+
+	}
+FUNC_MOCK_END
+
 /*
  * ulog_process -- ulog_process mock
  */
@@ -171,6 +171,76 @@ test_same_twice(struct operation_context *ctx, struct test_object *object)
 	UT_ASSERTeq(object->values[0], 10);
 }
 
+/*
+ * test_merge_far -- entries for the same offset are merged even when many
+ *	other entries were added in between, otherwise the second pass
+ *	wouldn't fit in the log, which cannot be extended
+ */
+static void
+test_merge_far(struct operation_context *ctx, struct test_object *object)
+{
+	operation_start(ctx);
+
+	for (size_t i = 0; i < 100; ++i) {
+		operation_add_typed_entry(ctx,
+			&object->values[i], i + 1,
+			ULOG_OPERATION_SET, LOG_PERSISTENT);
+	}
+
+	for (size_t i = 0; i < 100; ++i) {
+		operation_add_typed_entry(ctx,
+			&object->values[i], i + 2,
+			ULOG_OPERATION_SET, LOG_PERSISTENT);
+	}
+
+	operation_add_typed_entry(ctx,
+		&object->values[0], 0b100,
+		ULOG_OPERATION_OR, LOG_PERSISTENT);
+
+	operation_finish(ctx);
+
+	UT_ASSERTeq(object->values[0], 0b110);
+	for (size_t i = 1; i < 100; ++i)
+		UT_ASSERTeq(object->values[i], i + 2);
+}
+
+/*
+ * test_compact -- operations with only a few entries are stored in the
+ *	compact redo log, the entries are indexed once the log grows past it
+ */
+static void
+test_compact(struct operation_context *ctx, struct test_object *object)
+{
+	uint64_t next = object->redo.next;
+
+	for (size_t n = 1; n <= 5; ++n) {
+		operation_start(ctx);
+
+		for (size_t i = 0; i < n; ++i) {
+			operation_add_typed_entry(ctx,
+				&object->values[i], 1ULL << i,
+				ULOG_OPERATION_OR, LOG_PERSISTENT);
+			operation_add_typed_entry(ctx,
+				&object->values[0], 1ULL << (i + 8),
+				ULOG_OPERATION_OR, LOG_PERSISTENT);
+		}
+
+		operation_finish(ctx);
+
+		UT_ASSERTeq(object->values[0],
+			1 | (((1ULL << n) - 1) << 8));
+		for (size_t i = 1; i < n; ++i)
+			UT_ASSERTeq(object->values[i], 1ULL << i);
+
+		/* the log is invalidated, but the next ulog is kept */
+		UT_ASSERTeq(ulog_recovery_needed(
+			(struct ulog *)&object->redo, 1), 0);
+		UT_ASSERTeq(object->redo.next, next);
+
+		clear_test_values(object);
+	}
+}
+
 static void
 test_redo(PMEMobjpool *pop, struct test_object *object)
 {
@@ -192,6 +262,7 @@ test_redo(PMEMobjpool *pop, struct test_object *object)
 	clear_test_values(object);
 	test_set_entries(pop, ctx, object, 10, FAIL_MODIFY_VALUE);
 	clear_test_values(object);
+	test_compact(ctx, object);
 	test_same_twice(ctx, object);
 	clear_test_values(object);
 
@@ -204,6 +275,9 @@ test_redo(PMEMobjpool *pop, struct test_object *object)
 
 	test_set_entries(pop, ctx, object, 100, 0);
 	clear_test_values(object);
+	test_merge_far(ctx, object);
+	clear_test_values(object);
+	test_compact(ctx, object);
 
 	/* FAIL_MODIFY_NEXT tests can only happen after redo_next test */
 	test_set_entries(pop, ctx, object, 100, FAIL_MODIFY_NEXT);
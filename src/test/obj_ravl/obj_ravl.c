@@ -229,6 +229,55 @@ test_emplace(void)
 	ravl_delete(r);
 }
 
+static void
+next_cb(void *data, void *arg)
+{
+	intptr_t *prev = arg;
+	intptr_t v = (intptr_t)data;
+
+	/* elements are visited in ascending order */
+	UT_ASSERTeq(v, *prev + 1);
+	*prev = v;
+}
+
+static void
+test_foreach(void)
+{
+	struct ravl *r = ravl_new(cmpkey);
+	intptr_t prev = 0;
+
+	ravl_foreach(r, next_cb, &prev);
+	UT_ASSERTeq(prev, 0);
+
+	ravl_insert(r, (void *)2);
+	ravl_insert(r, (void *)4);
+	ravl_insert(r, (void *)1);
+	ravl_insert(r, (void *)3);
+
+	ravl_foreach(r, next_cb, &prev);
+	UT_ASSERTeq(prev, 4);
+
+	/* the tree is left intact */
+	UT_ASSERTne(ravl_find(r, (void *)3, RAVL_PREDICATE_EQUAL), NULL);
+
+	ravl_delete(r);
+}
+
+static void
+test_delete_cb(void)
+{
+	struct ravl *r = ravl_new(cmpkey);
+	intptr_t prev = 0;
+
+	ravl_insert(r, (void *)3);
+	ravl_insert(r, (void *)1);
+	ravl_insert(r, (void *)2);
+
+	/* the callback receives the stored pointers, not the node storage */
+	ravl_delete_cb(r, next_cb, &prev);
+	UT_ASSERTeq(prev, 3);
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -238,6 +287,8 @@ main(int argc, char *argv[])
 	test_misc();
 	test_stress();
 	test_emplace();
+	test_foreach();
+	test_delete_cb();
 
 	DONE(NULL);
 }
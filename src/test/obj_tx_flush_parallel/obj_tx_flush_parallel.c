@@ -0,0 +1,252 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_tx_flush_parallel.c -- tests for flushing of large transactions by
+ *	the helper threads
+ */
+
+#include "unittest.h"
+
+#define OBJ_SIZE (1024 * 1024)
+#define ALLOC_SIZE (300 * 1024)
+#define THRESHOLD (64 * 1024)
+#define NTHREADS 4
+#define NOPS 8
+#define NRESIZES 32
+
+struct root {
+	PMEMoid objs[NTHREADS];
+};
+
+static PMEMobjpool *pop;
+
+/*
+ * ctl_set -- sets a long long ctl entry and returns the result
+ */
+static int
+ctl_set(const char *name, long long value)
+{
+	return pmemobj_ctl_set(pop, name, &value);
+}
+
+/*
+ * ctl_get -- returns the value of a long long ctl entry
+ */
+static long long
+ctl_get(const char *name)
+{
+	long long value;
+	int ret = pmemobj_ctl_get(pop, name, &value);
+	UT_ASSERTeq(ret, 0);
+
+	return value;
+}
+
+/*
+ * check -- verifies that the first 'size' bytes of the buffer are equal 'c'
+ */
+static void
+check(const void *buf, size_t size, int c)
+{
+	const unsigned char *data = buf;
+	for (size_t i = 0; i < size; ++i)
+		UT_ASSERTeq(data[i], (unsigned char)c);
+}
+
+/*
+ * modify -- snapshots and fills the whole object with 'c', allocates a new
+ *	object filled with 'c' and optionally aborts the transaction
+ */
+static void
+modify(PMEMoid oid, int c, int abort)
+{
+	PMEMoid nobj = OID_NULL;
+
+	TX_BEGIN(pop) {
+		pmemobj_tx_add_range(oid, 0, OBJ_SIZE);
+		memset(pmemobj_direct(oid), c, OBJ_SIZE);
+
+		nobj = pmemobj_tx_alloc(ALLOC_SIZE, 0);
+		memset(pmemobj_direct(nobj), c, ALLOC_SIZE);
+
+		if (abort)
+			pmemobj_tx_abort(ECANCELED);
+	} TX_ONCOMMIT {
+		UT_ASSERT(!abort);
+	} TX_ONABORT {
+		UT_ASSERT(abort);
+		nobj = OID_NULL;
+	} TX_END
+
+	if (!OID_IS_NULL(nobj)) {
+		check(pmemobj_direct(nobj), ALLOC_SIZE, c);
+		pmemobj_free(&nobj);
+	}
+}
+
+/*
+ * worker -- modifies its own object in a loop
+ */
+static void *
+worker(void *arg)
+{
+	unsigned idx = *(unsigned *)arg;
+	struct root *rootp = pmemobj_direct(pmemobj_root(pop,
+		sizeof(struct root)));
+	PMEMoid oid = rootp->objs[idx];
+
+	for (int i = 1; i <= NOPS; ++i) {
+		modify(oid, (int)idx * NOPS + i, i % 3 == 0);
+		int c = (int)idx * NOPS + (i % 3 == 0 ? i - 1 : i);
+		check(pmemobj_direct(oid), OBJ_SIZE, c);
+	}
+
+	return NULL;
+}
+
+/*
+ * resizer -- restarts the helper threads while the workers commit
+ */
+static void *
+resizer(void *arg)
+{
+	for (int i = 0; i < NRESIZES; ++i)
+		UT_ASSERTeq(ctl_set("tx.commit.flush_threads", i % 4), 0);
+
+	return NULL;
+}
+
+/*
+ * run_workers -- runs NTHREADS workers concurrently, optionally together
+ *	with the resizer
+ */
+static void
+run_workers(int resize)
+{
+	os_thread_t threads[NTHREADS];
+	os_thread_t resize_thread;
+	unsigned idx[NTHREADS];
+
+	for (unsigned i = 0; i < NTHREADS; ++i) {
+		idx[i] = i;
+		PTHREAD_CREATE(&threads[i], NULL, worker, &idx[i]);
+	}
+
+	if (resize)
+		PTHREAD_CREATE(&resize_thread, NULL, resizer, NULL);
+
+	for (unsigned i = 0; i < NTHREADS; ++i)
+		PTHREAD_JOIN(&threads[i], NULL);
+
+	if (resize)
+		PTHREAD_JOIN(&resize_thread, NULL);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_tx_flush_parallel");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	if ((pop = pmemobj_create(path, "flush_parallel", PMEMOBJ_MIN_POOL * 16,
+		S_IWUSR | S_IRUSR)) == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	/* disabled by default */
+	UT_ASSERTeq(ctl_get("tx.commit.flush_threads"), 0);
+	UT_ASSERTeq(ctl_get("tx.commit.flush_threshold"), 1 << 22);
+
+	UT_ASSERTeq(ctl_set("tx.commit.flush_threads", -1), -1);
+	UT_ASSERTeq(errno, EINVAL);
+	UT_ASSERTeq(ctl_set("tx.commit.flush_threshold", -1), -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	UT_ASSERTeq(ctl_set("tx.commit.flush_threads", 3), 0);
+	UT_ASSERTeq(ctl_set("tx.commit.flush_threshold", THRESHOLD), 0);
+	UT_ASSERTeq(ctl_get("tx.commit.flush_threads"), 3);
+	UT_ASSERTeq(ctl_get("tx.commit.flush_threshold"), THRESHOLD);
+
+	struct root *rootp = pmemobj_direct(pmemobj_root(pop,
+		sizeof(struct root)));
+
+	TX_BEGIN(pop) {
+		pmemobj_tx_add_range_direct(rootp, sizeof(*rootp));
+		for (unsigned i = 0; i < NTHREADS; ++i)
+			rootp->objs[i] = pmemobj_tx_zalloc(OBJ_SIZE, 0);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	modify(rootp->objs[0], 1, 0);
+	check(pmemobj_direct(rootp->objs[0]), OBJ_SIZE, 1);
+	modify(rootp->objs[0], 2, 1);
+	check(pmemobj_direct(rootp->objs[0]), OBJ_SIZE, 1);
+
+	/* commits compete for the helper threads */
+	run_workers(0);
+
+	/* the pool can be resized at runtime */
+	UT_ASSERTeq(ctl_set("tx.commit.flush_threads", 1), 0);
+	run_workers(0);
+
+	/* ... and turned off */
+	UT_ASSERTeq(ctl_set("tx.commit.flush_threads", 0), 0);
+	run_workers(0);
+
+	/* ... also while the transactions are being committed */
+	run_workers(1);
+	UT_ASSERTeq(ctl_get("tx.commit.flush_threads"), (NRESIZES - 1) % 4);
+
+	UT_ASSERTeq(ctl_set("tx.commit.flush_threads", 2), 0);
+	modify(rootp->objs[0], 3, 0);
+
+	/* the helper threads are stopped on close */
+	pmemobj_close(pop);
+
+	if ((pop = pmemobj_open(path, "flush_parallel")) == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	rootp = pmemobj_direct(pmemobj_root(pop, sizeof(struct root)));
+	check(pmemobj_direct(rootp->objs[0]), OBJ_SIZE, 3);
+	for (unsigned i = 1; i < NTHREADS; ++i)
+		check(pmemobj_direct(rootp->objs[i]), OBJ_SIZE,
+			(int)i * NOPS + NOPS);
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
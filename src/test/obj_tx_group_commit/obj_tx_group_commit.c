@@ -0,0 +1,291 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_tx_group_commit.c -- tests for the group commit of transactions
+ */
+
+#include "unittest.h"
+
+#define NTHREADS 8
+#define NOPS 1000
+#define NCOUNTERS 16
+#define NTOGGLES 64
+
+struct root {
+	uint64_t counters[NTHREADS][NCOUNTERS];
+	PMEMoid objs[NTHREADS];
+	uint64_t redo[NTHREADS][2]; /* written directly and deferred */
+};
+
+static PMEMobjpool *pop;
+static struct root *rootp;
+
+/*
+ * worker -- increments its own counters in tiny transactions, some of which
+ *	are aborted
+ */
+static void *
+worker(void *arg)
+{
+	unsigned idx = *(unsigned *)arg;
+	uint64_t *counters = rootp->counters[idx];
+
+	for (unsigned i = 0; i < NOPS; ++i) {
+		uint64_t *c = &counters[i % NCOUNTERS];
+		int abort = i % 7 == 0;
+
+		TX_BEGIN(pop) {
+			pmemobj_tx_add_range_direct(c, sizeof(*c));
+			*c += 1;
+
+			/* allocations are committed as usual */
+			if (i % 100 == 0) {
+				pmemobj_tx_add_range_direct(&rootp->objs[idx],
+					sizeof(PMEMoid));
+				pmemobj_tx_free(rootp->objs[idx]);
+				rootp->objs[idx] = pmemobj_tx_alloc(64, 0);
+			}
+
+			if (abort)
+				pmemobj_tx_abort(ECANCELED);
+		} TX_ONCOMMIT {
+			UT_ASSERT(!abort);
+		} TX_ONABORT {
+			UT_ASSERT(abort);
+		} TX_END
+	}
+
+	return NULL;
+}
+
+/*
+ * redo_worker -- increments its own counters with pmemobj_tx_redo_write,
+ *	the first one has been added to the transaction and is written
+ *	directly, the second one is written on commit
+ */
+static void *
+redo_worker(void *arg)
+{
+	unsigned idx = *(unsigned *)arg;
+	uint64_t *redo = rootp->redo[idx];
+
+	for (unsigned i = 0; i < NOPS; ++i) {
+		TX_BEGIN(pop) {
+			pmemobj_tx_add_range_direct(&redo[0], sizeof(redo[0]));
+
+			uint64_t v = redo[0] + 1;
+			UT_ASSERTeq(pmemobj_tx_redo_write(&redo[0], &v,
+				sizeof(v)), 0);
+
+			v = redo[1] + 1;
+			UT_ASSERTeq(pmemobj_tx_redo_write(&redo[1], &v,
+				sizeof(v)), 0);
+		} TX_ONABORT {
+			UT_ASSERT(0);
+		} TX_END
+	}
+
+	return NULL;
+}
+
+/*
+ * run_redo_workers -- runs NTHREADS redo workers concurrently and verifies
+ *	their counters
+ */
+static void
+run_redo_workers(void)
+{
+	os_thread_t threads[NTHREADS];
+	unsigned idx[NTHREADS];
+
+	for (unsigned i = 0; i < NTHREADS; ++i) {
+		idx[i] = i;
+		PTHREAD_CREATE(&threads[i], NULL, redo_worker, &idx[i]);
+	}
+
+	for (unsigned i = 0; i < NTHREADS; ++i)
+		PTHREAD_JOIN(&threads[i], NULL);
+
+	for (unsigned i = 0; i < NTHREADS; ++i) {
+		UT_ASSERTeq(rootp->redo[i][0], NOPS);
+		UT_ASSERTeq(rootp->redo[i][1], NOPS);
+	}
+}
+
+/*
+ * toggler -- turns the group commit on and off while the workers commit
+ */
+static void *
+toggler(void *arg)
+{
+	for (int i = 0; i < NTOGGLES; ++i) {
+		int group = i % 2;
+		int ret = pmemobj_ctl_set(pop, "tx.commit.group", &group);
+		UT_ASSERTeq(ret, 0);
+	}
+
+	return NULL;
+}
+
+/*
+ * run_workers -- runs NTHREADS workers concurrently, optionally together
+ *	with the toggler
+ */
+static void
+run_workers(int toggle)
+{
+	os_thread_t threads[NTHREADS];
+	os_thread_t toggle_thread;
+	unsigned idx[NTHREADS];
+
+	for (unsigned i = 0; i < NTHREADS; ++i) {
+		idx[i] = i;
+		PTHREAD_CREATE(&threads[i], NULL, worker, &idx[i]);
+	}
+
+	if (toggle)
+		PTHREAD_CREATE(&toggle_thread, NULL, toggler, NULL);
+
+	for (unsigned i = 0; i < NTHREADS; ++i)
+		PTHREAD_JOIN(&threads[i], NULL);
+
+	if (toggle)
+		PTHREAD_JOIN(&toggle_thread, NULL);
+}
+
+/*
+ * check -- verifies the counters after 'rounds' runs of the workers
+ */
+static void
+check(unsigned rounds)
+{
+	/* operations which aren't aborted, spread evenly among counters */
+	uint64_t expected = 0;
+	for (unsigned i = 0; i < NOPS; ++i) {
+		if (i % NCOUNTERS == 0 && i % 7 != 0)
+			expected++;
+	}
+
+	for (unsigned t = 0; t < NTHREADS; ++t) {
+		UT_ASSERTeq(rootp->counters[t][0], expected * rounds);
+		UT_ASSERT(!OID_IS_NULL(rootp->objs[t]));
+	}
+
+	uint64_t total = 0;
+	for (unsigned t = 0; t < NTHREADS; ++t) {
+		for (unsigned c = 0; c < NCOUNTERS; ++c)
+			total += rootp->counters[t][c];
+	}
+
+	UT_ASSERTeq(total, (uint64_t)NTHREADS * rounds * (NOPS - NOPS / 7 - 1));
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_tx_group_commit");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	if ((pop = pmemobj_create(path, "group_commit", PMEMOBJ_MIN_POOL,
+		S_IWUSR | S_IRUSR)) == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	int group;
+	int ret = pmemobj_ctl_get(pop, "tx.commit.group", &group);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(group, 0);
+
+	group = 1;
+	ret = pmemobj_ctl_set(pop, "tx.commit.group", &group);
+	UT_ASSERTeq(ret, 0);
+	ret = pmemobj_ctl_get(pop, "tx.commit.group", &group);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(group, 1);
+
+	rootp = pmemobj_direct(pmemobj_root(pop, sizeof(struct root)));
+
+	run_workers(0);
+	check(1);
+
+	/* the group commit can be combined with the helper flush threads */
+	long long threads = 2;
+	ret = pmemobj_ctl_set(pop, "tx.commit.flush_threads", &threads);
+	UT_ASSERTeq(ret, 0);
+	long long threshold = 0;
+	ret = pmemobj_ctl_set(pop, "tx.commit.flush_threshold", &threshold);
+	UT_ASSERTeq(ret, 0);
+
+	run_workers(0);
+	check(2);
+
+	pmemobj_close(pop);
+
+	if ((pop = pmemobj_open(path, "group_commit")) == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	rootp = pmemobj_direct(pmemobj_root(pop, sizeof(struct root)));
+	check(2);
+
+	/* ... and turned off again */
+	ret = pmemobj_ctl_set(pop, "tx.commit.group", &group);
+	UT_ASSERTeq(ret, 0);
+	group = 0;
+	ret = pmemobj_ctl_set(pop, "tx.commit.group", &group);
+	UT_ASSERTeq(ret, 0);
+
+	run_workers(0);
+	check(3);
+
+	/* ... also while the transactions are being committed */
+	run_workers(1);
+	check(4);
+
+	ret = pmemobj_ctl_get(pop, "tx.commit.group", &group);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(group, (NTOGGLES - 1) % 2);
+
+	/* the direct writes of the members are fenced before grouping */
+	group = 1;
+	ret = pmemobj_ctl_set(pop, "tx.commit.group", &group);
+	UT_ASSERTeq(ret, 0);
+
+	run_redo_workers();
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
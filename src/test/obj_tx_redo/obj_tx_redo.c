@@ -0,0 +1,288 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_tx_redo.c -- unit test for pmemobj_tx_redo_write and pmemobj_tx_redo_read
+ */
+
+#include "unittest.h"
+
+#define LAYOUT_NAME "obj_tx_redo"
+#define BUF_SIZE 4096
+#define LARGE_SIZE 3000 /* spans several ulogs of the redo log */
+
+struct root {
+	char buf[BUF_SIZE];
+};
+
+/*
+ * check_pattern -- checks that the range consists of the given byte
+ */
+static void
+check_pattern(const char *buf, int c, size_t off, size_t size)
+{
+	for (size_t i = off; i < off + size; ++i)
+		UT_ASSERTeq(buf[i], (char)c);
+}
+
+/*
+ * redo_write_pattern -- writes the byte pattern using the redo log
+ */
+static void
+redo_write_pattern(char *dest, int c, size_t size)
+{
+	char *src = (char *)MALLOC(size);
+	memset(src, c, size);
+	int ret = pmemobj_tx_redo_write(dest, src, size);
+	UT_ASSERTeq(ret, 0);
+	FREE(src);
+}
+
+/*
+ * test_commit -- deferred writes are visible through pmemobj_tx_redo_read and
+ *	applied on commit
+ */
+static void
+test_commit(PMEMobjpool *pop, struct root *rootp)
+{
+	char rbuf[256];
+
+	TX_BEGIN(pop) {
+		redo_write_pattern(rootp->buf, 'a', 100);
+		/* the persistent memory isn't modified until commit */
+		check_pattern(rootp->buf, 0, 0, 100);
+
+		/* overlapping and adjacent writes are merged */
+		redo_write_pattern(rootp->buf + 50, 'b', 100);
+		redo_write_pattern(rootp->buf + 150, 'c', 50);
+		redo_write_pattern(rootp->buf + 10, 'd', 10);
+
+		int ret = pmemobj_tx_redo_read(rbuf, rootp->buf, 256);
+		UT_ASSERTeq(ret, 0);
+		check_pattern(rbuf, 'a', 0, 10);
+		check_pattern(rbuf, 'd', 10, 10);
+		check_pattern(rbuf, 'a', 20, 30);
+		check_pattern(rbuf, 'b', 50, 100);
+		check_pattern(rbuf, 'c', 150, 50);
+		check_pattern(rbuf, 0, 200, 56);
+
+		/* a read of a part of the pending writes */
+		ret = pmemobj_tx_redo_read(rbuf, rootp->buf + 140, 20);
+		UT_ASSERTeq(ret, 0);
+		check_pattern(rbuf, 'b', 0, 10);
+		check_pattern(rbuf, 'c', 10, 10);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	check_pattern(rootp->buf, 'a', 0, 10);
+	check_pattern(rootp->buf, 'd', 10, 10);
+	check_pattern(rootp->buf, 'a', 20, 30);
+	check_pattern(rootp->buf, 'b', 50, 100);
+	check_pattern(rootp->buf, 'c', 150, 50);
+	check_pattern(rootp->buf, 0, 200, BUF_SIZE - 200);
+}
+
+/*
+ * test_abort -- deferred writes are discarded on abort
+ */
+static void
+test_abort(PMEMobjpool *pop, struct root *rootp)
+{
+	TX_BEGIN(pop) {
+		redo_write_pattern(rootp->buf + 1000, 'e', 100);
+		pmemobj_tx_abort(ECANCELED);
+	} TX_ONCOMMIT {
+		UT_ASSERT(0);
+	} TX_END
+
+	check_pattern(rootp->buf, 0, 1000, 100);
+}
+
+/*
+ * test_large -- writes that don't fit in a single ulog are committed along
+ *	with an allocation
+ */
+static void
+test_large(PMEMobjpool *pop, struct root *rootp)
+{
+	PMEMoid oid = OID_NULL;
+
+	TX_BEGIN(pop) {
+		redo_write_pattern(rootp->buf + 1000, 'f', LARGE_SIZE);
+		redo_write_pattern(rootp->buf + 1000 + LARGE_SIZE, 'g', 1);
+		oid = pmemobj_tx_zalloc(128, 0);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	check_pattern(rootp->buf, 'f', 1000, LARGE_SIZE);
+	check_pattern(rootp->buf, 'g', 1000 + LARGE_SIZE, 1);
+	check_pattern(pmemobj_direct(oid), 0, 0, 128);
+
+	pmemobj_free(&oid);
+}
+
+/*
+ * test_covered -- memory already covered by the transaction is modified
+ *	directly and rolled back by the undo log
+ */
+static void
+test_covered(PMEMobjpool *pop, struct root *rootp)
+{
+	PMEMoid root = pmemobj_root(pop, sizeof(struct root));
+
+	TX_BEGIN(pop) {
+		pmemobj_tx_add_range(root, 0, 64);
+		redo_write_pattern(rootp->buf + 8, 'h', 8);
+		check_pattern(rootp->buf, 'h', 8, 8);
+
+		PMEMoid oid = pmemobj_tx_alloc(64, 0);
+		char *obj = (char *)pmemobj_direct(oid);
+		redo_write_pattern(obj, 'i', 64);
+		check_pattern(obj, 'i', 0, 64);
+
+		pmemobj_tx_abort(ECANCELED);
+	} TX_ONCOMMIT {
+		UT_ASSERT(0);
+	} TX_END
+
+	check_pattern(rootp->buf, 'a', 0, 8);
+	check_pattern(rootp->buf, 'a', 8, 2);
+	check_pattern(rootp->buf, 'd', 10, 6);
+}
+
+/*
+ * test_add_range -- deferred writes to a range which is later added to the
+ *	transaction are applied right away, so they don't override the direct
+ *	stores on commit, and are rolled back on abort
+ */
+static void
+test_add_range(PMEMobjpool *pop, struct root *rootp)
+{
+	PMEMoid root = pmemobj_root(pop, sizeof(struct root));
+
+	TX_BEGIN(pop) {
+		redo_write_pattern(rootp->buf + 300, 'j', 100);
+		pmemobj_tx_add_range(root, 320, 40);
+		check_pattern(rootp->buf, 'j', 320, 40);
+		memset(rootp->buf + 330, 'k', 10);
+
+		/* the parts outside of the range are still deferred */
+		check_pattern(rootp->buf, 0, 300, 20);
+		check_pattern(rootp->buf, 0, 360, 40);
+	} TX_ONABORT {
+		UT_ASSERT(0);
+	} TX_END
+
+	check_pattern(rootp->buf, 'j', 300, 30);
+	check_pattern(rootp->buf, 'k', 330, 10);
+	check_pattern(rootp->buf, 'j', 340, 60);
+
+	TX_BEGIN(pop) {
+		redo_write_pattern(rootp->buf + 400, 'l', 100);
+		pmemobj_tx_add_range(root, 420, 20);
+		memset(rootp->buf + 430, 'm', 10);
+		pmemobj_tx_abort(ECANCELED);
+	} TX_ONCOMMIT {
+		UT_ASSERT(0);
+	} TX_END
+
+	check_pattern(rootp->buf, 0, 400, 100);
+}
+
+/*
+ * test_invalid -- ranges outside of the heap are rejected
+ */
+static void
+test_invalid(PMEMobjpool *pop)
+{
+	char rbuf[8];
+
+	errno = 0;
+	TX_BEGIN(pop) {
+		pmemobj_tx_redo_read(rbuf, pop, sizeof(rbuf));
+		UT_ASSERT(0);
+	} TX_ONCOMMIT {
+		UT_ASSERT(0);
+	} TX_END
+	UT_ASSERTeq(errno, EINVAL);
+
+	errno = 0;
+	TX_BEGIN(pop) {
+		pmemobj_tx_redo_write(pop, rbuf, sizeof(rbuf));
+		UT_ASSERT(0);
+	} TX_ONCOMMIT {
+		UT_ASSERT(0);
+	} TX_END
+	UT_ASSERTeq(errno, EINVAL);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_tx_redo");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s [file]", argv[0]);
+
+	PMEMobjpool *pop = pmemobj_create(argv[1], LAYOUT_NAME,
+		PMEMOBJ_MIN_POOL, S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create");
+
+	PMEMoid root = pmemobj_root(pop, sizeof(struct root));
+	struct root *rootp = (struct root *)pmemobj_direct(root);
+
+	test_commit(pop, rootp);
+	test_abort(pop, rootp);
+	test_large(pop, rootp);
+	test_covered(pop, rootp);
+	test_add_range(pop, rootp);
+	test_invalid(pop);
+
+	pmemobj_close(pop);
+
+	/* the committed writes must survive reopening the pool */
+	pop = pmemobj_open(argv[1], LAYOUT_NAME);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_open");
+
+	root = pmemobj_root(pop, sizeof(struct root));
+	rootp = (struct root *)pmemobj_direct(root);
+	check_pattern(rootp->buf, 'b', 50, 100);
+	check_pattern(rootp->buf, 'f', 1000, LARGE_SIZE);
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
@@ -0,0 +1,177 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_tx_ulog_retain.c -- tests for retention of the extended undo logs
+ */
+
+#include "unittest.h"
+
+#define SNAPSHOT_SIZE (256 * 1024)
+#define RETAIN_SIZE (1024 * 1024)
+#define DECAY 2
+
+/*
+ * allocated -- returns the number of bytes currently allocated in the heap
+ */
+static size_t
+allocated(PMEMobjpool *pop)
+{
+	size_t ret;
+	int err = pmemobj_ctl_get(pop, "stats.heap.curr_allocated", &ret);
+	UT_ASSERTeq(err, 0);
+
+	return ret;
+}
+
+/*
+ * snapshot -- snapshots 'size' bytes of the object, fills them with 'c' and
+ *	optionally aborts the transaction
+ */
+static void
+snapshot(PMEMobjpool *pop, PMEMoid oid, size_t size, int c, int abort)
+{
+	TX_BEGIN(pop) {
+		pmemobj_tx_add_range(oid, 0, size);
+		memset(pmemobj_direct(oid), c, size);
+		if (abort)
+			pmemobj_tx_abort(ECANCELED);
+	} TX_END
+}
+
+/*
+ * check -- verifies that the first 'size' bytes of the object are equal 'c'
+ */
+static void
+check(PMEMoid oid, size_t size, int c)
+{
+	unsigned char *data = pmemobj_direct(oid);
+	for (size_t i = 0; i < size; ++i)
+		UT_ASSERTeq(data[i], c);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_tx_ulog_retain");
+
+	if (argc != 2)
+		UT_FATAL("usage: %s file-name", argv[0]);
+
+	const char *path = argv[1];
+
+	PMEMobjpool *pop;
+	if ((pop = pmemobj_create(path, "ulog_retain", PMEMOBJ_MIN_POOL * 4,
+		S_IWUSR | S_IRUSR)) == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	int enabled = 1;
+	int ret = pmemobj_ctl_set(pop, "stats.enabled", &enabled);
+	UT_ASSERTeq(ret, 0);
+
+	long long retain;
+	ret = pmemobj_ctl_get(pop, "tx.cache.retain", &retain);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(retain, 0);
+
+	long long decay;
+	ret = pmemobj_ctl_get(pop, "tx.cache.decay", &decay);
+	UT_ASSERTeq(ret, 0);
+	UT_ASSERTeq(decay, 0);
+
+	retain = -1;
+	ret = pmemobj_ctl_set(pop, "tx.cache.retain", &retain);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	PMEMoid oid = pmemobj_root(pop, SNAPSHOT_SIZE);
+	UT_ASSERT(!OID_IS_NULL(oid));
+
+	/* by default only the first extended log is kept */
+	snapshot(pop, oid, SNAPSHOT_SIZE, 1, 0);
+	size_t base = allocated(pop);
+	snapshot(pop, oid, SNAPSHOT_SIZE, 2, 0);
+	UT_ASSERTeq(allocated(pop), base);
+
+	retain = RETAIN_SIZE;
+	ret = pmemobj_ctl_set(pop, "tx.cache.retain", &retain);
+	UT_ASSERTeq(ret, 0);
+
+	snapshot(pop, oid, SNAPSHOT_SIZE, 3, 0);
+	size_t retained = allocated(pop);
+	UT_ASSERT(retained >= base + SNAPSHOT_SIZE / 2);
+
+	/* the retained logs are reused */
+	snapshot(pop, oid, SNAPSHOT_SIZE, 4, 0);
+	UT_ASSERTeq(allocated(pop), retained);
+
+	/* ... and have no leftovers from the previous transactions */
+	snapshot(pop, oid, SNAPSHOT_SIZE, 5, 1);
+	check(oid, SNAPSHOT_SIZE, 4);
+	UT_ASSERTeq(allocated(pop), retained);
+
+	snapshot(pop, oid, SNAPSHOT_SIZE / 4, 6, 1);
+	check(oid, SNAPSHOT_SIZE, 4);
+
+	decay = DECAY;
+	ret = pmemobj_ctl_set(pop, "tx.cache.decay", &decay);
+	UT_ASSERTeq(ret, 0);
+
+	/* small transactions release the retained logs after 'decay' */
+	for (int i = 0; i < DECAY - 1; ++i) {
+		snapshot(pop, oid, 64, 7, 0);
+		UT_ASSERTeq(allocated(pop), retained);
+	}
+
+	snapshot(pop, oid, 64, 7, 0);
+	UT_ASSERTeq(allocated(pop), base);
+
+	/* a large transaction in between resets the decay */
+	snapshot(pop, oid, SNAPSHOT_SIZE, 8, 0);
+	UT_ASSERTeq(allocated(pop), retained);
+	snapshot(pop, oid, 64, 9, 0);
+	snapshot(pop, oid, SNAPSHOT_SIZE, 10, 0);
+	snapshot(pop, oid, 64, 11, 0);
+	UT_ASSERTeq(allocated(pop), retained);
+
+	retain = 0;
+	ret = pmemobj_ctl_set(pop, "tx.cache.retain", &retain);
+	UT_ASSERTeq(ret, 0);
+
+	snapshot(pop, oid, SNAPSHOT_SIZE, 12, 0);
+	UT_ASSERTeq(allocated(pop), base);
+	check(oid, SNAPSHOT_SIZE, 12);
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
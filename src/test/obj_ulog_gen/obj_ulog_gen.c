@@ -0,0 +1,308 @@
+/*
+ * Copyright 2018, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_ulog_gen.c -- tests for the generation-tagged undo logs
+ *
+ * usage: obj_ulog_gen file-name op:c|t|x|f|v|d...
+ *
+ * c - create the pool and enable the ULOG_GEN feature
+ * t - run a series of committed and aborted transactions
+ * x - crash in the middle of a transaction
+ * f - check that the feature cannot be disabled before recovery
+ * v - verify the state of the pool after recovery
+ * d - disable the ULOG_GEN feature
+ */
+
+#include "unittest.h"
+#include "lane.h"
+#include "obj.h"
+
+#include <libpmempool.h>
+
+#define LAYOUT "ulog_gen"
+#define SNAPSHOT_SIZE (64 * 1024)
+
+/* size of a snapshot which exactly fills the first undo log of a lane */
+#define BASE_FILL_SIZE (LANE_UNDO_SIZE - sizeof(struct ulog_entry_buf))
+
+/*
+ * snapshot -- snapshots 'size' bytes of the object, fills them with 'c' and
+ *	optionally aborts the transaction
+ */
+static void
+snapshot(PMEMobjpool *pop, PMEMoid oid, size_t size, int c, int abort)
+{
+	TX_BEGIN(pop) {
+		pmemobj_tx_add_range(oid, 0, size);
+		memset(pmemobj_direct(oid), c, size);
+		if (abort)
+			pmemobj_tx_abort(ECANCELED);
+	} TX_END
+}
+
+/*
+ * check -- verifies that 'size' bytes of the object at 'off' are equal 'c'
+ */
+static void
+check(PMEMoid oid, size_t off, size_t size, int c)
+{
+	unsigned char *data = pmemobj_direct(oid);
+	for (size_t i = off; i < off + size; ++i)
+		UT_ASSERTeq(data[i], c);
+}
+
+/*
+ * check_state -- verifies the state left by the 't' operation
+ */
+static void
+check_state(PMEMoid oid)
+{
+	check(oid, 0, 64, 3);
+	check(oid, 64, SNAPSHOT_SIZE / 2 - 64, 5);
+	check(oid, SNAPSHOT_SIZE / 2, SNAPSHOT_SIZE / 2, 1);
+}
+
+/*
+ * sum_gen -- returns the sum of the generations of all the undo logs
+ */
+static uint64_t
+sum_gen(PMEMobjpool *pop)
+{
+	uint64_t sum = 0;
+	for (uint64_t i = 0; i < pop->nlanes; ++i) {
+		struct lane_layout *layout = (void *)((char *)pop +
+			pop->lanes_offset + sizeof(struct lane_layout) * i);
+		sum += layout->undo.gen_num;
+	}
+
+	return sum;
+}
+
+/*
+ * open_pool -- opens the pool and returns its root object
+ */
+static PMEMobjpool *
+open_pool(const char *path, PMEMoid *root)
+{
+	PMEMobjpool *pop = pmemobj_open(path, LAYOUT);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_open: %s", path);
+
+	*root = pmemobj_root(pop, SNAPSHOT_SIZE);
+	UT_ASSERT(!OID_IS_NULL(*root));
+
+	return pop;
+}
+
+/*
+ * do_create -- creates the pool and enables the feature
+ */
+static void
+do_create(const char *path)
+{
+	PMEMobjpool *pop = pmemobj_create(path, LAYOUT,
+		PMEMOBJ_MIN_POOL * 4, S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		UT_FATAL("!pmemobj_create: %s", path);
+
+	PMEMoid root = pmemobj_root(pop, SNAPSHOT_SIZE);
+	UT_ASSERT(!OID_IS_NULL(root));
+	pmemobj_close(pop);
+
+	int ret = pmempool_feature_query(path, PMEMPOOL_FEAT_ULOG_GEN, 0);
+	UT_ASSERTeq(ret, 0);
+	ret = pmempool_feature_enable(path, PMEMPOOL_FEAT_ULOG_GEN, 0);
+	UT_ASSERTeq(ret, 0);
+	ret = pmempool_feature_query(path, PMEMPOOL_FEAT_ULOG_GEN, 0);
+	UT_ASSERTeq(ret, 1);
+}
+
+/*
+ * do_tx -- runs transactions which leave entries of the previous
+ *	generations in the undo logs
+ */
+static void
+do_tx(const char *path)
+{
+	PMEMoid root;
+	PMEMobjpool *pop = open_pool(path, &root);
+	uint64_t gen = sum_gen(pop);
+
+	snapshot(pop, root, SNAPSHOT_SIZE, 1, 0);
+	check(root, 0, SNAPSHOT_SIZE, 1);
+	UT_ASSERTeq(sum_gen(pop), gen + 1);
+
+	/*
+	 * Only the entries of the current generation are applied, the ones
+	 * in the extended log come from the previous transaction.
+	 */
+	snapshot(pop, root, BASE_FILL_SIZE, 2, 1);
+	check(root, 0, SNAPSHOT_SIZE, 1);
+	UT_ASSERTeq(sum_gen(pop), gen + 2);
+
+	snapshot(pop, root, SNAPSHOT_SIZE, 2, 1);
+	check(root, 0, SNAPSHOT_SIZE, 1);
+
+	snapshot(pop, root, 64, 3, 0);
+	snapshot(pop, root, SNAPSHOT_SIZE, 4, 1);
+	check(root, 0, 64, 3);
+	check(root, 64, SNAPSHOT_SIZE - 64, 1);
+
+	TX_BEGIN(pop) {
+		pmemobj_tx_add_range(root, 64, SNAPSHOT_SIZE / 2 - 64);
+		memset((char *)pmemobj_direct(root) + 64, 5,
+			SNAPSHOT_SIZE / 2 - 64);
+	} TX_END
+	check_state(root);
+
+	/* transactions that don't log anything don't start new generations */
+	gen = sum_gen(pop);
+	TX_BEGIN(pop) {
+	} TX_END
+	UT_ASSERTeq(sum_gen(pop), gen);
+
+	pmemobj_close(pop);
+
+	/* none of the stale entries is applied during recovery */
+	pop = open_pool(path, &root);
+	check_state(root);
+	pmemobj_close(pop);
+}
+
+/*
+ * do_crash -- exits in the middle of a transaction
+ */
+static void
+do_crash(const char *path)
+{
+	PMEMoid root;
+	PMEMobjpool *pop = open_pool(path, &root);
+
+	TX_BEGIN(pop) {
+		pmemobj_tx_add_range(root, 0, SNAPSHOT_SIZE);
+		memset(pmemobj_direct(root), 6, SNAPSHOT_SIZE);
+		exit(0); /* simulate a crash */
+	} TX_END
+}
+
+/*
+ * do_disable_fail -- checks that the feature cannot be disabled in a pool
+ *	which has to be recovered
+ */
+static void
+do_disable_fail(const char *path)
+{
+	int ret = pmempool_feature_disable(path, PMEMPOOL_FEAT_ULOG_GEN, 0);
+	UT_ASSERTeq(ret, -1);
+	UT_ASSERTeq(errno, EINVAL);
+
+	ret = pmempool_feature_query(path, PMEMPOOL_FEAT_ULOG_GEN, 0);
+	UT_ASSERTeq(ret, 1);
+}
+
+/*
+ * do_verify -- verifies the state of the pool
+ */
+static void
+do_verify(const char *path)
+{
+	PMEMoid root;
+	PMEMobjpool *pop = open_pool(path, &root);
+	check_state(root);
+	pmemobj_close(pop);
+}
+
+/*
+ * do_disable -- disables the feature and checks the legacy undo logs
+ */
+static void
+do_disable(const char *path)
+{
+	int ret = pmempool_feature_disable(path, PMEMPOOL_FEAT_ULOG_GEN, 0);
+	UT_ASSERTeq(ret, 0);
+
+	ret = pmempool_feature_query(path, PMEMPOOL_FEAT_ULOG_GEN, 0);
+	UT_ASSERTeq(ret, 0);
+
+	PMEMoid root;
+	PMEMobjpool *pop = open_pool(path, &root);
+	UT_ASSERTeq(sum_gen(pop), 0);
+	check_state(root);
+
+	snapshot(pop, root, SNAPSHOT_SIZE, 7, 1);
+	check_state(root);
+	UT_ASSERTeq(sum_gen(pop), 0);
+
+	pmemobj_close(pop);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_ulog_gen");
+
+	if (argc < 3)
+		UT_FATAL("usage: %s file-name op:c|t|x|f|v|d...", argv[0]);
+
+	const char *path = argv[1];
+
+	for (int arg = 2; arg < argc; ++arg) {
+		if (argv[arg][1] != '\0')
+			UT_FATAL("op must be c, t, x, f, v or d");
+
+		switch (argv[arg][0]) {
+		case 'c':
+			do_create(path);
+			break;
+		case 't':
+			do_tx(path);
+			break;
+		case 'x':
+			do_crash(path);
+			break;
+		case 'f':
+			do_disable_fail(path);
+			break;
+		case 'v':
+			do_verify(path);
+			break;
+		case 'd':
+			do_disable(path);
+			break;
+		default:
+			UT_FATAL("op must be c, t, x, f, v or d");
+		}
+	}
+
+	DONE(NULL);
+}
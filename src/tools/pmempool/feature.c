@@ -100,7 +100,8 @@ print_usage(const char *appname)
 {
 	printf("Usage: %s feature [<args>] <file>\n", appname);
 	printf(
-		"feature: SINGLEHDR, CKSUM_2K, SHUTDOWN_STATE, CHECK_BAD_BLOCKS\n");
+		"feature: SINGLEHDR, CKSUM_2K, SHUTDOWN_STATE, CHECK_BAD_BLOCKS,"
+		" ULOG_GEN\n");
 }
 
 /*